@@ -4,6 +4,21 @@
       "target_name": "znp",
       "sources": [
         "./src/znp.cc",
+        "./src/znp_txgov.cc",
+        "./src/znp_fanout.cc",
+        "./src/znp_groups.cc",
+        "./src/znp_shadow.cc",
+        "./src/znp_zcltypes.cc",
+        "./src/znp_zdowalk.cc",
+        "./src/znp_lqi.cc",
+        "./src/znp_topology.cc",
+        "./src/znp_rtg.cc",
+        "./src/znp_srcrtg.cc",
+        "./src/znp_interview.cc",
+        "./src/znp_devices.cc",
+        "./src/znp_devdb.cc",
+        "./src/znp_snapshot.cc",
+        "./src/znp_nvbackup.cc",
         "./deps/znp-host-framework/examples/zclSendRcv/zclSendRcv.c",
         "./deps/znp-host-framework/examples/zclSendRcv/zigbeeHa/zcl_gateway.c",
         "./deps/znp-host-framework/examples/zclSendRcv/zigbeeHa/znp_mngt.c",
@@ -49,6 +64,9 @@
             "-DZCL_LEVEL_CTRL", 
             "-DZCL_HVAC_CLUSTER",
             "-DZCL_ON_OFF", 
+            "-DZCL_GROUPS",
+            "-DZCL_SCENES",
+            "-DZCL_REPORT",
             "-DZCL_READ", 
             "-DZCL_WRITE", 
             "-DZCL_STANDALONE",
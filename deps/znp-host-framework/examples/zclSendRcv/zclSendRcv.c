@@ -44,6 +44,8 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "rpc.h"
 #include "mtSys.h"
@@ -114,11 +116,6 @@ static zclGw_callbacks_t zclGw_callbacks =
         NULL,
         zclGwZclGetSetPointCb };
 
-#define MAX_DEVICES 100
-epInfo_t deviceList[MAX_DEVICES] = {{0}};
-uint8_t devIdx = 0;
-uint8_t devCnt = 0;
-
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -138,41 +135,14 @@ void printHelp(void)
     dbg_print(PRINT_LEVEL_INFO, "'h' - this menu\n");
 }
 
-void printDevices(void)
-{
-    uint8_t idx;
-
-    printf("printDevices: cnt=%x:%x\n", &devCnt, devCnt);
-    dbg_print(PRINT_LEVEL_INFO, "Idx\tNwkAdd\tEndpoint\tDeviceId\n");
-    for(idx = 0; idx < devCnt; idx++)
-    {
-    	dbg_print(PRINT_LEVEL_INFO, "%d\t", idx);
-    	dbg_print(PRINT_LEVEL_INFO, "0x%04X\t", deviceList[idx].nwkAddr);
-    	dbg_print(PRINT_LEVEL_INFO, "0x%02X\t", deviceList[idx].endpoint);
-    	dbg_print(PRINT_LEVEL_INFO, "0x%04X\n", deviceList[idx].deviceID);
-    }
-}
-
 uint8_t zMngtZdoSimpleDescRspCb(epInfo_t *epInfo)
 {
     //process simple desc here
-    dbg_print(PRINT_LEVEL_INFO, "Device joined network:\n");
+    dbg_print(PRINT_LEVEL_INFO, "Device joined network: 0x%04X\t0x%02X\t0x%04X\n",
+            epInfo->nwkAddr, epInfo->endpoint, epInfo->deviceID);
 
-    if(devCnt < MAX_DEVICES)
-    {
-    	memcpy(&deviceList[devCnt], epInfo, sizeof(epInfo_t));
-       	dbg_print(PRINT_LEVEL_INFO, "%d\t", devCnt);
-        dbg_print(PRINT_LEVEL_INFO, "0x%04X\t", deviceList[devCnt].nwkAddr);
-        dbg_print(PRINT_LEVEL_INFO, "0x%02X\t", deviceList[devCnt].endpoint);
-        dbg_print(PRINT_LEVEL_INFO, "0x%04X\n", deviceList[devCnt].deviceID);
-	    devCnt++;
-    }
-    else
-    {
-    	dbg_print(PRINT_LEVEL_INFO, "Error: Max Devices in List\n");
-    }
+    //devices are kept by the addon's registry, not here
     zWZdoSimpleDescRspCb(epInfo);
-    //report the device to deviceJS
     return 0;
 }
 
@@ -260,15 +230,94 @@ uint8_t wZsetNVItem(uint16_t id, uint8_t len, uint8_t *value) {
     return zMngt_setNVItem(id, len, value);
 }
 
-uint8_t wZSendLqiReq(uint16_t dstAddr) 
+uint8_t wZSendLqiReq(uint16_t dstAddr, uint8_t startIndex)
 {
-    uint8_t status = 0;
     MgmtLqiReqFormat_t req;
     req.DstAddr = dstAddr;
+    req.StartIndex = startIndex;
+    return zdoMgmtLqiReq(&req);
+}
+
+uint8_t wZSendRtgReq(uint16_t dstAddr, uint8_t startIndex)
+{
+    MgmtRtgReqFormat_t req;
+    req.DstAddr = dstAddr;
+    req.StartIndex = startIndex;
+    return zdoMgmtRtgReq(&req);
+}
+
+uint8_t wZIeeeAddrReq(uint16_t nwkAddr)
+{
+    IeeeAddrReqFormat_t req;
+    req.ShortAddr = nwkAddr;
+    req.ReqType = 0; //single device response
     req.StartIndex = 0;
-    resetNodeTopology();
-    status = zdoMgmtLqiReq(&req);
-    return status;   
+    return zdoIeeeAddrReq(&req);
+}
+
+uint8_t wZNodeDescReq(uint16_t nwkAddr)
+{
+    NodeDescReqFormat_t req;
+    req.DstAddr = nwkAddr;
+    req.NwkAddrOfInterest = nwkAddr;
+    return zdoNodeDescReq(&req);
+}
+
+uint8_t wZActiveEpReq(uint16_t nwkAddr)
+{
+    ActiveEpReqFormat_t req;
+    req.DstAddr = nwkAddr;
+    req.NwkAddrOfInterest = nwkAddr;
+    return zdoActiveEpReq(&req);
+}
+
+uint8_t wZSimpleDescReq(uint16_t nwkAddr, uint8_t endpoint)
+{
+    SimpleDescReqFormat_t req;
+    req.DstAddr = nwkAddr;
+    req.NwkAddrOfInterest = nwkAddr;
+    req.Endpoint = endpoint;
+    return zdoSimpleDescReq(&req);
+}
+
+uint8_t wZNwkAddrReq(uint64_t ieeeAddr)
+{
+    NwkAddrReqFormat_t req;
+    uint8_t i;
+
+    for(i = 0; i < 8; i++)
+    {
+        req.IEEEAddress[i] = (uint8_t)(ieeeAddr >> (8 * i));
+    }
+    req.ReqType = 0; //single device response
+    req.StartIndex = 0;
+    return zdoNwkAddrReq(&req);
+}
+
+void wZStartTimings(zMngt_startTimings_t *timings)
+{
+    zMngt_getStartTimings(timings);
+}
+
+int wZNvLength(uint16_t id)
+{
+    return zMngt_nvLength(id);
+}
+
+int wZReadNVItem(uint16_t id, uint8_t *value, uint16_t maxLen)
+{
+    return zMngt_readNVItem(id, value, maxLen);
+}
+
+uint8_t wZWriteNVItem(uint16_t id, const uint8_t *value, uint16_t len)
+{
+    return zMngt_writeNVItem(id, value, len);
+}
+
+uint8_t wZResetZnp(void)
+{
+    dbg_print(PRINT_LEVEL_INFO, "Resetting the ZNP\n");
+    return zMngt_reset();
 }
 /*********************************************************************
 
@@ -282,10 +331,10 @@ uint32_t appInit(void)
     int_least32_t status = 0;
     uint_least32_t msgCnt = 0;
 
-    //Flush all messages from the que
+    //Flush all messages from the que, without waiting for more to arrive
     while (status != -1)
     {
-        status = rpcWaitMqClientMsg(100);
+        status = rpcWaitMqClientMsg(0);
         if (status != -1)
         {
             msgCnt++;
@@ -312,14 +361,56 @@ uint32_t appInit(void)
 
 //seperate mesage thread required so we can service the terminal and not block on messages
 uint8_t initDone = 0;
+
+//held while the message thread waits, so a caller running a series of
+//SREQs on its own can keep it from taking their responses
+static pthread_mutex_t msgLock = PTHREAD_MUTEX_INITIALIZER;
+static volatile uint8_t msgPaused = 0;
+
+//set to have appProcess start the network again, restored tells it to keep
+//what is in NV rather than form a new network
+static volatile uint8_t restartRequested = 0;
+static uint8_t restored = 0;
+
 int appMsgProcess(void *argument)
 {
-    if (initDone){
-        rpcWaitMqClientMsg(10000);
+    struct timespec req;
+
+    if (initDone && !msgPaused){
+        pthread_mutex_lock(&msgLock);
+        rpcWaitMqClientMsg(100);
+        pthread_mutex_unlock(&msgLock);
+    } else {
+        req.tv_sec = 0;
+        req.tv_nsec = 10000000;
+        nanosleep(&req, NULL);
     }
 	return 0;
 }
 
+uint8_t wZHoldMessages(uint8_t hold)
+{
+    if (hold) {
+        if (!initDone) {
+            return 0;
+        }
+        msgPaused = 1;
+        pthread_mutex_lock(&msgLock);
+    } else {
+        pthread_mutex_unlock(&msgLock);
+        msgPaused = 0;
+    }
+    return 1;
+}
+
+void wZRestartNetwork(uint8_t restore)
+{
+    if (restore) {
+        restored = 1;
+    }
+    restartRequested = 1;
+}
+
 int appProcess(void *argument)
 {
 	int32_t status;
@@ -335,21 +426,12 @@ int appProcess(void *argument)
 
     config_options *opts = (config_options*)argument;
 
-	//Flush all messages from the que
-	do
-	{
-		status = rpcWaitMqClientMsg(50);
-	} while (status != -1);
-
-	//We do not remember the device list so always start a new network for now
-    if(opts->newNwk) {
-        dbg_print(PRINT_LEVEL_INFO, "CLEARING NETWORK\n");
-        zMngt_clearNetwork(false);
-    } else {
-        dbg_print(PRINT_LEVEL_INFO, "RESTORING NETWORK\n");
-        zMngt_restoreNetwork();
-    }
-    status = zMngt_start(opts->devType, opts->channelMask, opts->newNwk, opts->panId);
+    //zMngt_start drains the queue, sets the startup option and resets the
+    //ZNP only if it has to, the device list is kept by the addon
+    //after an NV restore the network is the restored one, never a new one
+    restartRequested = 0;
+    dbg_print(PRINT_LEVEL_INFO, "%s NETWORK\n", (opts->newNwk && !restored) ? "CLEARING" : "RESTORING");
+    status = zMngt_start(opts->devType, opts->channelMask, opts->newNwk && !restored, opts->panId);
 
     if (status != MT_RPC_SUCCESS) {
         zWNetworkFailed();
@@ -364,7 +446,7 @@ int appProcess(void *argument)
 
 	initDone = 1;
 
-	while (1)
+	while (!restartRequested)
 	{
         //Set sleep time to 10ms
         req.tv_sec = 0;
@@ -372,6 +454,9 @@ int appProcess(void *argument)
         nanosleep(&req, &rem);
 	}
 
+    //appTask runs appProcess again
+    initDone = 0;
+    dbg_print(PRINT_LEVEL_INFO, "Restarting the network\n");
 	return 0;
 }
 
@@ -46,6 +46,8 @@
 #include "zcl.h"
 #include "zcl_general.h"
 
+#include "znp_cfuncs.h"
+
 #if defined ( INTER_PAN )
   #include "stub_aps.h"
 #endif
@@ -1067,8 +1069,8 @@ ZStatus_t zcl_SendCommand( uint8 srcEP, afAddrType_t *destAddr,
   msgLen = zclCalcHdrSize( &hdr );
   msgLen += cmdFormatLen;
 
-  // Allocate the buffer needed
-  msgBuf = zcl_mem_alloc( msgLen );
+  // Build the frame where the AF request wants it, no allocation or further copies
+  msgBuf = AF_DataRequestBuffer( destAddr, msgLen );
   if ( msgBuf != NULL )
   {
     // Fill in the ZCL Header
@@ -1079,11 +1081,11 @@ ZStatus_t zcl_SendCommand( uint8 srcEP, afAddrType_t *destAddr,
 
     status = AF_DataRequest( destAddr, epDesc, clusterID, msgLen, msgBuf,
                              &zcl_TransID, options, AF_DEFAULT_RADIUS );
-    zcl_mem_free ( msgBuf );
   }
   else
   {
-    status = ZMemError;
+    // larger frames have to be split by the caller
+    status = afStatus_INVALID_PARAMETER;
   }
 
   return ( status );
@@ -2162,6 +2164,13 @@ zclProcMsgStatus_t zcl_ProcessMessageMSG( afIncomingMSGPacket_t *pkt )
       // We don't support any manufacturer specific command
       status = ZCL_STATUS_UNSUP_MANU_GENERAL_COMMAND;
     }
+    else if ( ( inMsg.hdr.commandID == ZCL_CMD_READ_RSP || inMsg.hdr.commandID == ZCL_CMD_REPORT ) &&
+              zcl_HandleExternalRaw( &inMsg ) )
+    {
+      // Taken straight from the frame, without allocating a parsed copy
+      rawAFMsg = NULL;
+      return ( ZCL_PROC_SUCCESS ); // We're done
+    }
     else if ( ( inMsg.hdr.commandID <= ZCL_CMD_MAX ) &&
               ( zclCmdTable[inMsg.hdr.commandID].pfnParseInProfile != NULL ) )
     {
@@ -2966,41 +2975,8 @@ uint8 *zclSerializeData( uint8 dataType, void *attrData, uint8 *buf )
  */
 uint8 zclAnalogDataType( uint8 dataType )
 {
-  uint8 analog;
-
-  switch ( dataType )
-  {
-    case ZCL_DATATYPE_UINT8:
-    case ZCL_DATATYPE_UINT16:
-    case ZCL_DATATYPE_UINT24:
-    case ZCL_DATATYPE_UINT32:
-    case ZCL_DATATYPE_UINT40:
-    case ZCL_DATATYPE_UINT48:
-    case ZCL_DATATYPE_UINT56:
-    case ZCL_DATATYPE_UINT64:
-    case ZCL_DATATYPE_INT8:
-    case ZCL_DATATYPE_INT16:
-    case ZCL_DATATYPE_INT24:
-    case ZCL_DATATYPE_INT32:
-    case ZCL_DATATYPE_INT40:
-    case ZCL_DATATYPE_INT48:
-    case ZCL_DATATYPE_INT56:
-    case ZCL_DATATYPE_INT64:
-    case ZCL_DATATYPE_SEMI_PREC:
-    case ZCL_DATATYPE_SINGLE_PREC:
-    case ZCL_DATATYPE_DOUBLE_PREC:
-    case ZCL_DATATYPE_TOD:
-    case ZCL_DATATYPE_DATE:
-    case ZCL_DATATYPE_UTC:
-      analog = TRUE;
-      break;
-
-    default:
-      analog = FALSE;
-      break;
-  }
-
-  return ( analog );
+  // the addon's type table knows every ZCL data type
+  return ( zWZclAnalogType( dataType ) );
 }
 
 /*********************************************************************
@@ -3072,85 +3048,9 @@ static void zcl_BuildAnalogData( uint8 dataType, uint8 *pData, uint8 *pBuf )
  */
 uint8 zclGetDataTypeLength( uint8 dataType )
 {
-  uint8 len;
-
-  switch ( dataType )
-  {
-    case ZCL_DATATYPE_DATA8:
-    case ZCL_DATATYPE_BOOLEAN:
-    case ZCL_DATATYPE_BITMAP8:
-    case ZCL_DATATYPE_INT8:
-    case ZCL_DATATYPE_UINT8:
-    case ZCL_DATATYPE_ENUM8:
-      len = 1;
-      break;
-
-    case ZCL_DATATYPE_DATA16:
-    case ZCL_DATATYPE_BITMAP16:
-    case ZCL_DATATYPE_UINT16:
-    case ZCL_DATATYPE_INT16:
-    case ZCL_DATATYPE_ENUM16:
-    case ZCL_DATATYPE_SEMI_PREC:
-    case ZCL_DATATYPE_CLUSTER_ID:
-    case ZCL_DATATYPE_ATTR_ID:
-      len = 2;
-      break;
-
-    case ZCL_DATATYPE_DATA24:
-    case ZCL_DATATYPE_BITMAP24:
-    case ZCL_DATATYPE_UINT24:
-    case ZCL_DATATYPE_INT24:
-      len = 3;
-      break;
-
-    case ZCL_DATATYPE_DATA32:
-    case ZCL_DATATYPE_BITMAP32:
-    case ZCL_DATATYPE_UINT32:
-    case ZCL_DATATYPE_INT32:
-    case ZCL_DATATYPE_SINGLE_PREC:
-    case ZCL_DATATYPE_TOD:
-    case ZCL_DATATYPE_DATE:
-    case ZCL_DATATYPE_UTC:
-    case ZCL_DATATYPE_BAC_OID:
-      len = 4;
-      break;
-
-   case ZCL_DATATYPE_UINT40:
-   case ZCL_DATATYPE_INT40:
-       len = 5;
-       break;
-
-   case ZCL_DATATYPE_UINT48:
-   case ZCL_DATATYPE_INT48:
-       len = 6;
-       break;
-
-   case ZCL_DATATYPE_UINT56:
-   case ZCL_DATATYPE_INT56:
-       len = 7;
-       break;
-
-   case ZCL_DATATYPE_DOUBLE_PREC:
-   case ZCL_DATATYPE_IEEE_ADDR:
-   case ZCL_DATATYPE_UINT64:
-   case ZCL_DATATYPE_INT64:
-     len = 8;
-     break;
-
-    case ZCL_DATATYPE_128_BIT_SEC_KEY:
-     len = SEC_KEY_LEN;
-     break;
-
-    case ZCL_DATATYPE_NO_DATA:
-    case ZCL_DATATYPE_UNKNOWN:
-      // Fall through
-
-    default:
-      len = 0;
-      break;
-  }
-
-  return ( len );
+  // the addon's type table knows every ZCL data type, the 40 to 64 bit
+  // data and bitmap types included
+  return ( zWZclTypeLength( dataType ) );
 }
 
 /*********************************************************************
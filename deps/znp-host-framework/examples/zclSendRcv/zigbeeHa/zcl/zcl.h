@@ -838,6 +838,12 @@ extern uint8 zcl_TransID;
   */
 extern uint8 zcl_HandleExternal( zclIncoming_t *pInMsg );
 
+ /*
+  * callback function to handle a foundation message straight from the frame,
+  * before it is parsed. Returns TRUE if it was handled.
+  */
+extern uint8 zcl_HandleExternalRaw( zclIncoming_t *pInMsg );
+
 
 #if !defined ( ZCL_STANDALONE )
  /*
@@ -2024,7 +2024,7 @@ static ZStatus_t zclGeneral_ProcessInGroupsServer( zclIncoming_t *pInMsg )
         uint8 numGroups;
         uint16 groupList[APS_MAX_GROUPS];
 
-        if ( numGroups = aps_FindAllGroupsForEndpoint( pInMsg->msg->endPoint, groupList ) )
+        if ( ( numGroups = aps_FindAllGroupsForEndpoint( pInMsg->msg->endPoint, groupList ) ) )
         {
           for ( i = 0; i < numGroups; i++ )
           {
@@ -72,7 +72,7 @@
 #define LIGHT_ON              0x01
 
 #define ZSW_MAX_INCLUSTERS       2
-#define ZSW_MAX_OUTCLUSTERS      1
+#define ZSW_MAX_OUTCLUSTERS      3
 
 //*****************************************************************************
 // LOCAL VARIABLE
@@ -85,7 +85,7 @@ static uint_least16_t inputClusters[ZSW_MAX_INCLUSTERS] =
 ZCL_CLUSTER_ID_GEN_BASIC, ZCL_CLUSTER_ID_GEN_IDENTIFY };
 static uint_least16_t outputClusters[ZSW_MAX_OUTCLUSTERS] =
 {
-ZCL_CLUSTER_ID_GEN_ON_OFF };
+ZCL_CLUSTER_ID_GEN_ON_OFF, ZCL_CLUSTER_ID_GEN_GROUPS, ZCL_CLUSTER_ID_GEN_SCENES };
 
 //! \brief Attribute variables
 //!
@@ -150,6 +150,15 @@ static uint_least8_t zgwTransID = 0;
 //!
 static void regEndpoints(void);
 
+//! \brief Group and Scene response callbacks
+//!
+#ifdef ZCL_GROUPS
+static void zclGw_GroupRspCb(zclGroupRsp_t *pRsp);
+#endif
+#ifdef ZCL_SCENES
+static void zclGw_SceneRspCb(zclSceneRsp_t *pRsp);
+#endif
+
 //! \brief ZCL General Profile Callback table
 //!
 static zclGeneral_AppCallbacks_t cmdCallbacks =
@@ -173,12 +182,12 @@ static zclGeneral_AppCallbacks_t cmdCallbacks =
         NULL,                                   // Level Control Stop command
 #endif
 #ifdef ZCL_GROUPS
-        NULL,                                   // Group Response commands
+        zclGw_GroupRspCb,                       // Group Response commands
 #endif
 #ifdef ZCL_SCENES
         NULL,                                   // Scene Store Request command
         NULL,// Scene Recall Request command
-        NULL,// Scene Response command
+        zclGw_SceneRspCb,// Scene Response command
 #endif
 #ifdef ZCL_ALARMS
         NULL,                                   // Alarm (Response) commands
@@ -275,6 +284,20 @@ const zclAttrRec_t zswAttrs[ZSW_MAX_ATTRIBUTES] =
 static void processZclReadAttributeRsp(afAddrType_t srcAddr, uint8_t zclTransId,
 uint16_t clusterId, uint16_t payloadLen, uint8_t *pPayload);
 
+#ifdef ZCL_REPORT
+//! \brief Function for processing attribute reports and reporting configuration responses
+//!
+static void processZclReportCmd(zclIncoming_t *pInMsg);
+
+//! \brief Function for processing attribute reports straight from the frame
+//!
+static void processZclReportRaw(zclIncoming_t *pInMsg);
+#endif
+
+//! \brief Function for processing write attribute responses
+//!
+static void processZclWriteAttributeRsp(zclIncoming_t *pInMsg);
+
 //! \brief AfCallbacks for passing raw AF to ZCL for decoding
 //!
 static uint_least8_t mtAfDataConfirmCb(DataConfirmFormat_t *msg);
@@ -372,7 +395,7 @@ static uint_least8_t mtAfDataConfirmCb(DataConfirmFormat_t *msg)
         dbg_print(PRINT_LEVEL_INFO, "ZigBee: Message failed to transmit\n");
     }
 
-    zWDataResponseConfirm(&msg->Status);
+    zWDataResponseConfirm(&msg->Status, msg->TransId);
     
     return msg->Status;
 }
@@ -422,6 +445,271 @@ static void regEndpoints(void)
 }
 
 
+#ifdef ZCL_GROUPS
+//! \brief ZCL callback for Group responses (add, remove, view, get membership)
+//! \param[in]      pRsp - decoded group response
+//! \return         none
+static void zclGw_GroupRspCb(zclGroupRsp_t *pRsp)
+{
+    group_response resp;
+    uint8_t i;
+
+    memset(&resp, 0, sizeof(resp));
+    resp.srcAddr = pRsp->srcAddr->addr.shortAddr;
+    resp.endPoint = pRsp->srcAddr->endPoint;
+    resp.clusterId = ZCL_CLUSTER_ID_GEN_GROUPS;
+    resp.cmdId = pRsp->cmdID;
+    resp.status = pRsp->status;
+    resp.capacity = pRsp->capacity;
+    for (i = 0; i < pRsp->grpCnt && i < GROUP_RESPONSE_MAX_GROUPS; i++)
+    {
+        resp.grpList[i] = pRsp->grpList[i];
+    }
+    resp.grpCnt = i;
+    if (resp.grpCnt > 0)
+    {
+        resp.groupId = resp.grpList[0];
+    }
+
+    zWGroupResponse(&resp);
+}
+#endif
+
+#ifdef ZCL_SCENES
+//! \brief ZCL callback for Scene responses (add, view, remove, store, get membership)
+//! \param[in]      pRsp - decoded scene response
+//! \return         none
+static void zclGw_SceneRspCb(zclSceneRsp_t *pRsp)
+{
+    group_response resp;
+
+    memset(&resp, 0, sizeof(resp));
+    resp.srcAddr = pRsp->srcAddr->addr.shortAddr;
+    resp.endPoint = pRsp->srcAddr->endPoint;
+    resp.clusterId = ZCL_CLUSTER_ID_GEN_SCENES;
+    resp.cmdId = pRsp->cmdID;
+    resp.status = pRsp->status;
+    resp.capacity = pRsp->capacity;
+    if (pRsp->scene != NULL)
+    {
+        resp.groupId = pRsp->scene->groupID;
+        resp.sceneId = pRsp->scene->ID;
+    }
+
+    zWGroupResponse(&resp);
+}
+#endif
+
+//! \brief Function for processing write attribute responses
+//! \param[in]      pInMsg - incoming message, attrCmd holds the parsed command
+//! \return         none
+static void processZclWriteAttributeRsp(zclIncoming_t *pInMsg)
+{
+    zclWriteRspCmd_t *writeRsp = (zclWriteRspCmd_t *) pInMsg->attrCmd;
+    report_response rsp;
+    uint8_t i;
+
+    if (writeRsp == NULL)
+    {
+        return;
+    }
+
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.srcAddr = pInMsg->msg->srcAddr.addr.shortAddr;
+    rsp.endPoint = pInMsg->msg->srcAddr.endPoint;
+    rsp.clusterId = pInMsg->msg->clusterId;
+    rsp.transId = pInMsg->hdr.transSeqNum;
+    rsp.cmdId = pInMsg->hdr.commandID;
+
+    // a single success record without attribute id means every attribute was written
+    for (i = 0; i < writeRsp->numAttr && i < REPORT_MAX_ATTRS; i++)
+    {
+        rsp.attrs[i].status = writeRsp->attrList[i].status;
+        rsp.attrs[i].attrId = writeRsp->attrList[i].attrID;
+    }
+    rsp.numAttr = i;
+
+    zWWriteAttributeRsp(&rsp);
+}
+
+#ifdef ZCL_REPORT
+//! \brief Copy an attribute value (or reportable change) into a report record
+//! \param[in]      rec - record to fill
+//! \param[in]      pData - value, as parsed by ZCL
+//! \param[in]      len - value length
+//! \return         FALSE if the value does not fit, the record is then left out
+//!                 rather than passed on (and cached) cut short
+static uint8_t copyReportValue(report_record *rec, uint8_t *pData, uint16_t len)
+{
+    if (pData == NULL)
+    {
+        len = 0;
+    }
+    if (len > REPORT_MAX_VALUE)
+    {
+        return FALSE;
+    }
+    rec->len = len;
+    if (len > 0)
+    {
+        memcpy(rec->value, pData, len);
+    }
+    return TRUE;
+}
+
+//! \brief Function for processing attribute reports and reporting configuration responses
+//! \param[in]      pInMsg - incoming message, attrCmd holds the parsed command
+//! \return         none
+static void processZclReportCmd(zclIncoming_t *pInMsg)
+{
+    report_response rsp;
+    uint8_t i;
+
+    if (pInMsg->attrCmd == NULL)
+    {
+        return;
+    }
+
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.srcAddr = pInMsg->msg->srcAddr.addr.shortAddr;
+    rsp.endPoint = pInMsg->msg->srcAddr.endPoint;
+    rsp.clusterId = pInMsg->msg->clusterId;
+    rsp.transId = pInMsg->hdr.transSeqNum;
+    rsp.cmdId = pInMsg->hdr.commandID;
+
+    switch (pInMsg->hdr.commandID)
+    {
+    case ZCL_CMD_REPORT:
+    {
+        zclReportCmd_t *report = (zclReportCmd_t *) pInMsg->attrCmd;
+        uint8_t n;
+
+        for (i = 0, n = 0; n < report->numAttr && i < REPORT_MAX_ATTRS; n++)
+        {
+            report_record *rec = &rsp.attrs[i];
+
+            rec->attrId = report->attrList[n].attrID;
+            rec->dataType = report->attrList[n].dataType;
+            if (copyReportValue(rec, report->attrList[n].attrData,
+                    zclGetAttrDataLength(rec->dataType,
+                            report->attrList[n].attrData)))
+            {
+                i++;
+            }
+        }
+        break;
+    }
+
+    case ZCL_CMD_CONFIG_REPORT_RSP:
+    {
+        zclCfgReportRspCmd_t *cfgRsp = (zclCfgReportRspCmd_t *) pInMsg->attrCmd;
+
+        // a single success record without attribute id means every attribute was configured
+        for (i = 0; i < cfgRsp->numAttr && i < REPORT_MAX_ATTRS; i++)
+        {
+            rsp.attrs[i].status = cfgRsp->attrList[i].status;
+            rsp.attrs[i].direction = cfgRsp->attrList[i].direction;
+            rsp.attrs[i].attrId = cfgRsp->attrList[i].attrID;
+        }
+        break;
+    }
+
+    case ZCL_CMD_READ_REPORT_CFG_RSP:
+    {
+        zclReadReportCfgRspCmd_t *cfgRsp =
+                (zclReadReportCfgRspCmd_t *) pInMsg->attrCmd;
+
+        for (i = 0; i < cfgRsp->numAttr && i < REPORT_MAX_ATTRS; i++)
+        {
+            report_record *rec = &rsp.attrs[i];
+            zclReportCfgRspRec_t *cfg = &cfgRsp->attrList[i];
+
+            rec->status = cfg->status;
+            rec->direction = cfg->direction;
+            rec->attrId = cfg->attrID;
+
+            // the rest of the record is only parsed for successful reads
+            if (cfg->status != ZCL_STATUS_SUCCESS)
+            {
+                continue;
+            }
+            if (cfg->direction == ZCL_SEND_ATTR_REPORTS)
+            {
+                rec->dataType = cfg->dataType;
+                rec->minInterval = cfg->minReportInt;
+                rec->maxInterval = cfg->maxReportInt;
+                if (zclAnalogDataType(cfg->dataType))
+                {
+                    copyReportValue(rec, cfg->reportableChange,
+                            zclGetDataTypeLength(cfg->dataType));
+                }
+            } else
+            {
+                rec->timeoutPeriod = cfg->timeoutPeriod;
+            }
+        }
+        break;
+    }
+
+    default:
+        return;
+    }
+    rsp.numAttr = i;
+
+    zWAttributeReport(&rsp);
+}
+
+//! \brief Function for processing attribute reports straight from the frame
+//! \param[in]      pInMsg - incoming message, pData holds the unparsed records
+//! \return         none
+static void processZclReportRaw(zclIncoming_t *pInMsg)
+{
+    report_response rsp;
+    uint8_t *pBuf = pInMsg->pData;
+    uint8_t *pEnd = pInMsg->pData + pInMsg->pDataLen;
+    uint8_t i = 0;
+
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.srcAddr = pInMsg->msg->srcAddr.addr.shortAddr;
+    rsp.endPoint = pInMsg->msg->srcAddr.endPoint;
+    rsp.clusterId = pInMsg->msg->clusterId;
+    rsp.transId = pInMsg->hdr.transSeqNum;
+    rsp.cmdId = pInMsg->hdr.commandID;
+
+    // records: attrId, dataType, value
+    while (i < REPORT_MAX_ATTRS && pBuf + 3 <= pEnd)
+    {
+        report_record *rec = &rsp.attrs[i];
+        uint16_t len;
+
+        rec->attrId = BUILD_UINT16(pBuf[0], pBuf[1]);
+        rec->dataType = pBuf[2];
+        pBuf += 3;
+
+        // a truncated record ends the report, string lengths are read from the frame
+        if ((rec->dataType != ZCL_DATATYPE_NO_DATA && pBuf >= pEnd) ||
+                ((rec->dataType == ZCL_DATATYPE_LONG_OCTET_STR ||
+                  rec->dataType == ZCL_DATATYPE_LONG_CHAR_STR) && pBuf + 2 > pEnd))
+        {
+            break;
+        }
+        len = zclGetAttrDataLength(rec->dataType, pBuf);
+        if (len > pEnd - pBuf)
+        {
+            break;
+        }
+        if (copyReportValue(rec, pBuf, len))
+        {
+            i++;
+        }
+        pBuf += len;
+    }
+    rsp.numAttr = i;
+
+    zWAttributeReport(&rsp);
+}
+#endif
+
 int8_t waitZclGetRsp(void)
 {
     uint_least8_t delayCnt = 0;
@@ -450,47 +738,30 @@ int8_t waitZclGetRsp(void)
 //! \param[in]      payloadLen - length of pPayload
 //! \param[in]      pPayload - APS payload from incoming message indication
 //! \return         none
-
-attr_response resp;
 static void processZclReadAttributeRsp(afAddrType_t srcAddr, uint8_t zclTransId,
 uint16_t clusterId, uint16_t payloadLen, uint8_t *pPayload)
 {
     uint16_t attrId;
+    attr_response *resp;
 
-    resp.srcAddr = srcAddr.addr.shortAddr;
-    resp.endPoint = srcAddr.endPoint;
-    resp.addrMode = srcAddr.addrMode;
-    resp.transId = zclTransId;
-    resp.clusterId = clusterId;
-    resp.payloadLen = payloadLen;
-
-    int k = 0;
-    for(k = 0; k < resp.payloadLen; k++) {
-        resp.payload[k] = pPayload[k];
+    // the only copy of the payload, handed over to the addon which frees it
+    resp = (attr_response *) malloc(sizeof(attr_response));
+    if (resp != NULL)
+    {
+        if (payloadLen > sizeof(resp->payload))
+        {
+            payloadLen = sizeof(resp->payload);
+        }
+        resp->srcAddr = srcAddr.addr.shortAddr;
+        resp->endPoint = srcAddr.endPoint;
+        resp->addrMode = srcAddr.addrMode;
+        resp->transId = zclTransId;
+        resp->clusterId = clusterId;
+        resp->payloadLen = payloadLen;
+        memcpy(resp->payload, pPayload, payloadLen);
+
+        zWInformReadAttritubeRsp(resp);
     }
-
-
-    // resp.payload = pPayload;
-    // if(payloadLen) {
-    //     resp.payload = (uint8_t*) malloc(payloadLen * sizeof(uint8_t));
-    //     memcpy(resp.payload, pPayload, payloadLen * sizeof(uint8_t));
-    // }
-
-
-    // printf("\t srcAddr: %d\n",             resp.srcAddr              );
-    // printf("\t endPoint: %d\n",           resp.endPoint              );
-    // printf("\t addrMode: %d\n",             resp.addrMode              );
-    // printf("\t transId: %d\n",           resp.transId              );
-    // printf("\t clusterId: %d\n",             resp.clusterId              );
-    // printf("\t payloadLen: %d\n",           resp.payloadLen              );
-    // printf("\t payload: ");
-    // int i = 0;
-    // for(i = 0; i < resp.payloadLen; i++) {
-    //     printf("%d ", resp.payload[i]);
-    // }
-    // printf("\n");
-
-    zWInformReadAttritubeRsp(&resp);
     //printf( "Processing Read Attribute Response:" );
     //printf( " zclTransId %d, clusterId %d, payloadlen %d\n",
     //          zclTransId, clusterId, payloadLen );
@@ -687,8 +958,55 @@ uint16_t clusterId, uint16_t payloadLen, uint8_t *pPayload)
 uint_least8_t zGw_addGroup(uint16_t groupId, uint16_t dstAddr, uint8_t endpoint,
         uint8_t addrMode)
 {
-    //TODO
-    return afStatus_FAILED;
+    afAddrType_t afDstAddr;
+    uint8_t groupName[1] =
+    { 0 };
+
+    afDstAddr.addr.shortAddr = dstAddr;
+    afDstAddr.endPoint = endpoint;
+    afDstAddr.addrMode = (afAddrMode_t) addrMode;
+
+    return zclGeneral_SendGroupAdd(ZGW_EP, &afDstAddr, groupId, groupName,
+            FALSE, zgwTransID++);
+}
+
+//! \brief          Device control API: Remove a device from a group
+//! \param[in]      groupId - ID of the group to be removed from
+//! \param[in]      dstAddr - nwk addr of device to be removed
+//! \param[in]      endpoint - end point on the device to be removed from the group
+//! \param[in]      addrMode - address mode of dstAddr (afAddr16Bit or afAddrGroup)
+//! \return        	status
+uint_least8_t zGw_removeGroup(uint16_t groupId, uint16_t dstAddr,
+        uint8_t endpoint, uint8_t addrMode)
+{
+    afAddrType_t afDstAddr;
+
+    afDstAddr.addr.shortAddr = dstAddr;
+    afDstAddr.endPoint = endpoint;
+    afDstAddr.addrMode = (afAddrMode_t) addrMode;
+
+    return zclGeneral_SendGroupRemove(ZGW_EP, &afDstAddr, groupId, FALSE,
+            zgwTransID++);
+}
+
+//! \brief          Device control API: ask a device for all the groups it is in,
+//!                 the answer comes back through the group response callback
+//! \param[in]      dstAddr - nwk addr of device to query
+//! \param[in]      endpoint - end point on the device to query
+//! \param[in]      addrMode - address mode of dstAddr (afAddr16Bit or afAddrGroup)
+//! \return        	status
+uint_least8_t zGw_getGroupMembership(uint16_t dstAddr, uint8_t endpoint,
+        uint8_t addrMode)
+{
+    afAddrType_t afDstAddr;
+
+    afDstAddr.addr.shortAddr = dstAddr;
+    afDstAddr.endPoint = endpoint;
+    afDstAddr.addrMode = (afAddrMode_t) addrMode;
+
+    //an empty group list asks for every group
+    return zclGeneral_SendGroupGetMembership(ZGW_EP, &afDstAddr, 0, NULL,
+            FALSE, zgwTransID++);
 }
 
 //! \brief          Device control API: store a scene on a device
@@ -701,8 +1019,14 @@ uint_least8_t zGw_addGroup(uint16_t groupId, uint16_t dstAddr, uint8_t endpoint,
 uint_least8_t zGw_storeScene(uint16_t groupId, uint8_t sceneId,
         uint16_t dstAddr, uint8_t endpoint, afAddrMode_t addrMode)
 {
-    //TODO
-    return afStatus_FAILED;
+    afAddrType_t afDstAddr;
+
+    afDstAddr.addr.shortAddr = dstAddr;
+    afDstAddr.endPoint = endpoint;
+    afDstAddr.addrMode = addrMode;
+
+    return zclGeneral_SendSceneStore(ZGW_EP, &afDstAddr, groupId, sceneId, FALSE,
+            zgwTransID++);
 }
 
 //! \brief          Device control API: recall a scene on a device
@@ -715,8 +1039,14 @@ uint_least8_t zGw_storeScene(uint16_t groupId, uint8_t sceneId,
 uint_least8_t zGw_recallScene(uint16_t groupId, uint8_t sceneId,
         uint16_t dstAddr, uint8_t endpoint, afAddrMode_t addrMode)
 {
-    //TODO
-    return afStatus_FAILED;
+    afAddrType_t afDstAddr;
+
+    afDstAddr.addr.shortAddr = dstAddr;
+    afDstAddr.endPoint = endpoint;
+    afDstAddr.addrMode = addrMode;
+
+    return zclGeneral_SendSceneRecall(ZGW_EP, &afDstAddr, groupId, sceneId, FALSE,
+            zgwTransID++);
 }
 
 //! \brief          Device control API: binds a device output cluster (src) to
@@ -1213,9 +1543,19 @@ void zclGw_Init(void)
 //! \return        	none
 void zclGw_InitZcl(void)
 {
-    // Setup the endpoints
+    static uint8_t registered = 0;
+
+    // Setup the endpoints, the ZNP forgets them whenever it is reset
     regEndpoints();
 
+    // The host side lists only grow, register once however often the
+    // network is started
+    if (registered)
+    {
+        return;
+    }
+    registered = 1;
+
     // Register the ZCL General Cluster Library callback functions
     zclGeneral_RegisterCmdCallbacks( ZGW_EP, &cmdCallbacks);
 
@@ -1264,24 +1604,23 @@ void zclGw_processInCmds(zclIncoming_t *pInMsg)
 
         case ZCL_CMD_WRITE_RSP:
             // Process write attribute response
-            printf("ZigBee NOT SUPPORTED: ZCL_CMD_WRITE_RSP\n");
+            processZclWriteAttributeRsp(pInMsg);
             break;
 
+#ifdef ZCL_REPORT
         case ZCL_CMD_CONFIG_REPORT_RSP:
-            // Process read report configuration response
-            printf("ZigBee NOT SUPPORTED: ZCL_CMD_CONFIG_REPORT_RSP\n");
+        case ZCL_CMD_READ_REPORT_CFG_RSP:
+        case ZCL_CMD_REPORT:
+            // Process reporting configuration response or attribute report indication
+            processZclReportCmd(pInMsg);
             break;
+#endif
 
         case ZCL_CMD_DEFAULT_RSP:
             // Process default response
             printf("ZigBee NOT SUPPORTED: ZCL_CMD_DEFAULT_RSP\n");
             break;
 
-        case ZCL_CMD_REPORT:
-            // Process attribute report indication
-            printf("ZigBee NOT SUPPORTED: ZCL_CMD_REPORT\n");
-            break;
-
         case ZCL_CMD_DISCOVER_ATTRS_RSP:
             // Process discover attributes response
             printf("ZigBee NOT SUPPORTED: ZCL_CMD_DISCOVER_ATTRS_RSP\n");
@@ -1298,5 +1637,34 @@ void zclGw_processInCmds(zclIncoming_t *pInMsg)
     }
 }
 
+//! \brief          Process read attribute responses and attribute reports straight
+//!                 from the frame, before ZCL parses them
+//! \param[in]      pInMsg: pointer to the incoming message, attrCmd is not filled in
+//! \return        	TRUE if handled
+uint8_t zclGw_processInRaw(zclIncoming_t *pInMsg)
+{
+    if (!zcl_ClientCmd(pInMsg->hdr.fc.direction))
+    {
+        return FALSE;
+    }
+
+    switch (pInMsg->hdr.commandID)
+    {
+    case ZCL_CMD_READ_RSP:
+        processZclReadAttributeRsp( pInMsg->msg->srcAddr, pInMsg->hdr.transSeqNum, pInMsg->msg->clusterId,
+                                      pInMsg->pDataLen, pInMsg->pData );
+        return TRUE;
+
+#ifdef ZCL_REPORT
+    case ZCL_CMD_REPORT:
+        processZclReportRaw(pInMsg);
+        return TRUE;
+#endif
+
+    default:
+        return FALSE;
+    }
+}
+
 /*******************************************************************************
  ******************************************************************************/
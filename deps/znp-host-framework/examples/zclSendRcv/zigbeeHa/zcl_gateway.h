@@ -128,6 +128,24 @@ typedef struct
 uint_least8_t zGw_addGroup(uint16_t groupId, uint16_t dstAddr, uint8_t endpoint,
         uint8_t addrMode);
 
+//! \brief          Device control API: Remove a device from a group
+//! \param[in]      groupId - ID of the group to be removed from
+//! \param[in]      dstAddr - nwk addr of device to be removed
+//! \param[in]      endpoint - end point on the device to be removed from the group
+//! \param[in]      addrMode - address mode of dstAddr (afAddr16Bit or afAddrGroup)
+//! \return        	status
+uint_least8_t zGw_removeGroup(uint16_t groupId, uint16_t dstAddr,
+        uint8_t endpoint, uint8_t addrMode);
+
+//! \brief          Device control API: ask a device for all the groups it is in,
+//!                 the answer comes back through the group response callback
+//! \param[in]      dstAddr - nwk addr of device to query
+//! \param[in]      endpoint - end point on the device to query
+//! \param[in]      addrMode - address mode of dstAddr (afAddr16Bit or afAddrGroup)
+//! \return        	status
+uint_least8_t zGw_getGroupMembership(uint16_t dstAddr, uint8_t endpoint,
+        uint8_t addrMode);
+
 //! \brief          Device control API: store a scene on a device
 //! \param[in]      groupId - group ID of the scene to be stored
 //! \param[in]      sceneId - scene ID of the scene to be stored
@@ -334,6 +352,12 @@ extern void zclGw_registerCallbacks(zclGw_callbacks_t zclGwCallbacks);
 //! \return        	none
 void zclGw_processInCmds(zclIncoming_t *pInMsg);
 
+//! \brief          Process read attribute responses and attribute reports straight
+//!                 from the frame, before ZCL parses them
+//! \param[in]      pInMsg: pointer to the incoming message, attrCmd is not filled in
+//! \return        	TRUE if handled
+uint8_t zclGw_processInRaw(zclIncoming_t *pInMsg);
+
 /*********************************************************************
  *********************************************************************/
 
@@ -38,6 +38,7 @@
  * INCLUDES
  */
 #include "stdio.h"
+#include <pthread.h>
 
 #include "zcl_port.h"
 #include "zcl.h"
@@ -46,6 +47,7 @@
 #include "dbgPrint.h"
 
 #include "zcl_gateway.h"
+#include "znp_cfuncs.h"
 
 /*********************************************************************
  * MACROS
@@ -55,10 +57,39 @@
  * CONSTANTS
  */
 
+// zcl_mem_alloc size classes: 16, 32, .. 512 bytes, larger blocks go to malloc
+#define ZCL_MEM_MIN_SHIFT       4
+#define ZCL_MEM_CLASSES         6
+#define ZCL_MEM_HEAP_CLASS      0xFF
+// free blocks a thread keeps per class, the rest go back to the heap
+#define ZCL_MEM_MAX_CACHED      64
+
+#define ZCL_MEM_CLASS_SIZE(c)   (1u << ((c) + ZCL_MEM_MIN_SHIFT))
+
 /*********************************************************************
  * TYPEDEFS
  */
 
+// Precedes every block zcl_mem_alloc hands out
+typedef union zclMemHdr
+{
+    union zclMemHdr *next;      // on a free list
+    uint8 sizeClass;            // handed out
+    double align;
+} zclMemHdr_t;
+
+// Free lists and counters of one thread. The ZCL library allocates for
+// almost every frame parsed or built, keeping a pool per thread means the
+// RX and TX threads never contend for an allocator lock, and reusing fixed
+// size blocks keeps long running gateways from fragmenting the heap.
+typedef struct zclMemCache
+{
+    zclMemHdr_t *freeList[ZCL_MEM_CLASSES];
+    uint16 cached[ZCL_MEM_CLASSES];
+    zclMemStats_t stats;
+    struct zclMemCache *next;   // every thread's cache, for zcl_mem_stats
+} zclMemCache_t;
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -75,13 +106,36 @@ extern endPointDesc_t zswEpDesc;
 /*********************************************************************
  * LOCAL VARIABLES
  */
-#if defined(ZCL_GROUPS)
-static aps_Group_t foundGrp;
-#endif
+static __thread zclMemCache_t *memCache;
+static zclMemCache_t *memCaches;
+static pthread_mutex_t memCachesLock = PTHREAD_MUTEX_INITIALIZER;
 
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
+static int AF_SourceRoute(afAddrType_t *dstAddr, uint16 bufLen, uint16_t *relays);
+static afStatus_t AF_DataRequestSrcRtg(afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+uint16 cID, uint16 bufLen, uint8 *buf, uint8 *transID, uint16_t *relays,
+int relayCount);
+
+//! \brief The calling thread's pool, created on first use. Pools live as
+//! long as the process, so do the threads using ZCL.
+//! \return         pool, NULL if it could not be allocated
+static zclMemCache_t *zcl_mem_cache(void)
+{
+    if (memCache == NULL)
+    {
+        memCache = (zclMemCache_t *) calloc(1, sizeof(zclMemCache_t));
+        if (memCache != NULL)
+        {
+            pthread_mutex_lock(&memCachesLock);
+            memCache->next = memCaches;
+            memCaches = memCache;
+            pthread_mutex_unlock(&memCachesLock);
+        }
+    }
+    return memCache;
+}
 
 /*********************************************************************
  * API Functions
@@ -98,12 +152,64 @@ uint8 zcl_HandleExternal(zclIncoming_t *pInMsg)
     return true;
 }
 
+//! \brief Function for processing read responses and reports before ZCL parses them
+//! \param[in]      pInMsg - incoming message, attrCmd is not filled in
+//! \return         true if handled
+uint8 zcl_HandleExternalRaw(zclIncoming_t *pInMsg)
+{
+    return zclGw_processInRaw(pInMsg);
+}
+
 //! \brief Abstraction function to allocate memory
 //! \param[in]      size - size in bytes needed
 //! \return         pointer to allocated buffer, NULL if nothing allocated.
 void *zcl_mem_alloc( uint16 size)
 {
-    return ((void *) malloc(size));
+    zclMemCache_t *cache = zcl_mem_cache();
+    zclMemHdr_t *hdr;
+    uint8 sizeClass = 0;
+
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    while (sizeClass < ZCL_MEM_CLASSES && ZCL_MEM_CLASS_SIZE(sizeClass) < size)
+    {
+        sizeClass++;
+    }
+
+    if (sizeClass == ZCL_MEM_CLASSES)
+    {
+        sizeClass = ZCL_MEM_HEAP_CLASS;
+        hdr = (zclMemHdr_t *) malloc(sizeof(zclMemHdr_t) + size);
+        cache->stats.heapAllocs++;
+    } else if (cache->freeList[sizeClass] != NULL)
+    {
+        hdr = cache->freeList[sizeClass];
+        cache->freeList[sizeClass] = hdr->next;
+        cache->cached[sizeClass]--;
+        cache->stats.bytesCached -= ZCL_MEM_CLASS_SIZE(sizeClass);
+        cache->stats.poolHits++;
+    } else
+    {
+        hdr = (zclMemHdr_t *) malloc(sizeof(zclMemHdr_t) + ZCL_MEM_CLASS_SIZE(sizeClass));
+        cache->stats.heapAllocs++;
+    }
+
+    if (hdr == NULL)
+    {
+        cache->stats.failures++;
+        return NULL;
+    }
+
+    hdr->sizeClass = sizeClass;
+    cache->stats.allocs++;
+    if (sizeClass != ZCL_MEM_HEAP_CLASS)
+    {
+        cache->stats.bytesInUse += ZCL_MEM_CLASS_SIZE(sizeClass);
+    }
+    return ((void *) (hdr + 1));
 }
 
 //! \brief Abstraction function to set memory
@@ -142,13 +248,62 @@ void zcl_mem_free(void *ptr)
 {
     if (ptr != NULL)
     {
-        free(ptr);
+        zclMemCache_t *cache = zcl_mem_cache();
+        zclMemHdr_t *hdr = ((zclMemHdr_t *) ptr) - 1;
+        uint8 sizeClass = hdr->sizeClass;
+
+        // a block freed on another thread joins that thread's lists, the
+        // counters only add up over all threads
+        if (sizeClass == ZCL_MEM_HEAP_CLASS || cache == NULL
+                || cache->cached[sizeClass] >= ZCL_MEM_MAX_CACHED)
+        {
+            free(hdr);
+        } else
+        {
+            hdr->next = cache->freeList[sizeClass];
+            cache->freeList[sizeClass] = hdr;
+            cache->cached[sizeClass]++;
+            cache->stats.bytesCached += ZCL_MEM_CLASS_SIZE(sizeClass);
+        }
+        if (cache != NULL)
+        {
+            cache->stats.frees++;
+            if (sizeClass != ZCL_MEM_HEAP_CLASS)
+            {
+                cache->stats.bytesInUse -= ZCL_MEM_CLASS_SIZE(sizeClass);
+            }
+        }
     } else
     {
         printf("zcl_mem_free: NULL ptr\n");
     }
 }
 
+//! \brief Counters of the memory pool behind zcl_mem_alloc / zcl_mem_free
+//! \param[out]     stats - totals over every thread that used the pool
+//! \return         none
+void zcl_mem_stats(zclMemStats_t *stats)
+{
+    zclMemCache_t *cache;
+
+    memset(stats, 0, sizeof(zclMemStats_t));
+
+    // other threads' counters are read without their knowledge, each one is
+    // a single word so at worst a total is a few allocations behind
+    pthread_mutex_lock(&memCachesLock);
+    for (cache = memCaches; cache != NULL; cache = cache->next)
+    {
+        stats->allocs += cache->stats.allocs;
+        stats->frees += cache->stats.frees;
+        stats->poolHits += cache->stats.poolHits;
+        stats->heapAllocs += cache->stats.heapAllocs;
+        stats->failures += cache->stats.failures;
+        stats->bytesInUse += cache->stats.bytesInUse;
+        stats->bytesCached += cache->stats.bytesCached;
+    }
+    pthread_mutex_unlock(&memCachesLock);
+}
+
 //! \brief function to to convert 32b value
 //! to 4 byte array
 //! \param[out]      buf - pointer to 4 byte array
@@ -327,6 +482,22 @@ uint8 radius)
 
     afStatus_t status;
     DataRequestExtFormat_t req;
+    uint16_t relays[SRCRTG_MAX_RELAYS];
+    int relayCount = AF_SourceRoute(dstAddr, bufLen, relays);
+    uint8 *data;
+
+    if (relayCount >= 0)
+    {
+        return AF_DataRequestSrcRtg(dstAddr, srcEP, cID, bufLen, buf,
+                transID, relays, relayCount);
+    }
+
+    // larger frames have to be split by the caller
+    data = afDataRequestTxData(dstAddr->addrMode, bufLen);
+    if (data == NULL)
+    {
+        return (afStatus_INVALID_PARAMETER);
+    }
 
     req.DstAddrMode = dstAddr->addrMode;
     if (req.DstAddrMode == Addr64Bit)
@@ -337,21 +508,103 @@ uint8 radius)
         memcpy(req.DstAddr, &dstAddr->addr.shortAddr, 2);
     }
     req.DstEndpoint = dstAddr->endPoint;
+    req.DstPanID = 0;
     req.SrcEndpoint = srcEP->endPoint;
     req.ClusterId = cID;
     req.TransId = (*transID)++;
     // printf("send req transid: %d\n", req.TransId);
     req.Options = 0;
     req.Radius = AF_DEFAULT_RADIUS;
-    memcpy(req.Data, buf, bufLen);
+    if (buf != data)
+    {
+        // the route may have changed since the caller built it in place
+        memmove(data, buf, bufLen);
+    }
     req.Len = bufLen;
 
-    status = afDataRequestExt(&req);
+    if (req.DstAddrMode == afAddr16Bit)
+    {
+        zWSourceRouteSent(req.TransId, dstAddr->addr.shortAddr, 0);
+    }
+    status = afDataRequestTx(&req);
+    zWTxFrameSent(req.DstAddrMode, dstAddr->addr.shortAddr, bufLen, status);
 
     //dbg_print(PRINT_LEVEL_ERROR, "zcl_port: sending afDataRequest, addr:%x, status:%x\n", dstAddr->addr.shortAddr, status);
     return (status);
 }
 
+//! \brief Where AF_DataRequest wants the data for dstAddr, in the RPC TX buffer of
+//! this thread. Data built there goes out without being copied again.
+//! \param[in]      dstAddr - destination address
+//! \param[in]      bufLen - data length
+//! \return         pointer to bufLen bytes, NULL if that does not fit one request
+uint8 *AF_DataRequestBuffer(afAddrType_t *dstAddr, uint16 bufLen)
+{
+    uint16_t relays[SRCRTG_MAX_RELAYS];
+    int relayCount = AF_SourceRoute(dstAddr, bufLen, relays);
+
+    if (relayCount >= 0)
+    {
+        return afDataRequestSrcRtgTxData(relayCount, bufLen);
+    }
+    return afDataRequestTxData(dstAddr->addrMode, bufLen);
+}
+
+//! \brief Relays of the cached source route to dstAddr, if the frame goes
+//! source routed: a unicast to a network address that fits one request with
+//! the relay list.
+//! \param[in]      dstAddr - destination address
+//! \param[in]      bufLen - data length
+//! \param[out]     relays - SRCRTG_MAX_RELAYS entries
+//! \return         number of relays, -1 to send it the usual way
+static int AF_SourceRoute(afAddrType_t *dstAddr, uint16 bufLen, uint16_t *relays)
+{
+    int relayCount;
+
+    if (dstAddr->addrMode != afAddr16Bit || dstAddr->addr.shortAddr >= 0xFFF8)
+    {
+        return -1;
+    }
+    relayCount = zWSourceRoute(dstAddr->addr.shortAddr, relays, SRCRTG_MAX_RELAYS);
+    if (relayCount < 0 || afDataRequestSrcRtgTxData(relayCount, bufLen) == NULL)
+    {
+        return -1;
+    }
+    return relayCount;
+}
+
+//! \brief AF_DataRequest along a cached source route, the data is moved to
+//! where the source routed request wants it if it is not there yet.
+static afStatus_t AF_DataRequestSrcRtg(afAddrType_t *dstAddr, endPointDesc_t *srcEP,
+uint16 cID, uint16 bufLen, uint8 *buf, uint8 *transID, uint16_t *relays,
+int relayCount)
+{
+    afStatus_t status;
+    DataRequestSrcRtgFormat_t req;
+    uint8 *data = afDataRequestSrcRtgTxData(relayCount, bufLen);
+
+    req.DstAddr = dstAddr->addr.shortAddr;
+    req.DstEndpoint = dstAddr->endPoint;
+    req.SrcEndpoint = srcEP->endPoint;
+    req.ClusterID = cID;
+    req.TransID = (*transID)++;
+    req.Options = 0;
+    req.Radius = AF_DEFAULT_RADIUS;
+    req.RelayCount = relayCount;
+    memcpy(req.RelayList, relays, relayCount * sizeof(uint16_t));
+    if (buf != data)
+    {
+        memmove(data, buf, bufLen);
+    }
+    req.Len = bufLen;
+
+    zWSourceRouteSent(req.TransID, req.DstAddr, 1);
+    status = afDataRequestSrcRtgTx(&req);
+    zWTxFrameSent(afAddr16Bit, req.DstAddr, bufLen, status);
+
+    return (status);
+}
+
 #if defined(ZCL_GROUPS)
 /**************************************************************************************************
  * APS Interface messages
@@ -413,6 +666,15 @@ uint8 aps_CountAllGroups( void )
 {
     return (0);
 }
+
+//! \brief function to return the free group table entries (not used)
+//! (not used in this port)
+//! \param          none
+//! \return         capacity
+uint8 aps_GroupsRemaingCapacity( void )
+{
+    return (APS_MAX_GROUPS);
+}
 #endif // defined(ZCL_GROUPS)
 /*********************************************************************
  *********************************************************************/
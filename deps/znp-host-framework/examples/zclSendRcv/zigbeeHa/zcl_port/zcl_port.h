@@ -117,6 +117,19 @@ typedef uint32_t int32;
 typedef uint32_t ZStatus_t;
 typedef uint8_t afStatus_t;
 
+//! \brief Counters of the zcl_mem_alloc pool, summed over all threads
+//!
+typedef struct
+{
+    uint32_t allocs;        //!< blocks handed out
+    uint32_t frees;         //!< blocks given back
+    uint32_t poolHits;      //!< allocations served from a free list
+    uint32_t heapAllocs;    //!< allocations that went to malloc
+    uint32_t failures;      //!< allocations that returned NULL
+    uint32_t bytesInUse;    //!< size class bytes handed out, blocks over 512 bytes not included
+    uint32_t bytesCached;   //!< bytes held on free lists
+} zclMemStats_t;
+
 //! \brief Simple Description Format Structure
 //!
 typedef struct
@@ -141,6 +154,20 @@ typedef struct
     AF_NETWORK_LATENCY latencyReq;
 }endPointDesc_t;
 
+#if defined(ZCL_GROUPS)
+//! \brief APS group table definitions needed by the ZCL groups cluster.
+//! The gateway is a groups client only, the local table is never populated.
+#define APS_GROUP_NAME_LEN  16
+#define APS_MAX_GROUPS      16
+#define ZApsDuplicateEntry  afStatus_DUPLICATE
+
+typedef struct
+{
+    uint16_t ID;                        // Unique to this table
+    uint8_t name[APS_GROUP_NAME_LEN];   // Human readable name of group
+} aps_Group_t;
+#endif // defined(ZCL_GROUPS)
+
 //! \brief osal_event_hdr_t is used in typedef for
 //! zclIncomingMsg_t, defined in zcl.h. This should
 //! only be compiled in when ZCL_STANDALONE in not
@@ -171,6 +198,29 @@ afStatus_t AF_DataRequest(afAddrType_t *dstAddr, endPointDesc_t *srcEP,
 uint16 cID, uint16 bufLen, uint8 *buf, uint8 *transID, uint8 options,
 uint8 radius);
 
+//! \brief Where AF_DataRequest wants the data for dstAddr, built there it is not copied
+//! \param[in]      dstAddr - destination address
+//! \param[in]      bufLen - data length
+//! \return         pointer to bufLen bytes, NULL if that does not fit one request
+uint8 *AF_DataRequestBuffer(afAddrType_t *dstAddr, uint16 bufLen);
+
+//! \brief Counters of the memory pool behind zcl_mem_alloc / zcl_mem_free
+//! \param[out]     stats - totals over every thread that used the pool
+//! \return         none
+void zcl_mem_stats(zclMemStats_t *stats);
+
+#if defined(ZCL_GROUPS)
+//! \brief APS group table interface used by the ZCL groups cluster
+//! (not used in this port)
+uint8 aps_RemoveGroup( uint8 endpoint, uint16 groupID );
+void aps_RemoveAllGroup( uint8 endpoint );
+uint8 aps_FindAllGroupsForEndpoint( uint8 endpoint, uint16 *groupList );
+aps_Group_t *aps_FindGroup( uint8 endpoint, uint16 groupID );
+ZStatus_t aps_AddGroup( uint8 endpoint, aps_Group_t *group );
+uint8 aps_CountAllGroups( void );
+uint8 aps_GroupsRemaingCapacity( void );
+#endif // defined(ZCL_GROUPS)
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,9 +42,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "rpc.h"
 #include "mtSys.h"
+#include "mtSapi.h"
 #include "mtZdo.h"
 #include "AF.h"
 #include "mtAf.h"
@@ -60,6 +62,27 @@
  * MACROS
  */
 
+//! \brief wait for the reset indication, per reset request
+//!
+#define ZNP_RESET_TIMEOUT_MS        3000
+#define ZNP_RESET_TRIES             2
+
+//! \brief wait for the device state after zdoInit
+//!
+#define ZNP_START_TIMEOUT_MS        20000
+
+//! \brief SAPI device info property holding the device state
+//!
+#define ZB_INFO_DEV_STATE           0
+
+//! \brief devState of a ZNP that did not tell
+//!
+#define DEV_STATE_UNKNOWN           0xFF
+
+//! \brief NV item init status: the item did not exist and was created
+//!
+#define NV_ITEM_UNINIT              0x09
+
 /*********************************************************************
  * TYPES
  */
@@ -74,6 +97,18 @@ devStates_t devState = DEV_HOLD;
 
 bool znpHasReset = false;
 
+//! \brief device state as read with zbGetDeviceInfo
+//!
+static uint8_t probedDevState = DEV_STATE_UNKNOWN;
+
+//! \brief NV item length as read with sysOsalNvLength, -1 until it answers
+//!
+static int nvItemLen = -1;
+
+//! \brief phase timings of the last zMngt_start
+//!
+static zMngt_startTimings_t startTimings;
+
 //! \brief Match Desc rsp variable
 //!
 afAddrType_t matchDstAddrTbl[10];
@@ -92,25 +127,39 @@ zMngt_callbacks_t zMngt_callbacks;
 static uint_least8_t mtZdoStateChangeIndCb(uint_least8_t newDevState);
 static uint_least8_t mtZdoEndDeviceAnnceIndCb(EndDeviceAnnceIndFormat_t *msg);
 static uint_least8_t mtZdoTcEndDeviceAnnceIndCb(TcEndDeviceAnnceIndFormat_t *msg);
+static uint_least8_t mtZdoIeeeAddrRspCb(IeeeAddrRspFormat_t *msg);
+static uint_least8_t mtZdoNodeDescRspCb(NodeDescRspFormat_t *msg);
 static uint_least8_t mtZdoActiveEpRspCb(ActiveEpRspFormat_t *msg);
 static uint_least8_t mtZdoSimpleDescRspCb(SimpleDescRspFormat_t *msg);
 static uint_least8_t mtZdoMatchDescRsp(MatchDescRspFormat_t *rsp);
 static uint_least8_t mtZdoMgmtLeaveRspCb(MgmtLeaveRspFormat_t *msg);
 static uint_least8_t mtZdoMgmtLqiRspCb(MgmtLqiRspFormat_t *msg);
+static uint_least8_t mtZdoMgmtRtgRspCb(MgmtRtgRspFormat_t *msg);
+static uint_least8_t mtZdoSrcRtgIndCb(SrcRtgIndFormat_t *msg);
+static uint_least8_t mtZdoNwkAddrRspCb(NwkAddrRspFormat_t *msg);
+static uint_least8_t mtZdoLeaveIndCb(LeaveIndFormat_t *msg);
 //! \brief SYS Callbacks
 //!
 static uint_least8_t mtSysResetIndCb(ResetIndFormat_t *msg);
 static uint_least8_t mtSysOsalNvReadCb(OsalNvReadSrspFormat_t *rsp);
+static uint_least8_t mtSysOsalNvLengthCb(OsalNvLengthSrspFormat_t *rsp);
+//! \brief SAPI Callbacks
+//!
+static uint8_t mtSapiGetDeviceInfoSrspCb(GetDeviceInfoSrspFormat_t *msg);
 
 //! \brief helper functions
 //!
 static uint_least8_t setNVStartNew();
 static uint_least8_t setNVStartRestore();
-static uint_least8_t setNVChanList(uint_least32_t chanList);
-static uint_least8_t setNVPanID(uint_least32_t panId);
-static uint_least8_t setNVDevType(uint_least8_t devType);
-static uint_least8_t startNetwork(uint_least8_t devType, uint_least32_t chan, uint8_t newNwk, uint16_t panId);
+static int readNVChunk(uint16_t id, uint8_t offset, uint8_t *value, uint16_t maxLen);
+static uint_least8_t readNVItem(uint16_t id, uint8_t *value, uint8_t len);
+static uint_least8_t syncNVItem(uint16_t id, const uint8_t *value, uint8_t len);
+static uint_least8_t syncNVConfig(uint_least8_t devType, uint_least32_t chan, uint16_t panId);
+static uint8_t probeDevState(void);
+static uint8_t startedState(uint_least8_t devType);
+static uint_least8_t startNetwork(uint_least8_t devType);
 static uint_least8_t znpReset(void);
+static uint32_t msSince(struct timespec *from);
 
 
 static uint_least8_t getNVPanID();
@@ -131,7 +180,7 @@ static mtSysCb_t mtSysCb =
         mtSysResetIndCb,
         NULL,
         mtSysOsalNvReadCb,
-        NULL,
+        mtSysOsalNvLengthCb,
         NULL,
         NULL,
         NULL,
@@ -140,11 +189,24 @@ static mtSysCb_t mtSysCb =
         NULL,
         NULL };
 
+//! \brief SAPI callbacks, only used to read the device state
+//!
+static mtSapiCb_t mtSapiCb =
+{
+        NULL,                        // MT_SAPI_READ_CONFIGURATION
+        mtSapiGetDeviceInfoSrspCb,   // MT_SAPI_GET_DEVICE_INFO
+        NULL,                        // MT_SAPI_FIND_DEVICE_CNF
+        NULL,                        // MT_SAPI_SEND_DATA_CNF
+        NULL,                        // MT_SAPI_RECEIVE_DATA_IND
+        NULL,                        // MT_SAPI_ALLOW_BIND_CNF
+        NULL,                        // MT_SAPI_BIND_CNF
+        NULL };                      // MT_SAPI_START_CNF
+
 static mtZdoCb_t mtZdoCb =
 {
-NULL,       // MT_ZDO_NWK_ADDR_RSP
-        NULL,      // MT_ZDO_IEEE_ADDR_RSP
-        NULL,      // MT_ZDO_NODE_DESC_RSP
+        mtZdoNwkAddrRspCb,       // MT_ZDO_NWK_ADDR_RSP
+        mtZdoIeeeAddrRspCb,      // MT_ZDO_IEEE_ADDR_RSP
+        mtZdoNodeDescRspCb,      // MT_ZDO_NODE_DESC_RSP
         NULL,     // MT_ZDO_POWER_DESC_RSP
         mtZdoSimpleDescRspCb,    // MT_ZDO_SIMPLE_DESC_RSP
         mtZdoActiveEpRspCb,      // MT_ZDO_ACTIVE_EP_RSP
@@ -158,19 +220,19 @@ NULL,       // MT_ZDO_NWK_ADDR_RSP
         NULL,        // MT_ZDO_UNBIND_RSP
         NULL,   // MT_ZDO_MGMT_NWK_DISC_RSP
         mtZdoMgmtLqiRspCb,       // MT_ZDO_MGMT_LQI_RSP
-        NULL,       // MT_ZDO_MGMT_RTG_RSP
+        mtZdoMgmtRtgRspCb,       // MT_ZDO_MGMT_RTG_RSP
         NULL,      // MT_ZDO_MGMT_BIND_RSP
         mtZdoMgmtLeaveRspCb,     // MT_ZDO_MGMT_LEAVE_RSP
         NULL,     // MT_ZDO_MGMT_DIRECT_JOIN_RSP
         NULL,     // MT_ZDO_MGMT_PERMIT_JOIN_RSP
         mtZdoStateChangeIndCb,   // MT_ZDO_STATE_CHANGE_IND
         mtZdoEndDeviceAnnceIndCb,   // MT_ZDO_END_DEVICE_ANNCE_IND
-        NULL,        // MT_ZDO_SRC_RTG_IND
+        mtZdoSrcRtgIndCb,        // MT_ZDO_SRC_RTG_IND
         NULL,	 //MT_ZDO_BEACON_NOTIFY_IND
         NULL,			 //MT_ZDO_JOIN_CNF
         NULL,	 //MT_ZDO_NWK_DISCOVERY_CNF
         NULL,                    // MT_ZDO_CONCENTRATOR_IND_CB
-        NULL,         // MT_ZDO_LEAVE_IND
+        mtZdoLeaveIndCb,         // MT_ZDO_LEAVE_IND
         mtZdoTcEndDeviceAnnceIndCb,   // MT_ZDO_TC_END_DEVICE_ANNCE_IND
         NULL,   //MT_ZDO_PERMIT_JOIN_IND
         NULL,   //MT_ZDO_STATUS_ERROR_RSP
@@ -178,20 +240,6 @@ NULL,       // MT_ZDO_NWK_ADDR_RSP
         NULL,
         NULL };
 
-//! \brief SampleDesc does not contain, define an array
-//!  for storing IEEE from devAnnce
-//!
-typedef struct IeeeMapping
-{
-    uint8_t ieee[8];
-    uint16_t nwkAddr;
-} IeeeMapping_t;
-
-#define IEEE_MAX 100
-static IeeeMapping_t ieeeMapping[IEEE_MAX] = {{ 0 }};
-static uint8_t ieeeMappingIdx = 0;
-
-
 epInfo_t epInfo;
 
 /********************************************************************
@@ -233,6 +281,25 @@ static uint_least8_t mtSysOsalNvReadCb(OsalNvReadSrspFormat_t *rsp)
     return 0;
 }
 
+static uint_least8_t mtSysOsalNvLengthCb(OsalNvLengthSrspFormat_t *rsp)
+{
+    nvItemLen = rsp->ItemLen;
+    return 0;
+}
+
+/********************************************************************
+ * START OF SAPI CALL BACK FUNCTIONS
+ */
+
+static uint8_t mtSapiGetDeviceInfoSrspCb(GetDeviceInfoSrspFormat_t *msg)
+{
+    if (msg->Param == ZB_INFO_DEV_STATE)
+    {
+        probedDevState = msg->Value[0];
+    }
+    return 0;
+}
+
 /********************************************************************
  * START OF ZDO CALL BACK FUNCTIONS
  */
@@ -307,153 +374,107 @@ static uint_least8_t mtZdoStateChangeIndCb(uint_least8_t newDevState)
     return SUCCESS;
 }
 
-Node_t nodeList[MAX_NODE_LIST];
-uint8_t nodeCount = 0;
-
-void printNodeTopology(uint8_t i) 
-{
-    // uint8_t i;
-    // for (i = 0; i < nodeCount; i++)
-    // {
-        char *devtype = (nodeList[i].Type == DEVICETYPE_ROUTER ? "ROUTER" : "END DEVICE");
-        if (nodeList[i].Type == DEVICETYPE_COORDINATOR)
-        {
-            devtype = "COORDINATOR";
-        }
-        dbg_print(PRINT_LEVEL_INFO, "Node Address: 0x%04X   Type: %s\n", nodeList[i].NodeAddr, devtype);
-        dbg_print(PRINT_LEVEL_INFO, "Children: %d\n", nodeList[i].ChildCount);
-        uint8_t cI;
-        for (cI = 0; cI < nodeList[i].ChildCount; cI++)
-        {
-            uint8_t type = nodeList[i].childs[cI].Type;
-            dbg_print(PRINT_LEVEL_INFO, "\tAddress: 0x%04X   Type: %s\n", nodeList[i].childs[cI].ChildAddr, (type == DEVICETYPE_ROUTER ? "ROUTER" : "END DEVICE"));
-        }
-        dbg_print(PRINT_LEVEL_INFO, "\n");
-    // }
-}
-
+//! \brief Mgmt_Lqi responses go to the topology crawler, which asks for
+//! further pages and the routers found in them
 static uint_least8_t mtZdoMgmtLqiRspCb(MgmtLqiRspFormat_t *msg)
 {
     dbg_print(PRINT_LEVEL_VERBOSE, "in lqi response callback\n");
-    uint8_t devType = 0;
-    uint8_t devRelation = 0;
-    uint8_t localNodeCount = nodeCount;
-    MgmtLqiReqFormat_t req;
-
-    if (msg->Status == MT_RPC_SUCCESS)
-    {
-        nodeCount++;
-        nodeList[localNodeCount].NodeAddr = msg->SrcAddr;
-        nodeList[localNodeCount].Type = (msg->SrcAddr == 0 ? DEVICETYPE_COORDINATOR : DEVICETYPE_ROUTER);
-        nodeList[localNodeCount].ChildCount = 0;
-
-        uint32_t i;
-        for (i = 0; i < msg->NeighborLqiListCount; i++)
-        {
-            devType = msg->NeighborLqiList[i].DevTyp_RxOnWhenIdle_Relat & 3;
-            devRelation = ((msg->NeighborLqiList[i].DevTyp_RxOnWhenIdle_Relat >> 4) & 7);
-            if (devRelation == 1)
-            {
-                uint8_t cCount = nodeList[localNodeCount].ChildCount;
-                nodeList[localNodeCount].childs[cCount].ChildAddr = msg->NeighborLqiList[i].NetworkAddress;
-                nodeList[localNodeCount].childs[cCount].Type = devType;
-                nodeList[localNodeCount].childs[cCount].Lqi = msg->NeighborLqiList[i].LQI;
-                uint8_t j;
-                for(j = 0; j < 8; j++)
-                    nodeList[localNodeCount].childs[cCount].ExtendedAddress[j] = (uint8_t)(msg->NeighborLqiList[i].ExtendedAddress >> (j * 8)) & 0xFF;
-                nodeList[localNodeCount].ChildCount++;
-                if (devType == DEVICETYPE_ROUTER)
-                {
-                    req.DstAddr = msg->NeighborLqiList[i].NetworkAddress;
-                    req.StartIndex = 0;
-                    zdoMgmtLqiReq(&req);
-                }
-            }
-        }
-    }
-    else
+    if (msg->Status != MT_RPC_SUCCESS)
     {
         dbg_print(PRINT_LEVEL_INFO, "MgmtLqiRsp Status: FAIL 0x%02X\n", msg->Status);
     }
 
-    zWUpdateNetworkTopology(&nodeList[localNodeCount]);
+    zWMgmtLqiRsp(msg);
+    return msg->Status;
+}
 
-    //printNodeTopology(localNodeCount);
+//! \brief Mgmt_Rtg responses go to the routing table harvester
+static uint_least8_t mtZdoMgmtRtgRspCb(MgmtRtgRspFormat_t *msg)
+{
+    if (msg->Status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_INFO, "MgmtRtgRsp Status: FAIL 0x%02X\n", msg->Status);
+    }
+
+    zWMgmtRtgRsp(msg);
     return msg->Status;
 }
 
-void resetNodeTopology()
+//! \brief Route records go to the source route cache
+static uint_least8_t mtZdoSrcRtgIndCb(SrcRtgIndFormat_t *msg)
 {
-    nodeCount = 0;
-    memset(nodeList, 0, sizeof(nodeList));
+    dbg_print(PRINT_LEVEL_VERBOSE, "Route record from 0x%04X, %d relays\n", msg->DstAddr, msg->RelayCount);
+    zWSourceRouteInd(msg);
+    return 0;
 }
 
 //#define USE_TC_DEV_ANNCE
 //Use the trust center device announce as this is a reliable message and not a broadcast
+//! \brief The announce starts the device's interview on the v8 thread, which
+//! asks for its descriptors and endpoints
 static uint_least8_t mtZdoEndDeviceAnnceIndCb(EndDeviceAnnceIndFormat_t *msg)
 {
     zWDeviceJoinedNetwork(msg);
 	dbg_print(PRINT_LEVEL_WARNING,"New device joined network.NwkAddr: 0x%04X\n", msg->NwkAddr);
-#ifndef USE_TC_DEV_ANNCE
-    ActiveEpReqFormat_t actReq;
-    actReq.DstAddr = msg->NwkAddr;
-    actReq.NwkAddrOfInterest = msg->NwkAddr;
-    dbg_print(PRINT_LEVEL_WARNING,"New device joined the Trust Center.NwkAddr: 0x%04X\n", msg->NwkAddr);
-    zdoActiveEpReq(&actReq);
-
-    //Store the IEEE addr and nwkAddr for SimpleDesc
-    // ieeeMapping[ieeeMappingIdx].nwkAddr = msg->NwkAddr;
-    // memcpy(ieeeMapping[ieeeMappingIdx].ieee, (msg->IEEEAddr), 8);
-    // ieeeMappingIdx++;
-    // if (ieeeMappingIdx == IEEE_MAX)
-    // {
-    //     ieeeMappingIdx = 0;
-    // }
-#endif //!USE_TC_DEV_ANNCE
 	return 0;
 }
 
 static uint_least8_t mtZdoTcEndDeviceAnnceIndCb(TcEndDeviceAnnceIndFormat_t *msg)
 {
 #ifdef USE_TC_DEV_ANNCE
-    ActiveEpReqFormat_t actReq;
-    actReq.DstAddr = msg->NwkAddr;
-    actReq.NwkAddrOfInterest = msg->NwkAddr;
     dbg_print(PRINT_LEVEL_WARNING,"TC Annce- New device joined the Trust Center.NwkAddr: 0x%04X\n", msg->NwkAddr);
-    zdoActiveEpReq(&actReq);
-
-    //Store the IEEE addr and nwkAddr for SimpleDesc
-    // ieeeMapping[ieeeMappingIdx].nwkAddr = msg->NwkAddr;
-    // memcpy(ieeeMapping[ieeeMappingIdx].ieee, (msg->IEEEAddr), 8);
-    // ieeeMappingIdx++;
-    // if (ieeeMappingIdx == IEEE_MAX)
-    // {
-    //     ieeeMappingIdx = 0;
-    // }
 #endif //USE_TC_DEV_ANNCE
     return 0;
 }
 
-static uint_least8_t mtZdoActiveEpRspCb(ActiveEpRspFormat_t *msg)
+//! \brief Interview answers go to the interviewer, which asks for the next
+//! step, retries and reports the device once it is done
+static uint_least8_t mtZdoIeeeAddrRspCb(IeeeAddrRspFormat_t *msg)
 {
+    if (msg->Status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_INFO, "IeeeAddrRsp Status: FAIL 0x%02X\n", msg->Status);
+    }
+
+    zWIeeeAddrRsp(msg);
+    return msg->Status;
+}
+
+//! \brief A device found by its IEEE address, the addon's registry moves it
+//! to the nwk address it answers from
+static uint_least8_t mtZdoNwkAddrRspCb(NwkAddrRspFormat_t *msg)
+{
+    if (msg->Status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_INFO, "NwkAddrRsp Status: FAIL 0x%02X\n", msg->Status);
+    }
+
+    zWNwkAddrRsp(msg);
+    return msg->Status;
+}
+
+static uint_least8_t mtZdoNodeDescRspCb(NodeDescRspFormat_t *msg)
+{
+    if (msg->Status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_INFO, "NodeDescRsp Status: FAIL 0x%02X\n", msg->Status);
+    }
+
+    zWNodeDescRsp(msg);
+    return msg->Status;
+}
 
-    SimpleDescReqFormat_t simReq;
+static uint_least8_t mtZdoActiveEpRspCb(ActiveEpRspFormat_t *msg)
+{
     if (msg->Status == MT_RPC_SUCCESS)
     {
-        simReq.DstAddr = msg->NwkAddr;
-        simReq.NwkAddrOfInterest = msg->NwkAddr;
         dbg_print(PRINT_LEVEL_WARNING,"Number of Endpoints: %d\n", msg->ActiveEPCount);
-        uint32_t i;
-        for (i = 0; i < msg->ActiveEPCount; i++)
-        {
-            simReq.Endpoint = msg->ActiveEPList[i];
-            zdoSimpleDescReq(&simReq);
-        }
     } else
     {
         dbg_print(PRINT_LEVEL_WARNING,"ActiveEpRsp Status: FAIL 0x%02X\n", msg->Status);
     }
 
+    zWActiveEpRsp(msg);
     return msg->Status;
 }
 
@@ -482,8 +503,6 @@ static uint_least8_t mtZdoSimpleDescRspCb(SimpleDescRspFormat_t *msg)
 
         if (zMngt_callbacks.pfnZdoSimpleDescRspCb != NULL)
         {
-            uint_least8_t ieeeIdx;
-
             epInfo.srcAddr = msg->SrcAddr;
             epInfo.deviceID = msg->DeviceID;
             epInfo.profileID = msg->ProfileID;
@@ -492,33 +511,26 @@ static uint_least8_t mtZdoSimpleDescRspCb(SimpleDescRspFormat_t *msg)
             epInfo.status = msg->Status;
 
             epInfo.numInClusters = msg->NumInClusters;
-            uint32_t i;
-            for (i = 0; i < msg->NumInClusters; i++)
+            if (epInfo.numInClusters > sizeof(epInfo.inClusterList) / sizeof(epInfo.inClusterList[0]))
+            {
+                epInfo.numInClusters = sizeof(epInfo.inClusterList) / sizeof(epInfo.inClusterList[0]);
+            }
+            for (i = 0; i < epInfo.numInClusters; i++)
             {
                 epInfo.inClusterList[i] = msg->InClusterList[i];
             }
             epInfo.numOutClusters = msg->NumOutClusters;
-            for (i = 0; i < msg->NumOutClusters; i++)
+            if (epInfo.numOutClusters > sizeof(epInfo.outClusterList) / sizeof(epInfo.outClusterList[0]))
+            {
+                epInfo.numOutClusters = sizeof(epInfo.outClusterList) / sizeof(epInfo.outClusterList[0]);
+            }
+            for (i = 0; i < epInfo.numOutClusters; i++)
             {
                 epInfo.outClusterList[i] = msg->OutClusterList[i];
             }
 
-            //retrieve ieee addr
-            // for (ieeeIdx = 0; ieeeIdx < IEEE_MAX; ieeeIdx++)
-            // {
-            //     if (epInfo.nwkAddr == ieeeMapping[ieeeIdx].nwkAddr)
-            //     {
-            //         memcpy(epInfo.IEEEAddr, ieeeMapping[ieeeIdx].ieee, 8);
-
-            //         for (i = 0; i < 8; i++)
-            //         {
-            //             dbg_print(PRINT_LEVEL_WARNING,"\t\tIEEEAddr[%d]: 0x%02X\n", i,
-            //                     epInfo.IEEEAddr[i]);
-            //         }
-            //         dbg_print(PRINT_LEVEL_WARNING,"\n");
-            //         break;
-            //     }
-            // }
+            //the IEEE addr is filled in from the addon's device registry
+            memset(epInfo.IEEEAddr, 0, sizeof(epInfo.IEEEAddr));
 
             //if this is the TL endpoint OR if it is an EP with no cluster then ignore it
             if (!((epInfo.profileID == 0xC05E) && (msg->NumInClusters == 1)
@@ -536,27 +548,21 @@ static uint_least8_t mtZdoSimpleDescRspCb(SimpleDescRspFormat_t *msg)
         dbg_print(PRINT_LEVEL_INFO, "SimpleDescRsp Status: FAIL 0x%02X\n", msg->Status);
     }
 
+    zWSimpleDescRsp(msg);
     return msg->Status;
 }
 
 static uint_least8_t mtZdoMgmtLeaveRspCb(MgmtLeaveRspFormat_t *msg)
 {
-    uint_least8_t ieeeIdx;
-    //remove device from devvList
-
-    //remove device from ieee addr mapping
-    // for (ieeeIdx = 0; ieeeIdx < IEEE_MAX; ieeeIdx++)
-    // {
-    //     if (msg->SrcAddr == ieeeMapping[ieeeIdx].nwkAddr)
-    //     {
-    //         ieeeMapping[ieeeIdx].nwkAddr = 0;
-    //         memset(ieeeMapping[ieeeIdx].ieee, 0, 8);
-    //         break;
-    //     }
-    // }
-
-    //TODO: forward on the leave to next higher layer
+    //the device reports its leave in MT_ZDO_LEAVE_IND, which takes it out of the registry
+    return 0;
+}
 
+//! \brief A device left the network, or is rejoining at another address
+static uint_least8_t mtZdoLeaveIndCb(LeaveIndFormat_t *msg)
+{
+    dbg_print(PRINT_LEVEL_INFO, "Device 0x%04X left the network, rejoin %d\n", msg->SrcAddr, msg->Rejoin);
+    zWDeviceLeft(msg);
     return 0;
 }
 
@@ -709,128 +715,159 @@ static uint_least8_t setNVStartRestore(void)
     return status;
 }
 
-static uint_least8_t setNVDevType(uint_least8_t devType)
+//! \brief          Reads what one response holds of an NV item from offset on
+//! \param[out]     value: up to maxLen bytes
+//! \return         bytes read, -1 if it could not be read
+static int readNVChunk(uint16_t id, uint8_t offset, uint8_t *value, uint16_t maxLen)
 {
-    uint_least8_t status;
-    OsalNvWriteFormat_t nvWrite;
-    //uint_least8_t pbuf[1];
-    // setting dev type
-    nvWrite.Id = ZCD_NV_LOGICAL_TYPE;
-    nvWrite.Offset = 0;
-    nvWrite.Len = 1;
-    nvWrite.Value[0] = devType;
-    status = sysOsalNvWrite(&nvWrite);
-    //pbuf[0] = devType;
-    //status = sysNvWrite(ZCD_NV_LOGICAL_TYPE, 0, pbuf, 1);
-    // dbg_print(PRINT_LEVEL_INFO, "\n");
-    dbg_print(PRINT_LEVEL_INFO, "NV Write Device Type cmd sent... [%d]\n",
-            status);
+    int len = -1;
+    OsalNvReadFormat_t nvRead;
 
-    return status;
+    nvRead.Id = id;
+    nvRead.Offset = offset;
+    gotNVResponse = false;
+    if ((sysOsalNvRead(&nvRead) != MT_RPC_SUCCESS) || !gotNVResponse)
+    {
+        return -1;
+    }
+
+    if (nvReadResponse->status == SUCCESS)
+    {
+        len = nvReadResponse->len < maxLen ? nvReadResponse->len : maxLen;
+        memcpy(value, nvReadResponse->data, len);
+    }
+    free(nvReadResponse);
+    nvReadResponse = NULL;
+
+    return len;
 }
 
-static uint_least8_t setNVPanID(uint_least32_t panId)
+//! \brief          Reads an NV item of a known length
+//! \param[in]      id: NV item
+//! \param[out]     value: len bytes
+//! \return         MT_RPC_SUCCESS, or an error if it could not be read or
+//!                 is not len bytes long
+static uint_least8_t readNVItem(uint16_t id, uint8_t *value, uint8_t len)
 {
-    uint_least8_t status;
-    OsalNvWriteFormat_t nvWrite;
+    uint8_t buf[sizeof(((nvRead_response*)0)->data)];
 
-    // dbg_print(PRINT_LEVEL_INFO, "\n");
-    dbg_print(PRINT_LEVEL_INFO, "NV Write PAN ID cmd sending...\n");
-
-    nvWrite.Id = ZCD_NV_PANID;
-    nvWrite.Offset = 0;
-    nvWrite.Len = 2;
-    nvWrite.Value[0] = LO_UINT16(panId);
-    nvWrite.Value[1] = HI_UINT16(panId);
-    status = sysOsalNvWrite(&nvWrite);
-    //status = sysNvWrite(ZCD_NV_PANID, 0, pbuf, 2);
-    // dbg_print(PRINT_LEVEL_INFO, "\n");
-    dbg_print(PRINT_LEVEL_INFO, "NV Write PAN ID cmd sent...[%d]\n", status);
+    if (readNVChunk(id, 0, buf, sizeof(buf)) != len)
+    {
+        return MT_RPC_ERR_SUBSYSTEM;
+    }
+    memcpy(value, buf, len);
 
-    return status;
+    return MT_RPC_SUCCESS;
 }
 
-static uint_least8_t setNVChanList(uint_least32_t chanList)
+//! \brief          Writes an NV item, unless it holds value already
+//! \return         status of the write, MT_RPC_SUCCESS if none was needed
+static uint_least8_t syncNVItem(uint16_t id, const uint8_t *value, uint8_t len)
 {
-    OsalNvWriteFormat_t nvWrite;
     uint_least8_t status;
-    // setting chanList
-    nvWrite.Id = ZCD_NV_CHANLIST;
+    uint8_t current[4];
+    OsalNvWriteFormat_t nvWrite;
+
+    if ((len <= sizeof(current))
+            && (readNVItem(id, current, len) == MT_RPC_SUCCESS)
+            && (memcmp(current, value, len) == 0))
+    {
+        return MT_RPC_SUCCESS;
+    }
+
+    nvWrite.Id = id;
     nvWrite.Offset = 0;
-    nvWrite.Len = 4;
-    nvWrite.Value[0] = BREAK_UINT32(chanList, 0);
-    nvWrite.Value[1] = BREAK_UINT32(chanList, 1);
-    nvWrite.Value[2] = BREAK_UINT32(chanList, 2);
-    nvWrite.Value[3] = BREAK_UINT32(chanList, 3);
+    nvWrite.Len = len;
+    memcpy(nvWrite.Value, value, len);
     status = sysOsalNvWrite(&nvWrite);
-    //status = sysNvWrite(ZCD_NV_CHANLIST, 0, pbuf, 4);
-    // dbg_print(PRINT_LEVEL_INFO, "\n");
-    dbg_print(PRINT_LEVEL_INFO, "NV Write Channel List cmd sent...[%d]\n",
-            status);
+    dbg_print(PRINT_LEVEL_INFO, "NV Write 0x%04x cmd sent...[%d]\n", id, status);
+
+    if (status == MT_RPC_SUCCESS)
+    {
+        startTimings.nvWrites++;
+    }
 
     return status;
 }
 
-static uint_least8_t startNetwork(uint_least8_t devType, uint_least32_t chan, uint8_t newNwk, uint16_t panId)
+//! \brief          Device type, PAN ID and channel of a new network
+static uint_least8_t syncNVConfig(uint_least8_t devType, uint_least32_t chan, uint16_t panId)
 {
     uint_least8_t status;
-    int32_t rpcStatus = 0;
+    uint8_t value[4];
+    uint_least32_t chanList = 1 << chan;
 
-    if(newNwk) {
+    dbg_print(PRINT_LEVEL_INFO, "DEVICE TYPE: %d\n", devType);
+    value[0] = devType;
+    status = syncNVItem(ZCD_NV_LOGICAL_TYPE, value, 1);
+    if (status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_WARNING, "NV device type failed\n");
+        return status;
+    }
 
-        dbg_print(PRINT_LEVEL_INFO, "CLEARING NETWORK AGAIN...\n");
-        status = zMngt_clearNetwork(true);
-        if (status != MT_RPC_SUCCESS)
-        {
-            dbg_print(PRINT_LEVEL_WARNING, "setNVStartNew failed\n");
-            return 0;
-        }
+    //Select random PAN ID for Coord and join any PAN for RTR/ED
+    dbg_print(PRINT_LEVEL_INFO, "PAN ID: %d\n", panId);
+    value[0] = LO_UINT16(panId);
+    value[1] = HI_UINT16(panId);
+    status = syncNVItem(ZCD_NV_PANID, value, 2);
+    if (status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_WARNING, "NV PAN ID failed\n");
+        return status;
+    }
 
-        dbg_print(PRINT_LEVEL_INFO, "DEVICE TYPE: %d\n", devType);
-        status = setNVDevType(devType);
+    //Sett channel 11-25
+    dbg_print(PRINT_LEVEL_INFO, "CHANNEL: %d\n", chan);
+    value[0] = BREAK_UINT32(chanList, 0);
+    value[1] = BREAK_UINT32(chanList, 1);
+    value[2] = BREAK_UINT32(chanList, 2);
+    value[3] = BREAK_UINT32(chanList, 3);
+    status = syncNVItem(ZCD_NV_CHANLIST, value, 4);
+    if (status != MT_RPC_SUCCESS)
+    {
+        dbg_print(PRINT_LEVEL_WARNING, "NV channel list failed\n");
+    }
 
-        if (status != MT_RPC_SUCCESS)
-        {
-            dbg_print(PRINT_LEVEL_WARNING, "setNVDevType failed\n");
-            return 0;
-        }
-        //Select random PAN ID for Coord and join any PAN for RTR/ED
-        dbg_print(PRINT_LEVEL_INFO, "PAN ID: %d\n", panId);
-        status = setNVPanID(panId);
-        if (status != MT_RPC_SUCCESS)
-        {
-            dbg_print(PRINT_LEVEL_WARNING, "setNVPanID failed\n");
-            return 0;
-        }
+    return status;
+}
 
-        // status = getNVPanID();
-        // if (status != MT_RPC_SUCCESS)
-        // {
-        //     dbg_print(PRINT_LEVEL_WARNING, "getNVPanID failed\n");
-        //     return 0;
-        // } else {
-        //     dbg_print(PRINT_LEVEL_INFO, "getNVPanID successful\n");
-        // }
-
-        //Sett channel 11-25
-        dbg_print(PRINT_LEVEL_INFO, "CHANNEL: %d\n", chan);
-        status = setNVChanList(1 << chan);
-        if (status != MT_RPC_SUCCESS)
-        {
-            dbg_print(PRINT_LEVEL_WARNING, "setNVPanID failed\n");
-            return 0;
-        }
+//! \brief          Asks the ZNP for its device state
+//! \return         devStates_t, DEV_STATE_UNKNOWN if it did not answer
+static uint8_t probeDevState(void)
+{
+    GetDeviceInfoFormat_t req;
 
-        // status = getNVChanList();
-        // if (status != MT_RPC_SUCCESS)
-        // {
-        //     dbg_print(PRINT_LEVEL_WARNING, "getNVChanList failed\n");
-        //     return 0;
-        // } else {
-        //     dbg_print(PRINT_LEVEL_INFO, "getNVChanList successful\n");
-        // }
+    probedDevState = DEV_STATE_UNKNOWN;
+    req.Param = ZB_INFO_DEV_STATE;
+    if (zbGetDeviceInfo(&req) != MT_RPC_SUCCESS)
+    {
+        return DEV_STATE_UNKNOWN;
     }
 
+    return probedDevState;
+}
+
+//! \brief          Device state of a ZNP started as devType
+static uint8_t startedState(uint_least8_t devType)
+{
+    switch (devType)
+    {
+    case DEVICETYPE_COORDINATOR:
+        return DEV_ZB_COORD;
+    case DEVICETYPE_ROUTER:
+        return DEV_ROUTER;
+    default:
+        return DEV_END_DEVICE;
+    }
+}
+
+static uint_least8_t startNetwork(uint_least8_t devType)
+{
+    uint_least8_t status;
+    uint32_t waited;
+    struct timespec started;
+
     status = zdoInit();
     if (status == NEW_NETWORK)
     {
@@ -848,49 +885,15 @@ static uint_least8_t startNetwork(uint_least8_t devType, uint_least32_t chan, ui
 
     dbg_print(PRINT_LEVEL_WARNING,"process zdoStatechange callbacks\n");
 
-    //flush AREQ ZDO State Change messages
-	while (rpcStatus != -1)
-	{
-		rpcStatus = rpcWaitMqClientMsg(5000);
-
-		if (((devType == DEVICETYPE_COORDINATOR) && (devState == DEV_ZB_COORD))
-		        || ((devType == DEVICETYPE_ROUTER) && (devState == DEV_ROUTER))
-		        || ((devType == DEVICETYPE_ENDDEVICE)
-		                && (devState == DEV_END_DEVICE)))
-		{
-			break;
-		}
-	}
-
-/*
-    while (rpcStatus != -1)
+    //process AREQ ZDO State Change messages as they come, until the device
+    //state is reached or the start timed out
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    while ((devState != startedState(devType))
+            && ((waited = msSince(&started)) < ZNP_START_TIMEOUT_MS))
     {
-        rpcStatus = rpcWaitMqClientMsg(1000);
-        printf("rpcWaitMqClientMsg returned %x\n", rpcStatus);
-
-        if ( ((devType == DEVICETYPE_COORDINATOR)
-                      && (devState == DEV_ZB_COORD)) ||
-             ((devType == DEVICETYPE_ROUTER)
-            		  && (devState == DEV_ROUTER)) ||
-             ((devType == DEVICETYPE_ENDDEVICE)
-                      && (devState == DEV_END_DEVICE)) )
-        {
-        	//Set ZNP to restore the network on next boot
-            status = setNVStartRestore();
-            if (status != MT_RPC_SUCCESS)
-            {
-                dbg_print(PRINT_LEVEL_WARNING, "Restore nwk option failed\n");
-                printf("Restore nwk option failed %x\n", status);
-                return MT_RPC_ERR_SUBSYSTEM;
-            }
-            break;
-        }
+        rpcWaitMqClientMsg(ZNP_START_TIMEOUT_MS - waited);
     }
-*/
 
-    //set startup option back to keep configuration in case of reset
-    //zMngt_restoreNetwork();
-    
     if (devState < DEV_END_DEVICE)
     {
         //start network failed
@@ -903,32 +906,45 @@ static uint_least8_t startNetwork(uint_least8_t devType, uint_least32_t chan, ui
 
 static uint_least8_t znpReset(void)
 {
-    znpHasReset = false;
-    //Reset ZNP
-    while (znpHasReset == false)
+    uint_least8_t tries;
+    uint32_t waited;
+    struct timespec sent;
+    ResetReqFormat_t resReq;
+
+    for (tries = 0; tries < ZNP_RESET_TRIES; tries++)
     {
         //Resetting ZNP
-        ResetReqFormat_t resReq;
+        znpHasReset = false;
         resReq.Type = 1;
         sysResetReq(&resReq);
 
-        //wait for reset ind
-        while (znpHasReset == false)
+        //wait for reset ind, it ends the wait as soon as it is processed
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        while ((znpHasReset == false)
+                && ((waited = msSince(&sent)) < ZNP_RESET_TIMEOUT_MS))
         {
-            //time out after 5*500ms
-            uint_least8_t to = 5;
-            //flush the Reset Ind
-            rpcWaitMqClientMsg(500);
-            if (--to == 0)
-            {
-                dbg_print(PRINT_LEVEL_ERROR,
-                        "zMngt_start: Timed out waiting for reset\n");
-                return MT_RPC_ERR_SUBSYSTEM;
-            }
+            rpcWaitMqClientMsg(ZNP_RESET_TIMEOUT_MS - waited);
+        }
+
+        if (znpHasReset)
+        {
+            startTimings.reset = 1;
+            return MT_RPC_SUCCESS;
         }
     }
 
-    return MT_RPC_SUCCESS;
+    dbg_print(PRINT_LEVEL_ERROR, "zMngt_start: Timed out waiting for reset\n");
+    return MT_RPC_ERR_SUBSYSTEM;
+}
+
+//! \brief          ms elapsed on the monotonic clock
+static uint32_t msSince(struct timespec *from)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - from->tv_sec) * 1000
+            + (now.tv_nsec - from->tv_nsec) / 1000000);
 }
 
 /*********************************************************************
@@ -944,6 +960,7 @@ uint_least8_t zMngt_init(void)
 {
     //Register Callbacks MT system callbacks
     sysRegisterCallbacks(mtSysCb);
+    sapiRegisterCallbacks(mtSapiCb);
     zdoRegisterCallbacks(mtZdoCb);
 
     return 0;
@@ -964,55 +981,225 @@ void zMngt_registerCallbacks(zMngt_callbacks_t zMngtCallbacks)
 //!                     DEVICETYPE_COORDINATOR
 //!                     DEVICETYPE_ROUTER
 //!                     DEVICETYPE_ENDDEVICE
-//! \param[in]      Chan: Channel Mask (bits 11-25 represent channel scanned)
+//! \param[in]      chan: Channel (11-25) of a new network
+//! \param[in]      newNwk: clear the network state and configuration first
+//! \param[in]      panId: PAN ID of a new network
 //! \return        	status:
 //                      SUCCESS
 //                      FAILURE
+//!
+//! NV items are read first and only written if they differ. The ZNP is only
+//! reset to clear the network, or if it is neither held nor running as
+//! devType already; a ZNP already running as devType is not started again.
 uint_least8_t zMngt_start(uint_least8_t devType, uint_least32_t chan, uint8_t newNwk, uint16_t panId)
 {
-    uint_least8_t status = MT_RPC_ERR_SUBSYSTEM;
-    int_least8_t rpcStatus = 0;
+    uint_least8_t status;
+    uint8_t value;
+    struct timespec began, phase;
 
-    //Flush all messages from the que
-    while (rpcStatus != -1)
+    memset(&startTimings, 0, sizeof(startTimings));
+    clock_gettime(CLOCK_MONOTONIC, &began);
+
+    //Process what is in the que already, without waiting for more
+    while (rpcWaitMqClientMsg(0) != -1)
     {
-        rpcStatus = rpcWaitMqClientMsg(50);
     }
 
-    status = znpReset();
-    if(status == MT_RPC_SUCCESS)
-    {
-        dbg_print(PRINT_LEVEL_INFO, "ZNP Reset\n");
-    } else
+    //what the ZNP is doing and how it will come up after a reset
+    phase = began;
+    startTimings.devState = probeDevState();
+    value = newNwk ? (ZCD_STARTOPT_CLEAR_STATE | ZCD_STARTOPT_CLEAR_CONFIG) : 0;
+    status = syncNVItem(ZCD_NV_STARTUP_OPTION, &value, 1);
+    startTimings.probeMs = msSince(&phase);
+    dbg_print(PRINT_LEVEL_INFO, "ZNP device state %d\n", startTimings.devState);
+
+    if (status == MT_RPC_SUCCESS)
     {
-        dbg_print(PRINT_LEVEL_INFO, "ZNP Reset error\n");
-        return status;
+        if (!newNwk && (startTimings.devState == startedState(devType)))
+        {
+            //running as devType already, only the host restarted
+            dbg_print(PRINT_LEVEL_INFO, "ZNP already up, not restarted\n");
+            startTimings.resumed = 1;
+            devState = startTimings.devState;
+        } else if (newNwk || (startTimings.devState != DEV_HOLD))
+        {
+            //clearing the network takes a reset, and so does starting over a
+            //ZNP that is neither held nor up
+            clock_gettime(CLOCK_MONOTONIC, &phase);
+            status = znpReset();
+            startTimings.resetMs = msSince(&phase);
+            dbg_print(PRINT_LEVEL_INFO, status == MT_RPC_SUCCESS ? "ZNP Reset\n" : "ZNP Reset error\n");
+        }
     }
 
-    //init variable
-    devState = DEV_HOLD;
+    if ((status == MT_RPC_SUCCESS) && !startTimings.resumed)
+    {
+        //init variable
+        devState = DEV_HOLD;
+    }
 
-    status = startNetwork(devType, chan, newNwk, panId);
+    //configure the new network and make ZNP send ZDO messages, NV items
+    //already holding the value are not written again
     if (status == MT_RPC_SUCCESS)
     {
-        dbg_print(PRINT_LEVEL_INFO, "Network up\n");
-    } else
+        clock_gettime(CLOCK_MONOTONIC, &phase);
+        if (newNwk)
+        {
+            status = syncNVConfig(devType, chan, panId);
+        }
+        if (status == MT_RPC_SUCCESS)
+        {
+            value = 1;
+            status = syncNVItem(ZCD_NV_ZDO_DIRECT_CB, &value, 1);
+        }
+        startTimings.configMs = msSince(&phase);
+    }
+
+    if ((status == MT_RPC_SUCCESS) && !startTimings.resumed)
     {
-        dbg_print(PRINT_LEVEL_INFO, "Network Error\n");
-        return status;
+        clock_gettime(CLOCK_MONOTONIC, &phase);
+        status = startNetwork(devType);
+        startTimings.startMs = msSince(&phase);
+        dbg_print(PRINT_LEVEL_INFO, status == MT_RPC_SUCCESS ? "Network up\n" : "Network Error\n");
     }
 
-    //Configure ZNP to send ZDO messages
-    OsalNvWriteFormat_t nvWrite;
-    nvWrite.Id = ZCD_NV_ZDO_DIRECT_CB;
-    nvWrite.Offset = 0;
-    nvWrite.Len = 1;
-    nvWrite.Value[0] = 1;
-    status = sysOsalNvWrite(&nvWrite);
+    startTimings.totalMs = msSince(&began);
+    dbg_print(PRINT_LEVEL_INFO,
+            "zMngt_start: probe %dms reset %dms config %dms start %dms total %dms, %d NV writes\n",
+            startTimings.probeMs, startTimings.resetMs, startTimings.configMs,
+            startTimings.startMs, startTimings.totalMs, startTimings.nvWrites);
 
     return status;
 }
 
+//! \brief          Phase timings of the last zMngt_start
+//! \param[out]     timings
+//! \return         none
+void zMngt_getStartTimings(zMngt_startTimings_t *timings)
+{
+    memcpy(timings, &startTimings, sizeof(zMngt_startTimings_t));
+}
+
+//! \brief          Length of an NV item
+//! \param[in]      id: NV item
+//! \return         length, 0 if the item does not exist, -1 if the ZNP did
+//!                 not answer
+int zMngt_nvLength(uint16_t id)
+{
+    OsalNvLengthFormat_t req;
+
+    nvItemLen = -1;
+    req.Id = id;
+    if (sysOsalNvLength(&req) != MT_RPC_SUCCESS)
+    {
+        return -1;
+    }
+
+    return nvItemLen;
+}
+
+//! \brief          Reads a whole NV item, one response at a time
+//! \param[in]      id: NV item
+//! \param[out]     value: the item
+//! \param[in]      maxLen: size of value
+//! \return         length, 0 if the item does not exist, -1 if it could not
+//!                 be read or is longer than maxLen or than a one byte read
+//!                 offset reaches
+int zMngt_readNVItem(uint16_t id, uint8_t *value, uint16_t maxLen)
+{
+    int len, got, offset = 0;
+
+    len = zMngt_nvLength(id);
+    if ((len <= 0) || (len > maxLen))
+    {
+        return len <= 0 ? len : -1;
+    }
+
+    while (offset < len)
+    {
+        if (offset > 0xFF)
+        {
+            return -1;
+        }
+        got = readNVChunk(id, offset, value + offset, len - offset);
+        if (got <= 0)
+        {
+            return -1;
+        }
+        offset += got;
+    }
+
+    return len;
+}
+
+//! \brief          Writes a whole NV item, creating it if it does not exist
+//! \param[in]      id: NV item
+//! \param[in]      value: len bytes
+//! \return         status: SUCCESS, MT_RPC_ERR_LENGTH if the item exists with
+//!                 another length or is too long for a one byte write offset,
+//!                 otherwise what the ZNP said
+uint8_t zMngt_writeNVItem(uint16_t id, const uint8_t *value, uint16_t len)
+{
+    uint_least8_t status;
+    uint16_t offset, n;
+    int have;
+    OsalNvItemInitFormat_t init;
+    OsalNvWriteFormat_t nvWrite;
+
+    have = zMngt_nvLength(id);
+    if (have < 0)
+    {
+        return MT_RPC_ERR_SUBSYSTEM;
+    }
+    if ((have > 0) && (have != len))
+    {
+        return MT_RPC_ERR_LENGTH;
+    }
+    if (have == 0)
+    {
+        init.Id = id;
+        init.ItemLen = len;
+        init.InitLen = 0;
+        status = sysOsalNvItemInit(&init);
+        if ((status != SUCCESS) && (status != NV_ITEM_UNINIT))
+        {
+            return status;
+        }
+    }
+
+    for (offset = 0; offset < len; offset += n)
+    {
+        if (offset > 0xFF)
+        {
+            return MT_RPC_ERR_LENGTH;
+        }
+        n = len - offset;
+        if (n > sizeof(nvWrite.Value))
+        {
+            n = sizeof(nvWrite.Value);
+        }
+        nvWrite.Id = id;
+        nvWrite.Offset = offset;
+        nvWrite.Len = n;
+        memcpy(nvWrite.Value, value + offset, n);
+        status = sysOsalNvWrite(&nvWrite);
+        if (status != SUCCESS)
+        {
+            dbg_print(PRINT_LEVEL_WARNING, "NV Write 0x%04x at %d failed [%d]\n", id, offset, status);
+            return status;
+        }
+    }
+
+    return SUCCESS;
+}
+
+//! \brief          Resets the ZNP and waits for it to come back
+//! \return         status
+uint_least8_t zMngt_reset(void)
+{
+    return znpReset();
+}
+
 //! \brief          Open the network
 //
 // \param[in]       duration: time to open the network for (0 to close)
@@ -1044,6 +1231,8 @@ uint_least8_t zMngt_openNetwork(uint_least8_t duration)
     req.TCSignificance = 1;
 
     status = zdoMgmtPermitJoinReq(&req);
+    //ZDO broadcast, count it against the BTT and airtime budget (2 byte ZDO payload)
+    zWTxFrameSent(req.AddrMode, req.DstAddr, 2, status);
 
     return status;
 }
@@ -66,13 +66,12 @@ typedef struct
     uint8_t status;
     uint8_t flags;
     uint8_t numInClusters;
-    uint16_t inClusterList[16];
+    uint16_t inClusterList[64];
     uint8_t numOutClusters;
-    uint16_t outClusterList[16];
+    uint16_t outClusterList[64];
 } epInfo_t;
 
 #define MAX_CHILDREN 20
-#define MAX_NODE_LIST 100
 
 typedef struct
 {
@@ -90,6 +89,21 @@ typedef struct
     ChildNode_t childs[MAX_CHILDREN];
 } Node_t;
 
+//! \brief How the last zMngt_start went, times in ms
+//!
+typedef struct
+{
+    uint32_t probeMs; // device state and startup option read
+    uint32_t resetMs; // ZNP reset, 0 if it was not reset
+    uint32_t configMs; // NV configuration read and the differing items written
+    uint32_t startMs; // zdoInit until the device state was reached
+    uint32_t totalMs;
+    uint8_t devState; // as found before starting, 0xFF if the ZNP did not say
+    uint8_t nvWrites; // NV items that differed and were written
+    uint8_t reset; // the ZNP was reset
+    uint8_t resumed; // already running with this configuration, not restarted
+} zMngt_startTimings_t;
+
 //! \brief simple descriptor (new devie) callback typedef
 //!
 typedef uint8_t (*zMngt_zdoSimpleDescRspCb_t)(epInfo_t *epInfo);
@@ -139,6 +153,40 @@ extern void zMngt_registerCallbacks(zMngt_callbacks_t zMngtCallbacks);
 //                      FAILURE
 extern uint_least8_t zMngt_start(uint_least8_t devType, uint_least32_t chan, uint8_t newNwk, uint16_t panId);
 
+//! \brief          Phase timings of the last zMngt_start
+//! \param[out]     timings
+//! \return         none
+extern void zMngt_getStartTimings(zMngt_startTimings_t *timings);
+
+//! \brief          Length of an NV item
+//! \param[in]      id: NV item
+//! \return         length, 0 if the item does not exist, -1 if the ZNP did
+//!                 not answer
+extern int zMngt_nvLength(uint16_t id);
+
+//! \brief          Reads a whole NV item
+//! \param[in]      id: NV item
+//! \param[out]     value: the item
+//! \param[in]      maxLen: size of value
+//! \return         length, 0 if the item does not exist, -1 if it could not
+//!                 be read
+extern int zMngt_readNVItem(uint16_t id, uint8_t *value, uint16_t maxLen);
+
+//! \brief          Writes a whole NV item, creating it if it does not exist
+//! \param[in]      id: NV item
+//! \param[in]      value: len bytes
+//! \return         status:
+//                      SUCCESS
+//                      MT_RPC_ERR_LENGTH, exists with another length
+//                      what the ZNP said otherwise
+extern uint8_t zMngt_writeNVItem(uint16_t id, const uint8_t *value, uint16_t len);
+
+//! \brief          Resets the ZNP and waits for it to come back
+//! \return         status:
+//                      SUCCESS
+//                      FAILURE
+extern uint_least8_t zMngt_reset(void);
+
 extern //! \brief          Open the network
 //
 // \param[in]       duration: time to open the network for (0 to close)
@@ -187,8 +235,6 @@ extern uint_least8_t zMngt_findInMatch(uint_least16_t profileId,
 void* zMngt_getNVItem(uint16_t);
 uint8_t zMngt_setNVItem(uint16_t, uint8_t, uint8_t *);
 
-void printNodeTopology(uint8_t);
-void resetNodeTopology();
 
 #ifdef __cplusplus
 }
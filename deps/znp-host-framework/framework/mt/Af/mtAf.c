@@ -212,6 +212,138 @@ uint8_t afDataRequestExt(DataRequestExtFormat_t *req)
 	}
 }
 
+// header lengths of MT_AF_DATA_REQUEST and MT_AF_DATA_REQUEST_EXT
+#define AF_DATA_REQUEST_HDR_LEN		10
+#define AF_DATA_REQUEST_EXT_HDR_LEN	20
+
+// the shorter request only takes network addresses in this PAN
+static int afShortDataRequest(uint8_t dstAddrMode, uint16_t len)
+{
+	return dstAddrMode == Addr16Bit
+	        && len <= sizeof(((DataRequestFormat_t*) 0)->Data);
+}
+
+uint8_t *afDataRequestTxData(uint8_t dstAddrMode, uint16_t len)
+{
+	if (afShortDataRequest(dstAddrMode, len))
+	{
+		return rpcTxPayload() + AF_DATA_REQUEST_HDR_LEN;
+	}
+	if (len > sizeof(((DataRequestExtFormat_t*) 0)->Data))
+	{
+		return NULL;
+	}
+	return rpcTxPayload() + AF_DATA_REQUEST_EXT_HDR_LEN;
+}
+
+uint8_t afDataRequestTx(DataRequestExtFormat_t *req)
+{
+	uint8_t status;
+	uint8_t cmInd = 0;
+	uint8_t *cmd = rpcTxPayload();
+
+	if (afShortDataRequest(req->DstAddrMode, req->Len) && req->DstPanID == 0)
+	{
+		cmd[cmInd++] = req->DstAddr[0];
+		cmd[cmInd++] = req->DstAddr[1];
+		cmd[cmInd++] = req->DstEndpoint;
+		cmd[cmInd++] = req->SrcEndpoint;
+		cmd[cmInd++] = (uint8_t)(req->ClusterId & 0xFF);
+		cmd[cmInd++] = (uint8_t)((req->ClusterId >> 8) & 0xFF);
+		cmd[cmInd++] = req->TransId;
+		cmd[cmInd++] = req->Options;
+		cmd[cmInd++] = req->Radius;
+		cmd[cmInd++] = (uint8_t)req->Len;
+
+		status = rpcSendFrame((MT_RPC_CMD_SREQ | MT_RPC_SYS_AF),
+		MT_AF_DATA_REQUEST, cmd, AF_DATA_REQUEST_HDR_LEN + req->Len);
+	}
+	else
+	{
+		if (afShortDataRequest(req->DstAddrMode, req->Len))
+		{
+			// another PAN, move the data from where the shorter request wanted it
+			memmove(cmd + AF_DATA_REQUEST_EXT_HDR_LEN,
+			        cmd + AF_DATA_REQUEST_HDR_LEN, req->Len);
+		}
+
+		cmd[cmInd++] = req->DstAddrMode;
+		memcpy((cmd + cmInd), req->DstAddr, 8);
+		cmInd += 8;
+		cmd[cmInd++] = req->DstEndpoint;
+		cmd[cmInd++] = (uint8_t)(req->DstPanID & 0xFF);
+		cmd[cmInd++] = (uint8_t)((req->DstPanID >> 8) & 0xFF);
+		cmd[cmInd++] = req->SrcEndpoint;
+		cmd[cmInd++] = (uint8_t)(req->ClusterId & 0xFF);
+		cmd[cmInd++] = (uint8_t)((req->ClusterId >> 8) & 0xFF);
+		cmd[cmInd++] = req->TransId;
+		cmd[cmInd++] = req->Options;
+		cmd[cmInd++] = req->Radius;
+		cmd[cmInd++] = (uint8_t)(req->Len & 0xFF);
+		cmd[cmInd++] = (uint8_t)((req->Len >> 8) & 0xFF);
+
+		status = rpcSendFrame((MT_RPC_CMD_SREQ | MT_RPC_SYS_AF),
+		MT_AF_DATA_REQUEST_EXT, cmd, AF_DATA_REQUEST_EXT_HDR_LEN + req->Len);
+	}
+
+	if (status == MT_RPC_SUCCESS)
+	{
+		rpcWaitMqClientMsg(50);
+	}
+
+	return status;
+}
+
+// header length of MT_AF_DATA_REQUEST_SRC_RTG, without the relay list
+#define AF_DATA_REQUEST_SRC_RTG_HDR_LEN	11
+
+uint8_t *afDataRequestSrcRtgTxData(uint8_t relayCount, uint16_t len)
+{
+	uint32_t hdrLen = AF_DATA_REQUEST_SRC_RTG_HDR_LEN + relayCount * 2;
+
+	if (len > sizeof(((DataRequestSrcRtgFormat_t*) 0)->Data)
+	        || hdrLen + len > RPC_MAX_LEN - RPC_UART_HDR_LEN - RPC_UART_FCS_LEN)
+	{
+		return NULL;
+	}
+	return rpcTxPayload() + hdrLen;
+}
+
+uint8_t afDataRequestSrcRtgTx(DataRequestSrcRtgFormat_t *req)
+{
+	uint8_t status;
+	uint8_t cmInd = 0;
+	uint8_t *cmd = rpcTxPayload();
+	int idx;
+
+	cmd[cmInd++] = (uint8_t)(req->DstAddr & 0xFF);
+	cmd[cmInd++] = (uint8_t)((req->DstAddr >> 8) & 0xFF);
+	cmd[cmInd++] = req->DstEndpoint;
+	cmd[cmInd++] = req->SrcEndpoint;
+	cmd[cmInd++] = (uint8_t)(req->ClusterID & 0xFF);
+	cmd[cmInd++] = (uint8_t)((req->ClusterID >> 8) & 0xFF);
+	cmd[cmInd++] = req->TransID;
+	cmd[cmInd++] = req->Options;
+	cmd[cmInd++] = req->Radius;
+	cmd[cmInd++] = req->RelayCount;
+	for (idx = 0; idx < req->RelayCount; idx++)
+	{
+		cmd[cmInd++] = (uint8_t)(req->RelayList[idx] & 0xFF);
+		cmd[cmInd++] = (uint8_t)((req->RelayList[idx] >> 8) & 0xFF);
+	}
+	cmd[cmInd++] = req->Len;
+
+	status = rpcSendFrame((MT_RPC_CMD_SREQ | MT_RPC_SYS_AF),
+	MT_AF_DATA_REQUEST_SRC_RTG, cmd, cmInd + req->Len);
+
+	if (status == MT_RPC_SUCCESS)
+	{
+		rpcWaitMqClientMsg(50);
+	}
+
+	return status;
+}
+
 uint8_t afDataRequestSrcRtg(DataRequestSrcRtgFormat_t *req)
 {
 	uint8_t status;
@@ -388,15 +520,11 @@ static void processIncomingMsg(uint8_t *rpcBuff, uint8_t rpcLen)
 			rsp.TimeStamp |= ((uint32_t) rpcBuff[msgIdx++]) << (i * 8);
 		rsp.TransSeqNum = rpcBuff[msgIdx++];
 		rsp.Len = rpcBuff[msgIdx++];
-		if (rpcLen > 17)
+		// the data is not copied, and never read past what the frame holds
+		rsp.Data = &rpcBuff[msgIdx];
+		if (rpcLen < msgIdx + rsp.Len)
 		{
-			uint32_t i;
-			for (i = 0; i < rsp.Len; i++)
-			{
-				rsp.Data[i] = rpcBuff[msgIdx++];
-				// printf("%d ", rsp.Data[i]);
-			}
-			// printf("\n");
+			rsp.Len = rpcLen > msgIdx ? rpcLen - msgIdx : 0;
 		}
 		mtAfCbs.pfnAfIncomingMsg(&rsp);
 	}
@@ -442,10 +570,11 @@ static void processIncomingMsgExt(uint8_t *rpcBuff, uint8_t rpcLen)
 			rsp.TimeStamp |= ((uint32_t) rpcBuff[msgIdx++]) << (i * 8);
 		rsp.TransSeqNum = rpcBuff[msgIdx++];
 		rsp.Len = rpcBuff[msgIdx++];
-		uint32_t ind;
-		for (ind = 0; ind < rsp.Len; ind++)
+		// the data is not copied, and never read past what the frame holds
+		rsp.Data = &rpcBuff[msgIdx];
+		if (rpcLen < msgIdx + rsp.Len)
 		{
-			rsp.Data[ind] = rpcBuff[msgIdx++];
+			rsp.Len = rpcLen > msgIdx ? rpcLen - msgIdx : 0;
 		}
 
 		mtAfCbs.pfnAfIncomingMsgExt(&rsp);
@@ -225,7 +225,7 @@ typedef struct
 	uint32_t TimeStamp;
 	uint8_t TransSeqNum;
 	uint8_t Len;
-	uint8_t Data[99];
+	uint8_t *Data;		//view into the RPC frame, valid for the callback only
 } IncomingMsgFormat_t;
 
 typedef struct
@@ -243,7 +243,7 @@ typedef struct
 	uint32_t TimeStamp;
 	uint8_t TransSeqNum;
 	uint8_t Len;
-	uint8_t Data[99];
+	uint8_t *Data;		//view into the RPC frame, valid for the callback only
 } IncomingMsgExtFormat_t;
 
 typedef struct
@@ -296,6 +296,17 @@ void afProcess(uint8_t *rpcBuff, uint8_t rpcLen);
 uint8_t afRegister(RegisterFormat_t *req);
 uint8_t afDataRequest(DataRequestFormat_t *req);
 uint8_t afDataRequestExt(DataRequestExtFormat_t *req);
+// Data request built in the RPC TX buffer: the data is written at
+// afDataRequestTxData(), then afDataRequestTx() fills in the header in front of
+// it, picking MT_AF_DATA_REQUEST for network addresses, and sends it. req->Data
+// is not used.
+uint8_t *afDataRequestTxData(uint8_t dstAddrMode, uint16_t len);
+uint8_t afDataRequestTx(DataRequestExtFormat_t *req);
+// Same for a source routed request: the data goes at
+// afDataRequestSrcRtgTxData(), which depends on the number of relays, NULL if
+// it does not fit one frame. req->Data is not used.
+uint8_t *afDataRequestSrcRtgTxData(uint8_t relayCount, uint16_t len);
+uint8_t afDataRequestSrcRtgTx(DataRequestSrcRtgFormat_t *req);
 uint8_t afDataRequestSrcRtg(DataRequestSrcRtgFormat_t *req);
 uint8_t afInterPanCtl(InterPanCtlFormat_t *req);
 uint8_t afDataStore(DataStoreFormat_t *req);
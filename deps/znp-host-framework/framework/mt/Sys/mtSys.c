@@ -545,6 +545,10 @@ static void processOsalNvReadSrsp(uint8_t *rpcBuff, uint8_t rpcLen)
 
 		rsp.Status = rpcBuff[msgIdx++];
 		rsp.Len = rpcBuff[msgIdx++];
+		if (rsp.Len > sizeof(rsp.Value))
+		{
+			rsp.Len = sizeof(rsp.Value);
+		}
 		if (rpcLen > 2)
 		{
 			uint32_t i;
@@ -564,7 +568,7 @@ static void processOsalNvReadSrsp(uint8_t *rpcBuff, uint8_t rpcLen)
  *
  * @param   req - Pointer to command specific structure.
  *
- * @return   status, either Success (0) or Failure (1).
+ * @return   status, the one in the SRSP if the request was sent.
  */
 uint8_t sysOsalNvWrite(OsalNvWriteFormat_t *req)
 {
@@ -593,6 +597,7 @@ uint8_t sysOsalNvWrite(OsalNvWriteFormat_t *req)
 		if (status == MT_RPC_SUCCESS)
 		{
 			rpcWaitMqClientMsg(50);
+			status = srspRpcBuff[2];
 		}
 
 		free(cmd);
@@ -613,7 +618,7 @@ uint8_t sysOsalNvWrite(OsalNvWriteFormat_t *req)
  *
  * @param   req - Pointer to command specific structure.
  *
- * @return   status, either Success (0) or Failure (1).
+ * @return   status, the one in the SRSP if the request was sent.
  */
 uint8_t sysOsalNvItemInit(OsalNvItemInitFormat_t *req)
 {
@@ -643,6 +648,7 @@ uint8_t sysOsalNvItemInit(OsalNvItemInitFormat_t *req)
 		if (status == MT_RPC_SUCCESS)
 		{
 			rpcWaitMqClientMsg(50);
+			status = srspRpcBuff[2];
 		}
 
 		free(cmd);
@@ -663,7 +669,7 @@ uint8_t sysOsalNvItemInit(OsalNvItemInitFormat_t *req)
  *
  * @param   req - Pointer to command specific structure.
  *
- * @return   status, either Success (0) or Failure (1).
+ * @return   status, the one in the SRSP if the request was sent.
  */
 uint8_t sysOsalNvDelete(OsalNvDeleteFormat_t *req)
 {
@@ -686,6 +692,7 @@ uint8_t sysOsalNvDelete(OsalNvDeleteFormat_t *req)
 		if (status == MT_RPC_SUCCESS)
 		{
 			rpcWaitMqClientMsg(50);
+			status = srspRpcBuff[2];
 		}
 
 		free(cmd);
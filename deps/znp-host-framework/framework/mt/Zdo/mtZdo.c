@@ -1593,6 +1593,10 @@ static void processNwkAddrRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 		msgIdx += 2;
 		rsp.StartIndex = rpcBuff[msgIdx++];
 		rsp.NumAssocDev = rpcBuff[msgIdx++];
+		if (rsp.NumAssocDev > sizeof(rsp.AssocDevList) / sizeof(rsp.AssocDevList[0]))
+		{
+			rsp.NumAssocDev = sizeof(rsp.AssocDevList) / sizeof(rsp.AssocDevList[0]);
+		}
 		if (rpcLen > 13)
 		{
 			uint32_t i;
@@ -1640,6 +1644,10 @@ static void processIeeeAddrRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 		rsp.StartIndex = rpcBuff[msgIdx++];
 		rsp.NumAssocDev = rpcBuff[msgIdx++];
 		rsp.StartIndex = (rsp.NumAssocDev == 0 ? 0 : rsp.StartIndex);
+		if (rsp.NumAssocDev > sizeof(rsp.AssocDevList) / sizeof(rsp.AssocDevList[0]))
+		{
+			rsp.NumAssocDev = sizeof(rsp.AssocDevList) / sizeof(rsp.AssocDevList[0]);
+		}
 		if (rpcLen > 13)
 		{
 			uint32_t i;
@@ -1776,6 +1784,19 @@ static void processSimpleDescRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 			msgIdx += 2;
 			rsp.DeviceVersion = rpcBuff[msgIdx++];
 			rsp.NumInClusters = rpcBuff[msgIdx++];
+			// no more clusters than the frame, or the list, holds
+			if (rpcLen < msgIdx)
+			{
+				rsp.NumInClusters = 0;
+			}
+			else if (rsp.NumInClusters > (rpcLen - msgIdx) / 2)
+			{
+				rsp.NumInClusters = (rpcLen - msgIdx) / 2;
+			}
+			if (rsp.NumInClusters > sizeof(rsp.InClusterList) / sizeof(rsp.InClusterList[0]))
+			{
+				rsp.NumInClusters = sizeof(rsp.InClusterList) / sizeof(rsp.InClusterList[0]);
+			}
 			uint32_t i;
 			for (i = 0; i < rsp.NumInClusters; i++)
 			{
@@ -1784,6 +1805,18 @@ static void processSimpleDescRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 				msgIdx += 2;
 			}
 			rsp.NumOutClusters = rpcBuff[msgIdx++];
+			if (rpcLen < msgIdx)
+			{
+				rsp.NumOutClusters = 0;
+			}
+			else if (rsp.NumOutClusters > (rpcLen - msgIdx) / 2)
+			{
+				rsp.NumOutClusters = (rpcLen - msgIdx) / 2;
+			}
+			if (rsp.NumOutClusters > sizeof(rsp.OutClusterList) / sizeof(rsp.OutClusterList[0]))
+			{
+				rsp.NumOutClusters = sizeof(rsp.OutClusterList) / sizeof(rsp.OutClusterList[0]);
+			}
 			for (i = 0; i < rsp.NumOutClusters; i++)
 			{
 				rsp.OutClusterList[i] = BUILD_UINT16(rpcBuff[msgIdx],
@@ -1824,6 +1857,10 @@ static void processActiveEpRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 		rsp.NwkAddr = BUILD_UINT16(rpcBuff[msgIdx], rpcBuff[msgIdx + 1]);
 		msgIdx += 2;
 		rsp.ActiveEPCount = rpcBuff[msgIdx++];
+		if (rsp.ActiveEPCount > sizeof(rsp.ActiveEPList))
+		{
+			rsp.ActiveEPCount = sizeof(rsp.ActiveEPList);
+		}
 		if (rpcLen > 6)
 		{
 			uint32_t i;
@@ -2196,6 +2233,19 @@ static void processMgmtLqiRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 		rsp.NeighborTableEntries = rpcBuff[msgIdx++];
 		rsp.StartIndex = rpcBuff[msgIdx++];
 		rsp.NeighborLqiListCount = rpcBuff[msgIdx++];
+		// no more neighbors than the frame, or the list, holds
+		if (rpcLen < msgIdx)
+		{
+			rsp.NeighborLqiListCount = 0;
+		}
+		else if (rsp.NeighborLqiListCount > (rpcLen - msgIdx) / 22)
+		{
+			rsp.NeighborLqiListCount = (rpcLen - msgIdx) / 22;
+		}
+		if (rsp.NeighborLqiListCount > sizeof(rsp.NeighborLqiList) / sizeof(rsp.NeighborLqiList[0]))
+		{
+			rsp.NeighborLqiListCount = sizeof(rsp.NeighborLqiList) / sizeof(rsp.NeighborLqiList[0]);
+		}
 		if (rpcLen > 6)
 		{
 			uint32_t i;
@@ -2256,6 +2306,19 @@ static void processMgmtRtgRsp(uint8_t *rpcBuff, uint8_t rpcLen)
 		rsp.RoutingTableEntries = rpcBuff[msgIdx++];
 		rsp.StartIndex = rpcBuff[msgIdx++];
 		rsp.RoutingTableListCount = rpcBuff[msgIdx++];
+		// no more routes than the frame, or the list, holds
+		if (rpcLen < msgIdx)
+		{
+			rsp.RoutingTableListCount = 0;
+		}
+		else if (rsp.RoutingTableListCount > (rpcLen - msgIdx) / 5)
+		{
+			rsp.RoutingTableListCount = (rpcLen - msgIdx) / 5;
+		}
+		if (rsp.RoutingTableListCount > sizeof(rsp.RoutingTableList) / sizeof(rsp.RoutingTableList[0]))
+		{
+			rsp.RoutingTableListCount = sizeof(rsp.RoutingTableList) / sizeof(rsp.RoutingTableList[0]);
+		}
 		if (rpcLen > 6)
 		{
 			uint32_t i;
@@ -2559,6 +2622,15 @@ static void processSrcRtgInd(uint8_t *rpcBuff, uint8_t rpcLen)
 		rsp.DstAddr = BUILD_UINT16(rpcBuff[msgIdx], rpcBuff[msgIdx + 1]);
 		msgIdx += 2;
 		rsp.RelayCount = rpcBuff[msgIdx++];
+		// no more relays than the frame holds
+		if (rpcLen < msgIdx)
+		{
+			rsp.RelayCount = 0;
+		}
+		else if (rsp.RelayCount > (rpcLen - msgIdx) / 2)
+		{
+			rsp.RelayCount = (rpcLen - msgIdx) / 2;
+		}
 		uint32_t i;
 		for (i = 0; i < rsp.RelayCount; i++)
 		{
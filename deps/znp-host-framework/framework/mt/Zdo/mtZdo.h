@@ -497,9 +497,9 @@ typedef struct
 	uint16_t DeviceID;
 	uint8_t DeviceVersion;
 	uint8_t NumInClusters;
-	uint16_t InClusterList[16];
+	uint16_t InClusterList[64];
 	uint8_t NumOutClusters;
-	uint16_t OutClusterList[16];
+	uint16_t OutClusterList[64];
 } SimpleDescRspFormat_t;
 
 typedef struct
@@ -94,6 +94,10 @@ static uint8_t expectedSrspCmdId;
 // RPC message queue for passing RPC frame from RPC process to APP process
 static llq_t rpcLlq;
 
+// outgoing frame, per thread so callers can build the payload in place
+// before rpcSendFrame takes rpcSem
+static __thread uint8_t rpcTxBuf[RPC_MAX_LEN];
+
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -108,6 +112,9 @@ static uint8_t calcFcs(uint8_t *msg, uint8_t len);
 // function for printing out RPC frames
 static void printRpcMsg(char* preMsg, uint8_t sof, uint8_t len, uint8_t *msg);
 
+// function for turning a relative timeout into a sem_timedwait deadline
+static void rpcDeadline(struct timespec *deadline, uint32_t timeoutMs);
+
 /*********************************************************************
  * API FUNCTIONS
  */
@@ -226,8 +233,7 @@ int32_t rpcWaitMqClientMsg(uint32_t timeout)
 	struct timespec to;
 	struct timeval befTime, aftTime;
 	// calculate timeout
-	to.tv_sec = time(0) + (timeout / 1000);
-	to.tv_nsec = (long) ((long) timeout % 1000) * 1000000L;
+	rpcDeadline(&to, timeout);
 
 	// dbg_print(PRINT_LEVEL_VERBOSE, "rpcWaitMqClientMsg: timeout=%d\n", timeout);
 	// dbg_print(PRINT_LEVEL_VERBOSE,
@@ -457,7 +463,7 @@ int32_t rpcProcess(void)
 uint8_t rpcSendFrame(uint8_t cmd0, uint8_t cmd1, uint8_t *payload,
         uint8_t payload_len)
 {
-	uint8_t buf[RPC_MAX_LEN];
+	uint8_t *buf = rpcTxBuf;
 	int32_t status = MT_RPC_SUCCESS;
 
 	// block here if SREQ is in progress
@@ -477,9 +483,9 @@ uint8_t rpcSendFrame(uint8_t cmd0, uint8_t cmd1, uint8_t *payload,
 		expectedSrspCmdId = (cmd0 & MT_RPC_SUBSYSTEM_MASK);
 	}
 
-	if (payload_len > 0)
+	if (payload_len > 0 && payload != buf + RPC_UART_HDR_LEN)
 	{
-		// copy payload to buffer
+		// copy payload to buffer, unless it was built there
 		memcpy(buf + RPC_UART_HDR_LEN, payload, payload_len);
 	}
 
@@ -509,9 +515,8 @@ uint8_t rpcSendFrame(uint8_t cmd0, uint8_t cmd1, uint8_t *payload,
 	if ((cmd0 & MT_RPC_CMD_TYPE_MASK) == MT_RPC_CMD_SREQ)
 	{
 		// calculate timeout
-		struct timespec srspTimeOut =
-			{ time(0) + (SRSP_TIMEOUT_MS / 1000), (long) ((long) SRSP_TIMEOUT_MS
-			        % 1000) * 1000000 };
+		struct timespec srspTimeOut;
+		rpcDeadline(&srspTimeOut, SRSP_TIMEOUT_MS);
 
 		dbg_print(PRINT_LEVEL_VERBOSE, "rpcSendFrame: waiting for SRSP [%02x]\n",
 		        expectedSrspCmdId);
@@ -541,10 +546,46 @@ uint8_t rpcSendFrame(uint8_t cmd0, uint8_t cmd1, uint8_t *payload,
 	return status;
 }
 
+/*********************************************************************
+ * @fn      rpcTxPayload
+ *
+ * @brief   where the payload goes in this thread's outgoing frame. A payload
+ *          built here is sent by rpcSendFrame without being copied.
+ *
+ * @return  pointer to RPC_MAX_LEN - RPC_UART_HDR_LEN - RPC_UART_FCS_LEN bytes
+ */
+uint8_t *rpcTxPayload(void)
+{
+	return rpcTxBuf + RPC_UART_HDR_LEN;
+}
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
 
+/*********************************************************************
+ * @fn      rpcDeadline
+ *
+ * @brief   absolute CLOCK_REALTIME time timeoutMs from now, as
+ *          sem_timedwait wants it.
+ *
+ * @param   deadline  - filled in
+ * @param   timeoutMs - from now
+ *
+ * @return  -
+ */
+static void rpcDeadline(struct timespec *deadline, uint32_t timeoutMs)
+{
+	clock_gettime(CLOCK_REALTIME, deadline);
+	deadline->tv_sec += timeoutMs / 1000;
+	deadline->tv_nsec += (long) (timeoutMs % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
 /*********************************************************************
  * @fn      calcFcs
  *
@@ -149,6 +149,7 @@ void rpcClose(void);
 int32_t rpcProcess(void);
 uint8_t rpcSendFrame(uint8_t cmd0, uint8_t cmd1, uint8_t * payload,
         uint8_t payload_len);
+uint8_t *rpcTxPayload(void);
 void rpcForceRun(void);
 int32_t rpcInitMq(void);
 int32_t rpcGetMqClientMsg(void);
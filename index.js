@@ -67,4 +67,70 @@ var ZNP = function(path, options) {
 inherits(ZNP, events.EventEmitter);
 inherits(ZNP, znp);
 
+/*
+ * doZCLWork status codes for requests that never reached the ZNP
+ */
+ZNP.ZCL_WORK_CANCELLED = -1;
+ZNP.ZCL_WORK_EXPIRED = -2;
+ZNP.ZCL_WORK_SUPERSEDED = -3;
+
+/*
+ * doZCLWork work codes for attribute reporting
+ */
+ZNP.ZCL_CONFIG_REPORT = 5;
+ZNP.ZCL_READ_REPORT_CFG = 6;
+
+/*
+ * doZCLWork work codes that doZCLWorkBatch takes
+ */
+ZNP.ZCL_SEND_COMMAND = 0;
+ZNP.ZCL_READ_ATTR = 1;
+ZNP.ZCL_WRITE_ATTR = 2;
+
+/*
+ * doZCLWorkBatch descriptor size and flags, see ZCL_WORK_DESC_SIZE in znp_node.h for the layout
+ */
+ZNP.ZCL_WORK_DESC_SIZE = 32;
+ZNP.ZCL_WORK_FLAG_SPECIFIC = 0x01;
+ZNP.ZCL_WORK_FLAG_SERVER_TO_CLIENT = 0x02;
+ZNP.ZCL_WORK_FLAG_NO_DEFAULT_RSP = 0x04;
+ZNP.ZCL_WORK_FLAG_CONFLATE = 0x08;
+ZNP.ZCL_WORK_FLAG_COALESCE = 0x10;
+
+/*
+ * readShadow sources
+ */
+ZNP.SHADOW_READ = 0;
+ZNP.SHADOW_REPORT = 1;
+ZNP.SHADOW_WRITE = 2;
+
+/*
+ * groupWork operations
+ */
+ZNP.GROUP_ADD = 0;
+ZNP.GROUP_REMOVE = 1;
+ZNP.GROUP_GET_MEMBERSHIP = 2;
+ZNP.SCENE_STORE = 3;
+ZNP.SCENE_RECALL = 4;
+
+/*
+ * onTopologyChange kinds
+ */
+ZNP.TOPOLOGY_NODE_ADDED = 0;
+ZNP.TOPOLOGY_NODE_ADDR_CHANGED = 1;
+ZNP.TOPOLOGY_LINK_ADDED = 2;
+ZNP.TOPOLOGY_LINK_REMOVED = 3;
+ZNP.TOPOLOGY_LINK_CHANGED = 4;
+ZNP.TOPOLOGY_ROUTE_ADDED = 5;
+ZNP.TOPOLOGY_ROUTE_REMOVED = 6;
+
+/*
+ * onDeviceReady failedStep, the interview step a device did not get through
+ */
+ZNP.INTERVIEW_IEEE_ADDR = 0;
+ZNP.INTERVIEW_NODE_DESC = 1;
+ZNP.INTERVIEW_ACTIVE_EP = 2;
+ZNP.INTERVIEW_SIMPLE_DESC = 3;
+ZNP.INTERVIEW_BASIC = 4;
+
 module.exports = ZNP;
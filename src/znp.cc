@@ -21,10 +21,15 @@
 */
 
 
+#include <errno.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <list>
 #include <queue>
+#include <deque>
+#include <map>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 
 #include <node.h>
@@ -33,9 +38,24 @@
 
 #include "zclSendRcv.h"
 #include "rpc.h"
+#include "mtSys.h"
 #include "dbgPrint.h"
 #include "znp_node.h"
 #include "znp_cfuncs.h"
+#include "znp_txgov.h"
+#include "znp_fanout.h"
+#include "znp_groups.h"
+#include "znp_shadow.h"
+#include "znp_zcltypes.h"
+#include "znp_lqi.h"
+#include "znp_topology.h"
+#include "znp_rtg.h"
+#include "znp_srcrtg.h"
+#include "znp_interview.h"
+#include "znp_devices.h"
+#include "znp_devdb.h"
+#include "znp_snapshot.h"
+#include "znp_nvbackup.h"
 #include "zcl_gateway.h"
 #include "zcl.h"
 
@@ -44,6 +64,11 @@ using namespace v8;
 __thread ZNP *myZnp = NULL;
 uv_async_t v8async;
 uv_async_t znpasync;
+uv_timer_t txtimer;
+uv_timer_t fanouttimer;
+uv_timer_t splittimer;
+uv_timer_t interviewtimer;
+uv_timer_t dbtimer;
 uv_mutex_t _control;
 uv_cond_t _start_cond;
 uv_thread_t znp_thread;
@@ -60,7 +85,118 @@ bool threadUp = false;
  * Message passing queue from v8 and znp.
  */
 static pthread_mutex_t workqueue_mutex = PTHREAD_MUTEX_INITIALIZER;
-static std::queue<ZNP::zclTransport *> workqueue;
+static std::deque<ZNP::zclTransport *> workqueue;
+static uint32_t nextWorkHandle = 1;
+
+/*
+ * Fan-outs that have been sent and are waiting for their data confirms.
+ */
+static std::list<ZNP::zclTransport *> fanOutsAwaiting;
+
+/*
+ * ZDO table walks driven from the loop: the walker, the request that asks it
+ * a page, the timer for page timeouts and the callback once the walk is done.
+ */
+typedef struct {
+	ZdoTableWalker *walker;
+	uint8_t (*ask)(uint16_t nwkAddr, uint8_t startIndex);
+	const char *name;			//for the log
+	const char *entries;		//what the summary calls table entries
+	void (*summarize)(v8::Local<v8::Object> o);	//fields of this walk only, may be NULL
+	uv_timer_t timer;
+	Nan::Callback *doneCB;
+} table_walk;
+
+static void summarizeHarvest(v8::Local<v8::Object> o);
+static table_walk crawl = { &lqiCrawler, wZSendLqiReq, "Mgmt_Lqi", "neighbors", NULL };
+static table_walk harvest = { &rtgHarvester, wZSendRtgReq, "Mgmt_Rtg", "routes", summarizeHarvest };
+static int pumpWalk(table_walk *w);
+static void reportRouter(ZNP *zb, const LqiCrawler::router &r);
+static void reportTopologyChanges(ZNP *zb, const std::vector<TopologyGraph::change> &changes);
+static void invalidateMovedRoutes(const std::vector<TopologyGraph::change> &changes);
+
+/*
+ * Devices being interviewed, each one goes to onDeviceReady once its interview ends.
+ */
+static int pumpInterviews();
+
+/*
+ * A device answered from another nwk address than the one it had, see deviceMoved().
+ */
+static void deviceMoved(ZNP *zb, uint64_t extAddr, uint16_t nwkAddr, int oldNwkAddr);
+static void addressTaken(uint16_t nwkAddr);
+
+/*
+ * How the last network start went, given to onNetworkReady and onNetworkFailed.
+ */
+static v8::Local<v8::Object> startTimingsToObject(const zMngt_startTimings_t *t);
+
+/*
+ * How often the device database is saved if devices changed, and how often
+ * if only attribute values did: reports change those all the time.
+ */
+static uint32_t dbSaveIntervalMs = 10000;
+static uint32_t dbAttrSaveIntervalMs = 60000;
+
+/*
+ * ZCL bytes that fit one unfragmented APS frame with network and APS security
+ * headers. Reads and writes are split, or coalesced, to stay within it.
+ */
+#define ZCL_FRAME_MAX_PAYLOAD	80
+#define READ_RSP_TIMEOUT	30000
+
+//ms a coalescable read or write waits at the head of the queue for others to join it
+static uint32_t coalesceWindowMs = 0;
+
+typedef struct {
+	uint16_t msgId;
+	uint16_t seqNumber;
+	std::vector<uint16_t> attrIds;
+} coalescedCaller;
+
+typedef struct {
+	uint64_t sent;
+	uint16_t clusterId;
+	std::vector<coalescedCaller> callers;	//the request that went on air first
+} coalescedRead;
+
+/*
+ * Merged reads waiting for their response, nwk addr << 8 | ZCL transaction id.
+ * Only used on the v8 thread.
+ */
+static std::map<uint32_t, coalescedRead> coalescedReads;
+
+/*
+ * A read too large for one frame, reassembled from the responses to its parts.
+ */
+typedef struct {
+	uint16_t srcAddr;
+	uint8_t endPoint;
+	uint8_t addrMode;
+	uint16_t clusterId;
+	uint16_t seqNumber;		//the caller's
+	uint8_t parts;
+	int outstanding;		//parts sent whose response is not in yet
+	bool complete;			//no more parts will be sent
+	uint64_t sent;
+	std::vector<uint8_t> payload;
+} splitRead;
+
+/*
+ * Split reads by doZCLWork handle, and the handle each part belongs to by
+ * nwk addr << 8 | ZCL transaction id. Only used on the v8 thread.
+ */
+static std::map<uint32_t, splitRead> splitReads;
+static std::map<uint32_t, uint32_t> splitReadParts;
+
+/*
+ * ZCL transaction ids of the doZCLWork reads waiting for their response, by
+ * nwk addr << 8 | id, and the loop time each one was sent. The ids of reads
+ * the addon sends on its own come from zclTransId(), which skips these, and
+ * a response with one of these ids goes to JS. Only used on the v8 thread.
+ */
+static std::map<uint32_t, uint64_t> readsInFlight;
+static uint8_t nextTransId = 0;
 
 enum event_code {
 	NETWORK_UP,
@@ -69,7 +205,16 @@ enum event_code {
 	ZCL_COMMAND_RESPONSE,
 	ZCL_ATTR_RESPONSE,
 	NETWORK_TOPOLOGY,
-	ONLINE_DEVICE
+	ROUTING_TABLE,
+	ONLINE_DEVICE,
+	GROUP_RESPONSE,
+	ATTRIBUTE_REPORT,
+	IEEE_ADDRESS,
+	NODE_DESCRIPTOR,
+	ACTIVE_ENDPOINTS,
+	SIMPLE_DESCRIPTOR,
+	NWK_ADDRESS,
+	DEVICE_LEFT
 };
 
 typedef struct {
@@ -91,6 +236,185 @@ static pthread_mutex_t critical_failure_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 //*********************************************************************************************************************
 
+/*
+ * onAttrResponse(info, payload, seqId, attributes), attributes being the payload
+ * decoded to { attrId, status, dataType, value } records.
+ */
+static void callAttrResponse(ZNP *zb, Local<Object> info, const uint8_t *payload, uint16_t len, uint16_t seqId)
+{
+	Local<Value> args[4];
+
+	if(!zb->onAttrResponseCB) {
+		return;
+	}
+
+	Local<Object> buf = UNI_BUFFER_NEW(len);
+	if(len > 0) {
+		memcpy(node::Buffer::Data(buf), payload, len);
+	}
+
+	args[0] = info;
+	args[1] = buf;
+	args[2] = Nan::New(seqId);
+	args[3] = zclDecodeReadRsp(payload, len);
+	zb->onAttrResponseCB->Call(Nan::GetCurrentContext()->Global(), 4, args);
+}
+
+void splittimer_cb_handler(uv_timer_t *handle, int status);
+
+/*
+ * Deliver a split read as one response once every part sent has answered.
+ */
+static void finishSplitRead(uint32_t handle)
+{
+	std::map<uint32_t, splitRead>::iterator it = splitReads.find(handle);
+	if(it == splitReads.end() || !it->second.complete || it->second.outstanding > 0) {
+		return;
+	}
+	splitRead &r = it->second;
+
+	v8::Local<v8::Object> info = Nan::New<v8::Object>();
+	info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(r.srcAddr));
+	info->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(r.endPoint));
+	info->Set(Nan::New("addrMode").ToLocalChecked(), Nan::New(r.addrMode));
+	info->Set(Nan::New("transId").ToLocalChecked(), Nan::New(r.seqNumber));
+	info->Set(Nan::New("clusterId").ToLocalChecked(), Nan::New(r.clusterId));
+	info->Set(Nan::New("payloadLen").ToLocalChecked(), Nan::New((uint32_t)r.payload.size()));
+	info->Set(Nan::New("parts").ToLocalChecked(), Nan::New(r.parts));
+
+	callAttrResponse(myZnp, info, r.payload.empty() ? NULL : &r.payload[0], r.payload.size(), r.seqNumber);
+	splitReads.erase(handle);
+
+	for(std::map<uint32_t, uint32_t>::iterator part = splitReadParts.begin(); part != splitReadParts.end(); ) {
+		if(part->second == handle) {
+			splitReadParts.erase(part++);
+		} else {
+			part++;
+		}
+	}
+}
+
+/*
+ * Collect the response to one part of a split read. Returns false if resp
+ * is not for a split read.
+ */
+static bool deliverSplitRead(ZNP *zb, attr_response *resp)
+{
+	std::map<uint32_t, uint32_t>::iterator part = splitReadParts.find(((uint32_t)resp->srcAddr << 8) | resp->transId);
+	if(part == splitReadParts.end()) {
+		return false;
+	}
+	uint32_t handle = part->second;
+	splitReadParts.erase(part);
+
+	std::map<uint32_t, splitRead>::iterator it = splitReads.find(handle);
+	if(it == splitReads.end() || it->second.clusterId != resp->clusterId || resp->payloadLen > sizeof(resp->payload)) {
+		return false;
+	}
+	it->second.payload.insert(it->second.payload.end(), resp->payload, resp->payload + resp->payloadLen);
+	it->second.outstanding--;
+	zb->waitForResponse = false;
+
+	finishSplitRead(handle);
+	return true;
+}
+
+/*
+ * Deliver what answered of every split read whose last part went out
+ * READ_RSP_TIMEOUT ago, then wake up for the next one.
+ */
+static void checkSplitReads()
+{
+	uint64_t now = uv_now(uv_default_loop());
+	uint64_t wake = 0;
+	std::vector<uint32_t> expired;
+
+	for(std::map<uint32_t, splitRead>::iterator it = splitReads.begin(); it != splitReads.end(); it++) {
+		uint64_t deadline = it->second.sent + READ_RSP_TIMEOUT;
+		if(it->second.complete && now >= deadline) {
+			expired.push_back(it->first);
+		} else if(wake == 0 || deadline < wake) {
+			wake = deadline;
+		}
+	}
+
+	if(wake) {
+		uv_timer_start(&splittimer, (uv_timer_cb)splittimer_cb_handler, wake > now ? wake - now : 0, 0);
+	}
+
+	for(size_t i = 0; i < expired.size(); i++) {
+		std::map<uint32_t, splitRead>::iterator it = splitReads.find(expired[i]);
+		if(it != splitReads.end()) {
+			it->second.outstanding = 0;
+			finishSplitRead(expired[i]);
+		}
+	}
+}
+
+void splittimer_cb_handler(uv_timer_t *handle, int status)
+{
+	Nan::HandleScope scope;
+	checkSplitReads();
+}
+
+/*
+ * Hand every caller of a merged read the records it asked for, as if its
+ * read had gone out on its own. Returns false if resp is not for a merged read.
+ */
+static bool deliverCoalescedRead(ZNP *zb, attr_response *resp)
+{
+	uint8_t payload[sizeof(resp->payload)];
+
+	std::map<uint32_t, coalescedRead>::iterator it = coalescedReads.find(((uint32_t)resp->srcAddr << 8) | resp->transId);
+	if(it == coalescedReads.end() || it->second.clusterId != resp->clusterId || resp->payloadLen > sizeof(resp->payload)) {
+		return false;
+	}
+
+	for(size_t c = 0; c < it->second.callers.size(); c++) {
+		coalescedCaller &caller = it->second.callers[c];
+		uint16_t len = 0, i = 0;
+
+		//read response records: attrId, status, [dataType, value]
+		while(i + 3 <= resp->payloadLen) {
+			uint16_t start = i;
+			uint16_t attrId = BUILD_UINT16(resp->payload[i], resp->payload[i + 1]);
+			uint8_t status = resp->payload[i + 2];
+			i += 3;
+			if(status == ZCL_STATUS_SUCCESS) {
+				if(i + 1 > resp->payloadLen) {
+					break;
+				}
+				uint8_t dataType = resp->payload[i++];
+				int vlen = zclValueLength(dataType, &resp->payload[i], resp->payloadLen - i);
+				if(vlen < 0) {
+					break;
+				}
+				i += vlen;
+			}
+			if(std::find(caller.attrIds.begin(), caller.attrIds.end(), attrId) != caller.attrIds.end()) {
+				memcpy(&payload[len], &resp->payload[start], i - start);
+				len += i - start;
+			}
+		}
+
+		v8::Local<v8::Object> info = Nan::New<v8::Object>();
+		info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(resp->srcAddr));
+		info->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(resp->endPoint));
+		info->Set(Nan::New("addrMode").ToLocalChecked(), Nan::New(resp->addrMode));
+		info->Set(Nan::New("transId").ToLocalChecked(), Nan::New(caller.seqNumber));
+		info->Set(Nan::New("clusterId").ToLocalChecked(), Nan::New(resp->clusterId));
+		info->Set(Nan::New("payloadLen").ToLocalChecked(), Nan::New(len));
+		info->Set(Nan::New("coalesced").ToLocalChecked(), Nan::New(true));
+
+		//attributes that did not fit the response are simply missing, as with any read
+		callAttrResponse(zb, info, payload, len, caller.seqNumber);
+	}
+
+	coalescedReads.erase(it);
+	zb->waitForResponse = false;
+	return true;
+}
+
 /*
  * Async handler, triggered by the ZNP callback.
  */
@@ -112,17 +436,23 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 		switch (req->code) {
 			case NETWORK_UP:
 			{
+				zMngt_startTimings_t *timings = (zMngt_startTimings_t*)req->data;
 				if(zb->onNetworkReadyCB) {
-					zb->onNetworkReadyCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+					args[0] = startTimingsToObject(timings);
+					zb->onNetworkReadyCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
 				}
+				free(timings);
 				break;
 			}
 
 			case NETWORK_DOWN: 
 			{
+				zMngt_startTimings_t *timings = (zMngt_startTimings_t*)req->data;
 				if(zb->onNetworkFailedCB) {
-					zb->onNetworkFailedCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+					args[0] = startTimingsToObject(timings);
+					zb->onNetworkFailedCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
 				}
+				free(timings);
 				break;
 			}
 
@@ -131,6 +461,11 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 				epInfo_t *nodeInfo = (epInfo_t*)req->data;
 				Local<Object> buf;
 				v8::Local<v8::Object> info = Nan::New<v8::Object>();
+				uint64_t extAddr = deviceRegistry.extAddrOf(nodeInfo->nwkAddr);
+
+				for(int i = 0; i < 8; i++) {
+					nodeInfo->IEEEAddr[i] = (uint8_t)(extAddr >> (8 * i));
+				}
 
 				info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(nodeInfo->srcAddr));
 				info->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(nodeInfo->nwkAddr));
@@ -157,6 +492,7 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 				if(zb->onNodeDiscoveredCB) {
 					zb->onNodeDiscoveredCB->Call(Nan::GetCurrentContext()->Global(), 4, args);
 				}
+				free(nodeInfo);
 				break;
 			}
 
@@ -179,7 +515,19 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 			{
 				dbg_print(PRINT_LEVEL_VERBOSE, "GOT ZCL_ATTR_RESPONSE\n");
 				attr_response *resp = (attr_response*)req->data;
-				Local<Object> buf;
+				//a doZCLWork read with the same id wins over an interview, which asks again
+				bool jsRead = readsInFlight.erase(((uint32_t)resp->srcAddr << 8) | resp->transId) > 0;
+				if(!jsRead && resp->payloadLen <= sizeof(resp->payload) &&
+						interviewer.basicRsp(resp->srcAddr, resp->transId, resp->clusterId,
+							resp->payload, resp->payloadLen, uv_now(uv_default_loop()))) {
+					pumpInterviews();
+					free(resp);
+					break;
+				}
+				if(deliverCoalescedRead(zb, resp) || deliverSplitRead(zb, resp)) {
+					free(resp);
+					break;
+				}
 				v8::Local<v8::Object> info = Nan::New<v8::Object>();
 
 					// printf("\tsrcAddr: %d\n",			resp->srcAddr		);
@@ -203,30 +551,50 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 						info->Set(Nan::New("clusterId").ToLocalChecked(), Nan::New(resp->clusterId));
 						info->Set(Nan::New("payloadLen").ToLocalChecked(), Nan::New(resp->payloadLen));
 
-						args[0] = info;
-						toBuffer(buf, resp->payload, resp->payloadLen * sizeof(uint8_t));
-						args[1] = buf->ToObject();
-						args[2] = Nan::New(zb->currentCmdSeqId);
-						if(zb->onAttrResponseCB) {
-							zb->onAttrResponseCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
-						}
+						callAttrResponse(zb, info, resp->payload, resp->payloadLen, zb->currentCmdSeqId);
 						zb->waitForResponse = false;
 					} else {
 						dbg_print(PRINT_LEVEL_ERROR, "ZCL_ATTR_RESPONSE got payload of len >255: %d\n", resp->payloadLen);
 					}
+				free(resp);
 				break;
 			}
 
 			case NETWORK_TOPOLOGY: 
 			{
-				Node_t *nodeLqi = (Node_t*)req->data;
-				Local<Object> buf;
+				MgmtLqiRspFormat_t *rsp = (MgmtLqiRspFormat_t*)req->data;
+				std::vector<LqiCrawler::router> complete;
+				std::vector<TopologyGraph::change> changes;
+
+				if(lqiCrawler.response(rsp, uv_now(uv_default_loop()))) {
+					lqiCrawler.ready(complete);
+					for(size_t i = 0; i < complete.size(); i++) {
+						topologyGraph.updateRouter(complete[i].nwkAddr, complete[i].neighbors, uv_now(uv_default_loop()), changes);
+						reportRouter(zb, complete[i]);
+					}
+					invalidateMovedRoutes(changes);
+					reportTopologyChanges(zb, changes);
+					pumpWalk(&crawl);
+				}
+				free(rsp);
+				break;
+			}
 
-				toBuffer(buf, nodeLqi, (sizeof(uint16_t) + 2 * sizeof(uint8_t) + nodeLqi->ChildCount * sizeof(ChildNode_t)));
-				args[0] = buf->ToObject();
-				if(zb->onNetworkTopologyCB) {
-					zb->onNetworkTopologyCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+			case ROUTING_TABLE:
+			{
+				MgmtRtgRspFormat_t *rsp = (MgmtRtgRspFormat_t*)req->data;
+				std::vector<uint16_t> complete;
+				std::vector<TopologyGraph::change> changes;
+
+				if(rtgHarvester.response(rsp, uv_now(uv_default_loop()))) {
+					rtgHarvester.ready(complete);
+					for(size_t i = 0; i < complete.size(); i++) {
+						topologyGraph.updateRoutes(complete[i], *rtgHarvester.table(complete[i]), uv_now(uv_default_loop()), changes);
+					}
+					reportTopologyChanges(zb, changes);
+					pumpWalk(&harvest);
 				}
+				free(rsp);
 				break;
 			}
 
@@ -234,6 +602,32 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 			{
 				EndDeviceAnnceIndFormat_t *msg = (EndDeviceAnnceIndFormat_t*)req->data;
 				v8::Local<v8::Object> info = Nan::New<v8::Object>();
+				std::vector<TopologyGraph::change> changes;
+
+				topologyGraph.announce(msg->NwkAddr, msg->IEEEAddr, msg->Capabilities, uv_now(uv_default_loop()), changes);
+				//a device that (re)joined may have a new parent, and its old address is gone
+				srcRoutes.invalidate(msg->NwkAddr);
+				invalidateMovedRoutes(changes);
+				reportTopologyChanges(zb, changes);
+
+				DeviceRegistry::device known;
+				bool wasKnown = deviceRegistry.find(msg->IEEEAddr, known);
+
+				uint64_t displaced;
+				int oldNwkAddr = deviceRegistry.announced(msg->IEEEAddr, msg->NwkAddr, msg->Capabilities, uv_now(uv_default_loop()), &displaced);
+				if(displaced) {
+					addressTaken(msg->NwkAddr);
+				}
+				if(oldNwkAddr >= 0) {
+					deviceMoved(zb, msg->IEEEAddr, msg->NwkAddr, oldNwkAddr);
+				}
+
+				//a device the database already knows is not interviewed again, interviewDevice() forces it,
+				//one it knows only part of goes ahead of the new ones
+				if(!(wasKnown && known.interviewed)
+						&& interviewer.start(msg->NwkAddr, msg->IEEEAddr, uv_now(uv_default_loop()), wasKnown)) {
+					pumpInterviews();
+				}
 
 				info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(msg->SrcAddr));
 				info->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(msg->NwkAddr));
@@ -244,6 +638,169 @@ void v8async_cb_handler(uv_async_t *handle, int status)
 				if(zb->onDeviceJoinedNetworkCB) {
 					zb->onDeviceJoinedNetworkCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
 				}
+				free(msg);
+				break;
+			}
+
+			case IEEE_ADDRESS:
+			{
+				IeeeAddrRspFormat_t *rsp = (IeeeAddrRspFormat_t*)req->data;
+				if(rsp->Status == MT_RPC_SUCCESS) {
+					uint64_t displaced;
+					int oldNwkAddr = deviceRegistry.address(rsp->IEEEAddr, rsp->NwkAddr, uv_now(uv_default_loop()), &displaced);
+					if(displaced) {
+						addressTaken(rsp->NwkAddr);
+					}
+					if(oldNwkAddr >= 0) {
+						deviceMoved(zb, rsp->IEEEAddr, rsp->NwkAddr, oldNwkAddr);
+					}
+				}
+				if(interviewer.ieeeAddr(rsp, uv_now(uv_default_loop()))) {
+					pumpInterviews();
+				}
+				free(rsp);
+				break;
+			}
+
+			case NWK_ADDRESS:
+			{
+				NwkAddrRspFormat_t *rsp = (NwkAddrRspFormat_t*)req->data;
+				if(rsp->Status == MT_RPC_SUCCESS) {
+					uint64_t displaced;
+					int oldNwkAddr = deviceRegistry.address(rsp->IEEEAddr, rsp->NwkAddr, uv_now(uv_default_loop()), &displaced);
+					if(displaced) {
+						addressTaken(rsp->NwkAddr);
+					}
+					if(oldNwkAddr >= 0) {
+						deviceMoved(zb, rsp->IEEEAddr, rsp->NwkAddr, oldNwkAddr);
+					}
+				}
+				free(rsp);
+				break;
+			}
+
+			case DEVICE_LEFT:
+			{
+				LeaveIndFormat_t *msg = (LeaveIndFormat_t*)req->data;
+				srcRoutes.invalidate(msg->SrcAddr);
+				//a device rejoining keeps its entry, its announce brings the new address
+				if(!msg->Rejoin) {
+					deviceRegistry.remove(msg->ExtAddr);
+					attrShadow.forget(msg->SrcAddr);
+					groupTable.forget(msg->SrcAddr);
+				}
+				free(msg);
+				break;
+			}
+
+			case NODE_DESCRIPTOR:
+			{
+				NodeDescRspFormat_t *rsp = (NodeDescRspFormat_t*)req->data;
+				if(interviewer.nodeDesc(rsp, uv_now(uv_default_loop()))) {
+					pumpInterviews();
+				}
+				free(rsp);
+				break;
+			}
+
+			case ACTIVE_ENDPOINTS:
+			{
+				ActiveEpRspFormat_t *rsp = (ActiveEpRspFormat_t*)req->data;
+				if(interviewer.activeEp(rsp, uv_now(uv_default_loop()))) {
+					pumpInterviews();
+				}
+				free(rsp);
+				break;
+			}
+
+			case SIMPLE_DESCRIPTOR:
+			{
+				SimpleDescRspFormat_t *rsp = (SimpleDescRspFormat_t*)req->data;
+				if(interviewer.simpleDesc(rsp, uv_now(uv_default_loop()))) {
+					pumpInterviews();
+				}
+				free(rsp);
+				break;
+			}
+
+			case GROUP_RESPONSE:
+			{
+				group_response *resp = (group_response*)req->data;
+				v8::Local<v8::Object> info = Nan::New<v8::Object>();
+				v8::Local<v8::Array> groups = Nan::New<v8::Array>(resp->grpCnt);
+
+				for(uint8_t i = 0; i < resp->grpCnt; i++) {
+					groups->Set(i, Nan::New(resp->grpList[i]));
+				}
+
+				info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(resp->srcAddr));
+				info->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(resp->endPoint));
+				info->Set(Nan::New("clusterId").ToLocalChecked(), Nan::New(resp->clusterId));
+				info->Set(Nan::New("cmdId").ToLocalChecked(), Nan::New(resp->cmdId));
+				info->Set(Nan::New("status").ToLocalChecked(), Nan::New(resp->status));
+				info->Set(Nan::New("capacity").ToLocalChecked(), Nan::New(resp->capacity));
+				info->Set(Nan::New("groupId").ToLocalChecked(), Nan::New(resp->groupId));
+				info->Set(Nan::New("sceneId").ToLocalChecked(), Nan::New(resp->sceneId));
+				info->Set(Nan::New("groups").ToLocalChecked(), groups);
+
+				args[0] = info;
+				if(zb->onGroupResponseCB) {
+					zb->onGroupResponseCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+				}
+				free(resp);
+				break;
+			}
+
+			case ATTRIBUTE_REPORT:
+			{
+				report_response *resp = (report_response*)req->data;
+				v8::Local<v8::Object> info = Nan::New<v8::Object>();
+				v8::Local<v8::Array> attrs = Nan::New<v8::Array>(resp->numAttr);
+				bool isReport = (resp->cmdId == ZCL_CMD_REPORT);
+
+				for(uint8_t i = 0; i < resp->numAttr; i++) {
+					report_record *rec = &resp->attrs[i];
+					v8::Local<v8::Object> attr = Nan::New<v8::Object>();
+
+					attr->Set(Nan::New("attrId").ToLocalChecked(), Nan::New(rec->attrId));
+					if(isReport) {
+						attr->Set(Nan::New("dataType").ToLocalChecked(), Nan::New(rec->dataType));
+						attr->Set(Nan::New("value").ToLocalChecked(), zclDecodeValue(rec->dataType, rec->value, rec->len));
+					} else {
+						attr->Set(Nan::New("status").ToLocalChecked(), Nan::New(rec->status));
+						attr->Set(Nan::New("direction").ToLocalChecked(), Nan::New(rec->direction));
+						if(resp->cmdId == ZCL_CMD_READ_REPORT_CFG_RSP && rec->status == ZCL_STATUS_SUCCESS) {
+							if(rec->direction == ZCL_SEND_ATTR_REPORTS) {
+								attr->Set(Nan::New("dataType").ToLocalChecked(), Nan::New(rec->dataType));
+								attr->Set(Nan::New("minInterval").ToLocalChecked(), Nan::New(rec->minInterval));
+								attr->Set(Nan::New("maxInterval").ToLocalChecked(), Nan::New(rec->maxInterval));
+								if(rec->len > 0) {
+									attr->Set(Nan::New("reportableChange").ToLocalChecked(), zclDecodeValue(rec->dataType, rec->value, rec->len));
+								}
+							} else {
+								attr->Set(Nan::New("timeoutPeriod").ToLocalChecked(), Nan::New(rec->timeoutPeriod));
+							}
+						}
+					}
+					attrs->Set(i, attr);
+				}
+
+				info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(resp->srcAddr));
+				info->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(resp->endPoint));
+				info->Set(Nan::New("clusterId").ToLocalChecked(), Nan::New(resp->clusterId));
+				info->Set(Nan::New("transId").ToLocalChecked(), Nan::New(resp->transId));
+				info->Set(Nan::New("cmdId").ToLocalChecked(), Nan::New(resp->cmdId));
+				info->Set(Nan::New("attributes").ToLocalChecked(), attrs);
+
+				args[0] = info;
+				if(isReport) {
+					if(zb->onAttributeReportCB) {
+						zb->onAttributeReportCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+					}
+				} else if(zb->onReportConfigCB) {
+					zb->onReportConfigCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+				}
+				free(resp);
 				break;
 			}
 
@@ -278,559 +835,2507 @@ void submitToV8(event_code code, void *data, int size, int err)
 
 //*********************************************************************************************************************
 /*
- * Async handler, triggered by the v8 calls.
+ * Destination and ZCL payload size of a queued request, as seen by the tx governor.
  */
-void znpasync_cb_handler(uv_async_t *handle, int status)
-{
-	Nan::HandleScope scope;
+static uint16_t readRspEstimate(ZNP::readAttr_t *command, uint16_t attrId);
 
-	ZNP::zclTransport *req;
-	Local<Value> args[16];
+/*
+ * Number of attributes, from nextAttr on, that go in the next read frame.
+ * Both the request and the expected response have to fit one frame.
+ */
+static int readPartAttrs(ZNP::readAttr_t *command)
+{
+	uint16_t rspLen = 0;
+	int n = 0;
 
-	ZNP *zb = (ZNP *)handle->data;
+	while(command->nextAttr + n < command->numAttr) {
+		uint16_t est = readRspEstimate(command, command->attrId[command->nextAttr + n]);
+		if(n > 0 && (3 + 2 * (n + 1) > ZCL_FRAME_MAX_PAYLOAD || 3 + rspLen + est > ZCL_FRAME_MAX_PAYLOAD)) {
+			break;
+		}
+		rspLen += est;
+		n++;
+	}
+	return n;
+}
 
-	pthread_mutex_lock(&workqueue_mutex);
+/*
+ * Bytes of cmdFormat, from nextByte on, that go in the next write frame.
+ * Records are never split; one that does not fit a frame goes out alone.
+ * Undivided writes only make sense as one frame and are never split.
+ */
+static uint16_t writePartLen(ZNP::writeAttr_t *command)
+{
+	uint16_t len = 0;
 
-	while (!workqueue.empty())
-	{
-		req = workqueue.front();
+	if(command->cmdId == ZCL_CMD_WRITE_UNDIVIDED) {
+		return command->cmdFormatLen - command->nextByte;
+	}
 
-		switch(req->workCode) {
+	while(command->nextByte + len + 4 <= command->cmdFormatLen) {
+		uint16_t rec = 4 + command->cmdFormat[command->nextByte + len + 3];
+		if(command->nextByte + len + rec > command->cmdFormatLen) {
+			break;
+		}
+		if(len > 0 && 3 + len + rec > ZCL_FRAME_MAX_PAYLOAD) {
+			break;
+		}
+		len += rec;
+	}
+	//a malformed tail makes up the last part, which has no records to send
+	if(len == 0) {
+		len = command->cmdFormatLen - command->nextByte;
+	}
+	return len;
+}
 
-			case ZNP::ZCL_SEND_COMMAND:
-			{
-				ZNP::sendCmd_t *command = (ZNP::sendCmd_t*)req->command;
+static void txFrameOf(ZNP::zclTransport *req, uint8_t *addrMode, uint16_t *dstAddr, uint16_t *len)
+{
+	switch(req->workCode) {
+		case ZNP::ZCL_SEND_COMMAND:
+		{
+			ZNP::sendCmd_t *command = (ZNP::sendCmd_t*)req->command;
+			*addrMode = command->addrMode;
+			*dstAddr = command->dstAddr;
+			*len = 3 + (command->manuCode ? 2 : 0) + command->cmdFormatLen;
+			break;
+		}
 
-				afAddrType_t afDstAddr;
-				int stat;
+		case ZNP::ZCL_READ_ATTR:
+		{
+			ZNP::readAttr_t *command = (ZNP::readAttr_t*)req->command;
+			*addrMode = command->addrMode;
+			*dstAddr = command->dstAddr;
+			*len = 3 + 2 * readPartAttrs(command);
+			break;
+		}
 
-			    afDstAddr.addr.shortAddr = command->dstAddr;
-			    afDstAddr.endPoint = command->endPoint;
-			    afDstAddr.addrMode = command->addrMode;
+		case ZNP::ZCL_WRITE_ATTR:
+		{
+			ZNP::writeAttr_t *command = (ZNP::writeAttr_t*)req->command;
+			*addrMode = command->addrMode;
+			*dstAddr = command->dstAddr;
+			*len = 3 + writePartLen(command);
+			break;
+		}
 
+		case ZNP::ZCL_FAN_OUT:
+		{
+			FanOutJob *job = (FanOutJob*)req->command;
+			*addrMode = afAddr16Bit;
+			*dstAddr = job->peek().dstAddr;
+			*len = job->frameLen();
+			break;
+		}
 
-	    		myZnp->waitForResponse = true;
-	    		myZnp->currentCmdSeqId = command->seqNumber;
+		case ZNP::ZCL_GROUP_WORK:
+		{
+			ZNP::groupCmd_t *command = (ZNP::groupCmd_t*)req->command;
+			*addrMode = command->addrMode;
+			*dstAddr = command->dstAddr;
+			*len = (command->op == ZNP::GROUP_GET_MEMBERSHIP) ? 4 : 6;
+			break;
+		}
 
-			    stat = zcl_SendCommand(command->srcEp, &afDstAddr, command->clusterId, command->cmdId, command->specific, 
-			    	command->direction, command->disableDefaultRsp, command->manuCode, command->seqNumber, command->cmdFormatLen, (uint8_t*)command->cmdFormat);
+		case ZNP::ZCL_CONFIG_REPORT:
+		case ZNP::ZCL_READ_REPORT_CFG:
+		{
+			ZNP::reportCfg_t *command = (ZNP::reportCfg_t*)req->command;
+			*addrMode = command->addrMode;
+			*dstAddr = command->dstAddr;
+			*len = 3;
+			for(uint8_t i = 0; i < command->numAttr; i++) {
+				*len += 3;
+				if(req->workCode == ZNP::ZCL_READ_REPORT_CFG) {
+					continue;
+				}
+				if(command->attrs[i].direction == ZCL_SEND_ATTR_REPORTS) {
+					*len += 5;
+					if(zclAnalogDataType(command->attrs[i].dataType)) {
+						*len += zclGetDataTypeLength(command->attrs[i].dataType);
+					}
+				} else {
+					*len += 2;
+				}
+			}
+			break;
+		}
 
-				if(stat == 0x00) { //SUCCESS
-		    		//wait for the request to resolve
-		    	} else {
-		    		myZnp->waitForResponse = false;
-		    	}
+		default:
+			*addrMode = afAddr16Bit;
+			*dstAddr = 0;
+			*len = 0;
+			break;
+	}
+}
 
-				args[0] = Nan::New(stat);
-				args[1] = Nan::New(command->msgId);
-				args[2] = Nan::New(command->seqNumber);
-				if(req->statusCB){
-		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
-				}
+/*
+ * Hand the per-destination results of a fan-out to its callback and free it.
+ */
+static void reportFanOut(ZNP::zclTransport *req)
+{
+	FanOutJob *job = (FanOutJob*)req->command;
+	Local<Value> args[3];
+	v8::Local<v8::Array> results = Nan::New<v8::Array>(job->targets.size());
+
+	for(size_t i = 0; i < job->targets.size(); i++) {
+		const FanOutJob::target &t = job->targets[i];
+		v8::Local<v8::Object> result = Nan::New<v8::Object>();
+
+		result->Set(Nan::New("dstAddr").ToLocalChecked(), Nan::New(t.dstAddr));
+		result->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(t.endPoint));
+		result->Set(Nan::New("seqNumber").ToLocalChecked(), Nan::New(t.seqNumber));
+		result->Set(Nan::New("status").ToLocalChecked(), Nan::New(t.status));
+		result->Set(Nan::New("confirmed").ToLocalChecked(), Nan::New(t.confirmed));
+		result->Set(Nan::New("latency").ToLocalChecked(), Nan::New(t.confirmed ? (double)(t.confirmedAt - t.sentAt) : -1));
+		results->Set(i, result);
+	}
 
-				delete req->command;
-				break;
-			}
+	args[0] = Nan::New(req->_errno);
+	args[1] = Nan::New(job->msgId);
+	args[2] = results;
+	if(req->statusCB) {
+		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+		delete req->statusCB;
+	}
+	delete job;
+	delete req;
+}
 
-			case ZNP::ZCL_READ_ATTR:
-			{
-				ZNP::readAttr_t *command = (ZNP::readAttr_t*)req->command;
+void fanouttimer_cb_handler(uv_timer_t *handle, int status);
 
-				afAddrType_t afDstAddr;
-    			zclReadCmd_t* readCmd;
-    			int stat;
+/*
+ * Report every fan-out that has all its confirms, or gave up waiting for them.
+ */
+static void checkFanOuts()
+{
+	uint64_t now = uv_hrtime() / 1000000;
+	uint64_t wake = 0;
+	std::list<ZNP::zclTransport *> finished;
 
-			    afDstAddr.addr.shortAddr = command->dstAddr;
-			    afDstAddr.endPoint = command->endPoint;
-			    afDstAddr.addrMode = command->addrMode;
+	for(std::list<ZNP::zclTransport *>::iterator it = fanOutsAwaiting.begin(); it != fanOutsAwaiting.end(); ) {
+		ZNP::zclTransport *req = *it;
+		FanOutJob *job = (FanOutJob*)req->command;
 
-    			readCmd = (zclReadCmd_t*)malloc(sizeof(zclReadCmd_t) + sizeof(uint16) * command->numAttr);
+		if(job->complete(now)) {
+			it = fanOutsAwaiting.erase(it);
+			finished.push_back(req);
+		} else {
+			if(wake == 0 || job->confirmDeadline < wake) {
+				wake = job->confirmDeadline;
+			}
+			it++;
+		}
+	}
 
-			    if (readCmd != NULL)
-			    {
-			        readCmd->numAttr = command->numAttr;
-			        
-			        int i = 0; 
-			        for(i = 0; i < readCmd->numAttr; i++) {
-			        	readCmd->attrID[i] = command->attrId[i];
-			        }
+	if(wake) {
+		uv_timer_start(&fanouttimer, (uv_timer_cb)fanouttimer_cb_handler, wake > now ? wake - now : 0, 0);
+	}
 
-		    		myZnp->waitForResponse = true;
-		    		myZnp->currentCmdSeqId = command->seqNumber;
+	//callbacks may queue or cancel more work, so only call them once the list is settled
+	while(!finished.empty()) {
+		reportFanOut(finished.front());
+		finished.pop_front();
+	}
+}
 
-			        stat = zcl_SendRead( command->srcEp, &afDstAddr,
-						        command->clusterId, readCmd,
-						        command->direction, command->disableDefaultRsp, command->seqNumber);
+void fanouttimer_cb_handler(uv_timer_t *handle, int status)
+{
+	Nan::HandleScope scope;
+	checkFanOuts();
+}
 
-			        free(readCmd);
+void walktimer_cb_handler(uv_timer_t *handle, int status);
 
-			        // if(block)
-			        // {
-			        //     if (waitZclGetRsp() == -1)
-			        //     {
-			        //         status = ZFailure;
-			        //     }
-			        // }
+/*
+ * Report the end of a table walk, done is false if it was replaced by a new one.
+ */
+static void reportWalk(table_walk *w, int stat, bool done)
+{
+	Local<Value> args[2];
+	Nan::Callback *cb = w->doneCB;
 
-					if(stat == 0x00) { //SUCCESS
-			    		//wait for the request to resolve
-			    	} else {
-			    		myZnp->waitForResponse = false;
-			    	}
-		   	 	}
+	w->doneCB = NULL;
+	if(!cb) {
+		return;
+	}
 
-				args[0] = Nan::New(stat);
-				args[1] = Nan::New(command->msgId);
-				args[2] = Nan::New(command->seqNumber);
-				if(req->statusCB){
-		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
-				}
-				delete req->command;
-				break;
-			}
+	args[0] = Nan::New(stat);
+	args[1] = Nan::Undefined();
+	if(done) {
+		const ZdoTableWalker::walk_summary &s = w->walker->summary();
+		v8::Local<v8::Object> o = Nan::New<v8::Object>();
+		v8::Local<v8::Array> failed = Nan::New<v8::Array>(s.failed.size());
 
-			case ZNP::ZCL_WRITE_ATTR:
-			{
-				ZNP::writeAttr_t *command = (ZNP::writeAttr_t*)req->command;
+		for(size_t i = 0; i < s.failed.size(); i++) {
+			failed->Set(i, Nan::New(s.failed[i]));
+		}
+		o->Set(Nan::New("routers").ToLocalChecked(), Nan::New(s.tables));
+		o->Set(Nan::New(w->entries).ToLocalChecked(), Nan::New(s.entries));
+		o->Set(Nan::New("requests").ToLocalChecked(), Nan::New(s.requests));
+		o->Set(Nan::New("retries").ToLocalChecked(), Nan::New(s.retries));
+		o->Set(Nan::New("durationMs").ToLocalChecked(), Nan::New(s.durationMs));
+		o->Set(Nan::New("failed").ToLocalChecked(), failed);
+		if(w->summarize) {
+			w->summarize(o);
+		}
+		args[1] = o;
+	}
+	cb->Call(Nan::GetCurrentContext()->Global(), 2, args);
+	delete cb;
+}
 
-				dbg_print(PRINT_LEVEL_VERBOSE, "Got write attribute\n");
-				afAddrType_t afDstAddr;
-    			zclWriteCmd_t* writeCmd;
-    			// zclWriteRec_t cmdRecord;
-    			int stat;
-    			//printf("1\n");
-			    afDstAddr.addr.shortAddr = command->dstAddr;
-			    afDstAddr.endPoint = command->endPoint;
-			    afDstAddr.addrMode = command->addrMode;
-    			//printf("2\n");
+static void summarizeHarvest(v8::Local<v8::Object> o)
+{
+	const RtgHarvester::churn_summary &c = rtgHarvester.churnSummary();
 
-    			writeCmd = (zclWriteCmd_t*)malloc( sizeof(uint8) + sizeof(zclWriteRec_t)*command->numAttr);
-    			// cmdRecord = (zclWriteRec_t*)malloc( sizeof(uint16) + sizeof(uint8) + sizeof(uint8));
+	o->Set(Nan::New("added").ToLocalChecked(), Nan::New(c.added));
+	o->Set(Nan::New("removed").ToLocalChecked(), Nan::New(c.removed));
+	o->Set(Nan::New("changed").ToLocalChecked(), Nan::New(c.changed));
+}
 
-			    if (writeCmd != NULL)
-			    {
-    			//printf("3\n");
-    			//
+/*
+ * Ask for every page the walk has due, then report the walk if that was the
+ * last of it or wake up for the next page timeout.
+ * Returns the status of the last request the ZNP did not accept, 0 if none.
+ */
+static int pumpWalk(table_walk *w)
+{
+	uint64_t now = uv_now(uv_default_loop());
+	std::vector<ZdoTableWalker::request> send;
+	int ret = 0;
 
-					// printf("\tsrcAddr: %d\n",			command->dstAddr		);
-					// printf("\tendPoint: %d\n",			command->endPoint		);
-					// printf("\taddrMode: %d\n",			command->addrMode		);
-					// printf("\tclusterId: %d\n",			command->numAttr		);
-					// printf("\tcmdFormatLen: %d\n",			command->cmdFormatLen		);
-					// int i = 0;
-					// printf("\tpayload: ");
-					// for(i = 0; i < command->cmdFormatLen; i++) {
-					// 	printf("%d ", command->cmdFormat[i]);
-					// }
-					// printf("\n");
-			        writeCmd->numAttr = command->numAttr;
-
-			        int index = 0;
-			        int listIndex = 0;
-			        int k = 0;
-			        // uint8 *attributeData[50];
-			        while(index <= (command->cmdFormatLen - 1)) {
-			        	// printf("\tindex: %d\n", index);
-			        	writeCmd->attrList[listIndex].attrID = (command->cmdFormat[index] << 8) + command->cmdFormat[index+1];
-						// printf("\tattrId: %d\n",			writeCmd->attrList[listIndex].attrID		);
-			        	writeCmd->attrList[listIndex].dataType = command->cmdFormat[index+2];
-						// printf("\tdataType: %d\n",			writeCmd->attrList[listIndex].dataType		);
-						// printf("\tdata: ");
-						writeCmd->attrList[listIndex].attrData = (uint8*)malloc(sizeof(uint8) * command->cmdFormat[index+3]);
-			        	for(k = 0; k < command->cmdFormat[index+3]; k++) {
-			        		writeCmd->attrList[listIndex].attrData[k] = command->cmdFormat[index + 4 + k];
-			        	// memcpy(writeCmd->attrList[listIndex].attrData, command->cmdFormat[index + 4 + k, command->cmdFormat[index+3]);
-			        		// printf("inx- %d, value- %d ", index+4+k, writeCmd->attrList[listIndex].attrData[k]);
-			        		
-			        	}
-			        	// writeCmd->attrList[listIndex].attrData = attributeData[listIndex];
-			        	// printf("\n");
-			        	listIndex++;
-			        	index = index + 2 + 1 + 1 + command->cmdFormat[index+3];
-			        }
-			        // cmdRecord.attrID = command->attrId;
-			        // cmdRecord.dataType = command->dataType;
-			        // cmdRecord.attrData = (uint8_t*)command->cmdFormat;
-			        
-			        // writeCmd->attrList[0] = cmdRecord;
-    			//printf("4\n");
-			        // for(int i = 0 ; i < command->cmdFormatLen; i++) {
-			        // 	cmdRecord->attrData[i] = command->cmdFormat[]
-			        // }
-			        // cmdRecord->attrData[0] = command->
-			        // writeCmd->attrID[0] = command->attrId;
-			        // cmdRecord
+	w->walker->due(now, send);
+	for(size_t i = 0; i < send.size(); i++) {
+		uint8_t status = w->ask(send[i].nwkAddr, send[i].startIndex);
+		if(status != MT_RPC_SUCCESS) {
+			dbg_print(PRINT_LEVEL_INFO, "%s request to 0x%04X failed: 0x%02X\n", w->name, send[i].nwkAddr, status);
+			ret = status;
+		}
+	}
 
-		    		myZnp->waitForResponse = true;
-		    		myZnp->currentCmdSeqId = command->seqNumber;
-    			//printf("5\n");
+	if(w->walker->finish(now)) {
+		uv_timer_stop(&w->timer);
+		reportWalk(w, 0, true);
+	} else {
+		uint64_t wake = w->walker->nextDeadline();
+		if(wake) {
+			uv_timer_start(&w->timer, (uv_timer_cb)walktimer_cb_handler, wake > now ? wake - now : 0, 0);
+		}
+	}
+	return ret;
+}
 
-			        stat = zcl_SendWriteRequest( command->srcEp, &afDstAddr,
-						        command->clusterId, writeCmd, command->cmdId,
-						        command->direction, command->disableDefaultRsp, command->seqNumber);
+/*
+ * The walk in progress, if any, is replaced by the one about to start.
+ */
+static void replaceWalk(table_walk *w, Nan::Callback *doneCB)
+{
+	if(w->walker->active()) {
+		reportWalk(w, ZNP::ZCL_WORK_SUPERSEDED, false);
+	}
+	w->doneCB = doneCB;
+}
 
-			        // free(cmdRecord);
-			        int j = 0;
-			        for(j = 0; j < listIndex; j++) {
-			        	free(writeCmd->attrList[j].attrData);
-			        }
-			        free(writeCmd);
+/*
+ * Start a topology crawl from root, replacing the one in progress.
+ */
+static int startCrawl(uint16_t root, const zdo_walk_options &opts, Nan::Callback *doneCB)
+{
+	replaceWalk(&crawl, doneCB);
+	lqiCrawler.start(root, opts, uv_now(uv_default_loop()));
+	return pumpWalk(&crawl);
+}
 
-			        // if(block)
-			        // {
-			        //     if (waitZclGetRsp() == -1)
-			        //     {
-			        //         status = ZFailure;
-			        //     }
-			        // }
+void walktimer_cb_handler(uv_timer_t *handle, int status)
+{
+	Nan::HandleScope scope;
+	pumpWalk((table_walk*)handle->data);
+}
 
-					if(stat == 0x00) { //SUCCESS
-			    		//wait for the request to resolve
-			    	} else {
-			    		myZnp->waitForResponse = false;
-			    	}
-		   	 	}
+void interviewtimer_cb_handler(uv_timer_t *handle, int status);
+
+//Basic cluster attributes an interview reads, by the name onDeviceReady gives them
+static const struct {
+	uint16_t attrId;
+	const char *name;
+} basicAttrNames[] = {
+	{ 0x0000, "zclVersion" },
+	{ 0x0001, "appVersion" },
+	{ 0x0002, "stackVersion" },
+	{ 0x0003, "hwVersion" },
+	{ 0x0004, "manufacturerName" },
+	{ 0x0005, "modelId" },
+	{ 0x0006, "dateCode" },
+	{ 0x0007, "powerSource" },
+	{ 0x4000, "swBuildId" }
+};
 
-				args[0] = Nan::New(stat);
-				args[1] = Nan::New(command->msgId);
-				args[2] = Nan::New(command->seqNumber);
-				if(req->statusCB){
-		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
-				}
-				delete req->command;
-				break;
-			}
+/*
+ * Endpoints with their cluster lists, as onDeviceReady and getDevice give them
+ */
+static v8::Local<v8::Array> endpointsToArray(const std::vector<DeviceRegistry::endpoint> &endpoints)
+{
+	v8::Local<v8::Array> arr = Nan::New<v8::Array>(endpoints.size());
 
-			default:
-			{
-				dbg_print(PRINT_LEVEL_ERROR, "znpasync_cb_handler: Unhandled ZCL WorkCode: %d\n", req->workCode);
+	for(size_t i = 0; i < endpoints.size(); i++) {
+		const DeviceRegistry::endpoint &e = endpoints[i];
+		v8::Local<v8::Object> ep = Nan::New<v8::Object>();
+		v8::Local<v8::Array> in = Nan::New<v8::Array>(e.inClusters.size());
+		v8::Local<v8::Array> out = Nan::New<v8::Array>(e.outClusters.size());
+
+		for(size_t c = 0; c < e.inClusters.size(); c++) {
+			in->Set(c, Nan::New(e.inClusters[c]));
+		}
+		for(size_t c = 0; c < e.outClusters.size(); c++) {
+			out->Set(c, Nan::New(e.outClusters[c]));
+		}
+		ep->Set(Nan::New("endpoint").ToLocalChecked(), Nan::New(e.endpoint));
+		ep->Set(Nan::New("profileId").ToLocalChecked(), Nan::New(e.profileId));
+		ep->Set(Nan::New("deviceId").ToLocalChecked(), Nan::New(e.deviceId));
+		ep->Set(Nan::New("version").ToLocalChecked(), Nan::New(e.version));
+		ep->Set(Nan::New("inClusters").ToLocalChecked(), in);
+		ep->Set(Nan::New("outClusters").ToLocalChecked(), out);
+		arr->Set(i, ep);
+	}
+	return arr;
+}
+
+/*
+ * Basic cluster attributes by name, from read response records:
+ * attrId, status, [dataType, value]
+ */
+static v8::Local<v8::Object> basicToObject(const std::vector<uint8_t> &records)
+{
+	v8::Local<v8::Object> basic = Nan::New<v8::Object>();
+	const uint8_t *p = records.empty() ? NULL : &records[0];
+	uint16_t len = records.size(), i = 0;
+
+	while(i + 3 <= len) {
+		uint16_t attrId = BUILD_UINT16(p[i], p[i + 1]);
+		uint8_t status = p[i + 2];
+		i += 3;
+		if(status != ZCL_STATUS_SUCCESS) {
+			continue;
+		}
+		if(i + 1 > len) {
+			break;
+		}
+		uint8_t dataType = p[i++];
+		int vlen = zclValueLength(dataType, &p[i], len - i);
+		if(vlen < 0) {
+			break;
+		}
+		for(size_t n = 0; n < sizeof(basicAttrNames) / sizeof(basicAttrNames[0]); n++) {
+			if(basicAttrNames[n].attrId == attrId) {
+				basic->Set(Nan::New(basicAttrNames[n].name).ToLocalChecked(), zclDecodeValue(dataType, &p[i], vlen));
 				break;
 			}
 		}
-
-		workqueue.pop();
-		delete req;
+		i += vlen;
 	}
-
-	pthread_mutex_unlock(&workqueue_mutex);
+	return basic;
 }
 
-void submitToZNP(ZNP::zclTransport *req)
+/*
+ * onDeviceReady(device), everything the interview learnt about it
+ */
+static void reportDevice(ZNP *zb, const Interviewer::device &d)
 {
-	pthread_mutex_lock(&workqueue_mutex);
-	workqueue.push(req);
-	pthread_mutex_unlock(&workqueue_mutex);
+	Local<Value> args[1];
+	char ext[17];
 
-	uv_async_send(&znpasync);
-}
+	if(!zb->onDeviceReadyCB) {
+		return;
+	}
 
+	v8::Local<v8::Object> o = Nan::New<v8::Object>();
+	o->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(d.nwkAddr));
+	if(d.extAddr) {
+		snprintf(ext, sizeof(ext), "%016llx", (unsigned long long)d.extAddr);
+		o->Set(Nan::New("ieeeAddr").ToLocalChecked(), Nan::New(ext).ToLocalChecked());
+	}
+	o->Set(Nan::New("status").ToLocalChecked(), Nan::New(d.status));
+	if(d.failedStep != Interviewer::STEP_DONE) {
+		o->Set(Nan::New("failedStep").ToLocalChecked(), Nan::New(d.failedStep));
+	}
 
-//*********************************************************************************************************************
-bool ZNP::setupThread()
-{
-	uv_mutex_lock(&_control);
-	bool ret = threadUp;
-	uv_mutex_unlock(&_control);
-	if(!ret) {
-		this->Ref();
-		uv_mutex_lock(&_control);
-		int r = uv_thread_create(&znp_thread, main_thread, this); // start thread
-        if (r < 0) {  // old libuv returns -1 on failure
-                dbg_print(PRINT_LEVEL_INFO, "NON-RECOVERABLE: failed to create znp main thread.\n");
-                uv_mutex_unlock(&_control);
-                return false;
-        }else {
-                dbg_print(PRINT_LEVEL_INFO, "znp_main_thread create called successfully\n");
-        }
-		uv_cond_wait(&_start_cond, &_control); // wait for thread's start...
-		ret = threadUp;
-		uv_mutex_unlock(&_control);
+	if(d.haveNodeDesc) {
+		o->Set(Nan::New("logicalType").ToLocalChecked(), Nan::New(d.logicalType));
+		o->Set(Nan::New("macCapabilities").ToLocalChecked(), Nan::New(d.macCapabilities));
+		o->Set(Nan::New("manufacturerCode").ToLocalChecked(), Nan::New(d.manufacturerCode));
+		o->Set(Nan::New("maxBufferSize").ToLocalChecked(), Nan::New(d.maxBufferSize));
+		o->Set(Nan::New("maxTransferSize").ToLocalChecked(), Nan::New(d.maxTransferSize));
+		o->Set(Nan::New("serverMask").ToLocalChecked(), Nan::New(d.serverMask));
 	}
-	return ret;
+
+	o->Set(Nan::New("endpoints").ToLocalChecked(), endpointsToArray(d.endpoints));
+
+	if(d.basicEndpoint) {
+		o->Set(Nan::New("basicEndpoint").ToLocalChecked(), Nan::New(d.basicEndpoint));
+		o->Set(Nan::New("basic").ToLocalChecked(), basicToObject(d.basic));
+	}
+
+	o->Set(Nan::New("requests").ToLocalChecked(), Nan::New(d.requests));
+	o->Set(Nan::New("retries").ToLocalChecked(), Nan::New(d.retries));
+	o->Set(Nan::New("durationMs").ToLocalChecked(), Nan::New(d.durationMs));
+
+	args[0] = o;
+	zb->onDeviceReadyCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
 }
 
-void ZNP::sigThreadUp() 
+/*
+ * A registry entry as getDevice and getDevices give it
+ */
+static v8::Local<v8::Object> deviceToObject(const DeviceRegistry::device &d, uint64_t now)
 {
-	uv_mutex_lock(&_control);
-	threadUp = true;
-	uv_cond_signal(&_start_cond);
-	uv_mutex_unlock(&_control);
+	v8::Local<v8::Object> o = Nan::New<v8::Object>();
+	char ext[17];
+
+	snprintf(ext, sizeof(ext), "%016llx", (unsigned long long)d.extAddr);
+	o->Set(Nan::New("ieeeAddr").ToLocalChecked(), Nan::New(ext).ToLocalChecked());
+	if(d.nwkAddr != DEVICE_NWK_UNKNOWN) {
+		o->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(d.nwkAddr));
+	}
+	o->Set(Nan::New("capabilities").ToLocalChecked(), Nan::New(d.capabilities));
+	o->Set(Nan::New("interviewed").ToLocalChecked(), Nan::New(d.interviewed));
+	if(d.interviewed) {
+		o->Set(Nan::New("logicalType").ToLocalChecked(), Nan::New(d.logicalType));
+		o->Set(Nan::New("manufacturerCode").ToLocalChecked(), Nan::New(d.manufacturerCode));
+		o->Set(Nan::New("endpoints").ToLocalChecked(), endpointsToArray(d.endpoints));
+		o->Set(Nan::New("basic").ToLocalChecked(), basicToObject(d.basic));
+	}
+	if(d.lastSeen) {
+		o->Set(Nan::New("lastSeen").ToLocalChecked(), Nan::New((double)(now - d.lastSeen)));
+	}
+	return o;
 }
 
-void ZNP::sigThreadDown() 
+static v8::Local<v8::Object> startTimingsToObject(const zMngt_startTimings_t *t)
 {
-	uv_mutex_lock(&_control);
-	threadUp = false;
-	uv_cond_signal(&_start_cond);
-	uv_mutex_unlock(&_control);
+	v8::Local<v8::Object> o = Nan::New<v8::Object>();
+
+	o->Set(Nan::New("probeMs").ToLocalChecked(), Nan::New(t->probeMs));
+	o->Set(Nan::New("resetMs").ToLocalChecked(), Nan::New(t->resetMs));
+	o->Set(Nan::New("configMs").ToLocalChecked(), Nan::New(t->configMs));
+	o->Set(Nan::New("startMs").ToLocalChecked(), Nan::New(t->startMs));
+	o->Set(Nan::New("totalMs").ToLocalChecked(), Nan::New(t->totalMs));
+	if(t->devState != 0xFF) {
+		o->Set(Nan::New("devState").ToLocalChecked(), Nan::New(t->devState));
+	}
+	o->Set(Nan::New("nvWrites").ToLocalChecked(), Nan::New(t->nvWrites));
+	o->Set(Nan::New("reset").ToLocalChecked(), Nan::New((bool)t->reset));
+	o->Set(Nan::New("resumed").ToLocalChecked(), Nan::New((bool)t->resumed));
+	return o;
 }
 
-//*********************************************************************************************************************
-NAN_METHOD(ZNP::New)
+/*
+ * The device's routes through its old address are gone, onDeviceAddressChange
+ * is told so JS can follow it.
+ */
+static void deviceMoved(ZNP *zb, uint64_t extAddr, uint16_t nwkAddr, int oldNwkAddr)
 {
-	assert(info.IsConstructCall());
-	ZNP* self = new ZNP();
-	self->Wrap(info.This());
+	Local<Value> args[1];
+	char ext[17];
+
+	srcRoutes.invalidate(oldNwkAddr);
+	//what is known of the device goes with it
+	attrShadow.move(oldNwkAddr, nwkAddr);
+	groupTable.move(oldNwkAddr, nwkAddr);
+	//an interview at the old address would wait for answers that no longer come
+	if(interviewer.cancel(oldNwkAddr)
+			&& interviewer.start(nwkAddr, extAddr, uv_now(uv_default_loop()), true)) {
+		pumpInterviews();
+	}
+	dbg_print(PRINT_LEVEL_INFO, "Device %016llx moved from 0x%04X to 0x%04X\n",
+			(unsigned long long)extAddr, oldNwkAddr, nwkAddr);
 
-	myZnp = self;
+	if(!zb->onDeviceAddressChangeCB) {
+		return;
+	}
 
-	if(info.Length() > 0 && info[0]->IsObject()) {
-		Local<Object> o = info[0]->ToObject();
-		Local<Value> v;
+	v8::Local<v8::Object> o = Nan::New<v8::Object>();
+	snprintf(ext, sizeof(ext), "%016llx", (unsigned long long)extAddr);
+	o->Set(Nan::New("ieeeAddr").ToLocalChecked(), Nan::New(ext).ToLocalChecked());
+	o->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(nwkAddr));
+	o->Set(Nan::New("prevNwkAddr").ToLocalChecked(), Nan::New(oldNwkAddr));
 
-		V8_IFEXIST_TO_DYN_CSTR("siodev",myZnp->siodev,v,o);
-		V8_IFEXIST_TO_INT_CAST("devType",myZnp->zOpts.devType,v,o,int);
-		V8_IFEXIST_TO_INT_CAST("channelMask",myZnp->zOpts.channelMask,v,o,int);
-		V8_IFEXIST_TO_INT_CAST("baudRate",myZnp->zOpts.baudRate,v,o,int);
-		V8_IFEXIST_TO_INT_CAST("panId",myZnp->zOpts.panId,v,o,int);
-		V8_IFEXIST_TO_BOOLEAN_CAST("newNwk",myZnp->zOpts.newNwk,v,o,bool);
-	}
-	
-	info.GetReturnValue().Set(info.This());
+	args[0] = o;
+	zb->onDeviceAddressChangeCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
 }
 
-NAN_METHOD(ZNP::Connect)
+/*
+ * Another device was at nwkAddr before, the values and groups known there are its.
+ */
+static void addressTaken(uint16_t nwkAddr)
 {
-	uv_async_init(uv_default_loop(), &v8async, (uv_async_cb)v8async_cb_handler);
-	uv_async_init(uv_default_loop(), &znpasync, (uv_async_cb)znpasync_cb_handler);
-	uv_mutex_init(&_control);
-	uv_cond_init(&_start_cond);
+	attrShadow.forget(nwkAddr);
+	groupTable.forget(nwkAddr);
+}
 
-	v8async.data = myZnp;
+/*
+ * A ZCL transaction id for a read the addon sends to nwkAddr on its own,
+ * one no doZCLWork read to it is waiting on.
+ */
+static uint8_t zclTransId(uint16_t nwkAddr)
+{
+	uint64_t now = uv_now(uv_default_loop());
 
-	const unsigned argc = 1;
-	Local<Value> argv[argc];
+	for(int i = 0; i < 256; i++) {
+		uint8_t id = nextTransId++;
+		std::map<uint32_t, uint64_t>::iterator it = readsInFlight.find(((uint32_t)nwkAddr << 8) | id);
+		if(it == readsInFlight.end()) {
+			return id;
+		}
+		if(now - it->second > READ_RSP_TIMEOUT) {
+			readsInFlight.erase(it);
+			return id;
+		}
+	}
+	return nextTransId++;
+}
 
-	if(info.Length() > 1) {
+/*
+ * Read Basic cluster attributes for an interview. Sent straight from here
+ * like the interview's ZDO requests, with an id from zclTransId(). The
+ * response is matched by it before any doZCLWork read sees it.
+ */
+static uint8_t sendBasicRead(const Interviewer::request &r)
+{
+	afAddrType_t afDstAddr;
+	zclReadCmd_t *readCmd;
+	uint8_t stat;
 
-		Local<Object> o = info[0]->ToObject();
-		Local<Value> v;
-		V8_IFEXIST_TO_DYN_CSTR("siodev",myZnp->siodev,v,o);
+	readCmd = (zclReadCmd_t*)malloc(sizeof(zclReadCmd_t) + sizeof(uint16) * r.numAttr);
+	if(readCmd == NULL) {
+		return ZMemError;
+	}
+	readCmd->numAttr = r.numAttr;
+	for(uint8_t i = 0; i < r.numAttr; i++) {
+		readCmd->attrID[i] = r.attrIds[i];
+	}
 
-		if(info[1]->IsFunction()) {
+	afDstAddr.addr.shortAddr = r.nwkAddr;
+	afDstAddr.endPoint = r.endpoint;
+	afDstAddr.addrMode = afAddr16Bit;
 
-			ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-			zb->onConnectedCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+	stat = zcl_SendRead(ZGW_EP, &afDstAddr, ZCL_CLUSTER_ID_GEN_BASIC, readCmd,
+			ZCL_FRAME_CLIENT_SERVER_DIR, TRUE, r.transId);
+	free(readCmd);
+	return stat;
+}
 
-			bool ret = zb->setupThread();
-			if(ret) {
-				argv[0] = Nan::New(true);	//thread started successfully
-			} else {
-				argv[0] = Nan::New(false);	//thread failed
+/*
+ * Send every interview request due, report the devices whose interview
+ * ended and wake up for the next timeout or retry, see pumpWalk().
+ */
+static int pumpInterviews()
+{
+	uint64_t now = uv_now(uv_default_loop());
+	std::vector<Interviewer::request> send;
+	std::vector<Interviewer::device> done;
+	int ret = 0;
+
+	//devices whose announce was dropped in a join storm are in the registry,
+	//they are queued again once the storm has been worked off
+	if(interviewer.overflowed() && interviewer.queued() == 0) {
+		std::vector<DeviceRegistry::device> list;
+		size_t i;
+
+		deviceRegistry.list(list);
+		for(i = 0; i < list.size() && interviewer.queued() < interviewer.options().maxQueued; i++) {
+			if(!list[i].interviewed && list[i].nwkAddr != DEVICE_NWK_UNKNOWN
+					&& !interviewer.interviewing(list[i].nwkAddr)) {
+				interviewer.start(list[i].nwkAddr, list[i].extAddr, now, true);
 			}
-			zb->onConnectedCB->Call(Nan::GetCurrentContext()->Global(), argc, argv);
-		} else {
-			Nan::ThrowTypeError("Passed arguments 2 should be a function.");
 		}
-	} else {
-		Nan::ThrowTypeError("Passed arguments should be atleast two.");
+		if(i == list.size()) {
+			interviewer.refilled();
+		}
 	}
-}
 
-NAN_METHOD(ZNP::Disconnect)
-{
-	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-	Nan::Callback *onSuccessCB, *onFailureCB;
-
-	if(info.Length() > 1) {
-		if(info[0]->IsFunction() && info[1]->IsFunction()) {
-			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[0]));
-			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[1]));
-		} else {
-			Nan::ThrowTypeError("Passed argument 0,1 should be a function.");
+	interviewer.due(now, send);
+	for(size_t i = 0; i < send.size(); i++) {
+		const Interviewer::request &r = send[i];
+		uint8_t status;
+
+		switch(r.step) {
+			case Interviewer::STEP_IEEE_ADDR:	status = wZIeeeAddrReq(r.nwkAddr); break;
+			case Interviewer::STEP_NODE_DESC:	status = wZNodeDescReq(r.nwkAddr); break;
+			case Interviewer::STEP_ACTIVE_EP:	status = wZActiveEpReq(r.nwkAddr); break;
+			case Interviewer::STEP_SIMPLE_DESC:	status = wZSimpleDescReq(r.nwkAddr, r.endpoint); break;
+			default:							status = sendBasicRead(r); break;
+		}
+		if(status != MT_RPC_SUCCESS) {
+			dbg_print(PRINT_LEVEL_INFO, "Interview step %d of 0x%04X failed: 0x%02X\n", r.step, r.nwkAddr, status);
+			ret = status;
 		}
-	} else {
-		Nan::ThrowTypeError("Disconnect: Should pass atleast two argments. [successcb, failcb]");
 	}
 
-	char * selected_serial_port;
-	selected_serial_port = myZnp->siodev;
+	interviewer.ready(done);
+	for(size_t i = 0; i < done.size(); i++) {
+		const Interviewer::device &d = done[i];
+		if(d.status == 0 && d.extAddr) {
+			deviceRegistry.describe(d.extAddr, d.logicalType, d.manufacturerCode, d.endpoints, d.basic);
+		}
+		reportDevice(myZnp, d);
+	}
 
-	dbg_print(PRINT_LEVEL_INFO, "attempting to close %s\n\n", selected_serial_port);
-	if(wZCloseRPC()) {
-		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onSuccessCB;
+	uint64_t wake = interviewer.nextDeadline();
+	if(wake) {
+		uv_timer_start(&interviewtimer, (uv_timer_cb)interviewtimer_cb_handler, wake > now ? wake - now : 0, 0);
 	} else {
-		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onFailureCB;
+		uv_timer_stop(&interviewtimer);
 	}
-	
-	myZnp->sigThreadDown();
-	pthread_cond_signal(&cond_critical_failure);
+	return ret;
 }
 
-NAN_METHOD(ZNP::AddDevice)
+void interviewtimer_cb_handler(uv_timer_t *handle, int status)
 {
-	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-	Nan::Callback *onSuccessCB, *onFailureCB;
-	int duration;
+	Nan::HandleScope scope;
+	pumpInterviews();
+}
 
-	if(info.Length() > 2) {
-		duration = info[0]->ToNumber()->Value();
-		if(info[1]->IsFunction() && info[2]->IsFunction()) {
-			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[1]));
-			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[2]));
-		} else {
-			Nan::ThrowTypeError("Passed arguments 1,2 should be a function.");
-		}
-	} else {
-		Nan::ThrowTypeError("AddDevice: Should pass atleast three argument. [duration, successcb, failcb]");
+/*
+ * A device database snapshot on its way to disk. It is encoded on the loop,
+ * the write, fsync and rename run on the libuv thread pool.
+ */
+typedef struct {
+	uv_work_t work;
+	std::string path;
+	std::vector<uint8_t> buf;
+	int err;
+	uint32_t writeMs;
+} db_write;
+
+static uint64_t dbSavedAt = 0;			//loop time of the last save started
+static bool dbSaveAgain = false;		//a forced save came in while one was being written
+
+static void saveDevices(bool force);
+
+static void dbWriteWork(uv_work_t *work)
+{
+	db_write *w = (db_write*)work->data;
+	uint64_t start = AttrShadow::nowMs();
+
+	w->err = snapshotWrite(w->path, w->buf) < 0 ? errno : 0;
+	w->writeMs = AttrShadow::nowMs() - start;
+}
+
+static void dbWriteDone(uv_work_t *work, int status)
+{
+	db_write *w = (db_write*)work->data;
+
+	deviceDb.written(w->err, w->writeMs);
+	if(w->err) {
+		dbg_print(PRINT_LEVEL_WARNING, "Could not save the device database to %s: %s\n", w->path.c_str(), strerror(w->err));
 	}
+	delete w;
 
-	if(!wZAddDevice(duration)) {
-		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onSuccessCB;
-	} else {
-		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onFailureCB;
+	if(dbSaveAgain) {
+		dbSaveAgain = false;
+		saveDevices(true);
 	}
 }
 
-NAN_METHOD(ZNP::SendLqiRequest)
+/*
+ * Save the device database if devices changed since it was last saved, or
+ * attribute values did and dbAttrSaveIntervalMs has gone by. Bursts of joins
+ * and reports are written out together. force saves any change now, or
+ * once the save being written is done.
+ */
+static void saveDevices(bool force)
 {
-	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-	Nan::Callback *onSuccessCB, *onFailureCB;
-	int dstAddr;
+	uint64_t now = uv_now(uv_default_loop());
 
-	if(info.Length() > 2) {
-		dstAddr = info[0]->ToNumber()->Value();
-		if(info[1]->IsFunction() && info[2]->IsFunction()) {
-			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[1]));
-			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[2]));
-		} else {
-			Nan::ThrowTypeError("Passed arguments 1,2 should be a function.");
-		}
-	} else {
-		Nan::ThrowTypeError("SendLqiRequest: Should pass atleast three argument. [dstAddr, successcb, failcb]");
+	if(!deviceDb.enabled()) {
+		return;
+	}
+	bool devices = deviceDb.registryDirty(deviceRegistry);
+	bool attrs = deviceDb.shadowDirty(attrShadow);
+	if(!devices && !(attrs && (force || now - dbSavedAt >= dbAttrSaveIntervalMs))) {
+		return;
+	}
+	if(deviceDb.writing()) {
+		dbSaveAgain = dbSaveAgain || force;
+		return;
 	}
 
-	if(!wZSendLqiReq(dstAddr)) {
-		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onSuccessCB;
-	} else {
-		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onFailureCB;
+	db_write *w = new db_write;
+	w->path = deviceDb.path();
+	w->err = 0;
+	w->writeMs = 0;
+	w->work.data = w;
+	if(deviceDb.prepare(deviceRegistry, attrShadow, w->buf) < 0) {
+		delete w;
+		return;
 	}
+	dbSavedAt = now;
+	uv_queue_work(uv_default_loop(), &w->work, dbWriteWork, dbWriteDone);
 }
 
-NAN_METHOD(ZNP::GetNVItem)
+void dbtimer_cb_handler(uv_timer_t *handle, int status)
 {
-	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-	Nan::Callback *onSuccessCB, *onFailureCB;
-	int nvId;
+	saveDevices(false);
+}
 
-	if(info.Length() > 2) {
-		nvId = info[0]->ToNumber()->Value();
-		// printf("GOT NVID- %d\n", nvId);
-		if(info[1]->IsFunction() && info[2]->IsFunction()) {
-			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[1]));
-			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[2]));
-		} else {
-			Nan::ThrowTypeError("Passed arguments 1,2 should be a function.");
-		}
-	} else {
-		Nan::ThrowTypeError("GetNVItem: Should pass atleast three argument. [id, successcb, failcb]");
-	}
+/*
+ * A router's children go to onNetworkTopology in the Node_t layout it has
+ * always had, only no longer cut off at MAX_CHILDREN.
+ */
+static void reportRouter(ZNP *zb, const LqiCrawler::router &r)
+{
+	std::vector<ChildNode_t> children;
+	Node_t hdr;
+	Local<Value> args[1];
 
-	// if(!wZgetNVItem(nvId)) {
-	// 	onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-	// 	delete onSuccessCB;
-	// } else {
-	// 	onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-	// 	delete onFailureCB;
-	// }
+	for(size_t i = 0; i < r.neighbors.size() && children.size() < 0xFF; i++) {
+		const LqiCrawler::neighbor &n = r.neighbors[i];
+		ChildNode_t c;
 
-	nvRead_response* response = (nvRead_response*)wZgetNVItem(nvId);
-	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
-	Local<Object> buf;
-	Local<Value> args[16];
+		if(n.relation != LQI_RELATION_CHILD) {
+			continue;
+		}
+		c.ChildAddr = n.nwkAddr;
+		c.Type = n.type;
+		c.Lqi = n.lqi;
+		for(int j = 0; j < 8; j++) {
+			c.ExtendedAddress[j] = (n.extAddr >> (j * 8)) & 0xFF;
+		}
+		children.push_back(c);
+	}
 
-	if(response->len > 0) {
-		toBuffer(buf, response->data, response->len * sizeof(uint8_t));
-		args[1] = buf->ToObject();
+	if(!zb->onNetworkTopologyCB) {
+		return;
 	}
 
-	// printf("Got respones- %d\n", response->status);
-	// printf("Got len- %d\n", response->len);
-	// printf("Got data- ");
-	// int i = 0;
-	// for(i = 0; i < response->len; i++) {
-	// 	printf("%d ", response->data[i]);
-	// }
-	// printf("\n");
-					
-	if(response->status == 0) { //success
-		obj->Set(Nan::New("status").ToLocalChecked(), Nan::New(response->status));
-		obj->Set(Nan::New("len").ToLocalChecked(), Nan::New(response->len));
-		args[0] = obj;
-		// if(response->len > 0) {
-		// 	toBuffer(buf, response->data, response->len * sizeof(uint8_t));
-		// 	args[1] = buf->ToObject();
-		// }
-		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 2, args);
-		delete onSuccessCB;
-	} else { //failure
-		obj->Set(Nan::New("status").ToLocalChecked(), Nan::New(response->status));
-		args[0] = obj;
-		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
-		delete onFailureCB;
+	hdr.NodeAddr = r.nwkAddr;
+	hdr.Type = (r.nwkAddr == 0 ? DEVICETYPE_COORDINATOR : DEVICETYPE_ROUTER);
+	hdr.ChildCount = children.size();
+
+	Local<Object> buf = UNI_BUFFER_NEW(offsetof(Node_t, childs) + children.size() * sizeof(ChildNode_t));
+	char *mem = node::Buffer::Data(buf);
+	memcpy(mem, &hdr, offsetof(Node_t, childs));
+	if(!children.empty()) {
+		memcpy(mem + offsetof(Node_t, childs), &children[0], children.size() * sizeof(ChildNode_t));
 	}
-	free(response);
+	args[0] = buf;
+	zb->onNetworkTopologyCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
 }
 
-NAN_METHOD(ZNP::SetNVItem)
+/*
+ * What one update changed in the topology graph goes to onTopologyChange as
+ * a single array, nothing is called if nothing changed.
+ */
+static void reportTopologyChanges(ZNP *zb, const std::vector<TopologyGraph::change> &changes)
 {
-	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-	Nan::Callback *onSuccessCB, *onFailureCB;
-	uint16 nvId;
-	uint8 len;
-	char *value;
+	Local<Value> args[1];
 
-	if(info.Length() > 4) {
-		nvId = info[0]->ToNumber()->Value();
-		len = info[1]->ToNumber()->Value();
-		if(len > 0) {
-			if(info[2]->IsObject()) {
-				value = node::Buffer::Data(info[2]->ToObject());
-			} else {
-				Nan::ThrowTypeError("SetNVItem: Passed arguments 3 should be an Object.");
-			}
+	if(changes.empty() || !zb->onTopologyChangeCB) {
+		return;
+	}
+
+	v8::Local<v8::Array> list = Nan::New<v8::Array>(changes.size());
+	for(size_t i = 0; i < changes.size(); i++) {
+		const TopologyGraph::change &c = changes[i];
+		v8::Local<v8::Object> o = Nan::New<v8::Object>();
+
+		o->Set(Nan::New("kind").ToLocalChecked(), Nan::New((int)c.kind));
+		o->Set(Nan::New("from").ToLocalChecked(), Nan::New(c.from));
+		o->Set(Nan::New("to").ToLocalChecked(), Nan::New(c.to));
+		if(c.kind == TopologyGraph::LINK_ADDED || c.kind == TopologyGraph::LINK_REMOVED || c.kind == TopologyGraph::LINK_CHANGED) {
+			o->Set(Nan::New("lqi").ToLocalChecked(), Nan::New(c.lqi));
+			o->Set(Nan::New("relation").ToLocalChecked(), Nan::New(c.relation));
 		}
-		if(info[3]->IsFunction() && info[4]->IsFunction()) {
-			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[3]));
-			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[4]));
-		} else {
-			Nan::ThrowTypeError("SetNVItem: Passed arguments 4,5 should be a function.");
+		if(c.kind == TopologyGraph::LINK_CHANGED) {
+			o->Set(Nan::New("prevLqi").ToLocalChecked(), Nan::New(c.prevLqi));
 		}
-	} else {
-		Nan::ThrowTypeError("SetNVItem: Should pass atleast five argument. [id, len, value, successcb, failcb]");
+		list->Set(i, o);
 	}
+	args[0] = list;
+	zb->onTopologyChangeCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+}
 
-	if(!wZsetNVItem(nvId, len, (uint8_t*)value)) {
-		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onSuccessCB;
-	} else {
-		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
-		delete onFailureCB;
+/*
+ * Source routes to a device that moved to a new nwk address lead nowhere,
+ * nor do the ones cached for its new address.
+ */
+static void invalidateMovedRoutes(const std::vector<TopologyGraph::change> &changes)
+{
+	for(size_t i = 0; i < changes.size(); i++) {
+		if(changes[i].kind == TopologyGraph::NODE_ADDR_CHANGED) {
+			srcRoutes.invalidate(changes[i].from);
+			srcRoutes.invalidate(changes[i].to);
+		}
 	}
 }
 
-NAN_METHOD(ZNP::RemoveDevice)
+/*
+ * Report a request that was dropped before reaching the ZNP and free it.
+ */
+static void dropZCLWork(ZNP::zclTransport *req, int stat)
 {
+	Local<Value> args[3];
+	uint16_t msgId = 0, seqNumber = 0;
+
+	switch(req->workCode) {
+		case ZNP::ZCL_FAN_OUT:
+		{
+			//destinations already sent still get their confirms
+			FanOutJob *job = (FanOutJob*)req->command;
+			job->abort(stat);
+			job->confirmDeadline = uv_hrtime() / 1000000 + job->confirmTimeout;
+			req->_errno = stat;
+			fanOutsAwaiting.push_back(req);
+			checkFanOuts();
+			return;
+		}
+
+		case ZNP::ZCL_SEND_COMMAND:
+			msgId = ((ZNP::sendCmd_t*)req->command)->msgId;
+			seqNumber = ((ZNP::sendCmd_t*)req->command)->seqNumber;
+			delete (ZNP::sendCmd_t*)req->command;
+			break;
+		case ZNP::ZCL_READ_ATTR:
+			msgId = ((ZNP::readAttr_t*)req->command)->msgId;
+			seqNumber = ((ZNP::readAttr_t*)req->command)->seqNumber;
+			//parts already sent still get their responses delivered
+			if(splitReads.find(req->handle) != splitReads.end()) {
+				splitReads[req->handle].complete = true;
+				finishSplitRead(req->handle);
+			}
+			delete (ZNP::readAttr_t*)req->command;
+			break;
+		case ZNP::ZCL_WRITE_ATTR:
+			msgId = ((ZNP::writeAttr_t*)req->command)->msgId;
+			seqNumber = ((ZNP::writeAttr_t*)req->command)->seqNumber;
+			delete (ZNP::writeAttr_t*)req->command;
+			break;
+		case ZNP::ZCL_GROUP_WORK:
+			msgId = ((ZNP::groupCmd_t*)req->command)->msgId;
+			delete (ZNP::groupCmd_t*)req->command;
+			break;
+		case ZNP::ZCL_CONFIG_REPORT:
+		case ZNP::ZCL_READ_REPORT_CFG:
+			msgId = ((ZNP::reportCfg_t*)req->command)->msgId;
+			seqNumber = ((ZNP::reportCfg_t*)req->command)->seqNumber;
+			delete (ZNP::reportCfg_t*)req->command;
+			break;
+	}
+
+	dbg_print(PRINT_LEVEL_VERBOSE, "Dropping ZCL work %d (msgId %d): %d\n", req->handle, msgId, stat);
 
+	args[0] = Nan::New(stat);
+	args[1] = Nan::New(msgId);
+	args[2] = Nan::New(seqNumber);
+	if(req->statusCB) {
+		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+		delete req->statusCB;
+	}
+	delete req;
 }
 
-NAN_METHOD(ZNP::EndDeviceAnnce)
+/*
+ * Answer a read with maxAge from the attribute shadow, the same way a read
+ * response from the device would be delivered. Returns false, without
+ * calling anything, unless every attribute asked for is fresh enough.
+ */
+static bool readFromShadow(ZNP *zb, ZNP::zclTransport *req)
 {
-	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
-	Nan::Callback *onSuccessCB, *onFailureCB;
+	ZNP::readAttr_t *command = (ZNP::readAttr_t*)req->command;
+	attr_response resp;
+	Local<Value> args[3];
 
-	EndDeviceAnnceIndFormat_t msg;
+	if(command->maxAge == 0 || command->addrMode != afAddr16Bit || command->numAttr == 0 || command->parts > 0) {
+		return false;
+	}
 
-	if(info.Length() > 2) {
-		if(info[0]->IsObject()) {
-			Local<Object> o = info[0]->ToObject();
-			Local<Value> v;
+	resp.srcAddr = command->dstAddr;
+	resp.endPoint = command->endPoint;
+	resp.addrMode = command->addrMode;
+	resp.transId = command->seqNumber;
+	resp.clusterId = command->clusterId;
+	resp.payloadLen = 0;
+
+	//read response records: attrId, status, dataType, value
+	for(int i = 0; i < command->numAttr; i++) {
+		AttrShadow::entry e;
+		if(!attrShadow.lookup(command->dstAddr, command->endPoint, command->clusterId, command->attrId[i], command->maxAge, e)) {
+			return false;
+		}
+		if(resp.payloadLen + 4 + e.value.size() > sizeof(resp.payload)) {
+			return false;
+		}
+		resp.payload[resp.payloadLen++] = LO_UINT16(command->attrId[i]);
+		resp.payload[resp.payloadLen++] = HI_UINT16(command->attrId[i]);
+		resp.payload[resp.payloadLen++] = ZCL_STATUS_SUCCESS;
+		resp.payload[resp.payloadLen++] = e.dataType;
+		if(!e.value.empty()) {
+			memcpy(&resp.payload[resp.payloadLen], &e.value[0], e.value.size());
+			resp.payloadLen += e.value.size();
+		}
+	}
+
+	dbg_print(PRINT_LEVEL_VERBOSE, "Read of 0x%04x cluster 0x%04x served from shadow\n", command->dstAddr, command->clusterId);
+
+	args[0] = Nan::New(ZSuccess);
+	args[1] = Nan::New(command->msgId);
+	args[2] = Nan::New(command->seqNumber);
+	if(req->statusCB) {
+		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+	}
+
+	v8::Local<v8::Object> info = Nan::New<v8::Object>();
+	info->Set(Nan::New("srcAddr").ToLocalChecked(), Nan::New(resp.srcAddr));
+	info->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(resp.endPoint));
+	info->Set(Nan::New("addrMode").ToLocalChecked(), Nan::New(resp.addrMode));
+	info->Set(Nan::New("transId").ToLocalChecked(), Nan::New(resp.transId));
+	info->Set(Nan::New("clusterId").ToLocalChecked(), Nan::New(resp.clusterId));
+	info->Set(Nan::New("payloadLen").ToLocalChecked(), Nan::New(resp.payloadLen));
+	info->Set(Nan::New("cached").ToLocalChecked(), Nan::New(true));
+
+	callAttrResponse(zb, info, resp.payload, resp.payloadLen, command->seqNumber);
+
+	return true;
+}
+
+static int writeAttrIds(ZNP::writeAttr_t *command, uint16_t *ids, int max);
+
+/*
+ * Bytes one attribute is expected to take in a read response, from the
+ * shadow when we have seen it before.
+ */
+static uint16_t readRspEstimate(ZNP::readAttr_t *command, uint16_t attrId)
+{
+	AttrShadow::entry e;
+	if(attrShadow.lookup(command->dstAddr, command->endPoint, command->clusterId, attrId, 0xFFFFFFFF, e)) {
+		return 4 + e.value.size();
+	}
+	return 4 + 4;
+}
+
+/*
+ * Add the attributes of a queued read to the head read, if they go to the
+ * same place and both the request and the expected response still fit.
+ */
+static bool mergeRead(ZNP::readAttr_t *x, ZNP::readAttr_t *y, uint16_t *rspLen)
+{
+	uint16_t add[ZCL_WORK_MAX_ATTRS];
+	uint16_t addLen = 0;
+	int n = 0;
+
+	if(!(x->srcEp == y->srcEp && x->dstAddr == y->dstAddr && x->addrMode == y->addrMode && x->endPoint == y->endPoint &&
+		x->clusterId == y->clusterId && x->direction == y->direction && x->disableDefaultRsp == y->disableDefaultRsp)) {
+		return false;
+	}
+	//reads that may be answered from the shadow get their own turn
+	if(y->maxAge) {
+		return false;
+	}
+
+	for(int i = 0; i < y->numAttr; i++) {
+		if(std::find(x->attrId, x->attrId + x->numAttr, y->attrId[i]) != x->attrId + x->numAttr ||
+			std::find(add, add + n, y->attrId[i]) != add + n) {
+			continue;
+		}
+		if(x->numAttr + n >= ZCL_WORK_MAX_ATTRS) {
+			return false;
+		}
+		add[n++] = y->attrId[i];
+		addLen += readRspEstimate(x, y->attrId[i]);
+	}
+
+	if(3 + 2 * (x->numAttr + n) > ZCL_FRAME_MAX_PAYLOAD || 3 + *rspLen + addLen > ZCL_FRAME_MAX_PAYLOAD) {
+		return false;
+	}
+
+	memcpy(&x->attrId[x->numAttr], add, n * sizeof(uint16_t));
+	x->numAttr += n;
+	*rspLen += addLen;
+	return true;
+}
+
+/*
+ * Append the records of a queued write to the head write. Writes touching
+ * the same attribute are left alone, conflation is the tool for those.
+ */
+static bool mergeWrite(ZNP::writeAttr_t *x, ZNP::writeAttr_t *y)
+{
+	uint16_t xIds[ZCL_WORK_MAX_ATTRS], yIds[ZCL_WORK_MAX_ATTRS];
+
+	if(!(x->srcEp == y->srcEp && x->dstAddr == y->dstAddr && x->addrMode == y->addrMode && x->endPoint == y->endPoint &&
+		x->clusterId == y->clusterId && x->cmdId == y->cmdId && x->direction == y->direction &&
+		x->disableDefaultRsp == y->disableDefaultRsp)) {
+		return false;
+	}
+	if(x->cmdFormatLen + y->cmdFormatLen > sizeof(x->cmdFormat) || 3 + x->cmdFormatLen + y->cmdFormatLen > ZCL_FRAME_MAX_PAYLOAD) {
+		return false;
+	}
+
+	int nx = writeAttrIds(x, xIds, ZCL_WORK_MAX_ATTRS);
+	int ny = writeAttrIds(y, yIds, ZCL_WORK_MAX_ATTRS);
+	if(nx + ny > ZCL_WORK_MAX_ATTRS) {
+		return false;
+	}
+	for(int i = 0; i < ny; i++) {
+		if(std::find(xIds, xIds + nx, yIds[i]) != xIds + nx) {
+			return false;
+		}
+	}
+
+	memcpy(&x->cmdFormat[x->cmdFormatLen], y->cmdFormat, y->cmdFormatLen);
+	x->cmdFormatLen += y->cmdFormatLen;
+	x->numAttr = nx + ny;
+	return true;
+}
+
+/*
+ * Pull reads or writes waiting further down the queue for the same device,
+ * endpoint and cluster into the head request, which is about to go on air.
+ * For reads, callers holds who asked for which attributes, head first.
+ */
+static void coalesceQueued(ZNP::zclTransport *req, std::vector<ZNP::zclTransport *> &riders, coalescedRead &read)
+{
+	uint64_t now = uv_now(uv_default_loop());
+	uint16_t rspLen = 0;
+
+	if(req->workCode == ZNP::ZCL_READ_ATTR) {
+		ZNP::readAttr_t *command = (ZNP::readAttr_t*)req->command;
+		coalescedCaller caller;
+		caller.msgId = command->msgId;
+		caller.seqNumber = command->seqNumber;
+		caller.attrIds.assign(command->attrId, command->attrId + command->numAttr);
+		read.callers.push_back(caller);
+		read.clusterId = command->clusterId;
+		read.sent = now;
+		for(int i = 0; i < command->numAttr; i++) {
+			rspLen += readRspEstimate(command, command->attrId[i]);
+		}
+		//a split read is reassembled on its own
+		if(command->addrMode != afAddr16Bit || command->parts > 0) {
+			return;
+		}
+	} else if(((ZNP::writeAttr_t*)req->command)->addrMode != afAddr16Bit || ((ZNP::writeAttr_t*)req->command)->parts > 0) {
+		return;
+	}
+
+	for(std::deque<ZNP::zclTransport *>::iterator it = workqueue.begin() + 1; it != workqueue.end(); ) {
+		ZNP::zclTransport *r = *it;
+		bool merged = false;
+
+		if(r->coalesce && r->workCode == req->workCode && !(r->deadline && now > r->deadline)) {
+			if(req->workCode == ZNP::ZCL_READ_ATTR) {
+				ZNP::readAttr_t *y = (ZNP::readAttr_t*)r->command;
+				merged = mergeRead((ZNP::readAttr_t*)req->command, y, &rspLen);
+				if(merged) {
+					coalescedCaller caller;
+					caller.msgId = y->msgId;
+					caller.seqNumber = y->seqNumber;
+					caller.attrIds.assign(y->attrId, y->attrId + y->numAttr);
+					read.callers.push_back(caller);
+				}
+			} else {
+				merged = mergeWrite((ZNP::writeAttr_t*)req->command, (ZNP::writeAttr_t*)r->command);
+			}
+		}
+
+		if(merged) {
+			riders.push_back(r);
+			it = workqueue.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	if(!riders.empty()) {
+		dbg_print(PRINT_LEVEL_VERBOSE, "Coalesced %d requests into handle %d\n", (int)riders.size(), req->handle);
+	}
+}
+
+/*
+ * Report the outcome of a merged frame to the requests that rode along.
+ */
+static void finishRiders(std::vector<ZNP::zclTransport *> &riders, int stat)
+{
+	Local<Value> args[3];
+
+	for(size_t i = 0; i < riders.size(); i++) {
+		ZNP::zclTransport *r = riders[i];
+		if(r->workCode == ZNP::ZCL_READ_ATTR) {
+			args[1] = Nan::New(((ZNP::readAttr_t*)r->command)->msgId);
+			args[2] = Nan::New(((ZNP::readAttr_t*)r->command)->seqNumber);
+			delete (ZNP::readAttr_t*)r->command;
+		} else {
+			args[1] = Nan::New(((ZNP::writeAttr_t*)r->command)->msgId);
+			args[2] = Nan::New(((ZNP::writeAttr_t*)r->command)->seqNumber);
+			delete (ZNP::writeAttr_t*)r->command;
+		}
+		args[0] = Nan::New(stat);
+		if(r->statusCB) {
+			r->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+			delete r->statusCB;
+		}
+		delete r;
+	}
+	riders.clear();
+}
+
+void znpasync_cb_handler(uv_async_t *handle, int status);
+
+/*
+ * Fires once the tx governor lets the head of the work queue go out.
+ */
+void txtimer_cb_handler(uv_timer_t *handle, int status)
+{
+	znpasync_cb_handler(&znpasync, 0);
+}
+
+/*
+ * Async handler, triggered by the v8 calls.
+ */
+void znpasync_cb_handler(uv_async_t *handle, int status)
+{
+	Nan::HandleScope scope;
+
+	ZNP::zclTransport *req;
+	Local<Value> args[16];
+
+	ZNP *zb = (ZNP *)handle->data;
+	std::vector<ZNP::zclTransport *> expired;
+
+	checkFanOuts();
+
+	pthread_mutex_lock(&workqueue_mutex);
+
+	while (!workqueue.empty())
+	{
+		req = workqueue.front();
+
+		if(req->deadline && uv_now(uv_default_loop()) > req->deadline) {
+			workqueue.pop_front();
+			expired.push_back(req);
+			continue;
+		}
+
+		//Cache hits never go on air, so they are not held back by the governor
+		if(req->workCode == ZNP::ZCL_READ_ATTR && readFromShadow(myZnp, req)) {
+			workqueue.pop_front();
+			delete (ZNP::readAttr_t*)req->command;
+			delete req;
+			continue;
+		}
+
+		bool coalescable = req->coalesce && (req->workCode == ZNP::ZCL_READ_ATTR || req->workCode == ZNP::ZCL_WRITE_ATTR);
+
+		//Give reads and writes for the same device a moment to queue up behind this one
+		if(coalescable && req->notBefore > uv_now(uv_default_loop())) {
+			uv_timer_start(&txtimer, (uv_timer_cb)txtimer_cb_handler, req->notBefore - uv_now(uv_default_loop()), 0);
+			break;
+		}
+
+		//Leave the request at the head of the queue until the channel has room for it
+		uint8_t txMode;
+		uint16_t txDst, txLen;
+		txFrameOf(req, &txMode, &txDst, &txLen);
+		uint32_t hold = txGovernor.admit(txMode, txDst, txLen);
+		if(hold > 0) {
+			uv_timer_start(&txtimer, (uv_timer_cb)txtimer_cb_handler, hold, 0);
+			break;
+		}
+
+		//Merged once admitted, the governor accounts the real length when the ZNP takes the frame
+		std::vector<ZNP::zclTransport *> riders;
+		coalescedRead read;
+		if(coalescable) {
+			coalesceQueued(req, riders, read);
+		}
+
+		switch(req->workCode) {
+
+			case ZNP::ZCL_SEND_COMMAND:
+			{
+				ZNP::sendCmd_t *command = (ZNP::sendCmd_t*)req->command;
+
+				afAddrType_t afDstAddr;
+				int stat;
+
+			    afDstAddr.addr.shortAddr = command->dstAddr;
+			    afDstAddr.endPoint = command->endPoint;
+			    afDstAddr.addrMode = command->addrMode;
+
+
+	    		myZnp->waitForResponse = true;
+	    		myZnp->currentCmdSeqId = command->seqNumber;
+
+			    stat = zcl_SendCommand(command->srcEp, &afDstAddr, command->clusterId, command->cmdId, command->specific, 
+			    	command->direction, command->disableDefaultRsp, command->manuCode, command->seqNumber, command->cmdFormatLen, command->cmdFormat);
+
+				if(stat == 0x00) { //SUCCESS
+		    		//wait for the request to resolve
+		    	} else {
+		    		myZnp->waitForResponse = false;
+		    	}
+
+				args[0] = Nan::New(stat);
+				args[1] = Nan::New(command->msgId);
+				args[2] = Nan::New(command->seqNumber);
+				if(req->statusCB){
+		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+				}
+
+				delete req->command;
+				break;
+			}
+
+			case ZNP::ZCL_READ_ATTR:
+			{
+				ZNP::readAttr_t *command = (ZNP::readAttr_t*)req->command;
+
+				afAddrType_t afDstAddr;
+    			zclReadCmd_t* readCmd;
+    			int stat = ZMemError;
+
+			    afDstAddr.addr.shortAddr = command->dstAddr;
+			    afDstAddr.endPoint = command->endPoint;
+			    afDstAddr.addrMode = command->addrMode;
+
+			    //more attributes than fit one frame go out in parts, the first with the caller's sequence number
+			    int partAttrs = readPartAttrs(command);
+			    uint8_t partSeq = command->parts == 0 ? command->seqNumber : zclTransId(command->dstAddr);
+			    bool split = command->parts > 0 || partAttrs < command->numAttr;
+
+    			readCmd = (zclReadCmd_t*)malloc(sizeof(zclReadCmd_t) + sizeof(uint16) * partAttrs);
+
+			    if (readCmd != NULL)
+			    {
+			        readCmd->numAttr = partAttrs;
+			        
+			        int i = 0; 
+			        for(i = 0; i < readCmd->numAttr; i++) {
+			        	readCmd->attrID[i] = command->attrId[command->nextAttr + i];
+			        }
+
+		    		myZnp->waitForResponse = true;
+		    		myZnp->currentCmdSeqId = command->seqNumber;
+
+			        stat = zcl_SendRead( command->srcEp, &afDstAddr,
+						        command->clusterId, readCmd,
+						        command->direction, command->disableDefaultRsp, partSeq);
+
+			        free(readCmd);
+
+			        if(stat == 0x00) {
+			        	uint64_t now = uv_now(uv_default_loop());
+			        	for(std::map<uint32_t, uint64_t>::iterator it = readsInFlight.begin(); it != readsInFlight.end(); ) {
+			        		if(now - it->second > READ_RSP_TIMEOUT) {
+			        			readsInFlight.erase(it++);
+			        		} else {
+			        			it++;
+			        		}
+			        	}
+			        	readsInFlight[((uint32_t)command->dstAddr << 8) | partSeq] = now;
+			        }
+
+			        if(stat == 0x00 && split) {
+			        	if(splitReads.find(req->handle) == splitReads.end()) {
+			        		splitRead &r = splitReads[req->handle];
+			        		r.srcAddr = command->dstAddr;
+			        		r.endPoint = command->endPoint;
+			        		r.addrMode = command->addrMode;
+			        		r.clusterId = command->clusterId;
+			        		r.seqNumber = command->seqNumber;
+			        		r.parts = 0;
+			        		r.outstanding = 0;
+			        		r.complete = false;
+			        	}
+			        	splitRead &r = splitReads[req->handle];
+			        	r.parts++;
+			        	r.outstanding++;
+			        	r.sent = uv_now(uv_default_loop());
+			        	splitReadParts[((uint32_t)command->dstAddr << 8) | partSeq] = req->handle;
+			        	//parts that never get an answer are given up on from splittimer
+			        	uv_timer_start(&splittimer, (uv_timer_cb)splittimer_cb_handler, READ_RSP_TIMEOUT, 0);
+			        }
+
+			        if(stat == 0x00 && !riders.empty()) {
+			        	uint64_t now = uv_now(uv_default_loop());
+			        	for(std::map<uint32_t, coalescedRead>::iterator it = coalescedReads.begin(); it != coalescedReads.end(); ) {
+			        		if(now - it->second.sent > READ_RSP_TIMEOUT) {
+			        			coalescedReads.erase(it++);
+			        		} else {
+			        			it++;
+			        		}
+			        	}
+			        	coalescedReads[((uint32_t)command->dstAddr << 8) | (uint8_t)command->seqNumber] = read;
+			        }
+
+			        // if(block)
+			        // {
+			        //     if (waitZclGetRsp() == -1)
+			        //     {
+			        //         status = ZFailure;
+			        //     }
+			        // }
+
+					if(stat == 0x00) { //SUCCESS
+			    		//wait for the request to resolve
+			    	} else {
+			    		myZnp->waitForResponse = false;
+			    	}
+		   	 	}
+
+				command->nextAttr += partAttrs;
+				command->parts++;
+				if(stat != 0x00 && command->status == 0x00) {
+					command->status = stat;
+				}
+				if(command->nextAttr < command->numAttr) {
+					//next part goes back through the tx governor
+					continue;
+				}
+				if(split) {
+					if(splitReads.find(req->handle) != splitReads.end()) {
+						splitReads[req->handle].complete = true;
+						finishSplitRead(req->handle);
+					}
+					//the caller hears about the first part that failed
+					stat = command->status;
+				}
+
+				args[0] = Nan::New(stat);
+				args[1] = Nan::New(command->msgId);
+				args[2] = Nan::New(command->seqNumber);
+				if(req->statusCB){
+		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+				}
+				finishRiders(riders, stat);
+				delete req->command;
+				break;
+			}
+
+			case ZNP::ZCL_WRITE_ATTR:
+			{
+				ZNP::writeAttr_t *command = (ZNP::writeAttr_t*)req->command;
+
+				dbg_print(PRINT_LEVEL_VERBOSE, "Got write attribute\n");
+				afAddrType_t afDstAddr;
+    			int stat = ZInvalidParameter;
+			    afDstAddr.addr.shortAddr = command->dstAddr;
+			    afDstAddr.endPoint = command->endPoint;
+			    afDstAddr.addrMode = command->addrMode;
+
+			    //records that do not fit one frame go out in parts, the first with the caller's sequence number
+			    uint16_t partLen = writePartLen(command);
+			    uint16_t partEnd = command->nextByte + partLen;
+			    uint8_t partSeq = command->parts == 0 ? command->seqNumber : zclTransId(command->dstAddr);
+			    bool split = command->parts > 0 || partEnd < command->cmdFormatLen;
+
+			    //the payload is the records as they go on air: attrId (little endian), dataType, value.
+			    //Values were already encoded, so they are copied as is instead of through zclSerializeData.
+			    uint8_t payload[ZCL_WORK_MAX_WRITE_LEN];
+			    uint16_t payloadLen = 0;
+			    int index = command->nextByte;
+			    while(index + 4 <= partEnd && index + 4 + command->cmdFormat[index+3] <= partEnd) {
+			    	uint8_t len = command->cmdFormat[index+3];
+			    	payload[payloadLen++] = command->cmdFormat[index+1];
+			    	payload[payloadLen++] = command->cmdFormat[index];
+			    	payload[payloadLen++] = command->cmdFormat[index+2];
+			    	memcpy(&payload[payloadLen], &command->cmdFormat[index+4], len);
+			    	payloadLen += len;
+			    	index = index + 2 + 1 + 1 + len;
+			    }
+
+	    		myZnp->waitForResponse = true;
+	    		myZnp->currentCmdSeqId = command->seqNumber;
+
+			    if(payloadLen > 0) {
+			    	stat = zcl_SendCommand(command->srcEp, &afDstAddr, command->clusterId, command->cmdId, FALSE,
+			    			command->direction, command->disableDefaultRsp, 0, partSeq, payloadLen, payload);
+			    }
+
+			    //the shadow takes the written values once the device acknowledges them
+			    if(stat == 0x00 && command->addrMode == afAddr16Bit && command->cmdId == ZCL_CMD_WRITE) {
+			    	attrShadow.expectWrite(command->dstAddr, command->endPoint, command->clusterId,
+			    			partSeq, &command->cmdFormat[command->nextByte], partLen);
+			    }
+
+				if(stat == 0x00) { //SUCCESS
+		    		//wait for the request to resolve
+		    	} else {
+		    		myZnp->waitForResponse = false;
+		    	}
+
+				command->nextByte = partEnd;
+				command->parts++;
+				if(stat != 0x00 && command->status == 0x00) {
+					command->status = stat;
+				}
+				if(command->nextByte < command->cmdFormatLen) {
+					//next part goes back through the tx governor
+					continue;
+				}
+				if(split) {
+					//the caller hears about the first part that failed
+					stat = command->status;
+				}
+
+				args[0] = Nan::New(stat);
+				args[1] = Nan::New(command->msgId);
+				args[2] = Nan::New(command->seqNumber);
+				if(req->statusCB){
+		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+				}
+				finishRiders(riders, stat);
+				delete req->command;
+				break;
+			}
+
+			case ZNP::ZCL_FAN_OUT:
+			{
+				FanOutJob *job = (FanOutJob*)req->command;
+
+				job->sendNext(uv_hrtime() / 1000000);
+				if(!job->done()) {
+					//next destination goes back through the tx governor
+					continue;
+				}
+
+				//reported once the queue is unlocked, see checkFanOuts() below
+				workqueue.pop_front();
+				job->confirmDeadline = uv_hrtime() / 1000000 + job->confirmTimeout;
+				fanOutsAwaiting.push_back(req);
+				continue;
+			}
+
+			case ZNP::ZCL_GROUP_WORK:
+			{
+				ZNP::groupCmd_t *command = (ZNP::groupCmd_t*)req->command;
+				int stat;
+
+				switch(command->op) {
+					case ZNP::GROUP_ADD:
+						stat = zGw_addGroup(command->groupId, command->dstAddr, command->endPoint, command->addrMode);
+						break;
+					case ZNP::GROUP_REMOVE:
+						stat = zGw_removeGroup(command->groupId, command->dstAddr, command->endPoint, command->addrMode);
+						break;
+					case ZNP::GROUP_GET_MEMBERSHIP:
+						stat = zGw_getGroupMembership(command->dstAddr, command->endPoint, command->addrMode);
+						break;
+					case ZNP::SCENE_STORE:
+						stat = zGw_storeScene(command->groupId, command->sceneId, command->dstAddr, command->endPoint, command->addrMode);
+						break;
+					case ZNP::SCENE_RECALL:
+						stat = zGw_recallScene(command->groupId, command->sceneId, command->dstAddr, command->endPoint, command->addrMode);
+						break;
+					default:
+						stat = ZInvalidParameter;
+						break;
+				}
+
+				args[0] = Nan::New(stat);
+				args[1] = Nan::New(command->msgId);
+				if(req->statusCB){
+		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 2, args);
+				}
+				delete command;
+				break;
+			}
+
+			case ZNP::ZCL_CONFIG_REPORT:
+			case ZNP::ZCL_READ_REPORT_CFG:
+			{
+				ZNP::reportCfg_t *command = (ZNP::reportCfg_t*)req->command;
+
+				afAddrType_t afDstAddr;
+				int stat = ZMemError;
+
+			    afDstAddr.addr.shortAddr = command->dstAddr;
+			    afDstAddr.endPoint = command->endPoint;
+			    afDstAddr.addrMode = command->addrMode;
+
+				if(req->workCode == ZNP::ZCL_CONFIG_REPORT) {
+					zclCfgReportCmd_t *cfgCmd = (zclCfgReportCmd_t*)malloc(sizeof(zclCfgReportCmd_t) + sizeof(zclCfgReportRec_t) * command->numAttr);
+
+					if(cfgCmd != NULL) {
+						cfgCmd->numAttr = command->numAttr;
+						for(int i = 0; i < command->numAttr; i++) {
+							ZNP::reportCfgRec_t *rec = &command->attrs[i];
+							cfgCmd->attrList[i].direction = rec->direction;
+							cfgCmd->attrList[i].attrID = rec->attrId;
+							cfgCmd->attrList[i].dataType = rec->dataType;
+							cfgCmd->attrList[i].minReportInt = rec->minInterval;
+							cfgCmd->attrList[i].maxReportInt = rec->maxInterval;
+							cfgCmd->attrList[i].timeoutPeriod = rec->timeoutPeriod;
+							cfgCmd->attrList[i].reportableChange = (uint8*)&rec->reportableChange;
+						}
+
+						stat = zcl_SendConfigReportCmd(command->srcEp, &afDstAddr, command->clusterId, cfgCmd,
+									command->direction, command->disableDefaultRsp, command->seqNumber);
+						free(cfgCmd);
+					}
+				} else {
+					zclReadReportCfgCmd_t *readCmd = (zclReadReportCfgCmd_t*)malloc(sizeof(zclReadReportCfgCmd_t) + sizeof(zclReadReportCfgRec_t) * command->numAttr);
+
+					if(readCmd != NULL) {
+						readCmd->numAttr = command->numAttr;
+						for(int i = 0; i < command->numAttr; i++) {
+							readCmd->attrList[i].direction = command->attrs[i].direction;
+							readCmd->attrList[i].attrID = command->attrs[i].attrId;
+						}
+
+						stat = zcl_SendReadReportCfgCmd(command->srcEp, &afDstAddr, command->clusterId, readCmd,
+									command->direction, command->disableDefaultRsp, command->seqNumber);
+						free(readCmd);
+					}
+				}
+
+				args[0] = Nan::New(stat);
+				args[1] = Nan::New(command->msgId);
+				args[2] = Nan::New(command->seqNumber);
+				if(req->statusCB){
+		    		req->statusCB->Call(Nan::GetCurrentContext()->Global(), 3, args);
+				}
+				delete command;
+				break;
+			}
+
+			default:
+			{
+				dbg_print(PRINT_LEVEL_ERROR, "znpasync_cb_handler: Unhandled ZCL WorkCode: %d\n", req->workCode);
+				break;
+			}
+		}
+
+		workqueue.pop_front();
+		delete req;
+	}
+
+	pthread_mutex_unlock(&workqueue_mutex);
+
+	//callbacks retry or chain the next command, which takes workqueue_mutex
+	for(size_t i = 0; i < expired.size(); i++) {
+		dropZCLWork(expired[i], ZNP::ZCL_WORK_EXPIRED);
+	}
+	checkFanOuts();
+}
+
+/*
+ * Attribute ids of a write request, in the order they appear in cmdFormat.
+ */
+static int writeAttrIds(ZNP::writeAttr_t *command, uint16_t *ids, int max)
+{
+	int index = 0, n = 0;
+	while(index + 3 < command->cmdFormatLen && n < max) {
+		ids[n++] = (command->cmdFormat[index] << 8) + command->cmdFormat[index+1];
+		index = index + 2 + 1 + 1 + command->cmdFormat[index+3];
+	}
+	return n;
+}
+
+/*
+ * Two requests conflate if they address the same device, endpoint, cluster and command
+ * (and, for writes, the same attributes), so only the newest one needs to go on air.
+ */
+static bool sameConflationKey(ZNP::zclTransport *a, ZNP::zclTransport *b)
+{
+	if(a->workCode != b->workCode) {
+		return false;
+	}
+
+	switch(a->workCode) {
+		case ZNP::ZCL_SEND_COMMAND:
+		{
+			ZNP::sendCmd_t *x = (ZNP::sendCmd_t*)a->command;
+			ZNP::sendCmd_t *y = (ZNP::sendCmd_t*)b->command;
+			return x->dstAddr == y->dstAddr && x->addrMode == y->addrMode && x->endPoint == y->endPoint &&
+				x->clusterId == y->clusterId && x->cmdId == y->cmdId && x->specific == y->specific &&
+				x->direction == y->direction && x->manuCode == y->manuCode;
+		}
+
+		case ZNP::ZCL_WRITE_ATTR:
+		{
+			ZNP::writeAttr_t *x = (ZNP::writeAttr_t*)a->command;
+			ZNP::writeAttr_t *y = (ZNP::writeAttr_t*)b->command;
+			uint16_t xIds[ZCL_WORK_MAX_ATTRS], yIds[ZCL_WORK_MAX_ATTRS];
+
+			if(!(x->dstAddr == y->dstAddr && x->addrMode == y->addrMode && x->endPoint == y->endPoint &&
+				x->clusterId == y->clusterId && x->cmdId == y->cmdId && x->direction == y->direction)) {
+				return false;
+			}
+			int n = writeAttrIds(x, xIds, ZCL_WORK_MAX_ATTRS);
+			return n == writeAttrIds(y, yIds, ZCL_WORK_MAX_ATTRS) && memcmp(xIds, yIds, n * sizeof(uint16_t)) == 0;
+		}
+
+		default:
+			//reads are never superseded, every caller wants its own answer
+			return false;
+	}
+}
+
+/*
+ * Queues req, workqueue_mutex held. Returns the request it superseded, if any.
+ */
+static ZNP::zclTransport *queueWork(ZNP::zclTransport *req)
+{
+	if(req->conflate) {
+		//take over the queue slot of the older request so the newest value is not delayed
+		for(std::deque<ZNP::zclTransport *>::iterator it = workqueue.begin(); it != workqueue.end(); it++) {
+			if((*it)->conflate && sameConflationKey(*it, req)) {
+				ZNP::zclTransport *superseded = *it;
+				*it = req;
+				return superseded;
+			}
+		}
+	}
+	workqueue.push_back(req);
+	return NULL;
+}
+
+void submitToZNP(ZNP::zclTransport *req)
+{
+	ZNP::zclTransport *superseded;
+
+	pthread_mutex_lock(&workqueue_mutex);
+	superseded = queueWork(req);
+	pthread_mutex_unlock(&workqueue_mutex);
+
+	if(superseded) {
+		dropZCLWork(superseded, ZNP::ZCL_WORK_SUPERSEDED);
+	}
+
+	uv_async_send(&znpasync);
+}
+
+/*
+ * Queues a batch under one lock and wakes the work queue once.
+ */
+static void submitBatchToZNP(std::vector<ZNP::zclTransport *> &reqs)
+{
+	std::vector<ZNP::zclTransport *> superseded;
+
+	pthread_mutex_lock(&workqueue_mutex);
+	for(size_t i = 0; i < reqs.size(); i++) {
+		ZNP::zclTransport *s = queueWork(reqs[i]);
+		if(s) {
+			superseded.push_back(s);
+		}
+	}
+	pthread_mutex_unlock(&workqueue_mutex);
+
+	for(size_t i = 0; i < superseded.size(); i++) {
+		dropZCLWork(superseded[i], ZNP::ZCL_WORK_SUPERSEDED);
+	}
+
+	uv_async_send(&znpasync);
+}
+
+
+//*********************************************************************************************************************
+bool ZNP::setupThread()
+{
+	uv_mutex_lock(&_control);
+	bool ret = threadUp;
+	uv_mutex_unlock(&_control);
+	if(!ret) {
+		this->Ref();
+		uv_mutex_lock(&_control);
+		int r = uv_thread_create(&znp_thread, main_thread, this); // start thread
+        if (r < 0) {  // old libuv returns -1 on failure
+                dbg_print(PRINT_LEVEL_INFO, "NON-RECOVERABLE: failed to create znp main thread.\n");
+                uv_mutex_unlock(&_control);
+                return false;
+        }else {
+                dbg_print(PRINT_LEVEL_INFO, "znp_main_thread create called successfully\n");
+        }
+		uv_cond_wait(&_start_cond, &_control); // wait for thread's start...
+		ret = threadUp;
+		uv_mutex_unlock(&_control);
+	}
+	return ret;
+}
+
+void ZNP::sigThreadUp() 
+{
+	uv_mutex_lock(&_control);
+	threadUp = true;
+	uv_cond_signal(&_start_cond);
+	uv_mutex_unlock(&_control);
+}
+
+void ZNP::sigThreadDown() 
+{
+	uv_mutex_lock(&_control);
+	threadUp = false;
+	uv_cond_signal(&_start_cond);
+	uv_mutex_unlock(&_control);
+}
+
+//*********************************************************************************************************************
+NAN_METHOD(ZNP::New)
+{
+	assert(info.IsConstructCall());
+	ZNP* self = new ZNP();
+	self->Wrap(info.This());
+
+	myZnp = self;
+
+	if(info.Length() > 0 && info[0]->IsObject()) {
+		Local<Object> o = info[0]->ToObject();
+		Local<Value> v;
+
+		V8_IFEXIST_TO_DYN_CSTR("siodev",myZnp->siodev,v,o);
+		V8_IFEXIST_TO_INT_CAST("devType",myZnp->zOpts.devType,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("channelMask",myZnp->zOpts.channelMask,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("baudRate",myZnp->zOpts.baudRate,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("panId",myZnp->zOpts.panId,v,o,int);
+		V8_IFEXIST_TO_BOOLEAN_CAST("newNwk",myZnp->zOpts.newNwk,v,o,bool);
+
+		txgov_options txOpts = txGovernor.options();
+		V8_IFEXIST_TO_INT_CAST("txWindow",txOpts.windowMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txDutyCycle",txOpts.dutyCycle,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txBttSize",txOpts.bttSize,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txBcastDeliveryTime",txOpts.bcastDeliveryMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txHops",txOpts.unicastHops,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txBcastRelays",txOpts.bcastRelays,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txBackoff",txOpts.backoffBaseMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("txBackoffMax",txOpts.backoffMaxMs,v,o,int);
+		txGovernor.configure(txOpts);
+
+		V8_IFEXIST_TO_INT_CAST("coalesceWindow",coalesceWindowMs,v,o,int);
+
+		zdo_walk_options lqiOpts = lqiCrawler.options();
+		V8_IFEXIST_TO_INT_CAST("lqiMaxInFlight",lqiOpts.maxInFlight,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("lqiTimeout",lqiOpts.timeoutMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("lqiRetries",lqiOpts.retries,v,o,int);
+		lqiCrawler.configure(lqiOpts);
+
+		zdo_walk_options rtgOpts = rtgHarvester.options();
+		V8_IFEXIST_TO_INT_CAST("rtgMaxInFlight",rtgOpts.maxInFlight,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("rtgTimeout",rtgOpts.timeoutMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("rtgRetries",rtgOpts.retries,v,o,int);
+		rtgHarvester.configure(rtgOpts);
+
+		int srcRouteMaxAge = -1;
+		V8_IFEXIST_TO_INT_CAST("srcRouteMaxAge",srcRouteMaxAge,v,o,int);
+		if(srcRouteMaxAge >= 0) {
+			srcRoutes.setMaxAge(srcRouteMaxAge);
+		}
+
+		interview_options ivOpts = interviewer.options();
+		V8_IFEXIST_TO_INT_CAST("interviewMaxInFlight",ivOpts.maxInFlight,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("interviewTimeout",ivOpts.timeoutMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("interviewRetries",ivOpts.retries,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("interviewBackoff",ivOpts.backoffMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("interviewBackoffMax",ivOpts.backoffMaxMs,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("interviewMaxQueued",ivOpts.maxQueued,v,o,int);
+		V8_IFEXIST_TO_INT_CAST("interviewAdmitInterval",ivOpts.admitIntervalMs,v,o,int);
+		interviewer.configure(ivOpts);
+
+		char *dbPath = NULL;
+		V8_IFEXIST_TO_DYN_CSTR("dbPath",dbPath,v,o);
+		if(dbPath) {
+			deviceDb.setPath(dbPath);
+			free(dbPath);
+		}
+		V8_IFEXIST_TO_INT_CAST("dbSaveInterval",dbSaveIntervalMs,v,o,int);
+		if(dbSaveIntervalMs == 0) {
+			dbSaveIntervalMs = 1000;
+		}
+		V8_IFEXIST_TO_INT_CAST("dbAttrSaveInterval",dbAttrSaveIntervalMs,v,o,int);
+
+		int lqiDelta = -1;
+		V8_IFEXIST_TO_INT_CAST("topologyLqiDelta",lqiDelta,v,o,int);
+		if(lqiDelta >= 0) {
+			topologyGraph.setLqiDelta(lqiDelta);
+		}
+	}
+	
+	info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(ZNP::Connect)
+{
+	uv_async_init(uv_default_loop(), &v8async, (uv_async_cb)v8async_cb_handler);
+	uv_async_init(uv_default_loop(), &znpasync, (uv_async_cb)znpasync_cb_handler);
+	uv_timer_init(uv_default_loop(), &txtimer);
+	uv_timer_init(uv_default_loop(), &fanouttimer);
+	uv_timer_init(uv_default_loop(), &splittimer);
+	uv_timer_init(uv_default_loop(), &crawl.timer);
+	crawl.timer.data = &crawl;
+	uv_timer_init(uv_default_loop(), &harvest.timer);
+	harvest.timer.data = &harvest;
+	uv_timer_init(uv_default_loop(), &interviewtimer);
+	interviewer.setTransIds(zclTransId);
+	uv_timer_init(uv_default_loop(), &dbtimer);
+	uv_mutex_init(&_control);
+	uv_cond_init(&_start_cond);
+
+	v8async.data = myZnp;
+
+	nvBackup.setAccess(wZNvLength, wZReadNVItem, wZWriteNVItem);
+
+	//devices known from the last run, before the network can announce any
+	if(deviceDb.enabled()) {
+		int n = deviceDb.load(deviceRegistry, attrShadow);
+		if(n >= 0) {
+			dbg_print(PRINT_LEVEL_INFO, "Loaded %d devices from %s in %d ms\n", n, deviceDb.path().c_str(), deviceDb.stats().loadMs);
+		} else if(errno != ENOENT) {
+			dbg_print(PRINT_LEVEL_WARNING, "Could not load the device database %s: %s\n", deviceDb.path().c_str(), strerror(errno));
+		}
+		uv_timer_start(&dbtimer, (uv_timer_cb)dbtimer_cb_handler, dbSaveIntervalMs, dbSaveIntervalMs);
+	}
+
+	const unsigned argc = 1;
+	Local<Value> argv[argc];
+
+	if(info.Length() > 1) {
+
+		Local<Object> o = info[0]->ToObject();
+		Local<Value> v;
+		V8_IFEXIST_TO_DYN_CSTR("siodev",myZnp->siodev,v,o);
+
+		if(info[1]->IsFunction()) {
+
+			ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+			zb->onConnectedCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+
+			bool ret = zb->setupThread();
+			if(ret) {
+				argv[0] = Nan::New(true);	//thread started successfully
+			} else {
+				argv[0] = Nan::New(false);	//thread failed
+			}
+			zb->onConnectedCB->Call(Nan::GetCurrentContext()->Global(), argc, argv);
+		} else {
+			Nan::ThrowTypeError("Passed arguments 2 should be a function.");
+		}
+	} else {
+		Nan::ThrowTypeError("Passed arguments should be atleast two.");
+	}
+}
+
+NAN_METHOD(ZNP::Disconnect)
+{
+	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+	Nan::Callback *onSuccessCB, *onFailureCB;
+
+	if(info.Length() > 1) {
+		if(info[0]->IsFunction() && info[1]->IsFunction()) {
+			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[0]));
+			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+		} else {
+			Nan::ThrowTypeError("Passed argument 0,1 should be a function.");
+		}
+	} else {
+		Nan::ThrowTypeError("Disconnect: Should pass atleast two argments. [successcb, failcb]");
+	}
+
+	char * selected_serial_port;
+	selected_serial_port = myZnp->siodev;
+
+	dbg_print(PRINT_LEVEL_INFO, "attempting to close %s\n\n", selected_serial_port);
+	//the last save finishes on the thread pool, the loop waits for it
+	uv_timer_stop(&dbtimer);
+	saveDevices(true);
+	if(wZCloseRPC()) {
+		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+		delete onSuccessCB;
+	} else {
+		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+		delete onFailureCB;
+	}
+	
+	myZnp->sigThreadDown();
+	pthread_cond_signal(&cond_critical_failure);
+}
+
+NAN_METHOD(ZNP::AddDevice)
+{
+	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+	Nan::Callback *onSuccessCB, *onFailureCB;
+	int duration;
+
+	if(info.Length() > 2) {
+		duration = info[0]->ToNumber()->Value();
+		if(info[1]->IsFunction() && info[2]->IsFunction()) {
+			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[2]));
+		} else {
+			Nan::ThrowTypeError("Passed arguments 1,2 should be a function.");
+		}
+	} else {
+		Nan::ThrowTypeError("AddDevice: Should pass atleast three argument. [duration, successcb, failcb]");
+	}
+
+	if(!wZAddDevice(duration)) {
+		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+		delete onSuccessCB;
+	} else {
+		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+		delete onFailureCB;
+	}
+}
+
+NAN_METHOD(ZNP::SendLqiRequest)
+{
+	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+	Nan::Callback *onSuccessCB, *onFailureCB;
+	int dstAddr;
+
+	if(info.Length() > 2) {
+		dstAddr = info[0]->ToNumber()->Value();
+		if(info[1]->IsFunction() && info[2]->IsFunction()) {
+			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[2]));
+		} else {
+			Nan::ThrowTypeError("Passed arguments 1,2 should be a function.");
+			return;
+		}
+	} else {
+		Nan::ThrowTypeError("SendLqiRequest: Should pass atleast three argument. [dstAddr, successcb, failcb]");
+		return;
+	}
+
+	//the whole mesh below dstAddr is walked, each router's table goes to onNetworkTopology
+	if(!startCrawl(dstAddr, lqiCrawler.options(), NULL)) {
+		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+	} else {
+		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+	}
+	delete onSuccessCB;
+	delete onFailureCB;
+}
+
+NAN_METHOD(ZNP::CrawlTopology)
+{
+	Local<Object> o;
+	Local<Value> v;
+	uint16_t root = 0;
+
+	if(info.Length() < 2 || !info[1]->IsFunction()) {
+		Nan::ThrowTypeError("CrawlTopology: Should pass atleast two argument. [options, cb]");
+		return;
+	}
+
+	//options given here are for this crawl only, the configured ones stay
+	zdo_walk_options lqiOpts = lqiCrawler.options();
+	if(info[0]->IsObject()) {
+		o = info[0]->ToObject();
+		V8_IFEXIST_TO_INT_CAST("root",			root,					v,	o,	int);//uint16
+		V8_IFEXIST_TO_INT_CAST("maxInFlight",	lqiOpts.maxInFlight,	v,	o,	int);
+		V8_IFEXIST_TO_INT_CAST("timeout",		lqiOpts.timeoutMs,		v,	o,	int);
+		V8_IFEXIST_TO_INT_CAST("retries",		lqiOpts.retries,		v,	o,	int);
+	}
+
+	//routers the ZNP would not ask are retried, they end up in the summary's failed list
+	startCrawl(root, lqiOpts, new Nan::Callback(Local<Function>::Cast(info[1])));
+}
+
+NAN_METHOD(ZNP::HarvestRoutes)
+{
+	Local<Object> o;
+	Local<Value> v;
+	std::vector<uint16_t> routers;
+
+	if(info.Length() < 2 || !info[1]->IsFunction()) {
+		Nan::ThrowTypeError("HarvestRoutes: Should pass atleast two argument. [options, cb]");
+		return;
+	}
+
+	//options given here are for this harvest only, the configured ones stay
+	zdo_walk_options rtgOpts = rtgHarvester.options();
+	if(info[0]->IsObject()) {
+		o = info[0]->ToObject();
+		v = o->Get(Nan::New("routers").ToLocalChecked());
+		if(v->IsArray()) {
+			Local<Array> list = Local<Array>::Cast(v);
+			for(uint32_t i = 0; i < list->Length(); i++) {
+				routers.push_back(list->Get(i)->ToNumber()->Value());
+			}
+		}
+		V8_IFEXIST_TO_INT_CAST("maxInFlight",	rtgOpts.maxInFlight,	v,	o,	int);
+		V8_IFEXIST_TO_INT_CAST("timeout",		rtgOpts.timeoutMs,		v,	o,	int);
+		V8_IFEXIST_TO_INT_CAST("retries",		rtgOpts.retries,		v,	o,	int);
+	}
+
+	//by default every router the topology graph knows of
+	if(routers.empty()) {
+		const std::map<uint16_t, TopologyGraph::node> &nodes = topologyGraph.nodes();
+		routers.push_back(0);
+		for(std::map<uint16_t, TopologyGraph::node>::const_iterator it = nodes.begin(); it != nodes.end(); it++) {
+			if(it->first != 0 && it->second.type == DEVICETYPE_ROUTER) {
+				routers.push_back(it->first);
+			}
+		}
+	}
+
+	replaceWalk(&harvest, new Nan::Callback(Local<Function>::Cast(info[1])));
+	rtgHarvester.start(routers, rtgOpts, uv_now(uv_default_loop()));
+	pumpWalk(&harvest);
+}
+
+NAN_METHOD(ZNP::GetRoutes)
+{
+	uint16_t dst;
+
+	if(info.Length() > 0 && info[0]->IsNumber()) {
+		dst = info[0]->ToNumber()->Value();
+	} else {
+		Nan::ThrowTypeError("GetRoutes: Should pass atleast one argument. [dstAddr]");
+		return;
+	}
+
+	const std::map<uint16_t, RtgHarvester::route> *routes = rtgHarvester.routesTo(dst);
+	v8::Local<v8::Array> list = Nan::New<v8::Array>(routes ? routes->size() : 0);
+	if(routes) {
+		uint32_t i = 0;
+		for(std::map<uint16_t, RtgHarvester::route>::const_iterator it = routes->begin(); it != routes->end(); it++, i++) {
+			v8::Local<v8::Object> r = Nan::New<v8::Object>();
+			r->Set(Nan::New("router").ToLocalChecked(), Nan::New(it->first));
+			r->Set(Nan::New("nextHop").ToLocalChecked(), Nan::New(it->second.nextHop));
+			r->Set(Nan::New("status").ToLocalChecked(), Nan::New(it->second.status));
+			list->Set(i, r);
+		}
+	}
+	info.GetReturnValue().Set(list);
+}
+
+NAN_METHOD(ZNP::GetRouteStats)
+{
+	std::map<uint16_t, RtgHarvester::router_stats> stats;
+	uint64_t now = uv_now(uv_default_loop());
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+	rtgHarvester.stats(stats);
+	v8::Local<v8::Array> routers = Nan::New<v8::Array>(stats.size());
+	uint32_t i = 0;
+	for(std::map<uint16_t, RtgHarvester::router_stats>::iterator it = stats.begin(); it != stats.end(); it++, i++) {
+		v8::Local<v8::Object> r = Nan::New<v8::Object>();
+		r->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(it->first));
+		r->Set(Nan::New("routes").ToLocalChecked(), Nan::New(it->second.routes));
+		r->Set(Nan::New("load").ToLocalChecked(), Nan::New(it->second.load));
+		r->Set(Nan::New("churn").ToLocalChecked(), Nan::New(it->second.churn));
+		if(it->second.updated) {
+			r->Set(Nan::New("age").ToLocalChecked(), Nan::New((double)(now - it->second.updated)));
+		}
+		routers->Set(i, r);
+	}
+	obj->Set(Nan::New("harvests").ToLocalChecked(), Nan::New(rtgHarvester.harvests()));
+	obj->Set(Nan::New("routers").ToLocalChecked(), routers);
+	info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(ZNP::GetSourceRoutes)
+{
+	std::map<uint16_t, SourceRouteCache::route> routes;
+	SourceRouteCache::cache_stats stats;
+	uint64_t now = SourceRouteCache::nowMs();
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+	srcRoutes.routes(routes);
+	srcRoutes.stats(stats);
+
+	v8::Local<v8::Array> list = Nan::New<v8::Array>(routes.size());
+	uint32_t i = 0;
+	for(std::map<uint16_t, SourceRouteCache::route>::iterator it = routes.begin(); it != routes.end(); it++, i++) {
+		v8::Local<v8::Object> r = Nan::New<v8::Object>();
+		v8::Local<v8::Array> relays = Nan::New<v8::Array>(it->second.relays.size());
+		for(size_t j = 0; j < it->second.relays.size(); j++) {
+			relays->Set(j, Nan::New(it->second.relays[j]));
+		}
+		r->Set(Nan::New("dstAddr").ToLocalChecked(), Nan::New(it->first));
+		r->Set(Nan::New("relays").ToLocalChecked(), relays);
+		r->Set(Nan::New("age").ToLocalChecked(), Nan::New((double)(now - it->second.updated)));
+		list->Set(i, r);
+	}
+	obj->Set(Nan::New("routes").ToLocalChecked(), list);
+	obj->Set(Nan::New("records").ToLocalChecked(), Nan::New(stats.records));
+	obj->Set(Nan::New("hits").ToLocalChecked(), Nan::New(stats.hits));
+	obj->Set(Nan::New("misses").ToLocalChecked(), Nan::New(stats.misses));
+	obj->Set(Nan::New("invalidated").ToLocalChecked(), Nan::New(stats.invalidated));
+	obj->Set(Nan::New("expired").ToLocalChecked(), Nan::New(stats.expired));
+	info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(ZNP::InterviewDevice)
+{
+	uint16_t nwkAddr;
+
+	if(info.Length() > 0 && info[0]->IsNumber()) {
+		nwkAddr = info[0]->ToNumber()->Value();
+	} else {
+		Nan::ThrowTypeError("InterviewDevice: Should pass atleast one argument. [nwkAddr]");
+		return;
+	}
+
+	//a device already in the network, its IEEE address is asked for first if the registry does not have it
+	bool queued = interviewer.start(nwkAddr, deviceRegistry.extAddrOf(nwkAddr), uv_now(uv_default_loop()));
+	if(queued) {
+		pumpInterviews();
+	}
+	info.GetReturnValue().Set(Nan::New(queued));
+}
+
+NAN_METHOD(ZNP::GetInterviewStats)
+{
+	const interview_stats &st = interviewer.stats();
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+	obj->Set(Nan::New("inFlight").ToLocalChecked(), Nan::New((uint32_t)interviewer.inFlight()));
+	obj->Set(Nan::New("queued").ToLocalChecked(), Nan::New((uint32_t)interviewer.queued()));
+	obj->Set(Nan::New("peakQueued").ToLocalChecked(), Nan::New(st.peakQueued));
+	obj->Set(Nan::New("announces").ToLocalChecked(), Nan::New(st.announces));
+	obj->Set(Nan::New("deduped").ToLocalChecked(), Nan::New(st.deduped));
+	obj->Set(Nan::New("dropped").ToLocalChecked(), Nan::New(st.dropped));
+	obj->Set(Nan::New("admitted").ToLocalChecked(), Nan::New(st.admitted));
+	obj->Set(Nan::New("interviews").ToLocalChecked(), Nan::New(interviewer.interviews()));
+	info.GetReturnValue().Set(obj);
+}
+
+/*
+ * getDevice(nwkAddr | ieeeAddr), the registry entry or undefined. IEEE
+ * addresses are hex strings, as everything else gives them.
+ */
+NAN_METHOD(ZNP::GetDevice)
+{
+	DeviceRegistry::device d;
+	bool found;
+
+	if(info.Length() > 0 && info[0]->IsNumber()) {
+		found = deviceRegistry.findNwk(info[0]->ToNumber()->Value(), d);
+	} else if(info.Length() > 0 && info[0]->IsString()) {
+		Nan::Utf8String ext(info[0]);
+		found = deviceRegistry.find(strtoull(*ext, NULL, 16), d);
+	} else {
+		Nan::ThrowTypeError("GetDevice: Should pass atleast one argument. [nwkAddr | ieeeAddr]");
+		return;
+	}
+
+	if(found) {
+		info.GetReturnValue().Set(deviceToObject(d, uv_now(uv_default_loop())));
+	}
+}
+
+NAN_METHOD(ZNP::GetDevices)
+{
+	std::vector<DeviceRegistry::device> list;
+	uint64_t now = uv_now(uv_default_loop());
+
+	deviceRegistry.list(list);
+	v8::Local<v8::Array> arr = Nan::New<v8::Array>(list.size());
+	for(size_t i = 0; i < list.size(); i++) {
+		arr->Set(i, deviceToObject(list[i], now));
+	}
+	info.GetReturnValue().Set(arr);
+}
+
+/*
+ * locateDevice(ieeeAddr), ask the network where a device is now. Its answer
+ * updates the registry and, if it moved, goes to onDeviceAddressChange.
+ */
+NAN_METHOD(ZNP::LocateDevice)
+{
+	if(info.Length() > 0 && info[0]->IsString()) {
+		Nan::Utf8String ext(info[0]);
+		info.GetReturnValue().Set(Nan::New(wZNwkAddrReq(strtoull(*ext, NULL, 16))));
+	} else {
+		Nan::ThrowTypeError("LocateDevice: Should pass atleast one argument. [ieeeAddr]");
+	}
+}
+
+/*
+ * saveDevices(), start writing the device database now rather than at the
+ * next interval. Returns false if there is no dbPath, getDeviceDbStats()
+ * tells how the write went.
+ */
+NAN_METHOD(ZNP::SaveDevices)
+{
+	saveDevices(true);
+	info.GetReturnValue().Set(Nan::New(deviceDb.enabled()));
+}
+
+NAN_METHOD(ZNP::GetDeviceDbStats)
+{
+	const DeviceDatabase::db_stats &st = deviceDb.stats();
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+	obj->Set(Nan::New("devices").ToLocalChecked(), Nan::New(st.devices));
+	obj->Set(Nan::New("bytes").ToLocalChecked(), Nan::New(st.bytes));
+	obj->Set(Nan::New("loadMs").ToLocalChecked(), Nan::New(st.loadMs));
+	obj->Set(Nan::New("encodeMs").ToLocalChecked(), Nan::New(st.encodeMs));
+	obj->Set(Nan::New("saveMs").ToLocalChecked(), Nan::New(st.saveMs));
+	obj->Set(Nan::New("writing").ToLocalChecked(), Nan::New(deviceDb.writing()));
+	obj->Set(Nan::New("saves").ToLocalChecked(), Nan::New(st.saves));
+	obj->Set(Nan::New("failures").ToLocalChecked(), Nan::New(st.failures));
+	info.GetReturnValue().Set(obj);
+}
+
+static v8::Local<v8::Object> nvBackupToObject(const NvBackup::result &res, uint32_t durationMs)
+{
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+	v8::Local<v8::Array> skipped = Nan::New<v8::Array>(res.skipped.size());
+
+	for(size_t i = 0; i < res.skipped.size(); i++) {
+		skipped->Set(i, Nan::New(res.skipped[i]));
+	}
+	obj->Set(Nan::New("ok").ToLocalChecked(), Nan::New(res.ok));
+	obj->Set(Nan::New("items").ToLocalChecked(), Nan::New(res.items));
+	obj->Set(Nan::New("bytes").ToLocalChecked(), Nan::New(res.bytes));
+	obj->Set(Nan::New("skipped").ToLocalChecked(), skipped);
+	if(res.failedId >= 0) {
+		obj->Set(Nan::New("failedId").ToLocalChecked(), Nan::New(res.failedId));
+	}
+	if(res.err != 0) {
+		obj->Set(Nan::New("error").ToLocalChecked(), Nan::New(strerror(res.err)).ToLocalChecked());
+	}
+	obj->Set(Nan::New("durationMs").ToLocalChecked(), Nan::New(durationMs));
+	return obj;
+}
+
+/*
+ * A backupNV or restoreNV in progress. The NV items are read or written on
+ * the libuv thread pool, the ZNP is held for it and answers nothing else
+ * meanwhile, the result goes to doneCB on the loop.
+ */
+typedef struct {
+	uv_work_t work;
+	bool restore;
+	std::string path;
+	uint32_t frameCounterDelta;
+	bool up;					//the network was up to hold the ZNP
+	NvBackup::result res;
+	uint64_t start;
+	Nan::Callback *doneCB;
+} nv_job;
+
+static bool nvBusy = false;
+
+static void nvWork(uv_work_t *work)
+{
+	nv_job *j = (nv_job*)work->data;
+
+	j->up = wZHoldMessages(1);
+	if(!j->up) {
+		return;
+	}
+	if(!j->restore) {
+		nvBackup.backup(j->path, j->res);
+		wZHoldMessages(0);
+	} else if(nvBackup.restore(j->path, j->frameCounterDelta, j->res)) {
+		wZResetZnp();
+		wZHoldMessages(0);
+		wZRestartNetwork(1);
+	} else {
+		wZHoldMessages(0);
+	}
+}
+
+static void nvDone(uv_work_t *work, int status)
+{
+	Nan::HandleScope scope;
+	nv_job *j = (nv_job*)work->data;
+	v8::Local<v8::Object> obj = nvBackupToObject(j->res, (uv_hrtime() - j->start) / 1000000);
+
+	nvBusy = false;
+	if(!j->up) {
+		obj->Set(Nan::New("error").ToLocalChecked(), Nan::New("the network is not up").ToLocalChecked());
+	} else if(j->res.ok) {
+		dbg_print(PRINT_LEVEL_INFO, "%s %d NV items %s %s\n", j->restore ? "Restored" : "Backed up", j->res.items,
+				j->restore ? "from" : "to", j->path.c_str());
+	}
+
+	v8::Local<v8::Value> args[1];
+	args[0] = obj;
+	j->doneCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+	delete j->doneCB;
+	delete j;
+}
+
+static bool startNvJob(bool restore, const char *path, uint32_t frameCounterDelta, Nan::Callback *doneCB)
+{
+	if(nvBusy) {
+		delete doneCB;
+		return false;
+	}
+
+	nv_job *j = new nv_job;
+	j->restore = restore;
+	j->path = path;
+	j->frameCounterDelta = frameCounterDelta;
+	j->up = false;
+	j->res.ok = false;
+	j->res.items = 0;
+	j->res.bytes = 0;
+	j->res.failedId = -1;
+	j->res.err = 0;
+	j->start = uv_hrtime();
+	j->doneCB = doneCB;
+	j->work.data = j;
+	nvBusy = true;
+	uv_queue_work(uv_default_loop(), &j->work, nvWork, nvDone);
+	return true;
+}
+
+/*
+ * backupNV(path, cb), copy the network the ZNP runs to a file. cb gets the
+ * result once every item is read.
+ */
+NAN_METHOD(ZNP::BackupNV)
+{
+	if(info.Length() < 2 || !info[0]->IsString() || !info[1]->IsFunction()) {
+		Nan::ThrowTypeError("BackupNV: Should pass atleast two argument. [path, cb]");
+		return;
+	}
+	Nan::Utf8String path(info[0]);
+
+	if(!startNvJob(false, *path, 0, new Nan::Callback(Local<Function>::Cast(info[1])))) {
+		Nan::ThrowError("BackupNV: a backup or restore is in progress");
+	}
+}
+
+/*
+ * restoreNV(path[, frameCounterDelta], cb), write a backupNV file into the
+ * ZNP, reset it and start the network from it. cb gets the result once the
+ * items are written, onNetworkReady follows once the network is up again.
+ */
+NAN_METHOD(ZNP::RestoreNV)
+{
+	uint32_t delta = NVBACKUP_FRAME_COUNTER_DELTA;
+	int cb = info.Length() - 1;
+
+	if(info.Length() < 2 || !info[0]->IsString() || !info[cb]->IsFunction()) {
+		Nan::ThrowTypeError("RestoreNV: Should pass atleast two argument. [path, frameCounterDelta, cb]");
+		return;
+	}
+	Nan::Utf8String path(info[0]);
+	if(info.Length() > 2 && info[1]->IsNumber()) {
+		delta = info[1]->ToNumber()->Value();
+	}
+
+	if(!startNvJob(true, *path, delta, new Nan::Callback(Local<Function>::Cast(info[cb])))) {
+		Nan::ThrowError("RestoreNV: a backup or restore is in progress");
+	}
+}
+
+NAN_METHOD(ZNP::GetNVItem)
+{
+	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+	Nan::Callback *onSuccessCB, *onFailureCB;
+	int nvId;
+
+	if(info.Length() > 2) {
+		nvId = info[0]->ToNumber()->Value();
+		// printf("GOT NVID- %d\n", nvId);
+		if(info[1]->IsFunction() && info[2]->IsFunction()) {
+			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[2]));
+		} else {
+			Nan::ThrowTypeError("Passed arguments 1,2 should be a function.");
+		}
+	} else {
+		Nan::ThrowTypeError("GetNVItem: Should pass atleast three argument. [id, successcb, failcb]");
+	}
+
+	// if(!wZgetNVItem(nvId)) {
+	// 	onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+	// 	delete onSuccessCB;
+	// } else {
+	// 	onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+	// 	delete onFailureCB;
+	// }
+
+	nvRead_response* response = (nvRead_response*)wZgetNVItem(nvId);
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+	Local<Object> buf;
+	Local<Value> args[16];
+
+	if(response->len > 0) {
+		toBuffer(buf, response->data, response->len * sizeof(uint8_t));
+		args[1] = buf->ToObject();
+	}
+
+	// printf("Got respones- %d\n", response->status);
+	// printf("Got len- %d\n", response->len);
+	// printf("Got data- ");
+	// int i = 0;
+	// for(i = 0; i < response->len; i++) {
+	// 	printf("%d ", response->data[i]);
+	// }
+	// printf("\n");
+					
+	if(response->status == 0) { //success
+		obj->Set(Nan::New("status").ToLocalChecked(), Nan::New(response->status));
+		obj->Set(Nan::New("len").ToLocalChecked(), Nan::New(response->len));
+		args[0] = obj;
+		// if(response->len > 0) {
+		// 	toBuffer(buf, response->data, response->len * sizeof(uint8_t));
+		// 	args[1] = buf->ToObject();
+		// }
+		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 2, args);
+		delete onSuccessCB;
+	} else { //failure
+		obj->Set(Nan::New("status").ToLocalChecked(), Nan::New(response->status));
+		args[0] = obj;
+		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 1, args);
+		delete onFailureCB;
+	}
+	free(response);
+}
+
+NAN_METHOD(ZNP::SetNVItem)
+{
+	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+	Nan::Callback *onSuccessCB, *onFailureCB;
+	uint16 nvId;
+	uint8 len;
+	char *value;
+
+	if(info.Length() > 4) {
+		nvId = info[0]->ToNumber()->Value();
+		len = info[1]->ToNumber()->Value();
+		if(len > 0) {
+			if(info[2]->IsObject()) {
+				value = node::Buffer::Data(info[2]->ToObject());
+			} else {
+				Nan::ThrowTypeError("SetNVItem: Passed arguments 3 should be an Object.");
+			}
+		}
+		if(info[3]->IsFunction() && info[4]->IsFunction()) {
+			onSuccessCB = new Nan::Callback(Local<Function>::Cast(info[3]));
+			onFailureCB = new Nan::Callback(Local<Function>::Cast(info[4]));
+		} else {
+			Nan::ThrowTypeError("SetNVItem: Passed arguments 4,5 should be a function.");
+		}
+	} else {
+		Nan::ThrowTypeError("SetNVItem: Should pass atleast five argument. [id, len, value, successcb, failcb]");
+	}
+
+	if(!wZsetNVItem(nvId, len, (uint8_t*)value)) {
+		onSuccessCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+		delete onSuccessCB;
+	} else {
+		onFailureCB->Call(Nan::GetCurrentContext()->Global(), 0, NULL);
+		delete onFailureCB;
+	}
+}
+
+NAN_METHOD(ZNP::RemoveDevice)
+{
+
+}
+
+NAN_METHOD(ZNP::EndDeviceAnnce)
+{
+	ZNP* zb = ObjectWrap::Unwrap<ZNP>(info.This());
+	Nan::Callback *onSuccessCB, *onFailureCB;
+
+	EndDeviceAnnceIndFormat_t msg;
+
+	if(info.Length() > 2) {
+		if(info[0]->IsObject()) {
+			Local<Object> o = info[0]->ToObject();
+			Local<Value> v;
 
 			V8_IFEXIST_TO_INT_CAST("srcAddr",msg.SrcAddr,v,o,int);
 			V8_IFEXIST_TO_INT_CAST("nwkAddr",msg.NwkAddr,v,o,int);
@@ -874,6 +3379,18 @@ NAN_METHOD(ZNP::DoZCLWork)
 
 			V8_IFEXIST_TO_INT_CAST("workCode",req->workCode,v,o,ZNP::work_code);
 
+			int timeout = 0;
+			V8_IFEXIST_TO_INT_CAST("timeout",timeout,v,o,int);
+			if(timeout > 0) {
+				req->deadline = uv_now(uv_default_loop()) + timeout;
+			}
+			req->handle = nextWorkHandle++;
+			V8_IFEXIST_TO_BOOLEAN_CAST("conflate",req->conflate,v,o,bool);
+			V8_IFEXIST_TO_BOOLEAN_CAST("coalesce",req->coalesce,v,o,bool);
+			if(req->coalesce) {
+				req->notBefore = uv_now(uv_default_loop()) + coalesceWindowMs;
+			}
+
 			switch(req->workCode) {
 
 				case ZNP::ZCL_SEND_COMMAND:
@@ -896,14 +3413,44 @@ NAN_METHOD(ZNP::DoZCLWork)
 					V8_IFEXIST_TO_INT_CAST("seqNumber",				command->seqNumber,				v,	o,	int);//uint16
 					V8_IFEXIST_TO_INT_CAST("cmdFormatLen",			command->cmdFormatLen,			v,	o,	int);//uint16
 
-					if(command->cmdFormatLen > 0) {
-						if(info[1]->IsObject()) {
-							command->cmdFormat = node::Buffer::Data(info[1]->ToObject());
+					//fields: [{ dataType, value }], the command payload encoded in order
+					v = o->Get(Nan::New("fields").ToLocalChecked());
+					if(v->IsArray()) {
+						Local<Array> fields = Local<Array>::Cast(v);
+						command->cmdFormatLen = 0;
+						for(uint32_t i = 0; i < fields->Length(); i++) {
+							int n = -1;
+							if(fields->Get(i)->IsObject()) {
+								Local<Object> f = fields->Get(i)->ToObject();
+								uint8_t dataType = ZCL_DATATYPE_UNKNOWN;
+								V8_IFEXIST_TO_INT_CAST("dataType",	dataType,	v,	f,	int);//uint8
+								n = zclEncodeValue(dataType, f->Get(Nan::New("value").ToLocalChecked()),
+										&command->cmdFormat[command->cmdFormatLen], sizeof(command->cmdFormat) - command->cmdFormatLen);
+							}
+							if(n < 0) {
+								Nan::ThrowTypeError("DoZCLWork: fields should be { dataType, value } with values that fit their type and one frame.");
+								delete command;
+								delete req;
+								return;
+							}
+							command->cmdFormatLen += n;
+						}
+					} else if(command->cmdFormatLen > 0) {
+						//copied, the caller's Buffer may be reused or collected before the command goes out
+						if(command->cmdFormatLen > sizeof(command->cmdFormat)) {
+							Nan::ThrowTypeError("DoZCLWork: cmdFormatLen is larger than a command can hold.");
+							delete command;
+							delete req;
+							return;
+						}
+						if(info[1]->IsObject() && node::Buffer::Length(info[1]->ToObject()) >= command->cmdFormatLen) {
+							memcpy(command->cmdFormat, node::Buffer::Data(info[1]->ToObject()), command->cmdFormatLen);
 						} else {
-							Nan::ThrowTypeError("DoZCLWork: Passed arguments 2 should be an Object.");
+							Nan::ThrowTypeError("DoZCLWork: Passed arguments 2 should be a Buffer of cmdFormatLen bytes.");
+							delete command;
+							delete req;
+							return;
 						}
-					} else {
-						V8_IFEXIST_TO_DYN_CSTR("cmdFormat",				command->cmdFormat,				v,	o 		);//uint8*
 					}
 
 					req->command = (void*)command;
@@ -923,140 +3470,817 @@ NAN_METHOD(ZNP::DoZCLWork)
 					// printf("\tcmdFormatLen: %d\n",		command->cmdFormatLen	);
 					// printf("\tcmdFormat: %d\n",			command->cmdFormat	);
 
-					break;
-				}
+					break;
+				}
+
+				case ZNP::ZCL_READ_ATTR:
+				{
+					readAttr_t *command = new readAttr_t();
+
+					//ZCL_READ_ATTR
+					V8_IFEXIST_TO_INT_CAST("srcEp",					command->srcEp,					v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("dstAddr",				command->dstAddr,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("endPoint",				command->endPoint,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("addrMode",				command->addrMode,				v,	o,	afAddrMode_t);//enum
+					V8_IFEXIST_TO_INT_CAST("clusterId",				command->clusterId,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("msgId",					command->msgId,					v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("numAttr",				command->numAttr,				v,	o,	int);//uint8
+					// V8_IFEXIST_TO_INT_CAST("attrId",				command->attrId,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("direction",				command->direction,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("disableDefaultRsp",		command->disableDefaultRsp,		v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("seqNumber",				command->seqNumber,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("maxAge",				command->maxAge,				v,	o,	int);//uint32
+					char *aIds;
+					if(command->numAttr > 0) {
+						if(info[2]->IsObject() && node::Buffer::Length(info[2]->ToObject()) >= 2 * (size_t)command->numAttr) {
+							aIds = (char*)node::Buffer::Data(info[2]->ToObject());
+						} else {
+							Nan::ThrowTypeError("DoZCLWork: Passed arguments 2 should be a Buffer of numAttr attribute ids.");
+							delete command;
+							delete req;
+							return;
+						}
+					} else {
+						// V8_IFEXIST_TO_INT_CAST("attrId",				command->attrId,				v,	o,	int);//uint16
+						// V8_IFEXIST_TO_DYN_CSTR("cmdFormat",				command->cmdFormat,				v,	o 		);//uint8*
+					}
+
+					int i = 0;
+					// printf("\tAttrId ");
+					for(i = 0; i < command->numAttr; i++) {
+						command->attrId[i] = ((uint8_t)aIds[i*2] << 8) + (uint8_t)aIds[i*2 + 1];
+						// printf("%d ", command->attrId[i]);
+					}
+					// printf("\n");
+
+					req->command = (void*)command;
+					req->size = sizeof(readAttr_t);
+
+					// printf("\tsrcEp: %d\n", 			command->srcEp				);
+					// printf("\tdstAddr: %d\n",			command->dstAddr		);
+					// printf("\tendPoint: %d\n",			command->endPoint		);
+					// printf("\taddrMode: %d\n",			command->addrMode		);
+					// printf("\tclusterId: %d\n",			command->clusterId		);
+					// printf("\tnumAttr: %d\n",				command->numAttr		);
+					// // printf("\tattrId: %d\n",			command->attrId		);
+					// printf("\tdirection: %d\n",			command->direction		);
+					// printf("\tdisableDefaultRsp: %d\n",	command->disableDefaultRsp);
+					// printf("\tseqNumber: %d\n",			command->seqNumber	);
+
+					break;
+				}
+
+				case ZNP::ZCL_WRITE_ATTR:
+				{
+
+					writeAttr_t *command = new writeAttr_t();
+
+					//ZCL_WRITE_ATTR
+					V8_IFEXIST_TO_INT_CAST("srcEp",					command->srcEp,					v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("dstAddr",				command->dstAddr,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("endPoint",				command->endPoint,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("addrMode",				command->addrMode,				v,	o,	afAddrMode_t);//enum
+					V8_IFEXIST_TO_INT_CAST("clusterId",				command->clusterId,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("msgId",					command->msgId,					v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("numAttr",				command->numAttr,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("cmdId",					command->cmdId,					v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("attrId",				command->attrId,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("dataType",				command->dataType,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("direction",				command->direction,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("disableDefaultRsp",		command->disableDefaultRsp,		v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("seqNumber",				command->seqNumber,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("cmdFormatLen",			command->cmdFormatLen,			v,	o,	int);//uint16
+
+					//attributes: [{ attrId, dataType, value }], encoded into records here instead of by the caller
+					v = o->Get(Nan::New("attributes").ToLocalChecked());
+					if(v->IsArray()) {
+						Local<Array> attrs = Local<Array>::Cast(v);
+						command->cmdFormatLen = 0;
+						command->numAttr = 0;
+						for(uint32_t i = 0; i < attrs->Length(); i++) {
+							uint16_t at = command->cmdFormatLen;
+							int n = -1;
+							if(attrs->Get(i)->IsObject() && at + 4u <= sizeof(command->cmdFormat)) {
+								Local<Object> a = attrs->Get(i)->ToObject();
+								uint16_t attrId = 0;
+								uint8_t dataType = ZCL_DATATYPE_UNKNOWN;
+								V8_IFEXIST_TO_INT_CAST("attrId",	attrId,		v,	a,	int);//uint16
+								V8_IFEXIST_TO_INT_CAST("dataType",	dataType,	v,	a,	int);//uint8
+								//a record's length byte limits each value to 255 bytes
+								n = zclEncodeValue(dataType, a->Get(Nan::New("value").ToLocalChecked()), &command->cmdFormat[at + 4],
+										std::min(0xFF, (int)sizeof(command->cmdFormat) - at - 4));
+								command->cmdFormat[at] = attrId >> 8;
+								command->cmdFormat[at + 1] = attrId & 0xFF;
+								command->cmdFormat[at + 2] = dataType;
+								command->cmdFormat[at + 3] = n;
+							}
+							if(n < 0) {
+								Nan::ThrowTypeError("DoZCLWork: attributes should be { attrId, dataType, value } with values that fit their type.");
+								delete command;
+								delete req;
+								return;
+							}
+							command->cmdFormatLen += 4 + n;
+							command->numAttr++;
+						}
+					} else {
+						char *cmd;
+						if(command->cmdFormatLen > sizeof(command->cmdFormat)) {
+							Nan::ThrowTypeError("DoZCLWork: cmdFormatLen is larger than a write request can hold.");
+							delete command;
+							delete req;
+							return;
+						}
+						if(command->cmdFormatLen > 0) {
+							if(info[1]->IsObject() && node::Buffer::Length(info[1]->ToObject()) >= command->cmdFormatLen) {
+								cmd = node::Buffer::Data(info[1]->ToObject());
+							} else {
+								Nan::ThrowTypeError("DoZCLWork: Passed arguments 2 should be a Buffer of cmdFormatLen bytes.");
+								delete command;
+								delete req;
+								return;
+							}
+						} else {
+							// V8_IFEXIST_TO_DYN_CSTR("cmdFormat",				command->cmdFormat,				v,	o 		);//uint8*
+						}
+
+						int i = 0;
+						for(i = 0; i < command->cmdFormatLen; i++) {
+							command->cmdFormat[i] = cmd[i];
+						}
+					}
+
+					req->command = (void*)command;
+					req->size = sizeof(writeAttr_t);
+
+					//printf("\tsrcEp: %d\n", 			command->srcEp				);
+					//printf("\tdstAddr: %d\n",			command->dstAddr		);
+					//printf("\tendPoint: %d\n",			command->endPoint		);
+					//printf("\taddrMode: %d\n",			command->addrMode		);
+					//printf("\tclusterId: %d\n",			command->clusterId		);
+					//printf("\tnumAttr: %d\n",				command->numAttr		);
+					//printf("\tcmdId: %d\n",				command->cmdId		);
+					//printf("\tdataType: %d\n",				command->dataType		);
+					//printf("\tattrId: %d\n",			command->attrId		);
+					//printf("\tdirection: %d\n",			command->direction		);
+					//printf("\tdisableDefaultRsp: %d\n",	command->disableDefaultRsp);
+					//printf("\tseqNumber: %d\n",			command->seqNumber	);
+					//printf("\tcmdFormatLen: %d\n",			command->cmdFormatLen	);
+
+					break;
+				}
+
+				case ZNP::ZCL_CONFIG_REPORT:
+				case ZNP::ZCL_READ_REPORT_CFG:
+				{
+					reportCfg_t *command = new reportCfg_t();
+
+					//ZCL_CONFIG_REPORT, ZCL_READ_REPORT_CFG
+					V8_IFEXIST_TO_INT_CAST("srcEp",					command->srcEp,					v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("dstAddr",				command->dstAddr,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("endPoint",				command->endPoint,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("addrMode",				command->addrMode,				v,	o,	afAddrMode_t);//enum
+					V8_IFEXIST_TO_INT_CAST("clusterId",				command->clusterId,				v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("msgId",					command->msgId,					v,	o,	int);//uint16
+					V8_IFEXIST_TO_INT_CAST("direction",				command->direction,				v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("disableDefaultRsp",		command->disableDefaultRsp,		v,	o,	int);//uint8
+					V8_IFEXIST_TO_INT_CAST("seqNumber",				command->seqNumber,				v,	o,	int);//uint16
+
+					//attributes: [{ attrId, dataType, minInterval, maxInterval, reportableChange, direction, timeoutPeriod }]
+					v = o->Get(Nan::New("attributes").ToLocalChecked());
+					if(v->IsArray()) {
+						Local<Array> attrs = Local<Array>::Cast(v);
+						for(uint32_t i = 0; i < attrs->Length() && command->numAttr < REPORT_MAX_ATTRS; i++) {
+							if(!attrs->Get(i)->IsObject()) {
+								continue;
+							}
+							Local<Object> a = attrs->Get(i)->ToObject();
+							reportCfgRec_t *rec = &command->attrs[command->numAttr++];
+
+							rec->direction = ZCL_SEND_ATTR_REPORTS;
+							rec->maxInterval = 0xFFFF;
+							V8_IFEXIST_TO_INT_CAST("direction",		rec->direction,		v,	a,	int);//uint8
+							V8_IFEXIST_TO_INT_CAST("attrId",		rec->attrId,		v,	a,	int);//uint16
+							V8_IFEXIST_TO_INT_CAST("dataType",		rec->dataType,		v,	a,	int);//uint8
+							V8_IFEXIST_TO_INT_CAST("minInterval",	rec->minInterval,	v,	a,	int);//uint16
+							V8_IFEXIST_TO_INT_CAST("maxInterval",	rec->maxInterval,	v,	a,	int);//uint16
+							V8_IFEXIST_TO_INT_CAST("timeoutPeriod",	rec->timeoutPeriod,	v,	a,	int);//uint16
+
+							v = a->Get(Nan::New("reportableChange").ToLocalChecked());
+							if(v->IsNumber()) {
+								if(rec->dataType == ZCL_DATATYPE_SINGLE_PREC) {
+									rec->reportableChange.f = v->NumberValue();
+								} else if(rec->dataType == ZCL_DATATYPE_DOUBLE_PREC) {
+									rec->reportableChange.d = v->NumberValue();
+								} else {
+									//zcl serializes the low bytes for the attribute's size
+									rec->reportableChange.u = (uint64_t)v->ToInteger()->IntegerValue();
+								}
+							}
+						}
+					}
+
+					req->command = (void*)command;
+					req->size = sizeof(reportCfg_t);
+					break;
+				}
+
+				default:
+				{
+					dbg_print(PRINT_LEVEL_ERROR, "DoZCLWork: Unhandled Work Code: %d\n", req->workCode);
+					break;
+				}
+			}
+
+			if(info[3]->IsFunction()) {
+				req->statusCB = new Nan::Callback(Local<Function>::Cast(info[3]));
+			} else {
+				Nan::ThrowTypeError("DoZCLWork: Passed arguments 3 should be a function.");
+			}
+
+			info.GetReturnValue().Set(Nan::New(req->handle));
+			submitToZNP(req);
+
+		} else {
+			Nan::ThrowTypeError("DoZCLWork: Passed arguments 1 should be an Object.");
+		}
+	} else {
+		Nan::ThrowTypeError("DoZCLWork: Should pass atleast 3 argument. [command, data, cb]");
+	}
+}
+
+static uint32_t descUint32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+ * One doZCLWorkBatch descriptor to a request, its payload copied out of the arena.
+ * Returns NULL with err set if the descriptor does not make sense.
+ */
+static ZNP::zclTransport *workFromDescriptor(const uint8_t *d, const uint8_t *arena, size_t arenaLen, const char **err)
+{
+	uint8_t flags = d[15];
+	uint32_t payloadOff = descUint32(&d[16]);
+	uint16_t payloadLen = BUILD_UINT16(d[20], d[21]);
+	uint32_t timeout = descUint32(&d[24]);
+	const uint8_t *payload = NULL;
+	ZNP::zclTransport *req;
+
+	if(payloadLen > 0) {
+		if(payloadOff > arenaLen || payloadLen > arenaLen - payloadOff) {
+			*err = "DoZCLWorkBatch: payload runs past the end of the payload arena.";
+			return NULL;
+		}
+		payload = &arena[payloadOff];
+	}
+
+	req = new ZNP::zclTransport();
+	req->workCode = (ZNP::work_code)d[0];
+	req->handle = nextWorkHandle++;
+	if(timeout > 0) {
+		req->deadline = uv_now(uv_default_loop()) + timeout;
+	}
+	req->conflate = (flags & ZCL_WORK_FLAG_CONFLATE) != 0;
+	req->coalesce = (flags & ZCL_WORK_FLAG_COALESCE) != 0;
+	if(req->coalesce) {
+		req->notBefore = uv_now(uv_default_loop()) + coalesceWindowMs;
+	}
+
+	switch(req->workCode) {
+		case ZNP::ZCL_SEND_COMMAND:
+		{
+			ZNP::sendCmd_t *command = new ZNP::sendCmd_t();
+
+			if(payloadLen > sizeof(command->cmdFormat)) {
+				*err = "DoZCLWorkBatch: command payload is larger than a command can hold.";
+				delete command;
+				break;
+			}
+			command->srcEp = d[1];
+			command->dstAddr = BUILD_UINT16(d[2], d[3]);
+			command->endPoint = d[4];
+			command->addrMode = (afAddrMode_t)d[5];
+			command->clusterId = BUILD_UINT16(d[6], d[7]);
+			command->msgId = BUILD_UINT16(d[8], d[9]);
+			command->seqNumber = BUILD_UINT16(d[10], d[11]);
+			command->manuCode = BUILD_UINT16(d[12], d[13]);
+			command->cmdId = d[14];
+			command->specific = (flags & ZCL_WORK_FLAG_SPECIFIC) ? 1 : 0;
+			command->direction = (flags & ZCL_WORK_FLAG_SERVER_TO_CLIENT) ? 1 : 0;
+			command->disableDefaultRsp = (flags & ZCL_WORK_FLAG_NO_DEFAULT_RSP) ? 1 : 0;
+			command->cmdFormatLen = payloadLen;
+			if(payloadLen > 0) {
+				memcpy(command->cmdFormat, payload, payloadLen);
+			}
+
+			req->command = (void*)command;
+			req->size = sizeof(ZNP::sendCmd_t);
+			return req;
+		}
+
+		case ZNP::ZCL_READ_ATTR:
+		{
+			ZNP::readAttr_t *command = new ZNP::readAttr_t();
+
+			if((payloadLen & 1) || payloadLen / 2 > ZCL_WORK_MAX_ATTRS) {
+				*err = "DoZCLWorkBatch: read payload should be up to 255 attribute ids.";
+				delete command;
+				break;
+			}
+			command->srcEp = d[1];
+			command->dstAddr = BUILD_UINT16(d[2], d[3]);
+			command->endPoint = d[4];
+			command->addrMode = (afAddrMode_t)d[5];
+			command->clusterId = BUILD_UINT16(d[6], d[7]);
+			command->msgId = BUILD_UINT16(d[8], d[9]);
+			command->seqNumber = BUILD_UINT16(d[10], d[11]);
+			command->direction = (flags & ZCL_WORK_FLAG_SERVER_TO_CLIENT) ? 1 : 0;
+			command->disableDefaultRsp = (flags & ZCL_WORK_FLAG_NO_DEFAULT_RSP) ? 1 : 0;
+			command->maxAge = descUint32(&d[28]);
+			command->numAttr = payloadLen / 2;
+			for(int i = 0; i < command->numAttr; i++) {
+				command->attrId[i] = (payload[i*2] << 8) + payload[i*2 + 1];
+			}
+
+			req->command = (void*)command;
+			req->size = sizeof(ZNP::readAttr_t);
+			return req;
+		}
+
+		case ZNP::ZCL_WRITE_ATTR:
+		{
+			ZNP::writeAttr_t *command = new ZNP::writeAttr_t();
+
+			if(payloadLen > sizeof(command->cmdFormat)) {
+				*err = "DoZCLWorkBatch: write payload is larger than a write request can hold.";
+				delete command;
+				break;
+			}
+			command->srcEp = d[1];
+			command->dstAddr = BUILD_UINT16(d[2], d[3]);
+			command->endPoint = d[4];
+			command->addrMode = (afAddrMode_t)d[5];
+			command->clusterId = BUILD_UINT16(d[6], d[7]);
+			command->msgId = BUILD_UINT16(d[8], d[9]);
+			command->seqNumber = BUILD_UINT16(d[10], d[11]);
+			command->cmdId = d[14];
+			command->direction = (flags & ZCL_WORK_FLAG_SERVER_TO_CLIENT) ? 1 : 0;
+			command->disableDefaultRsp = (flags & ZCL_WORK_FLAG_NO_DEFAULT_RSP) ? 1 : 0;
+			command->cmdFormatLen = payloadLen;
+			if(payloadLen > 0) {
+				memcpy(command->cmdFormat, payload, payloadLen);
+			}
+			for(uint16_t i = 0; i + 4 <= payloadLen; i += 4 + payload[i + 3]) {
+				command->numAttr++;
+			}
+
+			req->command = (void*)command;
+			req->size = sizeof(ZNP::writeAttr_t);
+			return req;
+		}
+
+		default:
+			*err = "DoZCLWorkBatch: only ZCL_SEND_COMMAND, ZCL_READ_ATTR and ZCL_WRITE_ATTR can be batched.";
+			break;
+	}
+
+	delete req;
+	return NULL;
+}
+
+/*
+ * doZCLWorkBatch(descriptors, payloads, cb): descriptors is a Buffer or typed array of
+ * ZCL_WORK_DESC_SIZE byte descriptors, payloads the arena their payloads point into.
+ * Everything is copied before returning, so both may be reused right away.
+ * Returns the handles in descriptor order; cb gets each request's status as for doZCLWork.
+ */
+NAN_METHOD(ZNP::DoZCLWorkBatch)
+{
+	std::vector<zclTransport *> reqs;
+	const uint8_t *desc, *arena = NULL;
+	size_t descLen, arenaLen = 0;
+	const char *err = NULL;
+
+	if(info.Length() < 3 || !node::Buffer::HasInstance(info[0]) || !info[2]->IsFunction()) {
+		Nan::ThrowTypeError("DoZCLWorkBatch: Should pass 3 arguments. [descriptors, payloads, cb]");
+		return;
+	}
+	desc = (const uint8_t*)node::Buffer::Data(info[0]);
+	descLen = node::Buffer::Length(info[0]);
+	if(descLen % ZCL_WORK_DESC_SIZE) {
+		Nan::ThrowTypeError("DoZCLWorkBatch: descriptors should be a multiple of ZCL_WORK_DESC_SIZE bytes.");
+		return;
+	}
+	if(node::Buffer::HasInstance(info[1])) {
+		arena = (const uint8_t*)node::Buffer::Data(info[1]);
+		arenaLen = node::Buffer::Length(info[1]);
+	}
+
+	for(size_t off = 0; off < descLen; off += ZCL_WORK_DESC_SIZE) {
+		zclTransport *req = workFromDescriptor(&desc[off], arena, arenaLen, &err);
+		if(req == NULL) {
+			//nothing is queued unless all of it is
+			for(size_t i = 0; i < reqs.size(); i++) {
+				if(reqs[i]->workCode == ZNP::ZCL_SEND_COMMAND) {
+					delete (ZNP::sendCmd_t*)reqs[i]->command;
+				} else if(reqs[i]->workCode == ZNP::ZCL_READ_ATTR) {
+					delete (ZNP::readAttr_t*)reqs[i]->command;
+				} else {
+					delete (ZNP::writeAttr_t*)reqs[i]->command;
+				}
+				delete reqs[i];
+			}
+			Nan::ThrowTypeError(err);
+			return;
+		}
+		reqs.push_back(req);
+	}
+
+	Local<Array> handles = Nan::New<v8::Array>(reqs.size());
+	for(size_t i = 0; i < reqs.size(); i++) {
+		reqs[i]->statusCB = new Nan::Callback(Local<Function>::Cast(info[2]));
+		handles->Set(i, Nan::New(reqs[i]->handle));
+	}
+	submitBatchToZNP(reqs);
+
+	info.GetReturnValue().Set(handles);
+}
+
+NAN_METHOD(ZNP::FanOut)
+{
+	zclTransport *req;
+	FanOutJob *job;
+	Local<Object> o;
+	Local<Value> v;
+
+	if(info.Length() < 4) {
+		Nan::ThrowTypeError("FanOut: Should pass atleast 4 argument. [command, data, destinations, cb]");
+		return;
+	}
+	if(!info[0]->IsObject()) {
+		Nan::ThrowTypeError("FanOut: Passed arguments 1 should be an Object.");
+		return;
+	}
+	if(!info[2]->IsArray()) {
+		Nan::ThrowTypeError("FanOut: Passed arguments 3 should be an Array.");
+		return;
+	}
+	if(!info[3]->IsFunction()) {
+		Nan::ThrowTypeError("FanOut: Passed arguments 4 should be a function.");
+		return;
+	}
+
+	o = info[0]->ToObject();
+
+	uint8_t srcEp = 0, endPoint = 0, cmdId = 0, specific = 0, direction = 0, disableDefaultRsp = 0;
+	uint16_t clusterId = 0, msgId = 0, manuCode = 0, seqNumber = 0, cmdFormatLen = 0;
+	int timeout = 0, confirmTimeout = 5000;
+	bool byParent = false;
+
+	V8_IFEXIST_TO_INT_CAST("srcEp",					srcEp,					v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("endPoint",				endPoint,				v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("clusterId",				clusterId,				v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("msgId",					msgId,					v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("cmdId",					cmdId,					v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("specific",				specific,				v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("direction",				direction,				v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("disableDefaultRsp",		disableDefaultRsp,		v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("manuCode",				manuCode,				v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("seqNumber",				seqNumber,				v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("cmdFormatLen",			cmdFormatLen,			v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("timeout",				timeout,				v,	o,	int);
+	V8_IFEXIST_TO_INT_CAST("confirmTimeout",		confirmTimeout,			v,	o,	int);
+	V8_IFEXIST_TO_BOOLEAN_CAST("orderByParent",		byParent,				v,	o,	bool);
+
+	if(cmdFormatLen > 0 && (!info[1]->IsObject() || node::Buffer::Length(info[1]->ToObject()) < cmdFormatLen)) {
+		Nan::ThrowTypeError("FanOut: Passed arguments 2 should be a Buffer of cmdFormatLen bytes.");
+		return;
+	}
+
+	job = new FanOutJob(srcEp, clusterId, msgId);
+	job->encode(cmdId, specific, direction, disableDefaultRsp, manuCode,
+			cmdFormatLen > 0 ? (uint8_t*)node::Buffer::Data(info[1]->ToObject()) : NULL, cmdFormatLen);
+
+	//destinations are either nwk addresses or { dstAddr, endPoint } objects
+	Local<Array> dests = Local<Array>::Cast(info[2]);
+	for(uint32_t i = 0; i < dests->Length(); i++) {
+		Local<Value> d = dests->Get(i);
+		uint16_t dstAddr = 0;
+		uint8_t ep = endPoint;
+
+		if(d->IsNumber()) {
+			dstAddr = d->ToInteger()->IntegerValue();
+		} else if(d->IsObject()) {
+			Local<Object> dobj = d->ToObject();
+			V8_IFEXIST_TO_INT_CAST("dstAddr",		dstAddr,		v,	dobj,	int);
+			V8_IFEXIST_TO_INT_CAST("endPoint",		ep,				v,	dobj,	int);
+		} else {
+			continue;
+		}
+		job->addTarget(dstAddr, ep, (seqNumber + i) & 0xFF);
+	}
+
+	if(job->targets.empty()) {
+		delete job;
+		Nan::ThrowTypeError("FanOut: No valid destinations.");
+		return;
+	}
+
+	if(byParent) {
+		job->orderByParent(topologyGraph.parents());
+	}
+
+	job->created = uv_hrtime() / 1000000;
+	job->confirmTimeout = confirmTimeout;
+
+	req = new zclTransport();
+	req->workCode = ZCL_FAN_OUT;
+	req->command = (void*)job;
+	req->size = sizeof(FanOutJob);
+	req->handle = nextWorkHandle++;
+	req->statusCB = new Nan::Callback(Local<Function>::Cast(info[3]));
+	if(timeout > 0) {
+		req->deadline = uv_now(uv_default_loop()) + timeout;
+	}
+
+	info.GetReturnValue().Set(Nan::New(req->handle));
+	submitToZNP(req);
+}
+
+NAN_METHOD(ZNP::GroupWork)
+{
+	zclTransport *req;
+	groupCmd_t *command;
+	Local<Object> o;
+	Local<Value> v;
+	int timeout = 0;
+
+	if(info.Length() < 2) {
+		Nan::ThrowTypeError("GroupWork: Should pass atleast 2 argument. [command, cb]");
+		return;
+	}
+	if(!info[0]->IsObject()) {
+		Nan::ThrowTypeError("GroupWork: Passed arguments 1 should be an Object.");
+		return;
+	}
+	if(!info[1]->IsFunction()) {
+		Nan::ThrowTypeError("GroupWork: Passed arguments 2 should be a function.");
+		return;
+	}
+
+	o = info[0]->ToObject();
+	command = new groupCmd_t();
+	command->addrMode = afAddr16Bit;
+
+	V8_IFEXIST_TO_INT_CAST("op",					command->op,					v,	o,	ZNP::group_op);//enum
+	V8_IFEXIST_TO_INT_CAST("dstAddr",				command->dstAddr,				v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("endPoint",				command->endPoint,				v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("addrMode",				command->addrMode,				v,	o,	afAddrMode_t);//enum
+	V8_IFEXIST_TO_INT_CAST("msgId",					command->msgId,					v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("groupId",				command->groupId,				v,	o,	int);//uint16
+	V8_IFEXIST_TO_INT_CAST("sceneId",				command->sceneId,				v,	o,	int);//uint8
+	V8_IFEXIST_TO_INT_CAST("timeout",				timeout,						v,	o,	int);
+
+	req = new zclTransport();
+	req->workCode = ZCL_GROUP_WORK;
+	req->command = (void*)command;
+	req->size = sizeof(groupCmd_t);
+	req->handle = nextWorkHandle++;
+	req->statusCB = new Nan::Callback(Local<Function>::Cast(info[1]));
+	if(timeout > 0) {
+		req->deadline = uv_now(uv_default_loop()) + timeout;
+	}
+
+	info.GetReturnValue().Set(Nan::New(req->handle));
+	submitToZNP(req);
+}
+
+NAN_METHOD(ZNP::PlanGroupcast)
+{
+	Local<Value> v;
+	uint16_t payloadLen = 0;
+	uint8_t endPoint = 0;
+	std::vector<GroupTable::member> targets, unicasts;
+	std::vector<uint16_t> groups;
+
+	if(info.Length() < 1 || !info[0]->IsArray()) {
+		Nan::ThrowTypeError("PlanGroupcast: Passed arguments 1 should be an Array. [destinations, options]");
+		return;
+	}
+	if(info.Length() > 1 && info[1]->IsObject()) {
+		Local<Object> o = info[1]->ToObject();
+		V8_IFEXIST_TO_INT_CAST("payloadLen",		payloadLen,		v,	o,	int);
+		V8_IFEXIST_TO_INT_CAST("endPoint",			endPoint,		v,	o,	int);
+	}
 
-				case ZNP::ZCL_READ_ATTR:
-				{
-					readAttr_t *command = new readAttr_t();
+	//destinations are either nwk addresses or { dstAddr, endPoint } objects, as for fanOut
+	Local<Array> dests = Local<Array>::Cast(info[0]);
+	for(uint32_t i = 0; i < dests->Length(); i++) {
+		Local<Value> d = dests->Get(i);
+		uint16_t dstAddr = 0;
+		uint8_t ep = endPoint;
+
+		if(d->IsNumber()) {
+			dstAddr = d->ToInteger()->IntegerValue();
+		} else if(d->IsObject()) {
+			Local<Object> dobj = d->ToObject();
+			V8_IFEXIST_TO_INT_CAST("dstAddr",		dstAddr,		v,	dobj,	int);
+			V8_IFEXIST_TO_INT_CAST("endPoint",		ep,				v,	dobj,	int);
+		} else {
+			continue;
+		}
+		targets.push_back(GroupTable::member(dstAddr, ep));
+	}
 
-					//ZCL_READ_ATTR
-					V8_IFEXIST_TO_INT_CAST("srcEp",					command->srcEp,					v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("dstAddr",				command->dstAddr,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("endPoint",				command->endPoint,				v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("addrMode",				command->addrMode,				v,	o,	afAddrMode_t);//enum
-					V8_IFEXIST_TO_INT_CAST("clusterId",				command->clusterId,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("msgId",					command->msgId,					v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("numAttr",				command->numAttr,				v,	o,	int);//uint8
-					// V8_IFEXIST_TO_INT_CAST("attrId",				command->attrId,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("direction",				command->direction,				v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("disableDefaultRsp",		command->disableDefaultRsp,		v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("seqNumber",				command->seqNumber,				v,	o,	int);//uint16
-					char *aIds;
-					if(command->numAttr > 0) {
-						if(info[2]->IsObject()) {
-							aIds = (char*)node::Buffer::Data(info[2]->ToObject());
-						} else {
-							Nan::ThrowTypeError("DoZCLWork: Passed arguments 2 should be an Object.");
-						}
-					} else {
-						// V8_IFEXIST_TO_INT_CAST("attrId",				command->attrId,				v,	o,	int);//uint16
-						// V8_IFEXIST_TO_DYN_CSTR("cmdFormat",				command->cmdFormat,				v,	o 		);//uint8*
-					}
+	groupTable.plan(targets, payloadLen, groups, unicasts);
 
-					int i = 0;
-					// printf("\tAttrId ");
-					for(i = 0; i < command->numAttr; i++) {
-						command->attrId[i] = (aIds[i*2] << 8) + aIds[i*2 + 1];
-						// printf("%d ", command->attrId[i]);
-					}
-					// printf("\n");
+	v8::Local<v8::Object> plan = Nan::New<v8::Object>();
+	v8::Local<v8::Array> g = Nan::New<v8::Array>(groups.size());
+	v8::Local<v8::Array> u = Nan::New<v8::Array>(unicasts.size());
 
-					req->command = (void*)command;
-					req->size = sizeof(readAttr_t);
+	for(size_t i = 0; i < groups.size(); i++) {
+		g->Set(i, Nan::New(groups[i]));
+	}
+	for(size_t i = 0; i < unicasts.size(); i++) {
+		v8::Local<v8::Object> dest = Nan::New<v8::Object>();
+		dest->Set(Nan::New("dstAddr").ToLocalChecked(), Nan::New(unicasts[i].first));
+		dest->Set(Nan::New("endPoint").ToLocalChecked(), Nan::New(unicasts[i].second));
+		u->Set(i, dest);
+	}
+	plan->Set(Nan::New("groups").ToLocalChecked(), g);
+	plan->Set(Nan::New("unicast").ToLocalChecked(), u);
 
-					// printf("\tsrcEp: %d\n", 			command->srcEp				);
-					// printf("\tdstAddr: %d\n",			command->dstAddr		);
-					// printf("\tendPoint: %d\n",			command->endPoint		);
-					// printf("\taddrMode: %d\n",			command->addrMode		);
-					// printf("\tclusterId: %d\n",			command->clusterId		);
-					// printf("\tnumAttr: %d\n",				command->numAttr		);
-					// // printf("\tattrId: %d\n",			command->attrId		);
-					// printf("\tdirection: %d\n",			command->direction		);
-					// printf("\tdisableDefaultRsp: %d\n",	command->disableDefaultRsp);
-					// printf("\tseqNumber: %d\n",			command->seqNumber	);
+	info.GetReturnValue().Set(plan);
+}
 
-					break;
-				}
+NAN_METHOD(ZNP::ReadShadow)
+{
+	AttrShadow::entry e;
+	uint32_t maxAge = 0xFFFFFFFF;
 
-				case ZNP::ZCL_WRITE_ATTR:
-				{
+	if(info.Length() < 4) {
+		Nan::ThrowTypeError("ReadShadow: Should pass atleast 4 argument. [dstAddr, endPoint, clusterId, attrId, maxAge]");
+		return;
+	}
+	if(info.Length() > 4 && info[4]->IsNumber()) {
+		maxAge = info[4]->ToNumber()->Value();
+	}
 
-					writeAttr_t *command = new writeAttr_t();
+	if(!attrShadow.lookup(info[0]->ToNumber()->Value(), info[1]->ToNumber()->Value(),
+			info[2]->ToNumber()->Value(), info[3]->ToNumber()->Value(), maxAge, e)) {
+		info.GetReturnValue().Set(Nan::Undefined());
+		return;
+	}
 
-					//ZCL_WRITE_ATTR
-					V8_IFEXIST_TO_INT_CAST("srcEp",					command->srcEp,					v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("dstAddr",				command->dstAddr,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("endPoint",				command->endPoint,				v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("addrMode",				command->addrMode,				v,	o,	afAddrMode_t);//enum
-					V8_IFEXIST_TO_INT_CAST("clusterId",				command->clusterId,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("msgId",					command->msgId,					v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("numAttr",				command->numAttr,				v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("cmdId",					command->cmdId,					v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("attrId",				command->attrId,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("dataType",				command->dataType,				v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("direction",				command->direction,				v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("disableDefaultRsp",		command->disableDefaultRsp,		v,	o,	int);//uint8
-					V8_IFEXIST_TO_INT_CAST("seqNumber",				command->seqNumber,				v,	o,	int);//uint16
-					V8_IFEXIST_TO_INT_CAST("cmdFormatLen",			command->cmdFormatLen,			v,	o,	int);//uint16
+	v8::Local<v8::Object> attr = Nan::New<v8::Object>();
+	attr->Set(Nan::New("dataType").ToLocalChecked(), Nan::New(e.dataType));
+	attr->Set(Nan::New("value").ToLocalChecked(), zclDecodeValue(e.dataType, e.value.empty() ? NULL : &e.value[0], e.value.size()));
+	attr->Set(Nan::New("age").ToLocalChecked(), Nan::New((double)(AttrShadow::nowMs() - e.updated)));
+	attr->Set(Nan::New("source").ToLocalChecked(), Nan::New(e.from));
+	info.GetReturnValue().Set(attr);
+}
 
-					char *cmd;
-					if(command->cmdFormatLen > 0) {
-						if(info[1]->IsObject()) {
-							cmd = node::Buffer::Data(info[1]->ToObject());
-						} else {
-							Nan::ThrowTypeError("DoZCLWork: Passed arguments 2 should be an Object.");
-						}
-					} else {
-						// V8_IFEXIST_TO_DYN_CSTR("cmdFormat",				command->cmdFormat,				v,	o 		);//uint8*
-					}
+NAN_METHOD(ZNP::QueryTopology)
+{
+	uint16_t nwkAddr, p, from, to;
+	uint8_t lqi;
+	int hops;
 
-					int i = 0;
-					for(i = 0; i < command->cmdFormatLen; i++) {
-						command->cmdFormat[i] = cmd[i];
-					}
+	if(info.Length() > 0 && info[0]->IsNumber()) {
+		nwkAddr = info[0]->ToNumber()->Value();
+	} else {
+		Nan::ThrowTypeError("QueryTopology: Should pass atleast one argument. [nwkAddr]");
+		return;
+	}
 
-					req->command = (void*)command;
-					req->size = sizeof(writeAttr_t);
+	//undefined for a device the graph has never heard of
+	std::map<uint16_t, TopologyGraph::node>::const_iterator n = topologyGraph.nodes().find(nwkAddr);
+	if(n == topologyGraph.nodes().end()) {
+		return;
+	}
 
-					//printf("\tsrcEp: %d\n", 			command->srcEp				);
-					//printf("\tdstAddr: %d\n",			command->dstAddr		);
-					//printf("\tendPoint: %d\n",			command->endPoint		);
-					//printf("\taddrMode: %d\n",			command->addrMode		);
-					//printf("\tclusterId: %d\n",			command->clusterId		);
-					//printf("\tnumAttr: %d\n",				command->numAttr		);
-					//printf("\tcmdId: %d\n",				command->cmdId		);
-					//printf("\tdataType: %d\n",				command->dataType		);
-					//printf("\tattrId: %d\n",			command->attrId		);
-					//printf("\tdirection: %d\n",			command->direction		);
-					//printf("\tdisableDefaultRsp: %d\n",	command->disableDefaultRsp);
-					//printf("\tseqNumber: %d\n",			command->seqNumber	);
-					//printf("\tcmdFormatLen: %d\n",			command->cmdFormatLen	);
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+	obj->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(nwkAddr));
+	if(n->second.type != 0xFF) {
+		obj->Set(Nan::New("type").ToLocalChecked(), Nan::New(n->second.type));
+	}
+	if(n->second.depth != 0xFF) {
+		obj->Set(Nan::New("depth").ToLocalChecked(), Nan::New(n->second.depth));
+	}
+	if(topologyGraph.parent(nwkAddr, p)) {
+		obj->Set(Nan::New("parent").ToLocalChecked(), Nan::New(p));
+	}
+	hops = topologyGraph.hops(nwkAddr);
+	obj->Set(Nan::New("hops").ToLocalChecked(), Nan::New(hops));
+	if(topologyGraph.weakestLink(nwkAddr, from, to, lqi)) {
+		v8::Local<v8::Object> weakest = Nan::New<v8::Object>();
+		weakest->Set(Nan::New("from").ToLocalChecked(), Nan::New(from));
+		weakest->Set(Nan::New("to").ToLocalChecked(), Nan::New(to));
+		weakest->Set(Nan::New("lqi").ToLocalChecked(), Nan::New(lqi));
+		obj->Set(Nan::New("weakestLink").ToLocalChecked(), weakest);
+	}
+	info.GetReturnValue().Set(obj);
+}
 
-					break;
-				}
+NAN_METHOD(ZNP::GetTopology)
+{
+	const std::map<uint16_t, TopologyGraph::node> &nodes = topologyGraph.nodes();
+	const std::map<uint32_t, TopologyGraph::link> &links = topologyGraph.links();
+	const std::set<uint32_t> &routes = topologyGraph.routes();
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+	v8::Local<v8::Array> nodeList = Nan::New<v8::Array>(nodes.size());
+	v8::Local<v8::Array> linkList = Nan::New<v8::Array>(links.size());
+	v8::Local<v8::Array> routeList = Nan::New<v8::Array>(routes.size());
+	uint32_t i = 0;
+	char ext[17];
+
+	for(std::map<uint16_t, TopologyGraph::node>::const_iterator it = nodes.begin(); it != nodes.end(); it++, i++) {
+		v8::Local<v8::Object> n = Nan::New<v8::Object>();
+		n->Set(Nan::New("nwkAddr").ToLocalChecked(), Nan::New(it->first));
+		if(it->second.extAddr) {
+			snprintf(ext, sizeof(ext), "%016llx", (unsigned long long)it->second.extAddr);
+			n->Set(Nan::New("ieeeAddr").ToLocalChecked(), Nan::New(ext).ToLocalChecked());
+		}
+		if(it->second.type != 0xFF) {
+			n->Set(Nan::New("type").ToLocalChecked(), Nan::New(it->second.type));
+		}
+		if(it->second.depth != 0xFF) {
+			n->Set(Nan::New("depth").ToLocalChecked(), Nan::New(it->second.depth));
+		}
+		nodeList->Set(i, n);
+	}
 
-				default:
-				{
-					dbg_print(PRINT_LEVEL_ERROR, "DoZCLWork: Unhandled Work Code: %d\n", req->workCode);
-					break;
-				}
-			}
+	i = 0;
+	for(std::map<uint32_t, TopologyGraph::link>::const_iterator it = links.begin(); it != links.end(); it++, i++) {
+		v8::Local<v8::Object> l = Nan::New<v8::Object>();
+		l->Set(Nan::New("from").ToLocalChecked(), Nan::New(it->first >> 16));
+		l->Set(Nan::New("to").ToLocalChecked(), Nan::New(it->first & 0xFFFF));
+		l->Set(Nan::New("lqi").ToLocalChecked(), Nan::New(it->second.lqi));
+		l->Set(Nan::New("relation").ToLocalChecked(), Nan::New(it->second.relation));
+		linkList->Set(i, l);
+	}
 
-			if(info[3]->IsFunction()) {
-				req->statusCB = new Nan::Callback(Local<Function>::Cast(info[3]));
-			} else {
-				Nan::ThrowTypeError("DoZCLWork: Passed arguments 3 should be a function.");
-			}
+	i = 0;
+	for(std::set<uint32_t>::const_iterator it = routes.begin(); it != routes.end(); it++, i++) {
+		v8::Local<v8::Object> r = Nan::New<v8::Object>();
+		r->Set(Nan::New("from").ToLocalChecked(), Nan::New(*it >> 16));
+		r->Set(Nan::New("nextHop").ToLocalChecked(), Nan::New(*it & 0xFFFF));
+		routeList->Set(i, r);
+	}
 
-			submitToZNP(req);
+	obj->Set(Nan::New("nodes").ToLocalChecked(), nodeList);
+	obj->Set(Nan::New("links").ToLocalChecked(), linkList);
+	obj->Set(Nan::New("routes").ToLocalChecked(), routeList);
+	info.GetReturnValue().Set(obj);
+}
 
-		} else {
-			Nan::ThrowTypeError("DoZCLWork: Passed arguments 1 should be an Object.");
-		}
+NAN_METHOD(ZNP::GetMemStats)
+{
+	zclMemStats_t stats;
+	v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+	zcl_mem_stats(&stats);
+	obj->Set(Nan::New("allocs").ToLocalChecked(), Nan::New(stats.allocs));
+	obj->Set(Nan::New("frees").ToLocalChecked(), Nan::New(stats.frees));
+	obj->Set(Nan::New("poolHits").ToLocalChecked(), Nan::New(stats.poolHits));
+	obj->Set(Nan::New("heapAllocs").ToLocalChecked(), Nan::New(stats.heapAllocs));
+	obj->Set(Nan::New("failures").ToLocalChecked(), Nan::New(stats.failures));
+	obj->Set(Nan::New("bytesInUse").ToLocalChecked(), Nan::New(stats.bytesInUse));
+	obj->Set(Nan::New("bytesCached").ToLocalChecked(), Nan::New(stats.bytesCached));
+	info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(ZNP::CancelZCLWork)
+{
+	ZNP::zclTransport *req = NULL;
+	uint32_t handle;
+
+	if(info.Length() > 0 && info[0]->IsNumber()) {
+		handle = info[0]->ToNumber()->Value();
 	} else {
-		Nan::ThrowTypeError("DoZCLWork: Should pass atleast 3 argument. [command, data, cb]");
+		Nan::ThrowTypeError("CancelZCLWork: Should pass atleast one argument. [handle]");
+		return;
+	}
+
+	pthread_mutex_lock(&workqueue_mutex);
+	for(std::deque<ZNP::zclTransport *>::iterator it = workqueue.begin(); it != workqueue.end(); it++) {
+		if((*it)->handle == handle) {
+			req = *it;
+			workqueue.erase(it);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&workqueue_mutex);
+
+	//already sent, or never queued
+	if(req == NULL) {
+		info.GetReturnValue().Set(Nan::New(false));
+		return;
 	}
+
+	dropZCLWork(req, ZNP::ZCL_WORK_CANCELLED);
+	info.GetReturnValue().Set(Nan::New(true));
 }
 
 NAN_METHOD(ZNP::OnNetworkReady) {
@@ -1103,6 +4327,39 @@ NAN_METHOD(ZNP::OnNetworkTopology) {
 	}
 }
 
+NAN_METHOD(ZNP::OnTopologyChange) {
+	if(info.Length() > 0) {
+		if(info[0]->IsFunction()) {
+			ZNP* obj = ObjectWrap::Unwrap<ZNP>(info.This());
+			obj->onTopologyChangeCB = new Nan::Callback(info[0].As<Function>());
+		} else {
+			Nan::ThrowTypeError("OnTopologyChange: Passed in argument must be a Function.");
+		}
+	}
+}
+
+NAN_METHOD(ZNP::OnDeviceReady) {
+	if(info.Length() > 0) {
+		if(info[0]->IsFunction()) {
+			ZNP* obj = ObjectWrap::Unwrap<ZNP>(info.This());
+			obj->onDeviceReadyCB = new Nan::Callback(info[0].As<Function>());
+		} else {
+			Nan::ThrowTypeError("OnDeviceReady: Passed in argument must be a Function.");
+		}
+	}
+}
+
+NAN_METHOD(ZNP::OnDeviceAddressChange) {
+	if(info.Length() > 0) {
+		if(info[0]->IsFunction()) {
+			ZNP* obj = ObjectWrap::Unwrap<ZNP>(info.This());
+			obj->onDeviceAddressChangeCB = new Nan::Callback(info[0].As<Function>());
+		} else {
+			Nan::ThrowTypeError("OnDeviceAddressChange: Passed in argument must be a Function.");
+		}
+	}
+}
+
 NAN_METHOD(ZNP::OnDeviceJoinedNetwork) {
 	if(info.Length() > 0) {
 		if(info[0]->IsFunction()) {
@@ -1114,6 +4371,39 @@ NAN_METHOD(ZNP::OnDeviceJoinedNetwork) {
 	}
 }
 
+NAN_METHOD(ZNP::OnGroupResponse) {
+	if(info.Length() > 0) {
+		if(info[0]->IsFunction()) {
+			ZNP* obj = ObjectWrap::Unwrap<ZNP>(info.This());
+			obj->onGroupResponseCB = new Nan::Callback(info[0].As<Function>());
+		} else {
+			Nan::ThrowTypeError("OnGroupResponse: Passed in argument must be a Function.");
+		}
+	}
+}
+
+NAN_METHOD(ZNP::OnAttributeReport) {
+	if(info.Length() > 0) {
+		if(info[0]->IsFunction()) {
+			ZNP* obj = ObjectWrap::Unwrap<ZNP>(info.This());
+			obj->onAttributeReportCB = new Nan::Callback(info[0].As<Function>());
+		} else {
+			Nan::ThrowTypeError("OnAttributeReport: Passed in argument must be a Function.");
+		}
+	}
+}
+
+NAN_METHOD(ZNP::OnReportConfig) {
+	if(info.Length() > 0) {
+		if(info[0]->IsFunction()) {
+			ZNP* obj = ObjectWrap::Unwrap<ZNP>(info.This());
+			obj->onReportConfigCB = new Nan::Callback(info[0].As<Function>());
+		} else {
+			Nan::ThrowTypeError("OnReportConfig: Passed in argument must be a Function.");
+		}
+	}
+}
+
 NAN_METHOD(ZNP::OnCmdResponse) {
 	if(info.Length() > 0) {
 		if(info[0]->IsFunction()) {
@@ -1242,25 +4532,61 @@ void ZNP::main_thread(void *d)
 void zWNetworkReady(void)
 {
 	event_code code = NETWORK_UP;
-	submitToV8(code, NULL, 0, 0);
+	zMngt_startTimings_t *timings = (zMngt_startTimings_t*)malloc(sizeof(zMngt_startTimings_t));
+	wZStartTimings(timings);
+	submitToV8(code, timings, sizeof(zMngt_startTimings_t), 0);
 }
 
 void zWNetworkFailed(void)
 {
 	event_code code = NETWORK_DOWN;
-	submitToV8(code, NULL, 0, 0);
+	zMngt_startTimings_t *timings = (zMngt_startTimings_t*)malloc(sizeof(zMngt_startTimings_t));
+	wZStartTimings(timings);
+	submitToV8(code, timings, sizeof(zMngt_startTimings_t), 0);
 }
 
-void zWDataResponseConfirm(uint8_t *status) 
+void zWDataResponseConfirm(uint8_t *status, uint8_t transId)
 {
     dbg_print(PRINT_LEVEL_VERBOSE, "Got zcl response - %d\n", status);
+    txGovernor.confirm(*status);
+    srcRoutes.confirm(transId, *status);
+    if(FanOutJob::confirm(transId, *status, uv_hrtime() / 1000000)) {
+        //let the js thread report the fan-out if this was its last confirm
+        uv_async_send(&znpasync);
+    }
     submitToV8(ZCL_COMMAND_RESPONSE, (void*)status, sizeof(uint8_t), 0);
 }
 
+void zWTxFrameSent(uint8_t addrMode, uint16_t dstAddr, uint16_t len, uint8_t status)
+{
+    if(status == afStatus_SUCCESS) {
+        txGovernor.commit(addrMode, dstAddr, len);
+    } else {
+        txGovernor.confirm(status);
+    }
+}
+
+int zWSourceRoute(uint16_t dstAddr, uint16_t *relays, int max)
+{
+    return srcRoutes.lookup(dstAddr, relays, max);
+}
+
+void zWSourceRouteSent(uint8_t transId, uint16_t dstAddr, uint8_t routed)
+{
+    srcRoutes.sent(transId, dstAddr, routed);
+}
+
+void zWSourceRouteInd(SrcRtgIndFormat_t *msg)
+{
+    srcRoutes.record(msg->DstAddr, msg->RelayList, msg->RelayCount);
+}
+
 void zWInformReadAttritubeRsp(attr_response *resp)
 {
     //process simple desc here
     dbg_print(PRINT_LEVEL_VERBOSE, "Got Attritube response\n");
+    //resp is malloc'd by the gateway and freed once delivered
+    attrShadow.storeReadRsp(resp);
     submitToV8(ZCL_ATTR_RESPONSE, (void*)resp, sizeof(attr_response), 0);
 }
 
@@ -1269,25 +4595,145 @@ uint8_t zWZdoSimpleDescRspCb(epInfo_t *epInfo)
 {
     //process simple desc here
     dbg_print(PRINT_LEVEL_VERBOSE, "Device joined network\n");
-    submitToV8(DISCOVERED, (void*)epInfo, sizeof(epInfo_t), 0);
+
+    //epInfo is reused for the next response, the v8 thread gets its own copy
+    epInfo_t *copy = (epInfo_t*)malloc(sizeof(epInfo_t));
+    if(copy) {
+        memcpy(copy, epInfo, sizeof(epInfo_t));
+        submitToV8(DISCOVERED, (void*)copy, sizeof(epInfo_t), 0);
+    }
     return 0;
 }
 
 //ZCL callbacks
-uint8_t zWUpdateNetworkTopology(Node_t *nodeList)
+void zWMgmtLqiRsp(MgmtLqiRspFormat_t *rsp)
 {
     dbg_print(PRINT_LEVEL_VERBOSE, "Got network topology\n");
-    submitToV8(NETWORK_TOPOLOGY, (void*)nodeList, sizeof(Node_t), 0);
-    return 0;
+
+    //rsp lives on the znp thread stack, the crawler runs on the v8 thread
+    MgmtLqiRspFormat_t *copy = (MgmtLqiRspFormat_t*)malloc(sizeof(MgmtLqiRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(MgmtLqiRspFormat_t));
+        submitToV8(NETWORK_TOPOLOGY, (void*)copy, sizeof(MgmtLqiRspFormat_t), 0);
+    }
+}
+
+void zWMgmtRtgRsp(MgmtRtgRspFormat_t *rsp)
+{
+    //rsp lives on the znp thread stack, the harvester runs on the v8 thread
+    MgmtRtgRspFormat_t *copy = (MgmtRtgRspFormat_t*)malloc(sizeof(MgmtRtgRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(MgmtRtgRspFormat_t));
+        submitToV8(ROUTING_TABLE, (void*)copy, sizeof(MgmtRtgRspFormat_t), 0);
+    }
 }
 
 //ZCL callbacks
 uint8_t zWDeviceJoinedNetwork(EndDeviceAnnceIndFormat_t *msg)
 {
     dbg_print(PRINT_LEVEL_VERBOSE, "Got device joined network\n");
-    submitToV8(ONLINE_DEVICE, (void*)msg, sizeof(EndDeviceAnnceIndFormat_t), 0);
+
+    //msg lives on the caller's stack
+    EndDeviceAnnceIndFormat_t *copy = (EndDeviceAnnceIndFormat_t*)malloc(sizeof(EndDeviceAnnceIndFormat_t));
+    if(copy) {
+        memcpy(copy, msg, sizeof(EndDeviceAnnceIndFormat_t));
+        submitToV8(ONLINE_DEVICE, (void*)copy, sizeof(EndDeviceAnnceIndFormat_t), 0);
+    }
     return 0;
 }
+
+//ZDO callbacks, the responses live on the znp thread stack and the interviewer runs on the v8 thread
+void zWIeeeAddrRsp(IeeeAddrRspFormat_t *rsp)
+{
+    IeeeAddrRspFormat_t *copy = (IeeeAddrRspFormat_t*)malloc(sizeof(IeeeAddrRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(IeeeAddrRspFormat_t));
+        submitToV8(IEEE_ADDRESS, (void*)copy, sizeof(IeeeAddrRspFormat_t), 0);
+    }
+}
+
+void zWNwkAddrRsp(NwkAddrRspFormat_t *rsp)
+{
+    NwkAddrRspFormat_t *copy = (NwkAddrRspFormat_t*)malloc(sizeof(NwkAddrRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(NwkAddrRspFormat_t));
+        submitToV8(NWK_ADDRESS, (void*)copy, sizeof(NwkAddrRspFormat_t), 0);
+    }
+}
+
+void zWDeviceLeft(LeaveIndFormat_t *msg)
+{
+    LeaveIndFormat_t *copy = (LeaveIndFormat_t*)malloc(sizeof(LeaveIndFormat_t));
+    if(copy) {
+        memcpy(copy, msg, sizeof(LeaveIndFormat_t));
+        submitToV8(DEVICE_LEFT, (void*)copy, sizeof(LeaveIndFormat_t), 0);
+    }
+}
+
+void zWNodeDescRsp(NodeDescRspFormat_t *rsp)
+{
+    NodeDescRspFormat_t *copy = (NodeDescRspFormat_t*)malloc(sizeof(NodeDescRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(NodeDescRspFormat_t));
+        submitToV8(NODE_DESCRIPTOR, (void*)copy, sizeof(NodeDescRspFormat_t), 0);
+    }
+}
+
+void zWActiveEpRsp(ActiveEpRspFormat_t *rsp)
+{
+    ActiveEpRspFormat_t *copy = (ActiveEpRspFormat_t*)malloc(sizeof(ActiveEpRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(ActiveEpRspFormat_t));
+        submitToV8(ACTIVE_ENDPOINTS, (void*)copy, sizeof(ActiveEpRspFormat_t), 0);
+    }
+}
+
+void zWSimpleDescRsp(SimpleDescRspFormat_t *rsp)
+{
+    SimpleDescRspFormat_t *copy = (SimpleDescRspFormat_t*)malloc(sizeof(SimpleDescRspFormat_t));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(SimpleDescRspFormat_t));
+        submitToV8(SIMPLE_DESCRIPTOR, (void*)copy, sizeof(SimpleDescRspFormat_t), 0);
+    }
+}
+
+//ZCL callbacks
+void zWGroupResponse(group_response *rsp)
+{
+    dbg_print(PRINT_LEVEL_VERBOSE, "Got group response\n");
+    groupTable.update(rsp);
+
+    //rsp lives on the znp thread stack
+    group_response *copy = (group_response*)malloc(sizeof(group_response));
+    if(copy) {
+        memcpy(copy, rsp, sizeof(group_response));
+        submitToV8(GROUP_RESPONSE, (void*)copy, sizeof(group_response), 0);
+    }
+}
+
+//ZCL callbacks
+void zWWriteAttributeRsp(report_response *rsp)
+{
+    dbg_print(PRINT_LEVEL_VERBOSE, "Got write attribute response\n");
+    attrShadow.writeAck(rsp);
+}
+
+//ZCL callbacks
+void zWAttributeReport(report_response *rsp)
+{
+    dbg_print(PRINT_LEVEL_VERBOSE, "Got attribute report / reporting configuration\n");
+    if(rsp->cmdId == ZCL_CMD_REPORT) {
+        attrShadow.storeReport(rsp);
+    }
+
+    //rsp lives on the znp thread stack, only the records in use are copied
+    size_t size = offsetof(report_response, attrs) + rsp->numAttr * sizeof(report_record);
+    report_response *copy = (report_response*)malloc(size);
+    if(copy) {
+        memcpy(copy, rsp, size);
+        submitToV8(ATTRIBUTE_REPORT, (void*)copy, size, 0);
+    }
+}
 //*********************************************************************************************************************
 
 extern "C" void init(v8::Local<v8::Object> target)
@@ -1303,10 +4749,33 @@ extern "C" void init(v8::Local<v8::Object> target)
 	Nan::SetPrototypeMethod(t, "addDevice", ZNP::AddDevice);
 	Nan::SetPrototypeMethod(t, "removeDevice", ZNP::RemoveDevice);
 	Nan::SetPrototypeMethod(t, "doZCLWork", ZNP::DoZCLWork);
+	Nan::SetPrototypeMethod(t, "doZCLWorkBatch", ZNP::DoZCLWorkBatch);
+	Nan::SetPrototypeMethod(t, "cancelZCLWork", ZNP::CancelZCLWork);
+	Nan::SetPrototypeMethod(t, "fanOut", ZNP::FanOut);
+	Nan::SetPrototypeMethod(t, "groupWork", ZNP::GroupWork);
+	Nan::SetPrototypeMethod(t, "planGroupcast", ZNP::PlanGroupcast);
+	Nan::SetPrototypeMethod(t, "readShadow", ZNP::ReadShadow);
+	Nan::SetPrototypeMethod(t, "getMemStats", ZNP::GetMemStats);
 	Nan::SetPrototypeMethod(t, "endDeviceAnnce", ZNP::EndDeviceAnnce);
 	Nan::SetPrototypeMethod(t, "getNVItem", ZNP::GetNVItem);
 	Nan::SetPrototypeMethod(t, "setNVItem", ZNP::SetNVItem);
 	Nan::SetPrototypeMethod(t, "sendLqiRequest", ZNP::SendLqiRequest);
+	Nan::SetPrototypeMethod(t, "crawlTopology", ZNP::CrawlTopology);
+	Nan::SetPrototypeMethod(t, "queryTopology", ZNP::QueryTopology);
+	Nan::SetPrototypeMethod(t, "getTopology", ZNP::GetTopology);
+	Nan::SetPrototypeMethod(t, "harvestRoutes", ZNP::HarvestRoutes);
+	Nan::SetPrototypeMethod(t, "getRoutes", ZNP::GetRoutes);
+	Nan::SetPrototypeMethod(t, "getRouteStats", ZNP::GetRouteStats);
+	Nan::SetPrototypeMethod(t, "getSourceRoutes", ZNP::GetSourceRoutes);
+	Nan::SetPrototypeMethod(t, "interviewDevice", ZNP::InterviewDevice);
+	Nan::SetPrototypeMethod(t, "getInterviewStats", ZNP::GetInterviewStats);
+	Nan::SetPrototypeMethod(t, "getDevice", ZNP::GetDevice);
+	Nan::SetPrototypeMethod(t, "getDevices", ZNP::GetDevices);
+	Nan::SetPrototypeMethod(t, "locateDevice", ZNP::LocateDevice);
+	Nan::SetPrototypeMethod(t, "saveDevices", ZNP::SaveDevices);
+	Nan::SetPrototypeMethod(t, "getDeviceDbStats", ZNP::GetDeviceDbStats);
+	Nan::SetPrototypeMethod(t, "backupNV", ZNP::BackupNV);
+	Nan::SetPrototypeMethod(t, "restoreNV", ZNP::RestoreNV);
 
 
 	//Callbacks
@@ -1316,7 +4785,13 @@ extern "C" void init(v8::Local<v8::Object> target)
 	Nan::SetPrototypeMethod(t, "onCmdResponse", ZNP::OnCmdResponse);
 	Nan::SetPrototypeMethod(t, "onAttrResponse", ZNP::OnAttrResponse);
 	Nan::SetPrototypeMethod(t, "onNetworkTopology", ZNP::OnNetworkTopology);
+	Nan::SetPrototypeMethod(t, "onTopologyChange", ZNP::OnTopologyChange);
 	Nan::SetPrototypeMethod(t, "onDeviceJoinedNetwork", ZNP::OnDeviceJoinedNetwork);
+	Nan::SetPrototypeMethod(t, "onDeviceReady", ZNP::OnDeviceReady);
+	Nan::SetPrototypeMethod(t, "onDeviceAddressChange", ZNP::OnDeviceAddressChange);
+	Nan::SetPrototypeMethod(t, "onGroupResponse", ZNP::OnGroupResponse);
+	Nan::SetPrototypeMethod(t, "onAttributeReport", ZNP::OnAttributeReport);
+	Nan::SetPrototypeMethod(t, "onReportConfig", ZNP::OnReportConfig);
 
 	target->Set(Nan::New("ZNP").ToLocalChecked(), t->GetFunction());
 }
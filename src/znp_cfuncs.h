@@ -46,6 +46,50 @@ typedef struct {
 	uint8_t data[248];
 } nvRead_response;
 
+//sized so that no frame is cut short: an incoming AF frame carries at most 255 bytes
+//and the ZCL header takes at least 3, the smallest record is 3 bytes (attribute id
+//and type, or status and attribute id) and a value can fill the frame after its id and type
+#define REPORT_MAX_PAYLOAD 252
+#define REPORT_MAX_ATTRS (REPORT_MAX_PAYLOAD / 3)
+#define REPORT_MAX_VALUE (REPORT_MAX_PAYLOAD - 3)
+
+typedef struct {
+	uint16_t attrId;
+	uint8_t dataType;
+	uint8_t status;			//config responses only
+	uint8_t direction;
+	uint16_t minInterval;
+	uint16_t maxInterval;
+	uint16_t timeoutPeriod;
+	uint8_t len;			//bytes in value, the attribute value or the reportable change
+	uint8_t value[REPORT_MAX_VALUE];
+} report_record;
+
+typedef struct {
+	uint16_t srcAddr;
+	uint8_t endPoint;
+	uint16_t clusterId;
+	uint8_t transId;
+	uint8_t cmdId;			//ZCL_CMD_REPORT, ZCL_CMD_CONFIG_REPORT_RSP, ZCL_CMD_READ_REPORT_CFG_RSP or ZCL_CMD_WRITE_RSP
+	uint8_t numAttr;
+	report_record attrs[REPORT_MAX_ATTRS];
+} report_response;
+
+#define GROUP_RESPONSE_MAX_GROUPS 48
+
+typedef struct {
+	uint16_t srcAddr;
+	uint8_t endPoint;
+	uint16_t clusterId;		//Groups or Scenes
+	uint8_t cmdId;
+	uint8_t status;
+	uint8_t capacity;
+	uint16_t groupId;
+	uint8_t sceneId;
+	uint8_t grpCnt;			//Groups get membership response only
+	uint16_t grpList[GROUP_RESPONSE_MAX_GROUPS];
+} group_response;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -55,15 +99,55 @@ uint8_t wZCloseRPC(void);
 uint8_t wZEndDeviceAnnce(EndDeviceAnnceIndFormat_t *);
 void* wZgetNVItem(uint16_t id);
 uint8_t wZsetNVItem(uint16_t id, uint8_t len, uint8_t *value);
-uint8_t wZSendLqiReq(uint16_t dstAddr);
+uint8_t wZSendLqiReq(uint16_t dstAddr, uint8_t startIndex);
+uint8_t wZSendRtgReq(uint16_t dstAddr, uint8_t startIndex);
+uint8_t wZIeeeAddrReq(uint16_t nwkAddr);
+uint8_t wZNodeDescReq(uint16_t nwkAddr);
+uint8_t wZActiveEpReq(uint16_t nwkAddr);
+uint8_t wZSimpleDescReq(uint16_t nwkAddr, uint8_t endpoint);
+//NWK_addr_req for the device with this IEEE address
+uint8_t wZNwkAddrReq(uint64_t ieeeAddr);
+//Phase timings of the last network start
+void wZStartTimings(zMngt_startTimings_t *timings);
+//Whole NV items: length 0 if absent, -1 if the ZNP did not answer
+int wZNvLength(uint16_t id);
+int wZReadNVItem(uint16_t id, uint8_t *value, uint16_t maxLen);
+uint8_t wZWriteNVItem(uint16_t id, const uint8_t *value, uint16_t len);
+uint8_t wZResetZnp(void);
+//Keeps the message thread from taking SRSPs while the caller runs SREQs
+//back to back. Returns 0 if the network is not up, nothing is held then.
+uint8_t wZHoldMessages(uint8_t hold);
+//Starts the network again, restore keeps what is in NV
+void wZRestartNetwork(uint8_t restore);
+
+//Source routes, longer relay lists go by route discovery
+#define SRCRTG_MAX_RELAYS 16
+int zWSourceRoute(uint16_t dstAddr, uint16_t *relays, int max);
+void zWSourceRouteSent(uint8_t transId, uint16_t dstAddr, uint8_t routed);
+void zWSourceRouteInd(SrcRtgIndFormat_t *);
+
+//ZCL data type size and analog flag, from the addon's type table
+uint8_t zWZclTypeLength(uint8_t dataType);
+uint8_t zWZclAnalogType(uint8_t dataType);
 
 void zWNetworkReady(void);
 void zWNetworkFailed(void);
 uint8_t zWZdoSimpleDescRspCb(epInfo_t *);
-void zWDataResponseConfirm(uint8_t*);
+void zWDataResponseConfirm(uint8_t*, uint8_t transId);
+void zWTxFrameSent(uint8_t addrMode, uint16_t dstAddr, uint16_t len, uint8_t status);
 void zWInformReadAttritubeRsp(attr_response *);
-uint8_t zWUpdateNetworkTopology(Node_t *);
+void zWMgmtLqiRsp(MgmtLqiRspFormat_t *);
+void zWMgmtRtgRsp(MgmtRtgRspFormat_t *);
 uint8_t zWDeviceJoinedNetwork(EndDeviceAnnceIndFormat_t *);
+void zWIeeeAddrRsp(IeeeAddrRspFormat_t *);
+void zWNodeDescRsp(NodeDescRspFormat_t *);
+void zWActiveEpRsp(ActiveEpRspFormat_t *);
+void zWSimpleDescRsp(SimpleDescRspFormat_t *);
+void zWNwkAddrRsp(NwkAddrRspFormat_t *);
+void zWDeviceLeft(LeaveIndFormat_t *);
+void zWGroupResponse(group_response *);
+void zWAttributeReport(report_response *);
+void zWWriteAttributeRsp(report_response *);
 
 #ifdef __cplusplus
 };
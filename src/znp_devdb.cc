@@ -0,0 +1,315 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "znp_devdb.h"
+#include "znp_snapshot.h"
+
+//magic, version, flags, saved at (wall clock ms), device count
+#define DEVDB_HEADER_LEN	20
+
+//interview results are in the record
+#define DEVDB_FLAG_INTERVIEWED	0x01
+
+DeviceDatabase deviceDb;
+
+DeviceDatabase::DeviceDatabase() :
+	savedDevices(0),
+	savedAttrs(0),
+	saved(false),
+	busy(false),
+	pendingDevices(0),
+	pendingAttrs(0),
+	pendingCount(0),
+	pendingBytes(0)
+{
+	memset(&counts, 0, sizeof(counts));
+}
+
+void DeviceDatabase::setPath(const char *path)
+{
+	file = path ? path : "";
+	saved = false;
+}
+
+void DeviceDatabase::remember(const DeviceRegistry &reg, const AttrShadow &shadow)
+{
+	savedDevices = reg.changes();
+	savedAttrs = shadow.changes();
+	saved = true;
+}
+
+bool DeviceDatabase::registryDirty(const DeviceRegistry &reg) const
+{
+	return !saved || reg.changes() != savedDevices;
+}
+
+bool DeviceDatabase::shadowDirty(const AttrShadow &shadow) const
+{
+	return !saved || shadow.changes() != savedAttrs;
+}
+
+void DeviceDatabase::encode(const DeviceRegistry &reg, const DeviceRegistry::device &d, AttrShadow &shadow,
+		uint64_t now, std::vector<uint8_t> &out)
+{
+	std::vector<AttrShadow::record> attrs;
+	size_t start = out.size();
+
+	put32(out, 0);		//record length, filled in below
+	put64(out, d.extAddr);
+	put16(out, d.nwkAddr);
+	put8(out, d.capabilities);
+	put8(out, d.interviewed ? DEVDB_FLAG_INTERVIEWED : 0);
+	put8(out, d.logicalType);
+	put16(out, d.manufacturerCode);
+
+	put8(out, d.endpoints.size());
+	for(size_t i = 0; i < d.endpoints.size() && i < 0xFF; i++) {
+		const DeviceRegistry::endpoint &e = d.endpoints[i];
+		put8(out, e.endpoint);
+		put16(out, e.profileId);
+		put16(out, e.deviceId);
+		put8(out, e.version);
+		put16(out, e.inClusters.size());
+		for(size_t c = 0; c < e.inClusters.size(); c++) {
+			put16(out, e.inClusters[c]);
+		}
+		put16(out, e.outClusters.size());
+		for(size_t c = 0; c < e.outClusters.size(); c++) {
+			put16(out, e.outClusters[c]);
+		}
+	}
+
+	put16(out, d.basic.size());
+	out.insert(out.end(), d.basic.begin(), d.basic.end());
+
+	//the shadow is kept by nwk addr, its entries are the device's only while the address is
+	if(d.nwkAddr != DEVICE_NWK_UNKNOWN && reg.extAddrOf(d.nwkAddr) == d.extAddr) {
+		shadow.entriesOf(d.nwkAddr, attrs);
+	}
+	if(attrs.size() > 0xFFFF) {
+		attrs.resize(0xFFFF);
+	}
+	put16(out, attrs.size());
+	for(size_t i = 0; i < attrs.size(); i++) {
+		const AttrShadow::record &r = attrs[i];
+		uint64_t age = now > r.e.updated ? now - r.e.updated : 0;
+		put8(out, r.endPoint);
+		put16(out, r.clusterId);
+		put16(out, r.attrId);
+		put8(out, r.e.dataType);
+		put8(out, r.e.from);
+		put32(out, age > 0xFFFFFFFF ? 0xFFFFFFFF : age);
+		put16(out, r.e.value.size());
+		out.insert(out.end(), r.e.value.begin(), r.e.value.end());
+	}
+
+	uint32_t len = out.size() - start - 4;
+	for(int i = 0; i < 4; i++) {
+		out[start + i] = (len >> (8 * i)) & 0xFF;
+	}
+}
+
+bool DeviceDatabase::decode(const uint8_t *p, uint32_t len, uint64_t elapsed,
+		DeviceRegistry::device &d, std::vector<AttrShadow::record> &attrs, std::vector<uint64_t> &ages)
+{
+	reader r(p, len);
+
+	d.extAddr = r.get64();
+	d.nwkAddr = r.get16();
+	d.capabilities = r.get8();
+	d.interviewed = (r.get8() & DEVDB_FLAG_INTERVIEWED) != 0;
+	d.logicalType = r.get8();
+	d.manufacturerCode = r.get16();
+	d.lastSeen = 0;
+
+	uint8_t numEp = r.get8();
+	d.endpoints.resize(numEp);
+	for(uint8_t i = 0; i < numEp && r.ok; i++) {
+		DeviceRegistry::endpoint &e = d.endpoints[i];
+		e.endpoint = r.get8();
+		e.profileId = r.get16();
+		e.deviceId = r.get16();
+		e.version = r.get8();
+		uint16_t n = r.get16();
+		if(!r.have(n * 2)) {
+			break;
+		}
+		e.inClusters.resize(n);
+		for(uint16_t c = 0; c < n; c++) {
+			e.inClusters[c] = r.get16();
+		}
+		n = r.get16();
+		if(!r.have(n * 2)) {
+			break;
+		}
+		e.outClusters.resize(n);
+		for(uint16_t c = 0; c < n; c++) {
+			e.outClusters[c] = r.get16();
+		}
+	}
+
+	uint16_t basicLen = r.get16();
+	const uint8_t *basic = r.bytes(basicLen);
+	if(basic) {
+		d.basic.assign(basic, basic + basicLen);
+	}
+
+	uint16_t numAttrs = r.get16();
+	for(uint16_t i = 0; i < numAttrs && r.ok; i++) {
+		AttrShadow::record a;
+		a.endPoint = r.get8();
+		a.clusterId = r.get16();
+		a.attrId = r.get16();
+		a.e.dataType = r.get8();
+		a.e.from = (AttrShadow::source)r.get8();
+		uint64_t age = r.get32();
+		uint16_t vlen = r.get16();
+		const uint8_t *value = r.bytes(vlen);
+		if(!value && vlen) {
+			break;
+		}
+		a.e.value.assign(value, value + vlen);
+		attrs.push_back(a);
+		ages.push_back(age + elapsed);
+	}
+
+	return r.ok && r.pos == len && d.extAddr != 0;
+}
+
+int DeviceDatabase::load(DeviceRegistry &reg, AttrShadow &shadow)
+{
+	uint64_t start = AttrShadow::nowMs();
+	std::vector<uint8_t> buf;
+
+	if(snapshotRead(file, buf, DEVDB_HEADER_LEN) < 0) {
+		return -1;
+	}
+
+	uint32_t bodyLen = buf.size();
+	reader r(&buf[0], bodyLen);
+	if(r.get32() != DEVDB_MAGIC || r.get16() != DEVDB_VERSION) {
+		errno = EINVAL;
+		return -1;
+	}
+	r.get16();		//flags
+	uint64_t savedAt = r.get64();
+	uint32_t count = r.get32();
+	uint64_t wall = snapshotWallMs();
+	uint64_t elapsed = wall > savedAt ? wall - savedAt : 0;
+
+	//all of it is checked before any of it is used
+	std::vector<DeviceRegistry::device> devices;
+	std::vector<std::vector<AttrShadow::record> > attrs;
+	std::vector<std::vector<uint64_t> > ages;
+	devices.reserve(count < 0x10000 ? count : 0x10000);
+	for(uint32_t i = 0; i < count; i++) {
+		uint32_t len = r.get32();
+		const uint8_t *rec = r.bytes(len);
+		if(rec == NULL) {
+			errno = EINVAL;
+			return -1;
+		}
+		devices.push_back(DeviceRegistry::device());
+		attrs.push_back(std::vector<AttrShadow::record>());
+		ages.push_back(std::vector<uint64_t>());
+		if(!decode(rec, len, elapsed, devices.back(), attrs.back(), ages.back())) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	if(r.pos != bodyLen) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for(size_t i = 0; i < devices.size(); i++) {
+		reg.restore(devices[i]);
+	}
+	//values go by IEEE addr to wherever the device is once all of them are in
+	for(size_t i = 0; i < devices.size(); i++) {
+		int nwkAddr = reg.nwkAddrOf(devices[i].extAddr);
+		if(nwkAddr < 0) {
+			continue;
+		}
+		for(size_t a = 0; a < attrs[i].size(); a++) {
+			shadow.restore(nwkAddr, attrs[i][a], ages[i][a]);
+		}
+	}
+	remember(reg, shadow);
+
+	counts.devices = devices.size();
+	counts.bytes = buf.size() + 4;		//and the CRC
+	counts.loadMs = AttrShadow::nowMs() - start;
+	return devices.size();
+}
+
+int DeviceDatabase::prepare(const DeviceRegistry &reg, AttrShadow &shadow, std::vector<uint8_t> &buf)
+{
+	uint64_t start = AttrShadow::nowMs();
+	std::vector<DeviceRegistry::device> devices;
+
+	if(file.empty()) {
+		errno = ENOENT;
+		return -1;
+	}
+	if(busy) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	//change counts before the snapshot, a change made while it is written is saved next time
+	pendingDevices = reg.changes();
+	pendingAttrs = shadow.changes();
+
+	reg.list(devices);
+	buf.clear();
+	put32(buf, DEVDB_MAGIC);
+	put16(buf, DEVDB_VERSION);
+	put16(buf, 0);
+	put64(buf, snapshotWallMs());
+	put32(buf, devices.size());
+	for(size_t i = 0; i < devices.size(); i++) {
+		encode(reg, devices[i], shadow, start, buf);
+	}
+
+	pendingCount = devices.size();
+	pendingBytes = buf.size();
+	counts.encodeMs = AttrShadow::nowMs() - start;
+	busy = true;
+	return 0;
+}
+
+void DeviceDatabase::written(int err, uint32_t writeMs)
+{
+	busy = false;
+	if(err) {
+		counts.failures++;
+		return;
+	}
+
+	savedDevices = pendingDevices;
+	savedAttrs = pendingAttrs;
+	saved = true;
+	counts.devices = pendingCount;
+	counts.bytes = pendingBytes;
+	counts.saveMs = counts.encodeMs + writeMs;
+	counts.saves++;
+}
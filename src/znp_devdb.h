@@ -0,0 +1,106 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_DEVDB_H_
+#define _ZNP_DEVDB_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "znp_devices.h"
+#include "znp_shadow.h"
+
+/*
+ * Device database.
+ *
+ * The device registry, interview results included, and the last known
+ * attribute values of every device, kept on disk so a restart does not have
+ * to interview the network again. The file is one snapshot: a header, a
+ * record per device and a CRC-32 over all of it. It is written to a
+ * temporary file, synced and renamed over the old one, so a crash leaves
+ * either the old snapshot or the new one. A file that is damaged or of
+ * another version is not loaded.
+ *
+ * A snapshot is encoded on the v8 thread and written by the caller, off it,
+ * one at a time; written() takes the outcome.
+ *
+ * Only used from the v8 thread, it does not lock.
+ */
+
+#define DEVDB_MAGIC			0x445A4E5A	//"ZNZD"
+#define DEVDB_VERSION		1
+
+class DeviceDatabase {
+	public:
+		typedef struct {
+			uint32_t	devices;		//in the last snapshot loaded or saved
+			uint32_t	bytes;
+			uint32_t	loadMs;
+			uint32_t	encodeMs;		//of the last save, on the v8 thread
+			uint32_t	saveMs;			//of the last save, encode and write
+			uint32_t	saves;
+			uint32_t	failures;		//saves that could not be written
+		} db_stats;
+
+		DeviceDatabase();
+
+		void setPath(const char *path);
+		const std::string &path() const { return file; }
+		bool enabled() const { return !file.empty(); }
+
+		//Snapshot into the registry and the shadow. Returns the number of
+		//devices, or -1 with errno set: ENOENT no file yet, EINVAL damaged or
+		//of another version.
+		int load(DeviceRegistry &reg, AttrShadow &shadow);
+		//Encode a snapshot into buf for snapshotWrite(). Returns -1 with errno
+		//set if there is no path or the last snapshot is still being written.
+		int prepare(const DeviceRegistry &reg, AttrShadow &shadow, std::vector<uint8_t> &buf);
+		//The last snapshot prepared was written, err 0 or the errno it failed with
+		void written(int err, uint32_t writeMs);
+		bool writing() const { return busy; }
+
+		//Devices or interview results changed since the last load or save
+		bool registryDirty(const DeviceRegistry &reg) const;
+		//Attribute values changed since the last load or save
+		bool shadowDirty(const AttrShadow &shadow) const;
+
+		const db_stats &stats() const { return counts; }
+
+	private:
+		void encode(const DeviceRegistry &reg, const DeviceRegistry::device &d, AttrShadow &shadow,
+				uint64_t now, std::vector<uint8_t> &out);
+		bool decode(const uint8_t *p, uint32_t len, uint64_t elapsed,
+				DeviceRegistry::device &d, std::vector<AttrShadow::record> &attrs, std::vector<uint64_t> &ages);
+		void remember(const DeviceRegistry &reg, const AttrShadow &shadow);
+
+		std::string file;
+		uint32_t savedDevices;		//registry and shadow change counts at the last load or save
+		uint32_t savedAttrs;
+		bool saved;
+		bool busy;					//a prepared snapshot is being written
+		uint32_t pendingDevices;	//change counts of the snapshot being written
+		uint32_t pendingAttrs;
+		uint32_t pendingCount;
+		uint32_t pendingBytes;
+		db_stats counts;
+};
+
+extern DeviceDatabase deviceDb;
+
+#endif //_ZNP_DEVDB_H_
@@ -0,0 +1,248 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "znp_devices.h"
+
+DeviceRegistry deviceRegistry;
+
+DeviceRegistry::DeviceRegistry() :
+	changeCount(0)
+{
+	pthread_mutex_init(&lock, NULL);
+}
+
+DeviceRegistry::device &DeviceRegistry::entry(uint64_t extAddr)
+{
+	std::unordered_map<uint64_t, device>::iterator it = byExtAddr.find(extAddr);
+	if(it != byExtAddr.end()) {
+		return it->second;
+	}
+
+	device &d = byExtAddr[extAddr];
+	d.extAddr = extAddr;
+	d.nwkAddr = DEVICE_NWK_UNKNOWN;
+	d.capabilities = 0;
+	d.interviewed = false;
+	d.logicalType = 0;
+	d.manufacturerCode = 0;
+	d.lastSeen = 0;
+	return d;
+}
+
+int DeviceRegistry::move(device &d, uint16_t nwkAddr, uint64_t *displaced)
+{
+	int old = -1;
+
+	if(displaced) {
+		*displaced = 0;
+	}
+	if(d.nwkAddr == nwkAddr) {
+		return old;
+	}
+	if(d.nwkAddr != DEVICE_NWK_UNKNOWN) {
+		old = d.nwkAddr;
+		std::unordered_map<uint16_t, uint64_t>::iterator was = byNwkAddr.find(d.nwkAddr);
+		if(was != byNwkAddr.end() && was->second == d.extAddr) {
+			byNwkAddr.erase(was);
+		}
+	}
+
+	//the address was handed out again, whoever had it before is somewhere else now
+	std::unordered_map<uint16_t, uint64_t>::iterator taken = byNwkAddr.find(nwkAddr);
+	if(taken != byNwkAddr.end() && taken->second != d.extAddr) {
+		std::unordered_map<uint64_t, device>::iterator other = byExtAddr.find(taken->second);
+		if(other != byExtAddr.end()) {
+			other->second.nwkAddr = DEVICE_NWK_UNKNOWN;
+		}
+		if(displaced) {
+			*displaced = taken->second;
+		}
+	}
+
+	byNwkAddr[nwkAddr] = d.extAddr;
+	d.nwkAddr = nwkAddr;
+	changeCount++;
+	return old;
+}
+
+int DeviceRegistry::address(uint64_t extAddr, uint16_t nwkAddr, uint64_t now, uint64_t *displaced)
+{
+	int old;
+
+	pthread_mutex_lock(&lock);
+	device &d = entry(extAddr);
+	old = move(d, nwkAddr, displaced);
+	d.lastSeen = now;
+	pthread_mutex_unlock(&lock);
+	return old;
+}
+
+int DeviceRegistry::announced(uint64_t extAddr, uint16_t nwkAddr, uint8_t capabilities, uint64_t now,
+		uint64_t *displaced)
+{
+	int old;
+
+	pthread_mutex_lock(&lock);
+	device &d = entry(extAddr);
+	old = move(d, nwkAddr, displaced);
+	if(d.capabilities != capabilities) {
+		d.capabilities = capabilities;
+		changeCount++;
+	}
+	d.lastSeen = now;
+	pthread_mutex_unlock(&lock);
+	return old;
+}
+
+void DeviceRegistry::describe(uint64_t extAddr, uint8_t logicalType, uint16_t manufacturerCode,
+		const std::vector<endpoint> &endpoints, const std::vector<uint8_t> &basic)
+{
+	pthread_mutex_lock(&lock);
+	device &d = entry(extAddr);
+	d.interviewed = true;
+	d.logicalType = logicalType;
+	d.manufacturerCode = manufacturerCode;
+	d.endpoints = endpoints;
+	d.basic = basic;
+	changeCount++;
+	pthread_mutex_unlock(&lock);
+}
+
+void DeviceRegistry::restore(const device &saved)
+{
+	pthread_mutex_lock(&lock);
+	device &d = entry(saved.extAddr);
+	if(saved.nwkAddr != DEVICE_NWK_UNKNOWN) {
+		move(d, saved.nwkAddr);
+	}
+	d.capabilities = saved.capabilities;
+	d.interviewed = saved.interviewed;
+	d.logicalType = saved.logicalType;
+	d.manufacturerCode = saved.manufacturerCode;
+	d.endpoints = saved.endpoints;
+	d.basic = saved.basic;
+	changeCount++;
+	pthread_mutex_unlock(&lock);
+}
+
+bool DeviceRegistry::remove(uint64_t extAddr)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&lock);
+	std::unordered_map<uint64_t, device>::iterator it = byExtAddr.find(extAddr);
+	if(it != byExtAddr.end()) {
+		std::unordered_map<uint16_t, uint64_t>::iterator n = byNwkAddr.find(it->second.nwkAddr);
+		if(n != byNwkAddr.end() && n->second == extAddr) {
+			byNwkAddr.erase(n);
+		}
+		byExtAddr.erase(it);
+		changeCount++;
+		found = true;
+	}
+	pthread_mutex_unlock(&lock);
+	return found;
+}
+
+bool DeviceRegistry::find(uint64_t extAddr, device &out) const
+{
+	bool found = false;
+
+	pthread_mutex_lock(&lock);
+	std::unordered_map<uint64_t, device>::const_iterator it = byExtAddr.find(extAddr);
+	if(it != byExtAddr.end()) {
+		out = it->second;
+		found = true;
+	}
+	pthread_mutex_unlock(&lock);
+	return found;
+}
+
+bool DeviceRegistry::findNwk(uint16_t nwkAddr, device &out) const
+{
+	bool found = false;
+
+	pthread_mutex_lock(&lock);
+	std::unordered_map<uint16_t, uint64_t>::const_iterator n = byNwkAddr.find(nwkAddr);
+	if(n != byNwkAddr.end()) {
+		std::unordered_map<uint64_t, device>::const_iterator it = byExtAddr.find(n->second);
+		if(it != byExtAddr.end()) {
+			out = it->second;
+			found = true;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return found;
+}
+
+uint64_t DeviceRegistry::extAddrOf(uint16_t nwkAddr) const
+{
+	uint64_t extAddr = 0;
+
+	pthread_mutex_lock(&lock);
+	std::unordered_map<uint16_t, uint64_t>::const_iterator n = byNwkAddr.find(nwkAddr);
+	if(n != byNwkAddr.end()) {
+		extAddr = n->second;
+	}
+	pthread_mutex_unlock(&lock);
+	return extAddr;
+}
+
+int DeviceRegistry::nwkAddrOf(uint64_t extAddr) const
+{
+	int nwkAddr = -1;
+
+	pthread_mutex_lock(&lock);
+	std::unordered_map<uint64_t, device>::const_iterator it = byExtAddr.find(extAddr);
+	if(it != byExtAddr.end() && it->second.nwkAddr != DEVICE_NWK_UNKNOWN) {
+		nwkAddr = it->second.nwkAddr;
+	}
+	pthread_mutex_unlock(&lock);
+	return nwkAddr;
+}
+
+void DeviceRegistry::list(std::vector<device> &out) const
+{
+	pthread_mutex_lock(&lock);
+	out.clear();
+	out.reserve(byExtAddr.size());
+	for(std::unordered_map<uint64_t, device>::const_iterator it = byExtAddr.begin(); it != byExtAddr.end(); it++) {
+		out.push_back(it->second);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+uint32_t DeviceRegistry::changes() const
+{
+	uint32_t n;
+
+	pthread_mutex_lock(&lock);
+	n = changeCount;
+	pthread_mutex_unlock(&lock);
+	return n;
+}
+
+size_t DeviceRegistry::size() const
+{
+	size_t n;
+
+	pthread_mutex_lock(&lock);
+	n = byExtAddr.size();
+	pthread_mutex_unlock(&lock);
+	return n;
+}
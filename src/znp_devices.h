@@ -0,0 +1,105 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_DEVICES_H_
+#define _ZNP_DEVICES_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Device registry.
+ *
+ * Every device in the network by IEEE address, with a hash index on its
+ * current nwk address, so either address finds it in constant time however
+ * many devices there are. A device that comes back with another nwk address,
+ * seen in its announce or in a NWK_addr / IEEE_addr response, keeps its
+ * entry and only moves in the nwk index. Endpoints and cluster lists are as
+ * long as the device's descriptors say.
+ *
+ * Written from the v8 thread, readable from any thread, it locks.
+ */
+
+//nwk addr of a device whose address is not known
+#define DEVICE_NWK_UNKNOWN		0xFFFE
+
+class DeviceRegistry {
+	public:
+		typedef struct {
+			uint8_t		endpoint;
+			uint16_t	profileId;
+			uint16_t	deviceId;
+			uint8_t		version;
+			std::vector<uint16_t> inClusters;
+			std::vector<uint16_t> outClusters;
+		} endpoint;
+
+		typedef struct {
+			uint64_t	extAddr;
+			uint16_t	nwkAddr;		//DEVICE_NWK_UNKNOWN once another device took it
+			uint8_t		capabilities;	//of the last announce, 0 if never announced
+			bool		interviewed;	//the fields below are filled in
+			uint8_t		logicalType;	//DEVICETYPE_*
+			uint16_t	manufacturerCode;
+			std::vector<endpoint> endpoints;
+			std::vector<uint8_t> basic;	//Basic cluster read attributes response records
+			uint64_t	lastSeen;		//ms, loop time of the last announce or address answer
+		} device;
+
+		DeviceRegistry();
+
+		//extAddr is at nwkAddr, a device not known yet is added. Returns the
+		//nwk addr it had before if that was another one, -1 if not. displaced
+		//gets the device that had nwkAddr until now, 0 if none.
+		int address(uint64_t extAddr, uint16_t nwkAddr, uint64_t now, uint64_t *displaced = NULL);
+		//Same, from an announce
+		int announced(uint64_t extAddr, uint16_t nwkAddr, uint8_t capabilities, uint64_t now,
+				uint64_t *displaced = NULL);
+		//What an interview learnt
+		void describe(uint64_t extAddr, uint8_t logicalType, uint16_t manufacturerCode,
+				const std::vector<endpoint> &endpoints, const std::vector<uint8_t> &basic);
+		bool remove(uint64_t extAddr);
+		//A device as it was saved, it replaces what is known of it
+		void restore(const device &d);
+		//Bumped by every change, to tell whether there is anything new to save
+		uint32_t changes() const;
+
+		bool find(uint64_t extAddr, device &out) const;
+		bool findNwk(uint16_t nwkAddr, device &out) const;
+		//0 if no device is known at nwkAddr
+		uint64_t extAddrOf(uint16_t nwkAddr) const;
+		//-1 if the device or its address is not known
+		int nwkAddrOf(uint64_t extAddr) const;
+		void list(std::vector<device> &out) const;
+		size_t size() const;
+
+	private:
+		device &entry(uint64_t extAddr);
+		int move(device &d, uint16_t nwkAddr, uint64_t *displaced = NULL);
+
+		mutable pthread_mutex_t lock;
+		uint32_t changeCount;
+		std::unordered_map<uint64_t, device> byExtAddr;
+		std::unordered_map<uint16_t, uint64_t> byNwkAddr;
+};
+
+extern DeviceRegistry deviceRegistry;
+
+#endif //_ZNP_DEVICES_H_
@@ -0,0 +1,218 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <pthread.h>
+#include <list>
+
+#include "znp_fanout.h"
+#include "zcl_port.h"
+#include "zcl.h"
+#include "AF.h"
+
+/*
+ * AF transaction id -> fan-out destination waiting for its data confirm.
+ * Data confirms arrive on the znp message thread.
+ */
+typedef struct {
+	FanOutJob *job;
+	size_t index;
+} fanOutSlot;
+
+static pthread_mutex_t inflight_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<uint8_t, fanOutSlot> inflight;
+
+FanOutJob::FanOutJob(uint8_t srcEp, uint16_t clusterId, uint16_t msgId) :
+	msgId(msgId), created(0), confirmTimeout(0), confirmDeadline(0), srcEp(srcEp), clusterId(clusterId),
+	seqOffset(0), next(0), outstanding(0)
+{
+}
+
+FanOutJob::~FanOutJob()
+{
+	untrack();
+}
+
+void FanOutJob::encode(uint8_t cmdId, uint8_t specific, uint8_t direction, uint8_t disableDefaultRsp,
+		uint16_t manuCode, const uint8_t *payload, uint16_t len)
+{
+	uint8_t fc = specific ? ZCL_FRAME_TYPE_SPECIFIC_CMD : ZCL_FRAME_TYPE_PROFILE_CMD;
+	if(manuCode) fc |= 1 << 2;
+	if(direction) fc |= ZCL_FRAME_SERVER_CLIENT_DIR << 3;
+	if(disableDefaultRsp) fc |= 1 << 4;
+
+	frame.clear();
+	frame.push_back(fc);
+	if(manuCode) {
+		frame.push_back(manuCode & 0xFF);
+		frame.push_back(manuCode >> 8);
+	}
+	seqOffset = frame.size();
+	frame.push_back(0);
+	frame.push_back(cmdId);
+	frame.insert(frame.end(), payload, payload + len);
+}
+
+void FanOutJob::addTarget(uint16_t dstAddr, uint8_t endPoint, uint8_t seqNumber)
+{
+	target t;
+	t.dstAddr = dstAddr;
+	t.endPoint = endPoint;
+	t.seqNumber = seqNumber;
+	t.transId = 0;
+	t.status = 0;
+	t.sent = false;
+	t.confirmed = false;
+	t.sentAt = 0;
+	t.confirmedAt = 0;
+	targets.push_back(t);
+}
+
+void FanOutJob::orderByParent(const std::map<uint16_t, uint16_t> &parentOf)
+{
+	//parent -> destinations below it, in the order they were given
+	std::map<uint16_t, std::list<target> > branches;
+	std::list<uint16_t> order;
+
+	for(size_t i = 0; i < targets.size(); i++) {
+		std::map<uint16_t, uint16_t>::const_iterator p = parentOf.find(targets[i].dstAddr);
+		//devices we have no topology for are a branch of their own
+		uint16_t parent = (p != parentOf.end()) ? p->second : targets[i].dstAddr;
+		if(branches.find(parent) == branches.end()) {
+			order.push_back(parent);
+		}
+		branches[parent].push_back(targets[i]);
+	}
+
+	targets.clear();
+	while(!order.empty()) {
+		for(std::list<uint16_t>::iterator it = order.begin(); it != order.end(); ) {
+			std::list<target> &branch = branches[*it];
+			targets.push_back(branch.front());
+			branch.pop_front();
+			if(branch.empty()) {
+				it = order.erase(it);
+			} else {
+				it++;
+			}
+		}
+	}
+}
+
+int FanOutJob::sendNext(uint64_t now)
+{
+	target &t = targets[next];
+	afAddrType_t afDstAddr;
+	endPointDesc_t *epDesc;
+
+	afDstAddr.addr.shortAddr = t.dstAddr;
+	afDstAddr.endPoint = t.endPoint;
+	afDstAddr.addrMode = afAddr16Bit;
+
+	frame[seqOffset] = t.seqNumber;
+	t.sent = true;
+	t.sentAt = now;
+
+	epDesc = afFindEndPointDesc(srcEp);
+	if(epDesc == NULL) {
+		t.status = ZInvalidParameter;
+	} else {
+		//The confirm can be processed before AF_DataRequest returns (even on this
+		//thread, while it waits for the SRSP), so register the slot up front
+		fanOutSlot slot = { this, next };
+		t.transId = zcl_TransID;
+		pthread_mutex_lock(&inflight_mutex);
+		inflight[t.transId] = slot;
+		outstanding++;
+		pthread_mutex_unlock(&inflight_mutex);
+
+		int status = AF_DataRequest(&afDstAddr, epDesc, clusterId, frame.size(), frame.data(),
+				&zcl_TransID, 0, AF_DEFAULT_RADIUS);
+
+		//a confirm already in has the better status, the SRSP only says the ZNP took the frame
+		pthread_mutex_lock(&inflight_mutex);
+		if(!t.confirmed) {
+			t.status = status;
+		}
+		if(status != afStatus_SUCCESS) {
+			std::map<uint8_t, fanOutSlot>::iterator it = inflight.find(t.transId);
+			if(it != inflight.end() && it->second.job == this && it->second.index == next) {
+				inflight.erase(it);
+				outstanding--;
+			}
+		}
+		pthread_mutex_unlock(&inflight_mutex);
+
+		next++;
+		return status;
+	}
+
+	next++;
+	return t.status;
+}
+
+void FanOutJob::abort(int status)
+{
+	for(; next < targets.size(); next++) {
+		targets[next].status = status;
+	}
+}
+
+bool FanOutJob::complete(uint64_t now)
+{
+	bool ret;
+
+	pthread_mutex_lock(&inflight_mutex);
+	ret = done() && (outstanding == 0 || now >= confirmDeadline);
+	pthread_mutex_unlock(&inflight_mutex);
+
+	return ret;
+}
+
+bool FanOutJob::confirm(uint8_t transId, uint8_t status, uint64_t now)
+{
+	bool ret = false;
+
+	pthread_mutex_lock(&inflight_mutex);
+	std::map<uint8_t, fanOutSlot>::iterator it = inflight.find(transId);
+	if(it != inflight.end()) {
+		target &t = it->second.job->targets[it->second.index];
+		t.status = status;
+		t.confirmed = true;
+		t.confirmedAt = now;
+		it->second.job->outstanding--;
+		inflight.erase(it);
+		ret = true;
+	}
+	pthread_mutex_unlock(&inflight_mutex);
+
+	return ret;
+}
+
+void FanOutJob::untrack()
+{
+	pthread_mutex_lock(&inflight_mutex);
+	for(std::map<uint8_t, fanOutSlot>::iterator it = inflight.begin(); it != inflight.end(); ) {
+		if(it->second.job == this) {
+			inflight.erase(it++);
+		} else {
+			it++;
+		}
+	}
+	outstanding = 0;
+	pthread_mutex_unlock(&inflight_mutex);
+}
@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_FANOUT_H_
+#define _ZNP_FANOUT_H_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+/*
+ * One ZCL command sent to many devices.
+ *
+ * The ZCL frame is encoded once; each destination only gets its own
+ * sequence number stamped into the header before the AF request goes out.
+ * Data confirms are matched back to destinations by AF transaction id so
+ * the caller gets a per-destination status and latency.
+ */
+class FanOutJob {
+	public:
+		typedef struct {
+			uint16_t	dstAddr;
+			uint8_t		endPoint;
+			uint8_t		seqNumber;
+			uint8_t		transId;
+			int			status;		//SREQ status, then the data confirm status
+			bool		sent;
+			bool		confirmed;
+			uint64_t	sentAt;			//ms, same clock as confirm()'s now
+			uint64_t	confirmedAt;
+		} target;
+
+		FanOutJob(uint8_t srcEp, uint16_t clusterId, uint16_t msgId);
+		~FanOutJob();
+
+		//Build the ZCL header and payload, the sequence number is left for send()
+		void encode(uint8_t cmdId, uint8_t specific, uint8_t direction, uint8_t disableDefaultRsp,
+				uint16_t manuCode, const uint8_t *payload, uint16_t len);
+		void addTarget(uint16_t dstAddr, uint8_t endPoint, uint8_t seqNumber);
+		//Interleave destinations round-robin across parent routers, so consecutive
+		//frames go down independent branches of the mesh
+		void orderByParent(const std::map<uint16_t, uint16_t> &parentOf);
+
+		bool done() const { return next >= targets.size(); }
+		const target &peek() const { return targets[next]; }
+		uint16_t frameLen() const { return frame.size(); }
+		//Send to the next destination, returns the AF status
+		int sendNext(uint64_t now);
+		//Mark every destination not sent yet with status
+		void abort(int status);
+
+		//All sent frames confirmed, or the confirm deadline passed
+		bool complete(uint64_t now);
+		//Route a data confirm to the fan-out that sent it, from any thread
+		static bool confirm(uint8_t transId, uint8_t status, uint64_t now);
+
+		uint16_t msgId;
+		uint64_t created;
+		uint32_t confirmTimeout;	//ms to wait for confirms once the last destination is sent
+		uint64_t confirmDeadline;
+		std::vector<target> targets;
+
+	private:
+		void untrack();
+
+		uint8_t srcEp;
+		uint16_t clusterId;
+		std::vector<uint8_t> frame;
+		size_t seqOffset;
+		size_t next;
+		size_t outstanding;
+};
+
+#endif //_ZNP_FANOUT_H_
@@ -0,0 +1,185 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <algorithm>
+
+#include "znp_groups.h"
+#include "znp_txgov.h"
+#include "zcl_port.h"
+#include "zcl.h"
+#include "zcl_general.h"
+
+GroupTable groupTable;
+
+GroupTable::GroupTable()
+{
+	pthread_mutex_init(&lock, NULL);
+}
+
+GroupTable::~GroupTable()
+{
+	pthread_mutex_destroy(&lock);
+}
+
+void GroupTable::update(const group_response *rsp)
+{
+	member m(rsp->srcAddr, rsp->endPoint);
+
+	if(rsp->clusterId != ZCL_CLUSTER_ID_GEN_GROUPS) {
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	switch(rsp->cmdId) {
+		case COMMAND_GROUP_ADD_RSP:
+			if(rsp->status == ZCL_STATUS_SUCCESS || rsp->status == ZCL_STATUS_DUPLICATE_EXISTS) {
+				groups[rsp->groupId].insert(m);
+			}
+			break;
+
+		case COMMAND_GROUP_REMOVE_RSP:
+			if(rsp->status == ZCL_STATUS_SUCCESS || rsp->status == ZCL_STATUS_NOT_FOUND) {
+				groups[rsp->groupId].erase(m);
+			}
+			break;
+
+		case COMMAND_GROUP_GET_MEMBERSHIP_RSP:
+			//the answer to an empty query is the complete list, replace what we had
+			for(std::map<uint16_t, std::set<member> >::iterator it = groups.begin(); it != groups.end(); it++) {
+				it->second.erase(m);
+			}
+			for(uint8_t i = 0; i < rsp->grpCnt; i++) {
+				groups[rsp->grpList[i]].insert(m);
+			}
+			break;
+
+		default:
+			break;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void GroupTable::forget(uint16_t nwkAddr)
+{
+	pthread_mutex_lock(&lock);
+	for(std::map<uint16_t, std::set<member> >::iterator it = groups.begin(); it != groups.end(); it++) {
+		for(std::set<member>::iterator m = it->second.begin(); m != it->second.end(); ) {
+			if(m->first == nwkAddr) {
+				it->second.erase(m++);
+			} else {
+				m++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void GroupTable::move(uint16_t from, uint16_t to)
+{
+	if(from == to) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	for(std::map<uint16_t, std::set<member> >::iterator it = groups.begin(); it != groups.end(); it++) {
+		std::vector<uint8_t> endPoints;
+		for(std::set<member>::iterator m = it->second.begin(); m != it->second.end(); ) {
+			if(m->first == from) {
+				endPoints.push_back(m->second);
+				it->second.erase(m++);
+			} else if(m->first == to) {
+				it->second.erase(m++);
+			} else {
+				m++;
+			}
+		}
+		for(size_t i = 0; i < endPoints.size(); i++) {
+			it->second.insert(member(to, endPoints[i]));
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+std::vector<GroupTable::member> GroupTable::members(uint16_t groupId)
+{
+	std::vector<member> ret;
+
+	pthread_mutex_lock(&lock);
+	std::map<uint16_t, std::set<member> >::iterator it = groups.find(groupId);
+	if(it != groups.end()) {
+		ret.assign(it->second.begin(), it->second.end());
+	}
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
+
+static bool largerGroup(const std::pair<uint16_t, size_t> &a, const std::pair<uint16_t, size_t> &b)
+{
+	return a.second > b.second;
+}
+
+void GroupTable::plan(const std::vector<member> &targets, uint16_t payloadLen,
+		std::vector<uint16_t> &chosen, std::vector<member> &unicasts)
+{
+	std::set<member> remaining(targets.begin(), targets.end());
+	std::vector<std::pair<uint16_t, size_t> > candidates;
+
+	pthread_mutex_lock(&lock);
+
+	//a groupcast reaches every member, so only groups made up entirely of targets qualify
+	for(std::map<uint16_t, std::set<member> >::iterator it = groups.begin(); it != groups.end(); it++) {
+		if(it->second.empty()) {
+			continue;
+		}
+		if(std::includes(remaining.begin(), remaining.end(), it->second.begin(), it->second.end())) {
+			candidates.push_back(std::make_pair(it->first, it->second.size()));
+		}
+	}
+	std::stable_sort(candidates.begin(), candidates.end(), largerGroup);
+
+	for(size_t i = 0; i < candidates.size(); i++) {
+		std::set<member> &g = groups[candidates[i].first];
+
+		//members already covered by a bigger group would get the command twice
+		if(!std::includes(remaining.begin(), remaining.end(), g.begin(), g.end())) {
+			continue;
+		}
+
+		uint64_t unicastUs = 0;
+		for(std::set<member>::iterator m = g.begin(); m != g.end(); m++) {
+			unicastUs += txGovernor.airtimeUs(afAddr16Bit, m->first, payloadLen);
+		}
+		if(txGovernor.airtimeUs(afAddrGroup, candidates[i].first, payloadLen) >= unicastUs) {
+			continue;
+		}
+
+		chosen.push_back(candidates[i].first);
+		for(std::set<member>::iterator m = g.begin(); m != g.end(); m++) {
+			remaining.erase(*m);
+		}
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	//keep the caller's order for whatever is left
+	for(size_t i = 0; i < targets.size(); i++) {
+		if(remaining.erase(targets[i])) {
+			unicasts.push_back(targets[i]);
+		}
+	}
+}
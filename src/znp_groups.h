@@ -0,0 +1,65 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_GROUPS_H_
+#define _ZNP_GROUPS_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+
+#include "znp_cfuncs.h"
+
+/*
+ * Group membership as reported by the devices themselves.
+ *
+ * Kept in sync from the Groups cluster responses (add, remove and get
+ * membership), so a command meant for many devices can go out as one
+ * groupcast when a known group covers exactly a part of them.
+ */
+class GroupTable {
+	public:
+		typedef std::pair<uint16_t, uint8_t> member;	//nwk addr, endpoint
+
+		GroupTable();
+		~GroupTable();
+
+		//Apply a Groups cluster response, called on the znp message thread
+		void update(const group_response *rsp);
+		void forget(uint16_t nwkAddr);
+		//The device at from is at to now, whatever to was a member of is dropped
+		void move(uint16_t from, uint16_t to);
+		std::vector<member> members(uint16_t groupId);
+
+		//Split targets into groupcasts and unicasts, picking a group only when
+		//all its members are targets and one broadcast of payloadLen bytes costs
+		//less airtime than unicasting to each of them
+		void plan(const std::vector<member> &targets, uint16_t payloadLen,
+				std::vector<uint16_t> &groups, std::vector<member> &unicasts);
+
+	private:
+		pthread_mutex_t lock;
+		std::map<uint16_t, std::set<member> > groups;
+};
+
+extern GroupTable groupTable;
+
+#endif //_ZNP_GROUPS_H_
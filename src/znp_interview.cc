@@ -0,0 +1,521 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "znp_interview.h"
+#include "rpc.h"
+
+//Status of a request that ran out of retries, ZCL_WORK_EXPIRED to JS
+#define INTERVIEW_NO_ANSWER		-2
+
+#define BASIC_CLUSTER			0x0000
+
+//Basic cluster attributes read, in two frames so the strings are not cut off
+static const uint16_t basicIdentity[] = {
+	0x0004,		//manufacturer name
+	0x0005,		//model identifier
+	0x0007		//power source
+};
+static const uint16_t basicVersions[] = {
+	0x0000,		//ZCL version
+	0x0001,		//application version
+	0x0002,		//stack version
+	0x0003,		//hardware version
+	0x0006,		//date code
+	0x4000		//software build id
+};
+
+static const struct {
+	const uint16_t *attrIds;
+	uint8_t numAttr;
+} basicParts[] = {
+	{ basicIdentity, sizeof(basicIdentity) / sizeof(basicIdentity[0]) },
+	{ basicVersions, sizeof(basicVersions) / sizeof(basicVersions[0]) }
+};
+
+Interviewer interviewer;
+
+Interviewer::Interviewer() :
+	transIds(NULL),
+	nextTransId(0),
+	completed(0),
+	nextAdmit(0),
+	overflow(false)
+{
+	opts.maxInFlight = 4;
+	opts.timeoutMs = 6000;
+	opts.retries = 2;
+	opts.backoffMs = 1000;
+	opts.backoffMaxMs = 8000;
+	opts.maxQueued = 64;
+	opts.admitIntervalMs = 200;
+	memset(&counts, 0, sizeof(counts));
+}
+
+void Interviewer::configure(const interview_options &o)
+{
+	opts = o;
+	if(opts.maxInFlight == 0) {
+		opts.maxInFlight = 1;
+	}
+	if(opts.maxQueued == 0) {
+		opts.maxQueued = 1;
+	}
+}
+
+bool Interviewer::start(uint16_t nwkAddr, uint64_t extAddr, uint64_t now, bool known)
+{
+	counts.announces++;
+
+	std::map<uint16_t, job>::iterator it = jobs.find(nwkAddr);
+	if(it != jobs.end()) {
+		if(extAddr && !it->second.info.extAddr) {
+			it->second.info.extAddr = extAddr;
+		}
+		counts.deduped++;
+		return false;
+	}
+	//a device that rejoined while it was waiting keeps its place under its new address
+	for(size_t i = 0; i < pending.size(); i++) {
+		if(pending[i].info.nwkAddr == nwkAddr || (extAddr && pending[i].info.extAddr == extAddr)) {
+			pending[i].info.nwkAddr = nwkAddr;
+			if(extAddr) {
+				pending[i].info.extAddr = extAddr;
+			}
+			counts.deduped++;
+			return false;
+		}
+	}
+	//one that rejoined while it was interviewed is asked again at the new address
+	if(extAddr) {
+		for(it = jobs.begin(); it != jobs.end(); it++) {
+			if(it->second.info.extAddr == extAddr) {
+				jobs.erase(it);
+				known = true;
+				break;
+			}
+		}
+	}
+
+	size_t at = pending.size();
+	if(known) {
+		for(at = 0; at < pending.size() && pending[at].known; at++);
+	}
+	if(pending.size() >= opts.maxQueued) {
+		//a known device takes the place of the last new one
+		if(!known || pending.back().known) {
+			counts.dropped++;
+			overflow = true;
+			return false;
+		}
+		pending.pop_back();
+		counts.dropped++;
+		overflow = true;
+	}
+
+	job j;
+	j.info.nwkAddr = nwkAddr;
+	j.info.extAddr = extAddr;
+	j.info.status = 0;
+	j.info.failedStep = STEP_DONE;
+	j.info.haveNodeDesc = false;
+	j.info.logicalType = 0;
+	j.info.macCapabilities = 0;
+	j.info.manufacturerCode = 0;
+	j.info.maxBufferSize = 0;
+	j.info.maxTransferSize = 0;
+	j.info.serverMask = 0;
+	j.info.basicEndpoint = 0;
+	j.info.requests = 0;
+	j.info.retries = 0;
+	j.info.durationMs = 0;
+	j.known = known;
+	j.step = STEP_IEEE_ADDR;
+	j.started = now;
+	j.refused = INTERVIEW_NO_ANSWER;
+	pending.insert(pending.begin() + at, j);
+	if(pending.size() > counts.peakQueued) {
+		counts.peakQueued = pending.size();
+	}
+	return true;
+}
+
+bool Interviewer::interviewing(uint16_t nwkAddr) const
+{
+	if(jobs.count(nwkAddr)) {
+		return true;
+	}
+	for(size_t i = 0; i < pending.size(); i++) {
+		if(pending[i].info.nwkAddr == nwkAddr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Interviewer::cancel(uint16_t nwkAddr)
+{
+	if(jobs.erase(nwkAddr)) {
+		return true;
+	}
+	for(std::deque<job>::iterator it = pending.begin(); it != pending.end(); it++) {
+		if(it->info.nwkAddr == nwkAddr) {
+			pending.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t Interviewer::backoff(uint8_t tries) const
+{
+	uint64_t b = opts.backoffMs;
+
+	for(uint8_t i = 1; i < tries && b < opts.backoffMaxMs; i++) {
+		b *= 2;
+	}
+	return b > opts.backoffMaxMs ? opts.backoffMaxMs : b;
+}
+
+void Interviewer::enter(job &j, uint8_t step, uint64_t now)
+{
+	j.asks.clear();
+	j.refused = INTERVIEW_NO_ANSWER;
+
+	//steps with nothing to ask are skipped
+	for(; step < STEP_DONE; step++) {
+		pending_ask a = { 0, 0, 0, 0, false, now };
+
+		if(step == STEP_IEEE_ADDR) {
+			if(j.info.extAddr) {
+				continue;
+			}
+			j.asks.push_back(a);
+		} else if(step == STEP_SIMPLE_DESC) {
+			for(size_t i = 0; i < j.info.endpoints.size(); i++) {
+				a.endpoint = j.info.endpoints[i].endpoint;
+				j.asks.push_back(a);
+			}
+		} else if(step == STEP_BASIC) {
+			for(size_t i = 0; i < j.info.endpoints.size() && !j.info.basicEndpoint; i++) {
+				const std::vector<uint16_t> &in = j.info.endpoints[i].inClusters;
+				for(size_t c = 0; c < in.size(); c++) {
+					if(in[c] == BASIC_CLUSTER) {
+						j.info.basicEndpoint = j.info.endpoints[i].endpoint;
+						break;
+					}
+				}
+			}
+			a.endpoint = j.info.basicEndpoint;
+			for(uint8_t p = 0; a.endpoint && p < sizeof(basicParts) / sizeof(basicParts[0]); p++) {
+				a.part = p;
+				a.transId = 0;
+				j.asks.push_back(a);
+			}
+		} else {
+			j.asks.push_back(a);
+		}
+
+		if(!j.asks.empty()) {
+			break;
+		}
+	}
+
+	j.step = step;
+	if(step == STEP_DONE) {
+		done(j, now);
+	}
+}
+
+void Interviewer::fail(job &j, int status, uint64_t now)
+{
+	j.info.status = status;
+	j.info.failedStep = j.step;
+	j.asks.clear();
+	j.step = STEP_DONE;
+	done(j, now);
+}
+
+void Interviewer::done(job &j, uint64_t now)
+{
+	j.info.durationMs = now - j.started;
+	completed++;
+	finished.push_back(j.info);
+}
+
+bool Interviewer::ieeeAddr(const IeeeAddrRspFormat_t *rsp, uint64_t now)
+{
+	std::map<uint16_t, job>::iterator it = jobs.find(rsp->NwkAddr);
+	if(it == jobs.end() || it->second.step != STEP_IEEE_ADDR) {
+		return false;
+	}
+	job &j = it->second;
+
+	if(rsp->Status != MT_RPC_SUCCESS) {
+		fail(j, rsp->Status, now);
+	} else {
+		j.info.extAddr = rsp->IEEEAddr;
+		enter(j, STEP_NODE_DESC, now);
+	}
+
+	if(j.step == STEP_DONE) {
+		jobs.erase(it);
+	}
+	return true;
+}
+
+bool Interviewer::nodeDesc(const NodeDescRspFormat_t *rsp, uint64_t now)
+{
+	std::map<uint16_t, job>::iterator it = jobs.find(rsp->NwkAddr);
+	if(it == jobs.end() || it->second.step != STEP_NODE_DESC) {
+		return false;
+	}
+	job &j = it->second;
+
+	if(rsp->Status != MT_RPC_SUCCESS) {
+		fail(j, rsp->Status, now);
+	} else {
+		j.info.haveNodeDesc = true;
+		j.info.logicalType = rsp->LoTy_ComDescAv_UsrDesAv & 0x07;
+		j.info.macCapabilities = rsp->MACCapFlg;
+		j.info.manufacturerCode = rsp->ManufacturerCode;
+		j.info.maxBufferSize = rsp->MaxBufferSize;
+		j.info.maxTransferSize = rsp->MaxTransferSize;
+		j.info.serverMask = rsp->ServerMask;
+		enter(j, STEP_ACTIVE_EP, now);
+	}
+
+	if(j.step == STEP_DONE) {
+		jobs.erase(it);
+	}
+	return true;
+}
+
+bool Interviewer::activeEp(const ActiveEpRspFormat_t *rsp, uint64_t now)
+{
+	std::map<uint16_t, job>::iterator it = jobs.find(rsp->NwkAddr);
+	if(it == jobs.end() || it->second.step != STEP_ACTIVE_EP) {
+		return false;
+	}
+	job &j = it->second;
+
+	if(rsp->Status != MT_RPC_SUCCESS) {
+		fail(j, rsp->Status, now);
+	} else {
+		j.info.endpoints.clear();
+		for(uint8_t i = 0; i < rsp->ActiveEPCount && i < sizeof(rsp->ActiveEPList); i++) {
+			endpoint_info e;
+			e.endpoint = rsp->ActiveEPList[i];
+			e.profileId = 0;
+			e.deviceId = 0;
+			e.version = 0;
+			j.info.endpoints.push_back(e);
+		}
+		enter(j, STEP_SIMPLE_DESC, now);
+	}
+
+	if(j.step == STEP_DONE) {
+		jobs.erase(it);
+	}
+	return true;
+}
+
+bool Interviewer::simpleDesc(const SimpleDescRspFormat_t *rsp, uint64_t now)
+{
+	std::map<uint16_t, job>::iterator it = jobs.find(rsp->NwkAddr);
+	if(it == jobs.end() || it->second.step != STEP_SIMPLE_DESC) {
+		return false;
+	}
+	job &j = it->second;
+
+	//a refusal does not say which endpoint it was for, the endpoints that are
+	//waiting for an answer are asked again after the backoff, as on a timeout
+	if(rsp->Status != MT_RPC_SUCCESS) {
+		j.refused = rsp->Status;
+		for(size_t a = 0; a < j.asks.size(); a++) {
+			if(j.asks[a].asked) {
+				j.asks[a].deadline = now;
+			}
+		}
+		return true;
+	}
+
+	size_t a = 0;
+	while(a < j.asks.size() && j.asks[a].endpoint != rsp->Endpoint) {
+		a++;
+	}
+	if(a == j.asks.size()) {
+		//answered already
+		return true;
+	}
+	j.asks.erase(j.asks.begin() + a);
+
+	for(size_t i = 0; i < j.info.endpoints.size(); i++) {
+		endpoint_info &e = j.info.endpoints[i];
+		if(e.endpoint != rsp->Endpoint) {
+			continue;
+		}
+		uint8_t numIn = rsp->NumInClusters, numOut = rsp->NumOutClusters;
+		if(numIn > sizeof(rsp->InClusterList) / sizeof(rsp->InClusterList[0])) {
+			numIn = sizeof(rsp->InClusterList) / sizeof(rsp->InClusterList[0]);
+		}
+		if(numOut > sizeof(rsp->OutClusterList) / sizeof(rsp->OutClusterList[0])) {
+			numOut = sizeof(rsp->OutClusterList) / sizeof(rsp->OutClusterList[0]);
+		}
+		e.profileId = rsp->ProfileID;
+		e.deviceId = rsp->DeviceID;
+		e.version = rsp->DeviceVersion;
+		e.inClusters.assign(rsp->InClusterList, rsp->InClusterList + numIn);
+		e.outClusters.assign(rsp->OutClusterList, rsp->OutClusterList + numOut);
+		break;
+	}
+
+	if(j.asks.empty()) {
+		enter(j, STEP_BASIC, now);
+		if(j.step == STEP_DONE) {
+			jobs.erase(it);
+		}
+	}
+	return true;
+}
+
+bool Interviewer::basicRsp(uint16_t srcAddr, uint8_t transId, uint16_t clusterId,
+		const uint8_t *payload, uint16_t len, uint64_t now)
+{
+	std::map<uint16_t, job>::iterator it = jobs.find(srcAddr);
+	if(it == jobs.end() || it->second.step != STEP_BASIC || clusterId != BASIC_CLUSTER) {
+		return false;
+	}
+	job &j = it->second;
+
+	size_t a = 0;
+	while(a < j.asks.size() && (j.asks[a].tries == 0 || j.asks[a].transId != transId)) {
+		a++;
+	}
+	if(a == j.asks.size()) {
+		return false;
+	}
+	j.asks.erase(j.asks.begin() + a);
+
+	//records of attributes the device does not have are kept, their status says so
+	j.info.basic.insert(j.info.basic.end(), payload, payload + len);
+
+	if(j.asks.empty()) {
+		enter(j, STEP_DONE, now);
+		jobs.erase(it);
+	}
+	return true;
+}
+
+void Interviewer::ask(job &j, uint64_t now, std::vector<request> &send)
+{
+	for(size_t i = 0; i < j.asks.size(); i++) {
+		pending_ask &a = j.asks[i];
+
+		if(now < a.deadline) {
+			continue;
+		}
+		if(a.asked) {
+			if(a.tries > opts.retries) {
+				fail(j, j.refused, now);
+				return;
+			}
+			//give a device that is busy, or asleep, some time before asking again
+			a.asked = false;
+			a.deadline = now + backoff(a.tries);
+			if(now < a.deadline) {
+				continue;
+			}
+		}
+		if(a.tries > 0) {
+			j.info.retries++;
+		} else if(j.step == STEP_BASIC) {
+			//retries keep the id, a late answer to the first ask is as good
+			a.transId = transIds ? transIds(j.info.nwkAddr) : nextTransId++;
+		}
+		a.tries++;
+		a.asked = true;
+		a.deadline = now + opts.timeoutMs;
+		j.info.requests++;
+
+		request r;
+		r.step = j.step;
+		r.nwkAddr = j.info.nwkAddr;
+		r.endpoint = a.endpoint;
+		r.transId = a.transId;
+		r.attrIds = NULL;
+		r.numAttr = 0;
+		if(j.step == STEP_BASIC) {
+			r.attrIds = basicParts[a.part].attrIds;
+			r.numAttr = basicParts[a.part].numAttr;
+		}
+		send.push_back(r);
+	}
+}
+
+void Interviewer::due(uint64_t now, std::vector<request> &send)
+{
+	for(std::map<uint16_t, job>::iterator it = jobs.begin(); it != jobs.end(); ) {
+		ask(it->second, now, send);
+		if(it->second.step == STEP_DONE) {
+			jobs.erase(it++);
+		} else {
+			it++;
+		}
+	}
+
+	while(!pending.empty() && jobs.size() < opts.maxInFlight && now >= nextAdmit) {
+		job &j = jobs[pending.front().info.nwkAddr];
+		j = pending.front();
+		pending.pop_front();
+
+		j.started = now;
+		enter(j, STEP_IEEE_ADDR, now);
+		ask(j, now, send);
+		nextAdmit = now + opts.admitIntervalMs;
+		counts.admitted++;
+	}
+}
+
+uint64_t Interviewer::nextDeadline() const
+{
+	uint64_t wake = 0;
+
+	for(std::map<uint16_t, job>::const_iterator it = jobs.begin(); it != jobs.end(); it++) {
+		for(size_t i = 0; i < it->second.asks.size(); i++) {
+			if(wake == 0 || it->second.asks[i].deadline < wake) {
+				wake = it->second.asks[i].deadline;
+			}
+		}
+	}
+	if(!pending.empty() && jobs.size() < opts.maxInFlight) {
+		uint64_t admit = nextAdmit ? nextAdmit : 1;
+		if(wake == 0 || admit < wake) {
+			wake = admit;
+		}
+	}
+	return wake;
+}
+
+void Interviewer::ready(std::vector<device> &out)
+{
+	out.insert(out.end(), finished.begin(), finished.end());
+	finished.clear();
+}
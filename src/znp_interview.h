@@ -0,0 +1,195 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_INTERVIEW_H_
+#define _ZNP_INTERVIEW_H_
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "mtZdo.h"
+#include "znp_devices.h"
+
+/*
+ * Device interviewer.
+ *
+ * Takes a device that joined from its announce to everything needed to use
+ * it: IEEE address (if the announce did not carry one), node descriptor,
+ * active endpoints, the simple descriptor of each endpoint and the Basic
+ * cluster identity attributes. The simple descriptors of a device are asked
+ * for together, no more than maxInFlight devices are interviewed at a time
+ * and a request that gets no answer is asked again after a backoff that
+ * doubles with each try. Whatever the outcome, a device is reported once,
+ * with all it answered.
+ *
+ * When a network is opened to many devices at once their announces queue up
+ * for a slot: one interview starts every admitIntervalMs, a device that
+ * announces again while it is waiting is not queued twice, devices known
+ * from before go ahead of new ones and no more than maxQueued wait. An
+ * announce that does not fit is dropped, the owner queues the device again
+ * once the queue has drained.
+ *
+ * Only used from the v8 thread, it does not lock.
+ */
+
+typedef struct {
+	uint8_t		maxInFlight;		//devices interviewed at once
+	uint32_t	timeoutMs;			//wait for an answer before asking again
+	uint8_t		retries;			//asks per request after the first
+	uint32_t	backoffMs;			//before the first retry, doubled for each one after
+	uint32_t	backoffMaxMs;
+	uint16_t	maxQueued;			//devices waiting for a slot, more are dropped
+	uint32_t	admitIntervalMs;	//between two interviews starting
+} interview_options;
+
+typedef struct {
+	uint32_t	announces;			//start() calls
+	uint32_t	deduped;			//devices already queued or being interviewed
+	uint32_t	dropped;			//the queue was full
+	uint32_t	admitted;			//interviews started
+	uint16_t	peakQueued;
+} interview_stats;
+
+class Interviewer {
+	public:
+		enum step {
+			STEP_IEEE_ADDR,
+			STEP_NODE_DESC,
+			STEP_ACTIVE_EP,
+			STEP_SIMPLE_DESC,
+			STEP_BASIC,
+			STEP_DONE
+		};
+
+		typedef struct {
+			uint8_t		step;
+			uint16_t	nwkAddr;
+			uint8_t		endpoint;		//STEP_SIMPLE_DESC, STEP_BASIC
+			uint8_t		transId;		//STEP_BASIC
+			const uint16_t *attrIds;	//STEP_BASIC
+			uint8_t		numAttr;
+		} request;
+
+		typedef DeviceRegistry::endpoint endpoint_info;
+
+		typedef struct {
+			uint16_t	nwkAddr;
+			uint64_t	extAddr;		//0 if never learnt
+			int			status;			//0, the ZDP or ZCL status the device refused with, or -2 if it never answered
+			uint8_t		failedStep;		//STEP_DONE if every step completed
+			bool		haveNodeDesc;
+			uint8_t		logicalType;	//DEVICETYPE_*
+			uint8_t		macCapabilities;
+			uint16_t	manufacturerCode;
+			uint8_t		maxBufferSize;
+			uint16_t	maxTransferSize;
+			uint16_t	serverMask;
+			std::vector<endpoint_info> endpoints;
+			uint8_t		basicEndpoint;	//0 if no endpoint has a Basic server
+			std::vector<uint8_t> basic;	//read attributes response records
+			uint32_t	requests;		//retries included
+			uint32_t	retries;
+			uint32_t	durationMs;
+		} device;
+
+		Interviewer();
+
+		void configure(const interview_options &opts);
+		const interview_options &options() const { return opts; }
+		//Where Basic reads get their ZCL transaction id, so they share the ids
+		//of the other reads to the device. Without one they count up on their own.
+		void setTransIds(uint8_t (*alloc)(uint16_t nwkAddr)) { transIds = alloc; }
+
+		//Queue a device, a known one ahead of the new ones. Returns false if
+		//it is queued or being interviewed already, or the queue is full.
+		bool start(uint16_t nwkAddr, uint64_t extAddr, uint64_t now, bool known = false);
+		bool interviewing(uint16_t nwkAddr) const;
+		//Drop the interview of nwkAddr, queued or in progress, without reporting
+		//it. Returns false if there was none.
+		bool cancel(uint16_t nwkAddr);
+		size_t queued() const { return pending.size(); }
+		size_t inFlight() const { return jobs.size(); }
+		//An announce was dropped since the last refilled()
+		bool overflowed() const { return overflow; }
+		void refilled() { overflow = false; }
+
+		//ZDO responses and Basic cluster read responses. Each returns false if
+		//no interview asked for it.
+		bool ieeeAddr(const IeeeAddrRspFormat_t *rsp, uint64_t now);
+		bool nodeDesc(const NodeDescRspFormat_t *rsp, uint64_t now);
+		bool activeEp(const ActiveEpRspFormat_t *rsp, uint64_t now);
+		bool simpleDesc(const SimpleDescRspFormat_t *rsp, uint64_t now);
+		bool basicRsp(uint16_t srcAddr, uint8_t transId, uint16_t clusterId,
+				const uint8_t *payload, uint16_t len, uint64_t now);
+
+		//Requests to send now: first asks, retries whose backoff is over and
+		//the first request of queued devices up to maxInFlight. A request the
+		//ZNP does not accept needs nothing, it is asked again once it times out.
+		void due(uint64_t now, std::vector<request> &send);
+		//Loop time of the earliest timeout, retry or interview start, 0 if
+		//nothing is waiting
+		uint64_t nextDeadline() const;
+		//Devices whose interview ended since the last call
+		void ready(std::vector<device> &out);
+
+		uint32_t interviews() const { return completed; }
+		const interview_stats &stats() const { return counts; }
+
+	private:
+		typedef struct {
+			uint8_t		endpoint;
+			uint8_t		part;			//STEP_BASIC, which attribute list
+			uint8_t		transId;		//STEP_BASIC, picked when first asked
+			uint8_t		tries;
+			bool		asked;
+			uint64_t	deadline;		//asked: answer timeout, otherwise: not before
+		} pending_ask;
+
+		typedef struct {
+			device		info;
+			bool		known;			//queued ahead of new devices
+			uint8_t		step;
+			uint64_t	started;
+			int			refused;		//status of the step's last refusal, INTERVIEW_NO_ANSWER if none
+			std::vector<pending_ask> asks;	//of the current step, answered ones removed
+		} job;
+
+		void enter(job &j, uint8_t step, uint64_t now);
+		void ask(job &j, uint64_t now, std::vector<request> &send);
+		void fail(job &j, int status, uint64_t now);
+		void done(job &j, uint64_t now);
+		uint32_t backoff(uint8_t tries) const;
+
+		interview_options opts;
+		uint8_t (*transIds)(uint16_t nwkAddr);
+		uint8_t nextTransId;
+		uint32_t completed;
+		uint64_t nextAdmit;
+		bool overflow;
+		interview_stats counts;
+
+		std::map<uint16_t, job> jobs;		//devices being interviewed, keyed by nwk addr
+		std::deque<job> pending;
+		std::vector<device> finished;
+};
+
+extern Interviewer interviewer;
+
+#endif //_ZNP_INTERVIEW_H_
@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "znp_lqi.h"
+#include "rpc.h"
+#include "mtSys.h"
+
+LqiCrawler lqiCrawler;
+
+void LqiCrawler::start(uint16_t root, const zdo_walk_options &o, uint64_t now)
+{
+	begin(o, now);
+	reading.clear();
+	finished.clear();
+	queue(root);
+}
+
+void LqiCrawler::discover(const neighbor &n)
+{
+	//end devices have no table, previous children may have left for another parent
+	if(n.type != DEVICETYPE_ROUTER && n.type != DEVICETYPE_COORDINATOR) {
+		return;
+	}
+	if(n.relation == LQI_RELATION_PREV_CHILD) {
+		return;
+	}
+	queue(n.nwkAddr);
+}
+
+bool LqiCrawler::response(const MgmtLqiRspFormat_t *rsp, uint64_t now)
+{
+	return page(rsp->SrcAddr, rsp->Status, rsp->StartIndex, rsp->NeighborLqiListCount,
+			rsp->NeighborTableEntries, rsp, now);
+}
+
+void LqiCrawler::decode(uint16_t nwkAddr, const void *p)
+{
+	const MgmtLqiRspFormat_t *rsp = (const MgmtLqiRspFormat_t*)p;
+	std::vector<neighbor> &table = reading[nwkAddr];
+
+	for(uint8_t i = 0; i < rsp->NeighborLqiListCount && i < sizeof(rsp->NeighborLqiList) / sizeof(rsp->NeighborLqiList[0]); i++) {
+		const NeighborLqiListItemFormat_t *item = &rsp->NeighborLqiList[i];
+		neighbor n;
+
+		n.extAddr = item->ExtendedAddress;
+		n.extPanId = item->ExtendedPanID;
+		n.nwkAddr = item->NetworkAddress;
+		n.type = item->DevTyp_RxOnWhenIdle_Relat & 0x03;
+		n.rxOnWhenIdle = (item->DevTyp_RxOnWhenIdle_Relat >> 2) & 0x03;
+		n.relation = (item->DevTyp_RxOnWhenIdle_Relat >> 4) & 0x07;
+		n.permitJoin = item->PermitJoining & 0x03;
+		n.depth = item->Depth;
+		n.lqi = item->LQI;
+		table.push_back(n);
+		discover(n);
+	}
+}
+
+uint32_t LqiCrawler::complete(uint16_t nwkAddr, uint8_t status, uint64_t now)
+{
+	router r;
+
+	r.nwkAddr = nwkAddr;
+	r.status = status;
+	r.neighbors.swap(reading[nwkAddr]);
+	reading.erase(nwkAddr);
+	finished.push_back(r);
+	return finished.back().neighbors.size();
+}
+
+void LqiCrawler::discard(uint16_t nwkAddr)
+{
+	reading.erase(nwkAddr);
+}
+
+void LqiCrawler::ready(std::vector<router> &out)
+{
+	out.insert(out.end(), finished.begin(), finished.end());
+	finished.clear();
+}
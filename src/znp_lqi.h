@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_LQI_H_
+#define _ZNP_LQI_H_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "mtZdo.h"
+#include "znp_zdowalk.h"
+
+/*
+ * Topology crawler.
+ *
+ * Walks the mesh with ZDO Mgmt_Lqi requests, starting from one router and
+ * following every router found in a neighbor table, each one read by the
+ * ZDO table walker's rules.
+ *
+ * Only used from the v8 thread, it does not lock.
+ */
+
+//Neighbor table relationships
+#define LQI_RELATION_PARENT			0
+#define LQI_RELATION_CHILD			1
+#define LQI_RELATION_SIBLING		2
+#define LQI_RELATION_NONE			3
+#define LQI_RELATION_PREV_CHILD		4
+
+class LqiCrawler : public ZdoTableWalker {
+	public:
+		typedef struct {
+			uint64_t	extAddr;
+			uint64_t	extPanId;
+			uint16_t	nwkAddr;
+			uint8_t		type;			//DEVICETYPE_*
+			uint8_t		rxOnWhenIdle;
+			uint8_t		relation;		//LQI_RELATION_*
+			uint8_t		permitJoin;
+			uint8_t		depth;
+			uint8_t		lqi;
+		} neighbor;
+
+		typedef struct {
+			uint16_t	nwkAddr;
+			uint8_t		status;			//of the last page, MT_RPC_SUCCESS if the table is complete
+			std::vector<neighbor> neighbors;
+		} router;
+
+		//Forget any crawl in progress and start over from root, with the options given
+		void start(uint16_t root, const zdo_walk_options &o, uint64_t now);
+
+		//A Mgmt_Lqi response. Returns false if no crawl asked for it.
+		bool response(const MgmtLqiRspFormat_t *rsp, uint64_t now);
+		//Tables read completely since the last call
+		void ready(std::vector<router> &out);
+
+	protected:
+		void decode(uint16_t nwkAddr, const void *rsp);
+		uint32_t complete(uint16_t nwkAddr, uint8_t status, uint64_t now);
+		void discard(uint16_t nwkAddr);
+
+	private:
+		void discover(const neighbor &n);
+
+		std::map<uint16_t, std::vector<neighbor> > reading;	//pages in so far, keyed by nwk addr
+		std::vector<router> finished;
+};
+
+extern LqiCrawler lqiCrawler;
+
+#endif //_ZNP_LQI_H_
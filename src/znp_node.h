@@ -51,6 +51,40 @@ else cfield = (typ) val->ToInteger()->IntegerValue(); } }
 
 #define toBuffer(buf, data, len) { if(len > 0) { buf = UNI_BUFFER_NEW(len); char *mem = node::Buffer::Data(buf); ::memcpy(mem,data,len); } }
 
+//Limits of a single doZCLWork read or write, split into frames as needed
+#define ZCL_WORK_MAX_ATTRS			255
+#define ZCL_WORK_MAX_WRITE_LEN		2048
+//Command payload, bounded by the smallest AF data request: a device reached over a
+//source route is sent AF_DATA_REQUEST_SRC_RTG, which carries 128 bytes
+#define ZCL_WORK_MAX_CMD_LEN		128
+
+/*
+ * doZCLWorkBatch descriptor, one per request, little endian:
+ *
+ *  0  workCode		1	ZCL_SEND_COMMAND, ZCL_READ_ATTR or ZCL_WRITE_ATTR
+ *  1  srcEp		1
+ *  2  dstAddr		2
+ *  4  endPoint		1
+ *  5  addrMode		1
+ *  6  clusterId	2
+ *  8  msgId		2
+ * 10  seqNumber	2
+ * 12  manuCode		2	ZCL_SEND_COMMAND
+ * 14  cmdId		1	ZCL_SEND_COMMAND, ZCL_WRITE_ATTR
+ * 15  flags		1	ZCL_WORK_FLAG_*
+ * 16  payloadOff	4	into the payload arena
+ * 20  payloadLen	2	cmdFormat, attribute ids (big endian) or write records, as for doZCLWork
+ * 22  reserved		2
+ * 24  timeout		4	ms, 0 - none
+ * 28  maxAge		4	ms, ZCL_READ_ATTR
+ */
+#define ZCL_WORK_DESC_SIZE				32
+#define ZCL_WORK_FLAG_SPECIFIC			0x01
+#define ZCL_WORK_FLAG_SERVER_TO_CLIENT	0x02
+#define ZCL_WORK_FLAG_NO_DEFAULT_RSP	0x04
+#define ZCL_WORK_FLAG_CONFLATE			0x08
+#define ZCL_WORK_FLAG_COALESCE			0x10
+
 class ZNP;
 
 #ifdef __cplusplus
@@ -71,10 +105,33 @@ class ZNP : public Nan::ObjectWrap {
 		static NAN_METHOD(AddDevice);
 		static NAN_METHOD(RemoveDevice);
 		static NAN_METHOD(DoZCLWork);
+		static NAN_METHOD(DoZCLWorkBatch);
+		static NAN_METHOD(CancelZCLWork);
+		static NAN_METHOD(FanOut);
+		static NAN_METHOD(GroupWork);
+		static NAN_METHOD(PlanGroupcast);
+		static NAN_METHOD(ReadShadow);
+		static NAN_METHOD(GetMemStats);
 		static NAN_METHOD(EndDeviceAnnce);
 		static NAN_METHOD(GetNVItem);
 		static NAN_METHOD(SetNVItem);
 		static NAN_METHOD(SendLqiRequest);
+		static NAN_METHOD(CrawlTopology);
+		static NAN_METHOD(QueryTopology);
+		static NAN_METHOD(GetTopology);
+		static NAN_METHOD(HarvestRoutes);
+		static NAN_METHOD(GetRoutes);
+		static NAN_METHOD(GetRouteStats);
+		static NAN_METHOD(GetSourceRoutes);
+		static NAN_METHOD(InterviewDevice);
+		static NAN_METHOD(GetInterviewStats);
+		static NAN_METHOD(GetDevice);
+		static NAN_METHOD(GetDevices);
+		static NAN_METHOD(LocateDevice);
+		static NAN_METHOD(SaveDevices);
+		static NAN_METHOD(GetDeviceDbStats);
+		static NAN_METHOD(BackupNV);
+		static NAN_METHOD(RestoreNV);
 
 		static NAN_METHOD(OnNetworkReady);
 		static NAN_METHOD(OnNetworkFailed);
@@ -82,7 +139,13 @@ class ZNP : public Nan::ObjectWrap {
 		static NAN_METHOD(OnCmdResponse);
 		static NAN_METHOD(OnAttrResponse);
 		static NAN_METHOD(OnNetworkTopology);
+		static NAN_METHOD(OnTopologyChange);
 		static NAN_METHOD(OnDeviceJoinedNetwork);
+		static NAN_METHOD(OnDeviceReady);
+		static NAN_METHOD(OnDeviceAddressChange);
+		static NAN_METHOD(OnGroupResponse);
+		static NAN_METHOD(OnAttributeReport);
+		static NAN_METHOD(OnReportConfig);
 
 		Nan::Callback *onConnectedCB;
 		Nan::Callback *onNetworkReadyCB;
@@ -91,7 +154,13 @@ class ZNP : public Nan::ObjectWrap {
 		Nan::Callback *onCmdResponseCB;
 		Nan::Callback *onAttrResponseCB;
 		Nan::Callback *onNetworkTopologyCB;
+		Nan::Callback *onTopologyChangeCB;
 		Nan::Callback *onDeviceJoinedNetworkCB;
+		Nan::Callback *onDeviceReadyCB;
+		Nan::Callback *onDeviceAddressChangeCB;
+		Nan::Callback *onGroupResponseCB;
+		Nan::Callback *onAttributeReportCB;
+		Nan::Callback *onReportConfigCB;
 
 		config_options zOpts;
 		char *siodev;
@@ -113,7 +182,7 @@ class ZNP : public Nan::ObjectWrap {
 			uint16_t 		manuCode;
 			uint16_t 		seqNumber;
 			uint16_t 		cmdFormatLen;
-			char	 		*cmdFormat;
+			uint8_t	 		cmdFormat[ZCL_WORK_MAX_CMD_LEN];
 		} sendCmd_t;
 
 		typedef struct {
@@ -124,10 +193,14 @@ class ZNP : public Nan::ObjectWrap {
 			afAddrMode_t	addrMode;
 			uint16_t		clusterId;
 			uint8_t			numAttr;
-			uint16_t		attrId[50];
+			uint16_t		attrId[ZCL_WORK_MAX_ATTRS];
 			uint8_t 		direction;
 			uint8_t 		disableDefaultRsp;
 			uint16_t 		seqNumber;
+			uint32_t		maxAge;			//ms, answer from the attribute shadow if every value is this fresh
+			uint8_t			nextAttr;		//first attribute of the next part
+			uint8_t			parts;			//parts sent so far
+			uint8_t			status;			//first failure among the parts
 		} readAttr_t;
 
 		typedef struct {
@@ -145,21 +218,86 @@ class ZNP : public Nan::ObjectWrap {
 			uint8_t 		disableDefaultRsp;
 			uint16_t 		seqNumber;
 			uint16_t 		cmdFormatLen;
-			uint8_t	 		cmdFormat[300];
+			uint8_t	 		cmdFormat[ZCL_WORK_MAX_WRITE_LEN];
+			uint16_t		nextByte;		//first record of the next part
+			uint8_t			parts;			//parts sent so far
+			uint8_t			status;			//first failure among the parts
 		} writeAttr_t;
 
+		typedef struct {
+			uint8_t			direction;			//ZCL_SEND_ATTR_REPORTS or ZCL_EXPECT_ATTR_REPORTS
+			uint16_t		attrId;
+			uint8_t			dataType;
+			uint16_t		minInterval;		//seconds
+			uint16_t		maxInterval;		//seconds, 0xFFFF turns reporting off
+			uint16_t		timeoutPeriod;
+			union {
+				uint64_t	u;
+				float		f;
+				double		d;
+			} reportableChange;					//analog data types only
+		} reportCfgRec_t;
+
+		typedef struct {
+			uint8_t			srcEp;
+			uint16_t		dstAddr;
+			uint16_t		msgId;
+			uint8_t			endPoint;
+			afAddrMode_t	addrMode;
+			uint16_t		clusterId;
+			uint8_t 		direction;
+			uint8_t 		disableDefaultRsp;
+			uint16_t 		seqNumber;
+			uint8_t			numAttr;
+			reportCfgRec_t	attrs[REPORT_MAX_ATTRS];
+		} reportCfg_t;
+
+		enum group_op {
+			GROUP_ADD,
+			GROUP_REMOVE,
+			GROUP_GET_MEMBERSHIP,
+			SCENE_STORE,
+			SCENE_RECALL
+		};
+
+		typedef struct {
+			group_op		op;
+			uint16_t		dstAddr;		//nwk addr, or the group id for afAddrGroup
+			uint8_t			endPoint;
+			afAddrMode_t	addrMode;
+			uint16_t		msgId;
+			uint16_t		groupId;
+			uint8_t			sceneId;
+		} groupCmd_t;
+
 		enum work_code {
 			ZCL_SEND_COMMAND,
 			ZCL_READ_ATTR,
-			ZCL_WRITE_ATTR
+			ZCL_WRITE_ATTR,
+			ZCL_FAN_OUT,
+			ZCL_GROUP_WORK,
+			ZCL_CONFIG_REPORT,
+			ZCL_READ_REPORT_CFG
+		};
+
+		//Reported through statusCB when a request never reaches the ZNP
+		enum work_status {
+			ZCL_WORK_CANCELLED = -1,
+			ZCL_WORK_EXPIRED = -2,
+			ZCL_WORK_SUPERSEDED = -3
 		};
 
 		typedef struct {
 			work_code workCode;
 			void *command;
 			int size;
-			int _errno;
+			int _errno;				//ZCL_FAN_OUT: status reported with the results
 			Nan::Callback *statusCB;
+			uint32_t handle;		//returned by doZCLWork, used to cancel
+			uint64_t deadline;		//loop time in ms after which the request is dropped, 0 - none
+			bool conflate;			//may replace a queued request for the same device/endpoint/cluster/command
+			bool coalesce;			//reads and writes: may share a frame with others for the same device/endpoint/cluster
+			uint64_t notBefore;		//loop time in ms, coalesce: held at the head of the queue until then
 		} zclTransport;
 
 	protected:
@@ -0,0 +1,282 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "mtSys.h"
+#include "znp_nvbackup.h"
+#include "znp_snapshot.h"
+
+//magic, version, flags, saved at (wall clock ms), item count
+#define NVBACKUP_HEADER_LEN		18
+
+//what a legacy NV read reaches with its one byte offset
+#define NVBACKUP_MAX_ITEM		512
+
+//table entries tried in each ranged item, absent ones are not in the file
+#define NVBACKUP_TABLE_ENTRIES	16
+
+//the file holds the network and link keys, only its owner reads it
+#define NVBACKUP_FILE_MODE		0600
+
+//NWKKEY: key sequence number, key, frame counter
+#define NWKKEY_LEN				21
+#define NWKKEY_FRAME_COUNTER	17
+
+NvBackup nvBackup;
+
+/*
+ * In restore order: what the network is, its keys, who is in it, and the
+ * NIB last, the stack takes it as the word that the rest is there.
+ */
+static const struct {
+	uint16_t	id;
+	uint16_t	entries;		//1, or the entries of a table that starts at id
+	bool		required;
+} nvItems[] = {
+	{ ZCD_NV_EXTADDR,				1,	true },
+	{ ZCD_NV_LOGICAL_TYPE,			1,	false },
+	{ ZCD_NV_PANID,					1,	true },
+	{ ZCD_NV_EXTENDED_PAN_ID,		1,	true },
+	{ ZCD_NV_APS_USE_EXT_PANID,		1,	false },
+	{ ZCD_NV_CHANLIST,				1,	true },
+	{ ZCD_NV_SECURITY_MODE,			1,	false },
+	{ ZCD_NV_PRECFGKEYS_ENABLE,		1,	false },
+	{ ZCD_NV_PRECFGKEY,				1,	false },
+	{ ZCD_NV_USE_DEFAULT_TCLK,		1,	false },
+	{ ZCD_NV_TRUSTCENTER_ADDR,		1,	false },
+	{ ZCD_NV_NWK_ACTIVE_KEY_INFO,	1,	true },
+	{ ZCD_NV_NWK_ALTERN_KEY_INFO,	1,	false },
+	{ ZCD_NV_NWKKEY,				1,	true },
+	{ ZCD_NV_APS_LINK_KEY_TABLE,	1,	false },
+	{ ZCD_NV_TCLK_TABLE_START,		NVBACKUP_TABLE_ENTRIES,	false },
+	{ ZCD_NV_APS_LINK_KEY_DATA_START,	NVBACKUP_TABLE_ENTRIES,	false },
+	{ ZCD_NV_ADDRMGR,				1,	false },
+	{ ZCD_NV_DEVICE_LIST,			1,	false },
+	{ ZCD_NV_BINDING_TABLE,			1,	false },
+	{ ZCD_NV_GROUP_TABLE,			1,	false },
+	{ ZCD_NV_NIB,					1,	true },
+};
+
+NvBackup::NvBackup() :
+	nvLength(NULL),
+	nvRead(NULL),
+	nvWrite(NULL)
+{
+}
+
+void NvBackup::setAccess(length_fn length, read_fn read, write_fn write)
+{
+	nvLength = length;
+	nvRead = read;
+	nvWrite = write;
+}
+
+void NvBackup::items(std::vector<item_id> &out) const
+{
+	out.clear();
+	for(size_t i = 0; i < sizeof(nvItems) / sizeof(nvItems[0]); i++) {
+		for(uint16_t e = 0; e < nvItems[i].entries; e++) {
+			item_id it;
+			it.id = nvItems[i].id + e;
+			it.required = nvItems[i].required;
+			out.push_back(it);
+		}
+	}
+}
+
+bool NvBackup::required(uint16_t id) const
+{
+	for(size_t i = 0; i < sizeof(nvItems) / sizeof(nvItems[0]); i++) {
+		if(id >= nvItems[i].id && id < nvItems[i].id + nvItems[i].entries) {
+			return nvItems[i].required;
+		}
+	}
+	return false;
+}
+
+static void clear(NvBackup::result &res)
+{
+	res.ok = false;
+	res.items = 0;
+	res.bytes = 0;
+	res.skipped.clear();
+	res.failedId = -1;
+	res.err = 0;
+}
+
+bool NvBackup::backup(const std::string &path, result &res)
+{
+	std::vector<item_id> ids;
+	std::vector<uint8_t> buf;
+	uint8_t value[NVBACKUP_MAX_ITEM];
+	uint16_t count = 0;
+
+	clear(res);
+	if(nvRead == NULL) {
+		res.err = ENODEV;
+		return false;
+	}
+
+	items(ids);
+	put32(buf, NVBACKUP_MAGIC);
+	put16(buf, NVBACKUP_VERSION);
+	put16(buf, 0);
+	put64(buf, snapshotWallMs());
+	put16(buf, 0);		//item count, filled in below
+	for(size_t i = 0; i < ids.size(); i++) {
+		int len = nvRead(ids[i].id, value, sizeof(value));
+		if(len <= 0) {
+			if(ids[i].required) {
+				res.failedId = ids[i].id;
+				return false;
+			}
+			if(len < 0) {
+				res.skipped.push_back(ids[i].id);
+			}
+			continue;
+		}
+		put16(buf, ids[i].id);
+		put16(buf, len);
+		buf.insert(buf.end(), value, value + len);
+		count++;
+	}
+	buf[NVBACKUP_HEADER_LEN - 2] = count & 0xFF;
+	buf[NVBACKUP_HEADER_LEN - 1] = count >> 8;
+
+	if(snapshotWrite(path, buf, NVBACKUP_FILE_MODE) < 0) {
+		res.err = errno;
+		return false;
+	}
+	res.items = count;
+	res.bytes = buf.size();
+	res.ok = true;
+	return true;
+}
+
+bool NvBackup::parse(const std::vector<uint8_t> &buf, std::vector<item> &out) const
+{
+	reader r(&buf[0], buf.size());
+
+	if(r.get32() != NVBACKUP_MAGIC || r.get16() != NVBACKUP_VERSION) {
+		return false;
+	}
+	r.get16();		//flags
+	r.get64();		//saved at
+	uint16_t count = r.get16();
+	out.clear();
+	for(uint16_t i = 0; i < count; i++) {
+		item it;
+		it.id = r.get16();
+		uint16_t len = r.get16();
+		const uint8_t *p = r.bytes(len);
+		if(p == NULL || len == 0 || len > NVBACKUP_MAX_ITEM) {
+			return false;
+		}
+		it.value.assign(p, p + len);
+		out.push_back(it);
+	}
+	if(!r.ok || r.pos != buf.size()) {
+		return false;
+	}
+
+	//a network cannot be started without every required item
+	std::vector<item_id> ids;
+	items(ids);
+	for(size_t i = 0; i < ids.size(); i++) {
+		if(!ids[i].required) {
+			continue;
+		}
+		size_t k;
+		for(k = 0; k < out.size() && out[k].id != ids[i].id; k++);
+		if(k == out.size()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool NvBackup::restore(const std::string &path, uint32_t frameCounterDelta, result &res)
+{
+	std::vector<uint8_t> buf;
+	std::vector<item> file;
+	std::vector<bool> skip;
+
+	clear(res);
+	if(nvLength == NULL || nvWrite == NULL) {
+		res.err = ENODEV;
+		return false;
+	}
+	if(snapshotRead(path, buf, NVBACKUP_HEADER_LEN) < 0) {
+		res.err = errno;
+		return false;
+	}
+	res.bytes = buf.size() + 4;		//and the CRC
+	if(!parse(buf, file)) {
+		res.err = EINVAL;
+		return false;
+	}
+
+	//every length is checked before anything is written, an item that
+	//exists is written over in place and cannot change its length
+	skip.resize(file.size(), false);
+	for(size_t i = 0; i < file.size(); i++) {
+		int have = nvLength(file[i].id);
+		if(have < 0 || (have > 0 && have != (int)file[i].value.size())) {
+			if(have < 0 || required(file[i].id)) {
+				res.failedId = file[i].id;
+				return false;
+			}
+			skip[i] = true;
+			res.skipped.push_back(file[i].id);
+		}
+	}
+
+	for(size_t i = 0; i < file.size(); i++) {
+		if(skip[i]) {
+			continue;
+		}
+		std::vector<uint8_t> &v = file[i].value;
+		if(file[i].id == ZCD_NV_NWKKEY && v.size() == NWKKEY_LEN) {
+			reader r(&v[NWKKEY_FRAME_COUNTER], 4);
+			uint32_t counter = r.get32() + frameCounterDelta;
+			for(int b = 0; b < 4; b++) {
+				v[NWKKEY_FRAME_COUNTER + b] = counter >> (8 * b);
+			}
+		}
+		if(nvWrite(file[i].id, &v[0], v.size()) != 0) {
+			if(required(file[i].id)) {
+				res.failedId = file[i].id;
+				return false;
+			}
+			res.skipped.push_back(file[i].id);
+			continue;
+		}
+		res.items++;
+	}
+
+	//start from what was written rather than clearing it
+	uint8_t startup = 0;
+	if(nvWrite(ZCD_NV_STARTUP_OPTION, &startup, 1) != 0) {
+		res.failedId = ZCD_NV_STARTUP_OPTION;
+		return false;
+	}
+	res.ok = true;
+	return true;
+}
@@ -0,0 +1,100 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_NVBACKUP_H_
+#define _ZNP_NVBACKUP_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * ZNP NV backup.
+ *
+ * Copies the NV items that make up the network the coordinator runs, its
+ * addresses, keys, the tables of devices and bindings and the NIB, to a file
+ * and back, so a replaced or reflashed stick carries on with the same
+ * network. The file is a header, each item as it was read and a CRC-32, it
+ * is written as the device database is. A restore checks the file and every
+ * item length against the ZNP before it writes anything, writes the items
+ * in an order the stack can start from and moves the network frame counter
+ * on, the devices drop frames with a counter they have seen already.
+ *
+ * The NV access goes through the functions given to setAccess, one item at
+ * a time, the caller keeps the ZNP to itself while it runs.
+ *
+ * Runs on the libuv thread pool, one backup or restore at a time, it does
+ * not lock.
+ */
+
+#define NVBACKUP_MAGIC			0x42564E5A	//"ZNVB"
+#define NVBACKUP_VERSION		1
+
+//What a restore moves the network frame counter on by unless told otherwise
+#define NVBACKUP_FRAME_COUNTER_DELTA	100000
+
+class NvBackup {
+	public:
+		//0 if the item does not exist, -1 if the ZNP did not answer or it could not be read
+		typedef int (*length_fn)(uint16_t id);
+		typedef int (*read_fn)(uint16_t id, uint8_t *value, uint16_t maxLen);
+		//0 or a status
+		typedef uint8_t (*write_fn)(uint16_t id, const uint8_t *value, uint16_t len);
+
+		typedef struct {
+			bool		ok;
+			uint32_t	items;			//read or written
+			uint32_t	bytes;			//of the file
+			std::vector<uint16_t> skipped;	//optional items that could not be read or written
+			int			failedId;		//item that failed the backup or restore, -1 if none did
+			int			err;			//errno of a file that could not be read or written, 0 otherwise
+		} result;
+
+		NvBackup();
+
+		void setAccess(length_fn length, read_fn read, write_fn write);
+
+		//Reads the items into the file
+		bool backup(const std::string &path, result &res);
+		//Writes the file into the ZNP, which has to be reset and started
+		//without forming a new network after it
+		bool restore(const std::string &path, uint32_t frameCounterDelta, result &res);
+
+	private:
+		typedef struct {
+			uint16_t	id;
+			bool		required;
+		} item_id;
+
+		typedef struct {
+			uint16_t	id;
+			std::vector<uint8_t> value;
+		} item;
+
+		void items(std::vector<item_id> &out) const;
+		bool required(uint16_t id) const;
+		bool parse(const std::vector<uint8_t> &buf, std::vector<item> &out) const;
+
+		length_fn nvLength;
+		read_fn nvRead;
+		write_fn nvWrite;
+};
+
+extern NvBackup nvBackup;
+
+#endif //_ZNP_NVBACKUP_H_
@@ -0,0 +1,159 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stddef.h>
+
+#include "znp_rtg.h"
+#include "rpc.h"
+
+RtgHarvester rtgHarvester;
+
+RtgHarvester::RtgHarvester()
+{
+	totals.added = 0;
+	totals.removed = 0;
+	totals.changed = 0;
+}
+
+void RtgHarvester::start(const std::vector<uint16_t> &routers, const zdo_walk_options &o, uint64_t now)
+{
+	begin(o, now);
+	reading.clear();
+	finished.clear();
+	for(size_t i = 0; i < routers.size(); i++) {
+		queue(routers[i]);
+	}
+	totals.added = 0;
+	totals.removed = 0;
+	totals.changed = 0;
+}
+
+void RtgHarvester::merge(uint16_t router, std::map<uint16_t, route> &entries, uint64_t now)
+{
+	std::map<uint16_t, route> &old = tables[router];
+	uint32_t n = 0;
+
+	for(std::map<uint16_t, route>::iterator it = entries.begin(); it != entries.end(); it++) {
+		std::map<uint16_t, route>::iterator was = old.find(it->first);
+		if(was == old.end()) {
+			totals.added++;
+			n++;
+		} else if(was->second.nextHop != it->second.nextHop || was->second.status != it->second.status) {
+			totals.changed++;
+			n++;
+		}
+		byDst[it->first][router] = it->second;
+	}
+	for(std::map<uint16_t, route>::iterator it = old.begin(); it != old.end(); it++) {
+		if(entries.count(it->first)) {
+			continue;
+		}
+		totals.removed++;
+		n++;
+		std::map<uint16_t, std::map<uint16_t, route> >::iterator d = byDst.find(it->first);
+		if(d != byDst.end()) {
+			d->second.erase(router);
+			if(d->second.empty()) {
+				byDst.erase(d);
+			}
+		}
+	}
+
+	//the first read of a router is not churn
+	if(updated.count(router)) {
+		churn[router] += n;
+	} else {
+		churn[router] = 0;
+	}
+	updated[router] = now;
+	old.swap(entries);
+}
+
+bool RtgHarvester::response(const MgmtRtgRspFormat_t *rsp, uint64_t now)
+{
+	return page(rsp->SrcAddr, rsp->Status, rsp->StartIndex, rsp->RoutingTableListCount,
+			rsp->RoutingTableEntries, rsp, now);
+}
+
+void RtgHarvester::decode(uint16_t nwkAddr, const void *p)
+{
+	const MgmtRtgRspFormat_t *rsp = (const MgmtRtgRspFormat_t*)p;
+	std::map<uint16_t, route> &entries = reading[nwkAddr];
+
+	for(uint8_t i = 0; i < rsp->RoutingTableListCount && i < sizeof(rsp->RoutingTableList) / sizeof(rsp->RoutingTableList[0]); i++) {
+		const RoutingTableListItemFormat_t *item = &rsp->RoutingTableList[i];
+		route r;
+
+		r.nextHop = item->NextHop;
+		r.status = item->Status & 0x07;
+		entries[item->DstAddr] = r;
+	}
+}
+
+uint32_t RtgHarvester::complete(uint16_t nwkAddr, uint8_t status, uint64_t now)
+{
+	std::map<uint16_t, route> &entries = reading[nwkAddr];
+	uint32_t n = entries.size();
+
+	merge(nwkAddr, entries, now);
+	reading.erase(nwkAddr);
+	finished.push_back(nwkAddr);
+	return n;
+}
+
+void RtgHarvester::discard(uint16_t nwkAddr)
+{
+	reading.erase(nwkAddr);
+}
+
+void RtgHarvester::ready(std::vector<uint16_t> &out)
+{
+	out.insert(out.end(), finished.begin(), finished.end());
+	finished.clear();
+}
+
+const std::map<uint16_t, RtgHarvester::route> *RtgHarvester::table(uint16_t router) const
+{
+	std::map<uint16_t, std::map<uint16_t, route> >::const_iterator it = tables.find(router);
+	return it == tables.end() ? NULL : &it->second;
+}
+
+const std::map<uint16_t, RtgHarvester::route> *RtgHarvester::routesTo(uint16_t dst) const
+{
+	std::map<uint16_t, std::map<uint16_t, route> >::const_iterator it = byDst.find(dst);
+	return it == byDst.end() ? NULL : &it->second;
+}
+
+void RtgHarvester::stats(std::map<uint16_t, router_stats> &out) const
+{
+	out.clear();
+	for(std::map<uint16_t, std::map<uint16_t, route> >::const_iterator t = tables.begin(); t != tables.end(); t++) {
+		router_stats &s = out[t->first];
+		s.routes = t->second.size();
+		s.churn = churn.find(t->first)->second;
+		s.updated = updated.find(t->first)->second;
+	}
+	//a router many routes go through carries their traffic, read or not
+	for(std::map<uint16_t, std::map<uint16_t, route> >::const_iterator t = tables.begin(); t != tables.end(); t++) {
+		for(std::map<uint16_t, route>::const_iterator r = t->second.begin(); r != t->second.end(); r++) {
+			if(r->second.status == RTG_STATUS_ACTIVE) {
+				out[r->second.nextHop].load++;
+			}
+		}
+	}
+}
@@ -0,0 +1,107 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_RTG_H_
+#define _ZNP_RTG_H_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "mtZdo.h"
+#include "znp_zdowalk.h"
+
+/*
+ * Routing table harvester.
+ *
+ * Reads the routing tables of a list of routers with ZDO Mgmt_Rtg requests,
+ * each one by the ZDO table walker's rules. A table read completely
+ * replaces what that router reported before, and the entries that
+ * appeared, went away or got another next hop are counted as churn.
+ *
+ * Only used from the v8 thread, it does not lock.
+ */
+
+//Routing table entry status
+#define RTG_STATUS_ACTIVE				0
+#define RTG_STATUS_DISCOVERY_UNDERWAY	1
+#define RTG_STATUS_DISCOVERY_FAILED		2
+#define RTG_STATUS_INACTIVE				3
+#define RTG_STATUS_VALIDATION_UNDERWAY	4
+
+class RtgHarvester : public ZdoTableWalker {
+	public:
+		typedef struct {
+			uint16_t	nextHop;
+			uint8_t		status;			//RTG_STATUS_*
+		} route;
+
+		typedef struct {
+			uint32_t	added;			//entries not in the router's previous table
+			uint32_t	removed;
+			uint32_t	changed;		//entries with another next hop or status
+		} churn_summary;
+
+		typedef struct {
+			uint32_t	routes;			//entries in the router's table
+			uint32_t	load;			//active routes of any router with it as next hop
+			uint32_t	churn;			//entries added, removed or changed since it was first read
+			uint64_t	updated;		//ms, loop time of the last complete read
+		} router_stats;
+
+		RtgHarvester();
+
+		//Forget any harvest in progress and start reading routers, with the options given
+		void start(const std::vector<uint16_t> &routers, const zdo_walk_options &o, uint64_t now);
+
+		//A Mgmt_Rtg response. Returns false if no harvest asked for it.
+		bool response(const MgmtRtgRspFormat_t *rsp, uint64_t now);
+		//Of the harvest in progress or the last one
+		const churn_summary &churnSummary() const { return totals; }
+
+		//Routers with a route to dst and their next hop
+		const std::map<uint16_t, route> *routesTo(uint16_t dst) const;
+		void stats(std::map<uint16_t, router_stats> &out) const;
+		//A router's table as last read, NULL if it never was
+		const std::map<uint16_t, route> *table(uint16_t router) const;
+		uint32_t harvests() const { return walksFinished(); }
+		//Routers whose table was read completely since the last call
+		void ready(std::vector<uint16_t> &out);
+
+	protected:
+		void decode(uint16_t nwkAddr, const void *rsp);
+		uint32_t complete(uint16_t nwkAddr, uint8_t status, uint64_t now);
+		void discard(uint16_t nwkAddr);
+
+	private:
+		void merge(uint16_t router, std::map<uint16_t, route> &entries, uint64_t now);
+
+		churn_summary totals;			//of the harvest in progress
+
+		std::map<uint16_t, std::map<uint16_t, route> > reading;	//pages in so far, router -> dst -> route
+		std::vector<uint16_t> finished;
+
+		std::map<uint16_t, std::map<uint16_t, route> > tables;		//router -> dst -> route
+		std::map<uint16_t, std::map<uint16_t, route> > byDst;		//dst -> router -> route
+		std::map<uint16_t, uint32_t> churn;
+		std::map<uint16_t, uint64_t> updated;
+};
+
+extern RtgHarvester rtgHarvester;
+
+#endif //_ZNP_RTG_H_
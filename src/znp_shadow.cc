@@ -0,0 +1,252 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <time.h>
+
+#include "znp_shadow.h"
+#include "znp_zcltypes.h"
+#include "zcl_port.h"
+#include "zcl.h"
+
+//writes never acknowledged (no default response asked for, or lost) are dropped after this
+#define SHADOW_WRITE_ACK_TIMEOUT	30000
+
+AttrShadow attrShadow;
+
+AttrShadow::AttrShadow() :
+	changeCount(0)
+{
+	pthread_mutex_init(&lock, NULL);
+}
+
+AttrShadow::~AttrShadow()
+{
+	pthread_mutex_destroy(&lock);
+}
+
+uint64_t AttrShadow::nowMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t AttrShadow::key(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint16_t attrId)
+{
+	return ((uint64_t)nwkAddr << 40) | ((uint64_t)endPoint << 32) | ((uint64_t)clusterId << 16) | attrId;
+}
+
+void AttrShadow::storeLocked(uint64_t k, uint8_t dataType, const uint8_t *value, uint16_t len, source from, uint64_t now)
+{
+	entry &e = entries[k];
+	e.dataType = dataType;
+	e.value.assign(value, value + len);
+	e.updated = now;
+	e.from = from;
+	changeCount++;
+}
+
+void AttrShadow::store(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint16_t attrId,
+		uint8_t dataType, const uint8_t *value, uint16_t len, source from)
+{
+	uint64_t now = nowMs();
+
+	pthread_mutex_lock(&lock);
+	storeLocked(key(nwkAddr, endPoint, clusterId, attrId), dataType, value, len, from, now);
+	pthread_mutex_unlock(&lock);
+}
+
+bool AttrShadow::lookup(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint16_t attrId,
+		uint32_t maxAge, entry &e)
+{
+	bool ret = false;
+	uint64_t now = nowMs();
+
+	pthread_mutex_lock(&lock);
+	std::map<uint64_t, entry>::iterator it = entries.find(key(nwkAddr, endPoint, clusterId, attrId));
+	if(it != entries.end() && now - it->second.updated <= maxAge) {
+		e = it->second;
+		ret = true;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
+
+void AttrShadow::forget(uint16_t nwkAddr)
+{
+	pthread_mutex_lock(&lock);
+	entries.erase(entries.lower_bound(key(nwkAddr, 0, 0, 0)), entries.upper_bound(key(nwkAddr, 0xFF, 0xFFFF, 0xFFFF)));
+	writes.erase(writes.lower_bound((uint32_t)nwkAddr << 8), writes.upper_bound(((uint32_t)nwkAddr << 8) | 0xFF));
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::move(uint16_t from, uint16_t to)
+{
+	std::map<uint64_t, entry> moved;
+
+	if(from == to) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	std::map<uint64_t, entry>::iterator first = entries.lower_bound(key(from, 0, 0, 0));
+	std::map<uint64_t, entry>::iterator last = entries.upper_bound(key(from, 0xFF, 0xFFFF, 0xFFFF));
+	for(std::map<uint64_t, entry>::iterator it = first; it != last; it++) {
+		moved[key(to, (it->first >> 32) & 0xFF, (it->first >> 16) & 0xFFFF, it->first & 0xFFFF)] = it->second;
+	}
+	entries.erase(first, last);
+	entries.erase(entries.lower_bound(key(to, 0, 0, 0)), entries.upper_bound(key(to, 0xFF, 0xFFFF, 0xFFFF)));
+	entries.insert(moved.begin(), moved.end());
+	//writes sent to the old address are not acknowledged from the new one
+	writes.erase(writes.lower_bound((uint32_t)from << 8), writes.upper_bound(((uint32_t)from << 8) | 0xFF));
+	writes.erase(writes.lower_bound((uint32_t)to << 8), writes.upper_bound(((uint32_t)to << 8) | 0xFF));
+	changeCount++;
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::entriesOf(uint16_t nwkAddr, std::vector<record> &out)
+{
+	pthread_mutex_lock(&lock);
+	std::map<uint64_t, entry>::iterator end = entries.upper_bound(key(nwkAddr, 0xFF, 0xFFFF, 0xFFFF));
+	for(std::map<uint64_t, entry>::iterator it = entries.lower_bound(key(nwkAddr, 0, 0, 0)); it != end; it++) {
+		record r;
+		r.endPoint = (it->first >> 32) & 0xFF;
+		r.clusterId = (it->first >> 16) & 0xFFFF;
+		r.attrId = it->first & 0xFFFF;
+		r.e = it->second;
+		out.push_back(r);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::restore(uint16_t nwkAddr, const record &r, uint64_t age)
+{
+	uint64_t now = nowMs();
+
+	pthread_mutex_lock(&lock);
+	entry &e = entries[key(nwkAddr, r.endPoint, r.clusterId, r.attrId)];
+	e = r.e;
+	//older than the monotonic clock goes back, as old as it can be
+	e.updated = now > age ? now - age : 0;
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::storeReadRsp(const attr_response *rsp)
+{
+	uint64_t now = nowMs();
+	uint16_t i = 0;
+
+	pthread_mutex_lock(&lock);
+	while(i + 3 <= rsp->payloadLen) {
+		uint16_t attrId = BUILD_UINT16(rsp->payload[i], rsp->payload[i + 1]);
+		uint8_t status = rsp->payload[i + 2];
+		i += 3;
+
+		if(status != ZCL_STATUS_SUCCESS) {
+			continue;
+		}
+		if(i + 1 > rsp->payloadLen) {
+			break;
+		}
+
+		uint8_t dataType = rsp->payload[i++];
+		int len = zclValueLength(dataType, &rsp->payload[i], rsp->payloadLen - i);
+		if(len < 0) {
+			break;
+		}
+		storeLocked(key(rsp->srcAddr, rsp->endPoint, rsp->clusterId, attrId), dataType, &rsp->payload[i], len, SHADOW_READ, now);
+		i += len;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::storeReport(const report_response *rsp)
+{
+	uint64_t now = nowMs();
+
+	pthread_mutex_lock(&lock);
+	for(uint8_t i = 0; i < rsp->numAttr; i++) {
+		const report_record *rec = &rsp->attrs[i];
+		storeLocked(key(rsp->srcAddr, rsp->endPoint, rsp->clusterId, rec->attrId), rec->dataType, rec->value, rec->len, SHADOW_REPORT, now);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::expectWrite(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint8_t transId,
+		const uint8_t *records, uint16_t len)
+{
+	pendingWrite w;
+	uint64_t now = nowMs();
+	uint16_t i = 0;
+
+	w.endPoint = endPoint;
+	w.clusterId = clusterId;
+	w.sent = now;
+	while(i + 4 <= len && i + 4 + records[i + 3] <= len) {
+		pendingAttr a;
+		a.attrId = (records[i] << 8) + records[i + 1];
+		a.dataType = records[i + 2];
+		a.value.assign(&records[i + 4], &records[i + 4] + records[i + 3]);
+		w.attrs.push_back(a);
+		i += 4 + records[i + 3];
+	}
+
+	pthread_mutex_lock(&lock);
+	for(std::map<uint32_t, pendingWrite>::iterator it = writes.begin(); it != writes.end(); ) {
+		if(now - it->second.sent > SHADOW_WRITE_ACK_TIMEOUT) {
+			writes.erase(it++);
+		} else {
+			it++;
+		}
+	}
+	writes[((uint32_t)nwkAddr << 8) | transId] = w;
+	pthread_mutex_unlock(&lock);
+}
+
+void AttrShadow::writeAck(const report_response *rsp)
+{
+	uint64_t now = nowMs();
+
+	pthread_mutex_lock(&lock);
+	std::map<uint32_t, pendingWrite>::iterator it = writes.find(((uint32_t)rsp->srcAddr << 8) | rsp->transId);
+	if(it != writes.end() && it->second.clusterId == rsp->clusterId) {
+		pendingWrite &w = it->second;
+		//all attributes written is reported as one success record without attribute id
+		bool allOk = (rsp->numAttr == 1 && rsp->attrs[0].status == ZCL_STATUS_SUCCESS);
+
+		for(size_t i = 0; i < w.attrs.size(); i++) {
+			bool ok = allOk;
+			if(!allOk) {
+				//only failed attributes are listed
+				ok = true;
+				for(uint8_t j = 0; j < rsp->numAttr; j++) {
+					if(rsp->attrs[j].attrId == w.attrs[i].attrId && rsp->attrs[j].status != ZCL_STATUS_SUCCESS) {
+						ok = false;
+					}
+				}
+			}
+			if(ok) {
+				const pendingAttr &a = w.attrs[i];
+				storeLocked(key(rsp->srcAddr, w.endPoint, w.clusterId, a.attrId), a.dataType,
+						a.value.empty() ? NULL : &a.value[0], a.value.size(), SHADOW_WRITE, now);
+			}
+		}
+		writes.erase(it);
+	}
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,115 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_SHADOW_H_
+#define _ZNP_SHADOW_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include <vector>
+
+#include "znp_cfuncs.h"
+
+/*
+ * Last known value of every device/endpoint/cluster/attribute we have seen.
+ *
+ * Fed from read responses, attribute reports and acknowledged writes, each
+ * entry remembers when and how it was learnt so reads that can tolerate
+ * some staleness are answered without going on air.
+ */
+class AttrShadow {
+	public:
+		enum source {
+			SHADOW_READ,
+			SHADOW_REPORT,
+			SHADOW_WRITE
+		};
+
+		typedef struct {
+			uint8_t dataType;
+			std::vector<uint8_t> value;		//as sent over the air
+			uint64_t updated;				//ms, monotonic
+			source from;
+		} entry;
+
+		AttrShadow();
+		~AttrShadow();
+
+		void store(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint16_t attrId,
+				uint8_t dataType, const uint8_t *value, uint16_t len, source from);
+		//Copies the entry out if it is no older than maxAge ms
+		bool lookup(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint16_t attrId,
+				uint32_t maxAge, entry &e);
+		void forget(uint16_t nwkAddr);
+		//The device at from is at to now, whatever to had is dropped
+		void move(uint16_t from, uint16_t to);
+
+		typedef struct {
+			uint8_t endPoint;
+			uint16_t clusterId;
+			uint16_t attrId;
+			entry e;
+		} record;
+
+		//Every entry of nwkAddr, to be saved
+		void entriesOf(uint16_t nwkAddr, std::vector<record> &out);
+		//A saved entry, age ms old
+		void restore(uint16_t nwkAddr, const record &r, uint64_t age);
+		//Bumped by every store, to tell whether there is anything new to save
+		uint32_t changes() const { return changeCount; }
+
+		//Read response payload: attrId, status, [dataType, value] records
+		void storeReadRsp(const attr_response *rsp);
+		//Attribute report
+		void storeReport(const report_response *rsp);
+		//Remember the values of a write request until the device acknowledges it.
+		//records are in doZCLWork format: attrId (big endian), dataType, len, value
+		void expectWrite(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint8_t transId,
+				const uint8_t *records, uint16_t len);
+		//Write response, statuses per attribute or a single success for all
+		void writeAck(const report_response *rsp);
+
+		static uint64_t nowMs();
+
+	private:
+		typedef struct {
+			uint16_t attrId;
+			uint8_t dataType;
+			std::vector<uint8_t> value;
+		} pendingAttr;
+
+		typedef struct {
+			uint8_t endPoint;
+			uint16_t clusterId;
+			uint64_t sent;
+			std::vector<pendingAttr> attrs;
+		} pendingWrite;
+
+		static uint64_t key(uint16_t nwkAddr, uint8_t endPoint, uint16_t clusterId, uint16_t attrId);
+		void storeLocked(uint64_t k, uint8_t dataType, const uint8_t *value, uint16_t len, source from, uint64_t now);
+
+		pthread_mutex_t lock;
+		uint32_t changeCount;
+		std::map<uint64_t, entry> entries;
+		std::map<uint32_t, pendingWrite> writes;		//nwk addr << 8 | transId
+};
+
+extern AttrShadow attrShadow;
+
+#endif //_ZNP_SHADOW_H_
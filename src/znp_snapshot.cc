@@ -0,0 +1,161 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "znp_snapshot.h"
+
+#define SNAPSHOT_CRC_LEN	4
+
+//built once, snapshots are checked on the v8 thread and written on the thread pool
+static uint32_t crcTable[256];
+static pthread_once_t crcTableOnce = PTHREAD_ONCE_INIT;
+
+static void crcTableInit()
+{
+	for(uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for(int k = 0; k < 8; k++) {
+			c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		}
+		crcTable[i] = c;
+	}
+}
+
+uint32_t snapshotCrc32(const uint8_t *p, size_t len, uint32_t crc)
+{
+	pthread_once(&crcTableOnce, crcTableInit);
+
+	crc = ~crc;
+	for(size_t i = 0; i < len; i++) {
+		crc = crcTable[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+uint64_t snapshotWallMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int snapshotWrite(const std::string &path, std::vector<uint8_t> &buf, mode_t mode)
+{
+	std::string tmp = path + ".tmp";
+	int fd, err;
+
+	if(path.empty()) {
+		errno = ENOENT;
+		return -1;
+	}
+	put32(buf, snapshotCrc32(buf.empty() ? NULL : &buf[0], buf.size()));
+
+	fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode);
+	if(fd < 0) {
+		return -1;
+	}
+	//a temporary file left over from before keeps its own mode otherwise
+	if(fchmod(fd, mode) < 0) {
+		err = errno;
+		close(fd);
+		unlink(tmp.c_str());
+		errno = err;
+		return -1;
+	}
+	size_t done = 0;
+	while(done < buf.size()) {
+		ssize_t n = write(fd, &buf[done], buf.size() - done);
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		done += n;
+	}
+	if(done < buf.size() || fsync(fd) < 0) {
+		err = errno;
+		close(fd);
+		unlink(tmp.c_str());
+		errno = err;
+		return -1;
+	}
+	close(fd);
+	if(rename(tmp.c_str(), path.c_str()) < 0) {
+		err = errno;
+		unlink(tmp.c_str());
+		errno = err;
+		return -1;
+	}
+
+	//the rename itself is only durable once the directory is synced
+	size_t slash = path.rfind('/');
+	std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+	fd = open(dir.c_str(), O_RDONLY);
+	if(fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	return 0;
+}
+
+int snapshotRead(const std::string &path, std::vector<uint8_t> &buf, uint32_t minLen)
+{
+	struct stat st;
+	FILE *f;
+
+	buf.clear();
+	if(path.empty()) {
+		errno = ENOENT;
+		return -1;
+	}
+	f = fopen(path.c_str(), "rb");
+	if(f == NULL) {
+		return -1;
+	}
+	if(fstat(fileno(f), &st) < 0 || st.st_size < (off_t)minLen + SNAPSHOT_CRC_LEN || st.st_size > 0x7FFFFFFF) {
+		fclose(f);
+		errno = EINVAL;
+		return -1;
+	}
+	buf.resize(st.st_size);
+	if(fread(&buf[0], 1, buf.size(), f) != buf.size()) {
+		fclose(f);
+		buf.clear();
+		errno = EINVAL;
+		return -1;
+	}
+	fclose(f);
+
+	uint32_t bodyLen = buf.size() - SNAPSHOT_CRC_LEN;
+	reader tail(&buf[bodyLen], SNAPSHOT_CRC_LEN);
+	if(snapshotCrc32(&buf[0], bodyLen) != tail.get32()) {
+		buf.clear();
+		errno = EINVAL;
+		return -1;
+	}
+	buf.resize(bodyLen);
+	return 0;
+}
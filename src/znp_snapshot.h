@@ -0,0 +1,117 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_SNAPSHOT_H_
+#define _ZNP_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+/*
+ * Snapshot files.
+ *
+ * What the device database and the NV backup have in common: little endian
+ * fields in and out of a buffer, and a file that is the buffer with a CRC-32
+ * after it, written to a temporary file, synced and renamed over the old one
+ * so a crash leaves either the old file or the new one.
+ */
+
+static inline void put8(std::vector<uint8_t> &b, uint8_t v)
+{
+	b.push_back(v);
+}
+
+static inline void put16(std::vector<uint8_t> &b, uint16_t v)
+{
+	b.push_back(v & 0xFF);
+	b.push_back(v >> 8);
+}
+
+static inline void put32(std::vector<uint8_t> &b, uint32_t v)
+{
+	put16(b, v & 0xFFFF);
+	put16(b, v >> 16);
+}
+
+static inline void put64(std::vector<uint8_t> &b, uint64_t v)
+{
+	put32(b, v & 0xFFFFFFFF);
+	put32(b, v >> 32);
+}
+
+/*
+ * Little endian fields out of a record, reading past its end leaves ok false
+ */
+struct reader {
+	const uint8_t *p;
+	uint32_t len;
+	uint32_t pos;
+	bool ok;
+
+	reader(const uint8_t *buf, uint32_t n) : p(buf), len(n), pos(0), ok(true) {}
+
+	bool have(uint32_t n) {
+		if(!ok || len - pos < n) {
+			ok = false;
+		}
+		return ok;
+	}
+	uint8_t get8() {
+		return have(1) ? p[pos++] : 0;
+	}
+	uint16_t get16() {
+		if(!have(2)) {
+			return 0;
+		}
+		uint16_t v = p[pos] | (p[pos + 1] << 8);
+		pos += 2;
+		return v;
+	}
+	uint32_t get32() {
+		uint32_t lo = get16();
+		return lo | ((uint32_t)get16() << 16);
+	}
+	uint64_t get64() {
+		uint64_t lo = get32();
+		return lo | ((uint64_t)get32() << 32);
+	}
+	const uint8_t *bytes(uint32_t n) {
+		if(!have(n)) {
+			return NULL;
+		}
+		const uint8_t *b = &p[pos];
+		pos += n;
+		return b;
+	}
+};
+
+uint32_t snapshotCrc32(const uint8_t *p, size_t len, uint32_t crc = 0);
+//Wall clock ms, what snapshots are stamped with
+uint64_t snapshotWallMs();
+
+//Appends the CRC to buf and replaces the file with it, created with mode.
+//0, or -1 with errno set, the old file stays.
+int snapshotWrite(const std::string &path, std::vector<uint8_t> &buf, mode_t mode = 0644);
+//The file without its CRC. 0, or -1 with errno set: ENOENT no file,
+//EINVAL shorter than minLen or damaged.
+int snapshotRead(const std::string &path, std::vector<uint8_t> &buf, uint32_t minLen);
+
+#endif //_ZNP_SNAPSHOT_H_
@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "znp_srcrtg.h"
+#include "rpc.h"
+
+SourceRouteCache srcRoutes;
+
+SourceRouteCache::SourceRouteCache() :
+	maxAgeMs(15 * 60 * 1000)
+{
+	pthread_mutex_init(&lock, NULL);
+	memset(inFlight, 0, sizeof(inFlight));
+	memset(&counts, 0, sizeof(counts));
+}
+
+uint64_t SourceRouteCache::nowMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void SourceRouteCache::setMaxAge(uint32_t ms)
+{
+	pthread_mutex_lock(&lock);
+	maxAgeMs = ms;
+	pthread_mutex_unlock(&lock);
+}
+
+void SourceRouteCache::record(uint16_t dstAddr, const uint16_t *relays, uint8_t count)
+{
+	pthread_mutex_lock(&lock);
+	counts.records++;
+	if(count > SRCRTG_MAX_RELAYS) {
+		table.erase(dstAddr);
+	} else {
+		route &r = table[dstAddr];
+		r.relays.assign(relays, relays + count);
+		r.updated = nowMs();
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+int SourceRouteCache::lookup(uint16_t dstAddr, uint16_t *relays, int max)
+{
+	int count = -1;
+
+	pthread_mutex_lock(&lock);
+	std::map<uint16_t, route>::iterator it = table.find(dstAddr);
+	if(it != table.end() && maxAgeMs && nowMs() - it->second.updated > maxAgeMs) {
+		table.erase(it);
+		it = table.end();
+		counts.expired++;
+	}
+	if(it != table.end() && (int)it->second.relays.size() <= max) {
+		count = it->second.relays.size();
+		for(int i = 0; i < count; i++) {
+			relays[i] = it->second.relays[i];
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return count;
+}
+
+void SourceRouteCache::sent(uint8_t transId, uint16_t dstAddr, bool routed)
+{
+	pthread_mutex_lock(&lock);
+	inFlight[transId].dstAddr = dstAddr;
+	inFlight[transId].routed = routed;
+	if(routed) {
+		counts.hits++;
+	} else {
+		counts.misses++;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void SourceRouteCache::confirm(uint8_t transId, uint8_t status)
+{
+	pthread_mutex_lock(&lock);
+	slot &s = inFlight[transId];
+	if(s.routed && status != MT_RPC_SUCCESS) {
+		//a relay has gone or moved, route discovery finds the way until the next route record
+		if(table.erase(s.dstAddr)) {
+			counts.invalidated++;
+		}
+	}
+	s.routed = false;
+	pthread_mutex_unlock(&lock);
+}
+
+void SourceRouteCache::invalidate(uint16_t dstAddr)
+{
+	pthread_mutex_lock(&lock);
+	table.erase(dstAddr);
+	pthread_mutex_unlock(&lock);
+}
+
+void SourceRouteCache::stats(cache_stats &s)
+{
+	pthread_mutex_lock(&lock);
+	s = counts;
+	s.routes = table.size();
+	pthread_mutex_unlock(&lock);
+}
+
+void SourceRouteCache::routes(std::map<uint16_t, route> &out)
+{
+	pthread_mutex_lock(&lock);
+	out = table;
+	pthread_mutex_unlock(&lock);
+}
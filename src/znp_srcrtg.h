@@ -0,0 +1,93 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_SRCRTG_H_
+#define _ZNP_SRCRTG_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include <vector>
+
+#include "znp_cfuncs.h"
+
+/*
+ * Source route cache.
+ *
+ * The route records devices send back to the concentrator arrive as
+ * MT_ZDO_SRC_RTG_IND with the relays between us and them. Unicasts to a
+ * device with a cached route are sent source routed, so the ZNP does not
+ * broadcast a route discovery for it. A route whose frame is not delivered
+ * is dropped, as is one older than maxAge; the device's next route record
+ * brings it back.
+ *
+ * Fed from the rpc thread and read from the znp thread, it locks.
+ */
+
+class SourceRouteCache {
+	public:
+		typedef struct {
+			uint32_t	routes;
+			uint32_t	records;		//route records received
+			uint32_t	hits;			//unicasts sent source routed
+			uint32_t	misses;			//unicasts with no route cached
+			uint32_t	invalidated;	//routes dropped after a failed delivery
+			uint32_t	expired;
+		} cache_stats;
+
+		typedef struct {
+			std::vector<uint16_t> relays;
+			uint64_t	updated;		//ms, monotonic
+		} route;
+
+		SourceRouteCache();
+
+		void setMaxAge(uint32_t ms);
+
+		//A route record, relays as the device listed them: nearest to it first,
+		//which is also the order a source routed request takes them in
+		void record(uint16_t dstAddr, const uint16_t *relays, uint8_t count);
+		//Relays for dstAddr, their count or -1 if none is cached
+		int lookup(uint16_t dstAddr, uint16_t *relays, int max);
+		//A unicast is going out with transId, routed or not, so its confirm can be matched
+		void sent(uint8_t transId, uint16_t dstAddr, bool routed);
+		//Data confirm for transId, a failed source routed frame drops its route
+		void confirm(uint8_t transId, uint8_t status);
+		void invalidate(uint16_t dstAddr);
+
+		void stats(cache_stats &s);
+		void routes(std::map<uint16_t, route> &out);
+
+		static uint64_t nowMs();
+
+	private:
+		typedef struct {
+			uint16_t	dstAddr;
+			bool		routed;
+		} slot;
+
+		pthread_mutex_t lock;
+		uint32_t maxAgeMs;
+		std::map<uint16_t, route> table;
+		slot inFlight[256];				//by AF transId
+		cache_stats counts;
+};
+
+extern SourceRouteCache srcRoutes;
+
+#endif //_ZNP_SRCRTG_H_
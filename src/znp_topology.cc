@@ -0,0 +1,347 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stddef.h>
+#include <deque>
+
+#include "znp_topology.h"
+#include "mtSys.h"
+
+//Announce capability bits
+#define CAPINFO_DEVICETYPE_FFD		0x02
+
+TopologyGraph topologyGraph;
+
+TopologyGraph::TopologyGraph() :
+	lqiDelta(16)
+{
+}
+
+void TopologyGraph::learn(uint16_t nwkAddr, uint64_t extAddr, uint8_t type, uint8_t depth,
+		uint64_t now, std::vector<change> &changes)
+{
+	if(extAddr) {
+		std::map<uint64_t, uint16_t>::iterator ext = byExtAddr.find(extAddr);
+		if(ext != byExtAddr.end() && ext->second != nwkAddr) {
+			//rejoined with a new address, its links are stale but the node is not new
+			change c = { NODE_ADDR_CHANGED, ext->second, nwkAddr, 0, 0, 0 };
+			std::map<uint16_t, node>::iterator old = nodeMap.find(ext->second);
+			if(old != nodeMap.end() && !nodeMap.count(nwkAddr)) {
+				nodeMap[nwkAddr] = old->second;
+			}
+			removeNode(ext->second, changes);
+			changes.push_back(c);
+		}
+		byExtAddr[extAddr] = nwkAddr;
+	}
+
+	std::map<uint16_t, node>::iterator it = nodeMap.find(nwkAddr);
+	if(it == nodeMap.end()) {
+		node n = { extAddr, type, depth, now };
+		nodeMap[nwkAddr] = n;
+		change c = { NODE_ADDED, nwkAddr, nwkAddr, 0, 0, 0 };
+		changes.push_back(c);
+		return;
+	}
+
+	node &n = it->second;
+	if(extAddr) {
+		n.extAddr = extAddr;
+	}
+	if(type != 0xFF) {
+		n.type = type;
+	}
+	if(depth != 0xFF) {
+		n.depth = depth;
+	}
+	n.seen = now;
+}
+
+void TopologyGraph::removeLink(std::map<uint32_t, link>::iterator it, std::vector<change> &changes)
+{
+	uint16_t from = it->first >> 16, to = it->first & 0xFFFF;
+	change c = { LINK_REMOVED, from, to, it->second.lqi, it->second.reportedLqi, it->second.relation };
+
+	if(it->second.relation == LQI_RELATION_CHILD) {
+		std::map<uint16_t, uint16_t>::iterator p = parentOf.find(to);
+		if(p != parentOf.end() && p->second == from) {
+			parentOf.erase(p);
+		}
+	} else if(it->second.relation == LQI_RELATION_PARENT) {
+		std::map<uint16_t, uint16_t>::iterator p = parentOf.find(from);
+		if(p != parentOf.end() && p->second == to) {
+			parentOf.erase(p);
+		}
+	}
+
+	reverse.erase(key(to, from));
+	linkMap.erase(it);
+	changes.push_back(c);
+}
+
+void TopologyGraph::removeRoute(uint32_t k, std::vector<change> &changes)
+{
+	change c = { ROUTE_REMOVED, (uint16_t)(k >> 16), (uint16_t)(k & 0xFFFF), 0, 0, LQI_RELATION_NONE };
+
+	routeReverse.erase(key(k & 0xFFFF, k >> 16));
+	routeSet.erase(k);
+	changes.push_back(c);
+}
+
+void TopologyGraph::removeNode(uint16_t nwkAddr, std::vector<change> &changes)
+{
+	std::vector<uint32_t> in;
+
+	while(true) {
+		std::map<uint32_t, link>::iterator it = linkMap.lower_bound(key(nwkAddr, 0));
+		if(it == linkMap.end() || (it->first >> 16) != nwkAddr) {
+			break;
+		}
+		removeLink(it, changes);
+	}
+
+	for(std::set<uint32_t>::iterator r = reverse.lower_bound(key(nwkAddr, 0));
+			r != reverse.end() && (*r >> 16) == nwkAddr; r++) {
+		in.push_back(key(*r & 0xFFFF, nwkAddr));
+	}
+	for(size_t i = 0; i < in.size(); i++) {
+		std::map<uint32_t, link>::iterator it = linkMap.find(in[i]);
+		if(it != linkMap.end()) {
+			removeLink(it, changes);
+		}
+	}
+
+	while(true) {
+		std::set<uint32_t>::iterator it = routeSet.lower_bound(key(nwkAddr, 0));
+		if(it == routeSet.end() || (*it >> 16) != nwkAddr) {
+			break;
+		}
+		removeRoute(*it, changes);
+	}
+	in.clear();
+	for(std::set<uint32_t>::iterator r = routeReverse.lower_bound(key(nwkAddr, 0));
+			r != routeReverse.end() && (*r >> 16) == nwkAddr; r++) {
+		in.push_back(key(*r & 0xFFFF, nwkAddr));
+	}
+	for(size_t i = 0; i < in.size(); i++) {
+		removeRoute(in[i], changes);
+	}
+
+	parentOf.erase(nwkAddr);
+	nodeMap.erase(nwkAddr);
+}
+
+void TopologyGraph::updateRouter(uint16_t nwkAddr, const std::vector<LqiCrawler::neighbor> &table,
+		uint64_t now, std::vector<change> &changes)
+{
+	std::set<uint16_t> listed;
+
+	learn(nwkAddr, 0, nwkAddr == 0 ? DEVICETYPE_COORDINATOR : DEVICETYPE_ROUTER, 0xFF, now, changes);
+
+	for(size_t i = 0; i < table.size(); i++) {
+		const LqiCrawler::neighbor &n = table[i];
+
+		if(n.relation == LQI_RELATION_PREV_CHILD || n.nwkAddr == nwkAddr) {
+			continue;
+		}
+		learn(n.nwkAddr, n.extAddr, n.type, n.depth, now, changes);
+		listed.insert(n.nwkAddr);
+
+		uint32_t k = key(nwkAddr, n.nwkAddr);
+		std::map<uint32_t, link>::iterator it = linkMap.find(k);
+		if(it == linkMap.end()) {
+			link l = { n.lqi, n.lqi, n.relation, now };
+			linkMap[k] = l;
+			reverse.insert(key(n.nwkAddr, nwkAddr));
+			change c = { LINK_ADDED, nwkAddr, n.nwkAddr, n.lqi, 0, n.relation };
+			changes.push_back(c);
+		} else {
+			link &l = it->second;
+			int moved = (int)n.lqi - (int)l.reportedLqi;
+			l.lqi = n.lqi;
+			l.seen = now;
+			if(moved >= lqiDelta || -moved >= lqiDelta || l.relation != n.relation) {
+				change c = { LINK_CHANGED, nwkAddr, n.nwkAddr, n.lqi, l.reportedLqi, n.relation };
+				changes.push_back(c);
+				l.reportedLqi = n.lqi;
+				l.relation = n.relation;
+			}
+		}
+
+		if(n.relation == LQI_RELATION_CHILD) {
+			parentOf[n.nwkAddr] = nwkAddr;
+		} else if(n.relation == LQI_RELATION_PARENT) {
+			parentOf[nwkAddr] = n.nwkAddr;
+		}
+	}
+
+	//links the table no longer lists
+	std::map<uint32_t, link>::iterator it = linkMap.lower_bound(key(nwkAddr, 0));
+	while(it != linkMap.end() && (it->first >> 16) == nwkAddr) {
+		if(listed.count(it->first & 0xFFFF)) {
+			it++;
+		} else {
+			std::map<uint32_t, link>::iterator gone = it++;
+			removeLink(gone, changes);
+		}
+	}
+}
+
+void TopologyGraph::updateRoutes(uint16_t nwkAddr, const std::map<uint16_t, RtgHarvester::route> &table,
+		uint64_t now, std::vector<change> &changes)
+{
+	std::set<uint16_t> hops;
+
+	learn(nwkAddr, 0, nwkAddr == 0 ? DEVICETYPE_COORDINATOR : DEVICETYPE_ROUTER, 0xFF, now, changes);
+
+	//routes being discovered or that failed do not go anywhere yet
+	for(std::map<uint16_t, RtgHarvester::route>::const_iterator it = table.begin(); it != table.end(); it++) {
+		if(it->second.status == RTG_STATUS_ACTIVE && it->second.nextHop != nwkAddr) {
+			hops.insert(it->second.nextHop);
+		}
+	}
+
+	for(std::set<uint16_t>::iterator h = hops.begin(); h != hops.end(); h++) {
+		learn(*h, 0, 0xFF, 0xFF, now, changes);
+		if(routeSet.insert(key(nwkAddr, *h)).second) {
+			routeReverse.insert(key(*h, nwkAddr));
+			change c = { ROUTE_ADDED, nwkAddr, *h, 0, 0, LQI_RELATION_NONE };
+			changes.push_back(c);
+		}
+	}
+
+	//next hops no route uses any more
+	std::set<uint32_t>::iterator it = routeSet.lower_bound(key(nwkAddr, 0));
+	while(it != routeSet.end() && (*it >> 16) == nwkAddr) {
+		uint32_t k = *it++;
+		if(!hops.count(k & 0xFFFF)) {
+			removeRoute(k, changes);
+		}
+	}
+}
+
+void TopologyGraph::announce(uint16_t nwkAddr, uint64_t extAddr, uint8_t capabilities,
+		uint64_t now, std::vector<change> &changes)
+{
+	learn(nwkAddr, extAddr, (capabilities & CAPINFO_DEVICETYPE_FFD) ? DEVICETYPE_ROUTER : DEVICETYPE_ENDDEVICE,
+			0xFF, now, changes);
+}
+
+bool TopologyGraph::parent(uint16_t nwkAddr, uint16_t &p) const
+{
+	std::map<uint16_t, uint16_t>::const_iterator it = parentOf.find(nwkAddr);
+	if(it == parentOf.end()) {
+		return false;
+	}
+	p = it->second;
+	return true;
+}
+
+bool TopologyGraph::path(uint16_t nwkAddr, std::vector<uint16_t> &p) const
+{
+	std::map<uint16_t, uint16_t> via;
+	std::deque<uint16_t> q;
+
+	//breadth first from the coordinator, links and route links count both ways
+	const std::set<uint32_t> *adjacent[3] = { &reverse, &routeSet, &routeReverse };
+	via[0] = 0;
+	q.push_back(0);
+	while(!q.empty() && !via.count(nwkAddr)) {
+		uint16_t at = q.front();
+		q.pop_front();
+
+		for(std::map<uint32_t, link>::const_iterator it = linkMap.lower_bound(key(at, 0));
+				it != linkMap.end() && (it->first >> 16) == at; it++) {
+			uint16_t next = it->first & 0xFFFF;
+			if(!via.count(next)) {
+				via[next] = at;
+				q.push_back(next);
+			}
+		}
+		for(size_t i = 0; i < sizeof(adjacent) / sizeof(adjacent[0]); i++) {
+			for(std::set<uint32_t>::const_iterator it = adjacent[i]->lower_bound(key(at, 0));
+					it != adjacent[i]->end() && (*it >> 16) == at; it++) {
+				uint16_t next = *it & 0xFFFF;
+				if(!via.count(next)) {
+					via[next] = at;
+					q.push_back(next);
+				}
+			}
+		}
+	}
+
+	if(!via.count(nwkAddr)) {
+		return false;
+	}
+	p.clear();
+	for(uint16_t at = nwkAddr; at != 0; at = via[at]) {
+		p.push_back(at);
+	}
+	p.push_back(0);
+	return true;
+}
+
+bool TopologyGraph::linkLqi(uint16_t a, uint16_t b, uint8_t &lqi) const
+{
+	std::map<uint32_t, link>::const_iterator ab = linkMap.find(key(a, b));
+	std::map<uint32_t, link>::const_iterator ba = linkMap.find(key(b, a));
+
+	if(ab == linkMap.end() && ba == linkMap.end()) {
+		return false;
+	}
+	//a link is only as good as its worse direction
+	lqi = 0xFF;
+	if(ab != linkMap.end()) {
+		lqi = ab->second.lqi;
+	}
+	if(ba != linkMap.end() && ba->second.lqi < lqi) {
+		lqi = ba->second.lqi;
+	}
+	return true;
+}
+
+int TopologyGraph::hops(uint16_t nwkAddr) const
+{
+	std::vector<uint16_t> p;
+
+	if(!path(nwkAddr, p)) {
+		return -1;
+	}
+	return p.size() - 1;
+}
+
+bool TopologyGraph::weakestLink(uint16_t nwkAddr, uint16_t &from, uint16_t &to, uint8_t &lqi) const
+{
+	std::vector<uint16_t> p;
+	bool found = false;
+
+	if(!path(nwkAddr, p)) {
+		return false;
+	}
+	//p runs from nwkAddr back to the coordinator
+	for(size_t i = p.size() - 1; i > 0; i--) {
+		uint8_t l;
+		if(linkLqi(p[i], p[i - 1], l) && (!found || l < lqi)) {
+			from = p[i];
+			to = p[i - 1];
+			lqi = l;
+			found = true;
+		}
+	}
+	return found;
+}
@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_TOPOLOGY_H_
+#define _ZNP_TOPOLOGY_H_
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "znp_lqi.h"
+#include "znp_rtg.h"
+
+/*
+ * Network topology graph.
+ *
+ * Nodes are devices by nwk address, links are neighbor table entries: a link
+ * from a to b is b as seen in a's table, with its LQI and relationship.
+ * Route links are the next hops of a router's active routes, from the
+ * harvester's routing tables. Neighbor and routing tables replace what the
+ * same router reported before and device announces add nodes or move them
+ * to a new nwk address.
+ * Every update returns what changed, so listeners keep their own copy in
+ * step without rebuilding it.
+ *
+ * Only used from the v8 thread, it does not lock.
+ */
+class TopologyGraph {
+	public:
+		enum change_kind {
+			NODE_ADDED,
+			NODE_ADDR_CHANGED,		//from is the old nwk address, to the new one
+			LINK_ADDED,
+			LINK_REMOVED,
+			LINK_CHANGED,			//LQI moved by lqiDelta or more since last reported
+			ROUTE_ADDED,			//from routes through its neighbor to
+			ROUTE_REMOVED
+		};
+
+		typedef struct {
+			change_kind	kind;
+			uint16_t	from;
+			uint16_t	to;
+			uint8_t		lqi;
+			uint8_t		prevLqi;
+			uint8_t		relation;	//LQI_RELATION_*, as seen by from
+		} change;
+
+		typedef struct {
+			uint64_t	extAddr;	//0 if not known yet
+			uint8_t		type;		//DEVICETYPE_*, 0xFF if not known yet
+			uint8_t		depth;		//0xFF if not known yet
+			uint64_t	seen;		//ms, loop time
+		} node;
+
+		typedef struct {
+			uint8_t		lqi;
+			uint8_t		reportedLqi;	//as last given in a change
+			uint8_t		relation;
+			uint64_t	seen;
+		} link;
+
+		TopologyGraph();
+
+		void setLqiDelta(uint8_t delta) { lqiDelta = delta; }
+
+		//Neighbor table of nwkAddr, links it no longer lists are removed
+		void updateRouter(uint16_t nwkAddr, const std::vector<LqiCrawler::neighbor> &table,
+				uint64_t now, std::vector<change> &changes);
+		//Routing table of nwkAddr, next hops no active route uses any more are removed
+		void updateRoutes(uint16_t nwkAddr, const std::map<uint16_t, RtgHarvester::route> &table,
+				uint64_t now, std::vector<change> &changes);
+		//Device announce
+		void announce(uint16_t nwkAddr, uint64_t extAddr, uint8_t capabilities,
+				uint64_t now, std::vector<change> &changes);
+
+		bool parent(uint16_t nwkAddr, uint16_t &p) const;
+		//Hops from the coordinator over known links, -1 if nwkAddr can not be reached
+		int hops(uint16_t nwkAddr) const;
+		//Lowest LQI link on the shortest path from the coordinator
+		bool weakestLink(uint16_t nwkAddr, uint16_t &from, uint16_t &to, uint8_t &lqi) const;
+
+		const std::map<uint16_t, uint16_t> &parents() const { return parentOf; }
+		const std::map<uint16_t, node> &nodes() const { return nodeMap; }
+		const std::map<uint32_t, link> &links() const { return linkMap; }		//from << 16 | to
+		const std::set<uint32_t> &routes() const { return routeSet; }			//from << 16 | next hop
+
+	private:
+		static uint32_t key(uint16_t from, uint16_t to) { return ((uint32_t)from << 16) | to; }
+
+		void learn(uint16_t nwkAddr, uint64_t extAddr, uint8_t type, uint8_t depth,
+				uint64_t now, std::vector<change> &changes);
+		void removeLink(std::map<uint32_t, link>::iterator it, std::vector<change> &changes);
+		void removeRoute(uint32_t k, std::vector<change> &changes);
+		void removeNode(uint16_t nwkAddr, std::vector<change> &changes);
+		bool path(uint16_t nwkAddr, std::vector<uint16_t> &p) const;
+		bool linkLqi(uint16_t a, uint16_t b, uint8_t &lqi) const;
+
+		std::map<uint16_t, node> nodeMap;
+		std::map<uint32_t, link> linkMap;
+		std::set<uint32_t> reverse;				//to << 16 | from of every link
+		std::set<uint32_t> routeSet;
+		std::set<uint32_t> routeReverse;		//next hop << 16 | from of every route link
+		std::map<uint16_t, uint16_t> parentOf;
+		std::map<uint64_t, uint16_t> byExtAddr;
+		uint8_t lqiDelta;
+};
+
+extern TopologyGraph topologyGraph;
+
+#endif //_ZNP_TOPOLOGY_H_
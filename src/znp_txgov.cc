@@ -0,0 +1,196 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "znp_txgov.h"
+#include "mtAf.h"
+#include "dbgPrint.h"
+
+/*
+ * 802.15.4 O-QPSK at 2.4GHz: 250 kbps, so every byte costs 32us on air.
+ * Frame overhead on top of the APS payload:
+ *   PHY  preamble + SFD + PHR                      6
+ *   MAC  header (short addressing) + FCS          11
+ *   NWK  header + security aux header + MIC       26
+ *   APS  header                                    8
+ * A unicast hop also pays for the turnaround and the MAC ack, every
+ * transmission pays for the average CSMA-CA backoff and CCA.
+ */
+#define TXGOV_US_PER_BYTE		32
+#define TXGOV_FRAME_OVERHEAD	51
+#define TXGOV_ACK_US			(192 + 11 * TXGOV_US_PER_BYTE)
+#define TXGOV_CSMA_US			(1120 + 128)
+#define TXGOV_IFS_US			640
+
+TxGovernor txGovernor;
+
+TxGovernor::TxGovernor() : usedUs(0), backoffLevel(0), backoffUntil(0)
+{
+	pthread_mutex_init(&lock, NULL);
+
+	opts.windowMs = 1000;
+	opts.dutyCycle = 25;
+	opts.bttSize = 8;			//Z-Stack keeps 9 entries, leave one for the stack
+	opts.bcastDeliveryMs = 3000;
+	opts.unicastHops = 2;
+	opts.bcastRelays = 6;
+	opts.backoffBaseMs = 50;
+	opts.backoffMaxMs = 2000;
+}
+
+TxGovernor::~TxGovernor()
+{
+	pthread_mutex_destroy(&lock);
+}
+
+void TxGovernor::configure(const txgov_options &o)
+{
+	pthread_mutex_lock(&lock);
+	opts = o;
+	if(opts.windowMs == 0) opts.windowMs = 1;
+	if(opts.dutyCycle == 0 || opts.dutyCycle > 100) opts.dutyCycle = 100;
+	if(opts.bttSize == 0) opts.bttSize = 1;
+	if(opts.unicastHops == 0) opts.unicastHops = 1;
+	pthread_mutex_unlock(&lock);
+}
+
+uint64_t TxGovernor::nowMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool TxGovernor::isBroadcast(uint8_t addrMode, uint16_t dstAddr)
+{
+	//Groupcasts travel as NWK broadcasts and take a BTT entry as well
+	if(addrMode == afAddrBroadcast || addrMode == afAddrGroup) {
+		return true;
+	}
+	return (addrMode == afAddr16Bit && dstAddr >= 0xFFF8);
+}
+
+uint32_t TxGovernor::airtimeUs(uint8_t addrMode, uint16_t dstAddr, uint16_t payloadLen) const
+{
+	uint32_t frame = (TXGOV_FRAME_OVERHEAD + payloadLen) * TXGOV_US_PER_BYTE + TXGOV_CSMA_US + TXGOV_IFS_US;
+
+	if(isBroadcast(addrMode, dstAddr)) {
+		//no MAC ack, but every router in range repeats it
+		return frame * (1 + opts.bcastRelays);
+	}
+	return (frame + TXGOV_ACK_US) * opts.unicastHops;
+}
+
+void TxGovernor::prune(uint64_t now)
+{
+	while(!samples.empty() && samples.front().when + opts.windowMs <= now) {
+		usedUs -= samples.front().airtime;
+		samples.pop_front();
+	}
+	while(!bcastExpiry.empty() && bcastExpiry.front() <= now) {
+		bcastExpiry.pop_front();
+	}
+}
+
+uint32_t TxGovernor::admit(uint8_t addrMode, uint16_t dstAddr, uint16_t payloadLen)
+{
+	uint32_t wait = 0;
+	uint64_t now = nowMs();
+
+	pthread_mutex_lock(&lock);
+	prune(now);
+
+	if(now < backoffUntil) {
+		wait = backoffUntil - now;
+	} else if(isBroadcast(addrMode, dstAddr) && bcastExpiry.size() >= opts.bttSize) {
+		wait = bcastExpiry.front() - now;
+	} else {
+		uint64_t budget = (uint64_t)opts.windowMs * 10 * opts.dutyCycle;	//ms * 1000 * pct / 100
+		uint32_t cost = airtimeUs(addrMode, dstAddr, payloadLen);
+
+		//a single frame bigger than the whole budget still has to go out on an idle channel
+		if(!samples.empty() && usedUs + cost > budget) {
+			uint64_t used = usedUs;
+			std::deque<txSample>::iterator it = samples.begin();
+			while(it != samples.end() && used + cost > budget) {
+				used -= it->airtime;
+				wait = it->when + opts.windowMs - now;
+				it++;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	if(wait > 0) {
+		dbg_print(PRINT_LEVEL_VERBOSE, "TxGovernor: holding frame to 0x%04x for %dms\n", dstAddr, wait);
+	}
+	return wait;
+}
+
+void TxGovernor::commit(uint8_t addrMode, uint16_t dstAddr, uint16_t payloadLen)
+{
+	uint64_t now = nowMs();
+	txSample s;
+
+	pthread_mutex_lock(&lock);
+	prune(now);
+
+	s.when = now;
+	s.airtime = airtimeUs(addrMode, dstAddr, payloadLen);
+	samples.push_back(s);
+	usedUs += s.airtime;
+
+	if(isBroadcast(addrMode, dstAddr)) {
+		bcastExpiry.push_back(now + opts.bcastDeliveryMs);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void TxGovernor::confirm(uint8_t status)
+{
+	pthread_mutex_lock(&lock);
+	switch(status) {
+		case TXGOV_STATUS_MEM_FAIL:
+		case TXGOV_STATUS_BUFFER_FULL:
+		case TXGOV_STATUS_MAC_CHANNEL_ACCESS_FAILURE:
+		case TXGOV_STATUS_MAC_TRANSACTION_OVERFLOW:
+		{
+			uint32_t hold = opts.backoffBaseMs << backoffLevel;
+			if(hold > opts.backoffMaxMs) {
+				hold = opts.backoffMaxMs;
+			} else if(backoffLevel < 16) {
+				backoffLevel++;
+			}
+			backoffUntil = nowMs() + hold;
+			dbg_print(PRINT_LEVEL_INFO, "TxGovernor: ZNP congested (status 0x%02x), backing off %dms\n", status, hold);
+			break;
+		}
+
+		case afStatus_SUCCESS:
+			backoffLevel = 0;
+			break;
+
+		default:
+			//delivery failures (no ack, no route) say nothing about channel load
+			break;
+	}
+	pthread_mutex_unlock(&lock);
+}
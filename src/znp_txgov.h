@@ -0,0 +1,93 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_TXGOV_H_
+#define _ZNP_TXGOV_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+
+/*
+ * Transmit governor.
+ *
+ * Paces outbound frames so the gateway stays under a channel utilization
+ * budget (250 kbps, 32us per byte on air) and never has more broadcasts in
+ * flight than the ZNP broadcast transaction table (BTT) can hold. Congestion
+ * statuses reported back by the ZNP push the governor into an exponential
+ * backoff until a frame is delivered again.
+ */
+
+//Data confirm / SRSP statuses that mean the ZNP or the channel is overloaded
+#define TXGOV_STATUS_MEM_FAIL					0x10	//ZMemError
+#define TXGOV_STATUS_BUFFER_FULL				0x11	//ZBufferFull
+#define TXGOV_STATUS_MAC_CHANNEL_ACCESS_FAILURE	0xE1
+#define TXGOV_STATUS_MAC_TRANSACTION_OVERFLOW	0xF1
+
+typedef struct {
+	uint32_t	windowMs;			//sliding window the utilization budget applies to
+	uint8_t		dutyCycle;			//percent of the window we may spend on air
+	uint8_t		bttSize;			//broadcasts allowed in flight at once
+	uint32_t	bcastDeliveryMs;	//time a broadcast occupies a BTT entry
+	uint8_t		unicastHops;		//estimated hops for a unicast frame
+	uint8_t		bcastRelays;		//estimated routers re-broadcasting a frame
+	uint32_t	backoffBaseMs;
+	uint32_t	backoffMaxMs;
+} txgov_options;
+
+class TxGovernor {
+	public:
+		TxGovernor();
+		~TxGovernor();
+
+		void configure(const txgov_options &opts);
+		const txgov_options &options() const { return opts; }
+
+		//Returns 0 if the frame may go out now, otherwise the number of ms to hold it
+		uint32_t admit(uint8_t addrMode, uint16_t dstAddr, uint16_t payloadLen);
+		//Account a frame the ZNP accepted for transmission
+		void commit(uint8_t addrMode, uint16_t dstAddr, uint16_t payloadLen);
+		//Feed a data confirm (or SRSP) status back into the backoff
+		void confirm(uint8_t status);
+
+		static bool isBroadcast(uint8_t addrMode, uint16_t dstAddr);
+		uint32_t airtimeUs(uint8_t addrMode, uint16_t dstAddr, uint16_t payloadLen) const;
+
+	private:
+		typedef struct {
+			uint64_t	when;
+			uint32_t	airtime;
+		} txSample;
+
+		void prune(uint64_t now);
+		static uint64_t nowMs();
+
+		txgov_options opts;
+		pthread_mutex_t lock;
+
+		std::deque<txSample> samples;
+		uint64_t usedUs;
+		std::deque<uint64_t> bcastExpiry;
+
+		uint8_t backoffLevel;
+		uint64_t backoffUntil;
+};
+
+extern TxGovernor txGovernor;
+
+#endif //_ZNP_TXGOV_H_
@@ -0,0 +1,681 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <node.h>
+
+#include "znp_zcltypes.h"
+#include "znp_cfuncs.h"
+#include "zcl_port.h"
+#include "zcl.h"
+
+using namespace v8;
+
+//arrays and structs may nest, but not without bound
+#define ZCL_MAX_NESTING		4
+
+static constexpr zclTypeInfo zclTypeTable[] = {
+	{ ZCL_DATATYPE_NO_DATA,			ZCL_KIND_NONE,				0,		false },
+	{ ZCL_DATATYPE_DATA8,			ZCL_KIND_UINT,				1,		false },
+	{ ZCL_DATATYPE_DATA16,			ZCL_KIND_UINT,				2,		false },
+	{ ZCL_DATATYPE_DATA24,			ZCL_KIND_UINT,				3,		false },
+	{ ZCL_DATATYPE_DATA32,			ZCL_KIND_UINT,				4,		false },
+	{ ZCL_DATATYPE_DATA40,			ZCL_KIND_UINT,				5,		false },
+	{ ZCL_DATATYPE_DATA48,			ZCL_KIND_UINT,				6,		false },
+	{ ZCL_DATATYPE_DATA56,			ZCL_KIND_UINT,				7,		false },
+	{ ZCL_DATATYPE_DATA64,			ZCL_KIND_UINT,				8,		false },
+	{ ZCL_DATATYPE_BOOLEAN,			ZCL_KIND_BOOL,				1,		false },
+	{ ZCL_DATATYPE_BITMAP8,			ZCL_KIND_UINT,				1,		false },
+	{ ZCL_DATATYPE_BITMAP16,		ZCL_KIND_UINT,				2,		false },
+	{ ZCL_DATATYPE_BITMAP24,		ZCL_KIND_UINT,				3,		false },
+	{ ZCL_DATATYPE_BITMAP32,		ZCL_KIND_UINT,				4,		false },
+	{ ZCL_DATATYPE_BITMAP40,		ZCL_KIND_UINT,				5,		false },
+	{ ZCL_DATATYPE_BITMAP48,		ZCL_KIND_UINT,				6,		false },
+	{ ZCL_DATATYPE_BITMAP56,		ZCL_KIND_UINT,				7,		false },
+	{ ZCL_DATATYPE_BITMAP64,		ZCL_KIND_UINT,				8,		false },
+	{ ZCL_DATATYPE_UINT8,			ZCL_KIND_UINT,				1,		true },
+	{ ZCL_DATATYPE_UINT16,			ZCL_KIND_UINT,				2,		true },
+	{ ZCL_DATATYPE_UINT24,			ZCL_KIND_UINT,				3,		true },
+	{ ZCL_DATATYPE_UINT32,			ZCL_KIND_UINT,				4,		true },
+	{ ZCL_DATATYPE_UINT40,			ZCL_KIND_UINT,				5,		true },
+	{ ZCL_DATATYPE_UINT48,			ZCL_KIND_UINT,				6,		true },
+	{ ZCL_DATATYPE_UINT56,			ZCL_KIND_UINT,				7,		true },
+	{ ZCL_DATATYPE_UINT64,			ZCL_KIND_UINT,				8,		true },
+	{ ZCL_DATATYPE_INT8,			ZCL_KIND_INT,				1,		true },
+	{ ZCL_DATATYPE_INT16,			ZCL_KIND_INT,				2,		true },
+	{ ZCL_DATATYPE_INT24,			ZCL_KIND_INT,				3,		true },
+	{ ZCL_DATATYPE_INT32,			ZCL_KIND_INT,				4,		true },
+	{ ZCL_DATATYPE_INT40,			ZCL_KIND_INT,				5,		true },
+	{ ZCL_DATATYPE_INT48,			ZCL_KIND_INT,				6,		true },
+	{ ZCL_DATATYPE_INT56,			ZCL_KIND_INT,				7,		true },
+	{ ZCL_DATATYPE_INT64,			ZCL_KIND_INT,				8,		true },
+	{ ZCL_DATATYPE_ENUM8,			ZCL_KIND_UINT,				1,		false },
+	{ ZCL_DATATYPE_ENUM16,			ZCL_KIND_UINT,				2,		false },
+	{ ZCL_DATATYPE_SEMI_PREC,		ZCL_KIND_FLOAT,				2,		true },
+	{ ZCL_DATATYPE_SINGLE_PREC,		ZCL_KIND_FLOAT,				4,		true },
+	{ ZCL_DATATYPE_DOUBLE_PREC,		ZCL_KIND_FLOAT,				8,		true },
+	{ ZCL_DATATYPE_OCTET_STR,		ZCL_KIND_OCTET_STR,			0,		false },
+	{ ZCL_DATATYPE_CHAR_STR,		ZCL_KIND_CHAR_STR,			0,		false },
+	{ ZCL_DATATYPE_LONG_OCTET_STR,	ZCL_KIND_LONG_OCTET_STR,	0,		false },
+	{ ZCL_DATATYPE_LONG_CHAR_STR,	ZCL_KIND_LONG_CHAR_STR,		0,		false },
+	{ ZCL_DATATYPE_ARRAY,			ZCL_KIND_ARRAY,				0,		false },
+	{ ZCL_DATATYPE_STRUCT,			ZCL_KIND_STRUCT,			0,		false },
+	{ ZCL_DATATYPE_SET,				ZCL_KIND_ARRAY,				0,		false },
+	{ ZCL_DATATYPE_BAG,				ZCL_KIND_ARRAY,				0,		false },
+	{ ZCL_DATATYPE_TOD,				ZCL_KIND_TOD,				4,		true },
+	{ ZCL_DATATYPE_DATE,			ZCL_KIND_DATE,				4,		true },
+	{ ZCL_DATATYPE_UTC,				ZCL_KIND_UINT,				4,		true },
+	{ ZCL_DATATYPE_CLUSTER_ID,		ZCL_KIND_UINT,				2,		false },
+	{ ZCL_DATATYPE_ATTR_ID,			ZCL_KIND_UINT,				2,		false },
+	{ ZCL_DATATYPE_BAC_OID,			ZCL_KIND_UINT,				4,		false },
+	{ ZCL_DATATYPE_IEEE_ADDR,		ZCL_KIND_BYTES,				8,		false },
+	{ ZCL_DATATYPE_128_BIT_SEC_KEY,	ZCL_KIND_BYTES,				SEC_KEY_LEN,	false },
+};
+
+static constexpr size_t zclTypeCount = sizeof(zclTypeTable) / sizeof(zclTypeTable[0]);
+static constexpr zclTypeInfo zclUnknownType = { ZCL_DATATYPE_UNKNOWN, ZCL_KIND_UNKNOWN, 0, false };
+
+static constexpr const zclTypeInfo &zclTypeLookup(uint8_t dataType, size_t i = 0)
+{
+	return i == zclTypeCount ? zclUnknownType :
+		zclTypeTable[i].dataType == dataType ? zclTypeTable[i] : zclTypeLookup(dataType, i + 1);
+}
+
+//spot checks against the ZCL specification, the zcl library takes its sizes
+//from this table through zWZclTypeLength / zWZclAnalogType
+static_assert(zclTypeLookup(ZCL_DATATYPE_BOOLEAN).size == 1, "ZCL boolean size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_UINT24).size == 3, "ZCL uint24 size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_INT56).size == 7, "ZCL int56 size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_SEMI_PREC).size == 2, "ZCL semi precision size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_UTC).size == 4, "ZCL UTC time size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_IEEE_ADDR).size == 8, "ZCL IEEE address size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_BITMAP40).size == 5, "ZCL bitmap40 size");
+static_assert(zclTypeLookup(ZCL_DATATYPE_TOD).analog && !zclTypeLookup(ZCL_DATATYPE_ENUM8).analog, "ZCL analog types");
+static_assert(zclTypeLookup(0x07).kind == ZCL_KIND_UNKNOWN, "reserved ZCL data types are unknown");
+
+/*
+ * The table indexed by data type, built on first use.
+ */
+static const zclTypeInfo *zclTypeIndex[256];
+
+static bool indexTypes()
+{
+	for(int i = 0; i < 256; i++) {
+		zclTypeIndex[i] = &zclUnknownType;
+	}
+	for(size_t i = 0; i < zclTypeCount; i++) {
+		zclTypeIndex[zclTypeTable[i].dataType] = &zclTypeTable[i];
+	}
+	return true;
+}
+
+const zclTypeInfo *zclTypeOf(uint8_t dataType)
+{
+	static bool indexed = indexTypes();
+	(void)indexed;
+	return zclTypeIndex[dataType];
+}
+
+uint8_t zWZclTypeLength(uint8_t dataType)
+{
+	return zclTypeOf(dataType)->size;
+}
+
+uint8_t zWZclAnalogType(uint8_t dataType)
+{
+	return zclTypeOf(dataType)->analog;
+}
+
+static int valueLength(uint8_t dataType, const uint8_t *data, uint16_t avail, int depth)
+{
+	const zclTypeInfo *t = zclTypeOf(dataType);
+	int len;
+
+	switch(t->kind) {
+		case ZCL_KIND_UNKNOWN:
+			return -1;
+
+		case ZCL_KIND_OCTET_STR:
+		case ZCL_KIND_CHAR_STR:
+			if(avail < 1) {
+				return -1;
+			}
+			len = 1 + (data[0] == 0xFF ? 0 : data[0]);	//0xFF - invalid
+			break;
+
+		case ZCL_KIND_LONG_OCTET_STR:
+		case ZCL_KIND_LONG_CHAR_STR:
+		{
+			if(avail < 2) {
+				return -1;
+			}
+			uint16_t n = BUILD_UINT16(data[0], data[1]);
+			len = 2 + (n == 0xFFFF ? 0 : n);
+			break;
+		}
+
+		case ZCL_KIND_ARRAY:
+		{
+			//element type, element count, elements
+			if(avail < 3 || depth >= ZCL_MAX_NESTING) {
+				return -1;
+			}
+			uint16_t n = BUILD_UINT16(data[1], data[2]);
+			len = 3;
+			for(uint16_t i = 0; n != 0xFFFF && i < n; i++) {
+				int e = valueLength(data[0], data + len, avail - len, depth + 1);
+				if(e < 0) {
+					return -1;
+				}
+				len += e;
+			}
+			break;
+		}
+
+		case ZCL_KIND_STRUCT:
+		{
+			//element count, then element type and value for each
+			if(avail < 2 || depth >= ZCL_MAX_NESTING) {
+				return -1;
+			}
+			uint16_t n = BUILD_UINT16(data[0], data[1]);
+			len = 2;
+			for(uint16_t i = 0; n != 0xFFFF && i < n; i++) {
+				if(len + 1 > avail) {
+					return -1;
+				}
+				int e = valueLength(data[len], data + len + 1, avail - len - 1, depth + 1);
+				if(e < 0) {
+					return -1;
+				}
+				len += 1 + e;
+			}
+			break;
+		}
+
+		default:
+			len = t->size;
+			break;
+	}
+
+	return len > avail ? -1 : len;
+}
+
+int zclValueLength(uint8_t dataType, const uint8_t *data, uint16_t avail)
+{
+	return valueLength(dataType, data, avail, 0);
+}
+
+static double halfToDouble(uint16_t h)
+{
+	int e = (h >> 10) & 0x1F;
+	int m = h & 0x3FF;
+	double v;
+
+	if(e == 0) {
+		v = ldexp(m, -24);
+	} else if(e == 31) {
+		v = m ? NAN : INFINITY;
+	} else {
+		v = ldexp(m + 1024, e - 25);
+	}
+	return (h & 0x8000) ? -v : v;
+}
+
+static Local<Value> decodeValue(uint8_t dataType, const uint8_t *data, uint16_t len, int depth)
+{
+	const zclTypeInfo *t = zclTypeOf(dataType);
+
+	switch(t->kind) {
+		case ZCL_KIND_NONE:
+			return Nan::Null();
+
+		case ZCL_KIND_BOOL:
+			if(len >= 1) {
+				return Nan::New<v8::Boolean>(data[0] != 0);
+			}
+			break;
+
+		case ZCL_KIND_UINT:
+		case ZCL_KIND_INT:
+		{
+			if(len < t->size) {
+				break;
+			}
+			uint64_t u = 0;
+			for(int i = t->size - 1; i >= 0; i--) {
+				u = (u << 8) | data[i];
+			}
+			//values above 2^53 lose precision, same as any JS number
+			if(t->kind == ZCL_KIND_INT) {
+				if(t->size < 8 && (u >> (t->size * 8 - 1)) & 1) {
+					u |= ~(uint64_t)0 << (t->size * 8);	//sign extend
+				}
+				return Nan::New<v8::Number>((double)(int64_t)u);
+			}
+			return Nan::New<v8::Number>((double)u);
+		}
+
+		case ZCL_KIND_FLOAT:
+			if(len < t->size) {
+				break;
+			}
+			if(t->size == 2) {
+				return Nan::New<v8::Number>(halfToDouble(BUILD_UINT16(data[0], data[1])));
+			} else if(t->size == 4) {
+				float f;
+				memcpy(&f, data, 4);
+				return Nan::New<v8::Number>(f);
+			} else {
+				double d;
+				memcpy(&d, data, 8);
+				return Nan::New<v8::Number>(d);
+			}
+
+		case ZCL_KIND_CHAR_STR:
+		case ZCL_KIND_LONG_CHAR_STR:
+		{
+			int hdr = (t->kind == ZCL_KIND_CHAR_STR) ? 1 : 2;
+			int n = zclValueLength(dataType, data, len);
+			if(n < 0) {
+				break;
+			}
+			return Nan::New((const char*)data + hdr, n - hdr).ToLocalChecked();
+		}
+
+		case ZCL_KIND_OCTET_STR:
+		case ZCL_KIND_LONG_OCTET_STR:
+		{
+			int hdr = (t->kind == ZCL_KIND_OCTET_STR) ? 1 : 2;
+			int n = zclValueLength(dataType, data, len);
+			if(n < 0) {
+				break;
+			}
+			Local<Object> buf = Nan::NewBuffer(n - hdr).ToLocalChecked();
+			if(n > hdr) {
+				memcpy(node::Buffer::Data(buf), data + hdr, n - hdr);
+			}
+			return buf;
+		}
+
+		case ZCL_KIND_ARRAY:
+		{
+			if(valueLength(dataType, data, len, depth) < 0) {
+				break;
+			}
+			uint16_t n = BUILD_UINT16(data[1], data[2]);
+			if(n == 0xFFFF) {
+				return Nan::Null();
+			}
+			Local<Array> a = Nan::New<v8::Array>(n);
+			uint16_t off = 3;
+			for(uint16_t i = 0; i < n; i++) {
+				int e = valueLength(data[0], data + off, len - off, depth + 1);
+				a->Set(i, decodeValue(data[0], data + off, e, depth + 1));
+				off += e;
+			}
+			return a;
+		}
+
+		case ZCL_KIND_STRUCT:
+		{
+			if(valueLength(dataType, data, len, depth) < 0) {
+				break;
+			}
+			uint16_t n = BUILD_UINT16(data[0], data[1]);
+			if(n == 0xFFFF) {
+				return Nan::Null();
+			}
+			Local<Array> a = Nan::New<v8::Array>(n);
+			uint16_t off = 2;
+			for(uint16_t i = 0; i < n; i++) {
+				uint8_t elemType = data[off++];
+				int e = valueLength(elemType, data + off, len - off, depth + 1);
+				Local<Object> elem = Nan::New<v8::Object>();
+				elem->Set(Nan::New("dataType").ToLocalChecked(), Nan::New(elemType));
+				elem->Set(Nan::New("value").ToLocalChecked(), decodeValue(elemType, data + off, e, depth + 1));
+				a->Set(i, elem);
+				off += e;
+			}
+			return a;
+		}
+
+		case ZCL_KIND_TOD:
+			if(len >= 4) {
+				Local<Object> tod = Nan::New<v8::Object>();
+				tod->Set(Nan::New("hours").ToLocalChecked(), Nan::New(data[0]));
+				tod->Set(Nan::New("minutes").ToLocalChecked(), Nan::New(data[1]));
+				tod->Set(Nan::New("seconds").ToLocalChecked(), Nan::New(data[2]));
+				tod->Set(Nan::New("hundredths").ToLocalChecked(), Nan::New(data[3]));
+				return tod;
+			}
+			break;
+
+		case ZCL_KIND_DATE:
+			if(len >= 4) {
+				Local<Object> date = Nan::New<v8::Object>();
+				date->Set(Nan::New("year").ToLocalChecked(), Nan::New(1900 + data[0]));
+				date->Set(Nan::New("month").ToLocalChecked(), Nan::New(data[1]));
+				date->Set(Nan::New("day").ToLocalChecked(), Nan::New(data[2]));
+				date->Set(Nan::New("weekday").ToLocalChecked(), Nan::New(data[3]));
+				return date;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	//IEEE addresses, keys, unknown types and anything truncated stay raw
+	Local<Object> buf = Nan::NewBuffer(len).ToLocalChecked();
+	if(len > 0) {
+		memcpy(node::Buffer::Data(buf), data, len);
+	}
+	return buf;
+}
+
+Local<Value> zclDecodeValue(uint8_t dataType, const uint8_t *data, uint16_t len)
+{
+	return decodeValue(dataType, data, len, 0);
+}
+
+Local<Array> zclDecodeReadRsp(const uint8_t *payload, uint16_t len)
+{
+	Local<Array> recs = Nan::New<v8::Array>();
+	uint16_t i = 0;
+	uint32_t n = 0;
+
+	//attrId, status, [dataType, value]
+	while(i + 3 <= len) {
+		Local<Object> rec = Nan::New<v8::Object>();
+		uint16_t attrId = BUILD_UINT16(payload[i], payload[i + 1]);
+		uint8_t status = payload[i + 2];
+		i += 3;
+
+		rec->Set(Nan::New("attrId").ToLocalChecked(), Nan::New(attrId));
+		rec->Set(Nan::New("status").ToLocalChecked(), Nan::New(status));
+		if(status == ZCL_STATUS_SUCCESS) {
+			if(i + 1 > len) {
+				break;
+			}
+			uint8_t dataType = payload[i++];
+			int vlen = zclValueLength(dataType, &payload[i], len - i);
+			if(vlen < 0) {
+				//the rest can not be framed without knowing this value's length
+				break;
+			}
+			rec->Set(Nan::New("dataType").ToLocalChecked(), Nan::New(dataType));
+			rec->Set(Nan::New("value").ToLocalChecked(), zclDecodeValue(dataType, &payload[i], vlen));
+			i += vlen;
+		}
+		recs->Set(n++, rec);
+	}
+
+	return recs;
+}
+
+static uint16_t doubleToHalf(double v)
+{
+	uint16_t sign = signbit(v) ? 0x8000 : 0;
+	int e;
+
+	v = fabs(v);
+	if(isnan(v)) {
+		return 0x7E00;
+	}
+	if(v >= 65520.0) {
+		//rounds past the largest half, 65504
+		return sign | 0x7C00;
+	}
+	if(v < ldexp(1, -14)) {
+		//subnormal, in units of 2^-24, rounding up into the smallest normal is still right
+		return sign | (uint16_t)lrint(ldexp(v, 24));
+	}
+	//v = m * 2^e with 0.5 <= m < 1, a half holds (1 + f / 1024) * 2^(exp - 15)
+	long f = lrint(ldexp(frexp(v, &e), 11) - 1024);
+	int exp = e + 14;
+	if(f == 1024) {
+		f = 0;
+		exp++;
+	}
+	return sign | (uint16_t)(exp << 10) | (uint16_t)f;
+}
+
+static void putUint(uint8_t *out, uint64_t u, int size)
+{
+	for(int i = 0; i < size; i++) {
+		out[i] = (uint8_t)(u >> (8 * i));
+	}
+}
+
+//0xFF is the ZCL's "don't care" for every field of a time or date, a value outside
+//min..max is refused rather than wrapped into the byte
+static bool fieldOr(Local<Object> o, const char *name, int min, int max, int bias, uint8_t *out)
+{
+	Local<Value> v = o->Get(Nan::New(name).ToLocalChecked());
+	if(!v->IsNumber()) {
+		*out = 0xFF;
+		return true;
+	}
+	int64_t i = v->IntegerValue();
+	if(i < min || i > max) {
+		return false;
+	}
+	*out = (uint8_t)(i - bias);
+	return true;
+}
+
+static int encodeValue(uint8_t dataType, Local<Value> value, uint8_t *out, uint16_t avail, int depth)
+{
+	const zclTypeInfo *t = zclTypeOf(dataType);
+	int len = t->size;
+
+	if(len > avail) {
+		return -1;
+	}
+
+	switch(t->kind) {
+		case ZCL_KIND_NONE:
+			return 0;
+
+		case ZCL_KIND_BOOL:
+			if(!value->IsBoolean() && !value->IsNumber()) {
+				return -1;
+			}
+			out[0] = value->BooleanValue() ? 1 : 0;
+			return 1;
+
+		case ZCL_KIND_UINT:
+		case ZCL_KIND_INT:
+		{
+			if(!value->IsNumber()) {
+				return -1;
+			}
+			double d = value->NumberValue();
+			double range = ldexp(1, 8 * t->size);
+			if(d != floor(d)) {
+				return -1;
+			}
+			if(t->kind == ZCL_KIND_UINT ? (d < 0 || d >= range) : (d < -range / 2 || d >= range / 2)) {
+				return -1;
+			}
+			putUint(out, d < 0 ? (uint64_t)(int64_t)d : (uint64_t)d, t->size);
+			return len;
+		}
+
+		case ZCL_KIND_FLOAT:
+			if(!value->IsNumber()) {
+				return -1;
+			}
+			if(t->size == 2) {
+				putUint(out, doubleToHalf(value->NumberValue()), 2);
+			} else if(t->size == 4) {
+				float f = (float)value->NumberValue();
+				memcpy(out, &f, 4);
+			} else {
+				double d = value->NumberValue();
+				memcpy(out, &d, 8);
+			}
+			return len;
+
+		case ZCL_KIND_CHAR_STR:
+		case ZCL_KIND_LONG_CHAR_STR:
+		case ZCL_KIND_OCTET_STR:
+		case ZCL_KIND_LONG_OCTET_STR:
+		{
+			bool isLong = (t->kind == ZCL_KIND_LONG_CHAR_STR || t->kind == ZCL_KIND_LONG_OCTET_STR);
+			int hdr = isLong ? 2 : 1;
+			size_t max = isLong ? 0xFFFE : 0xFE;
+			const char *data;
+			size_t n;
+
+			if(hdr > avail) {
+				return -1;
+			}
+			if(value->IsNull()) {
+				//the invalid value
+				putUint(out, isLong ? 0xFFFF : 0xFF, hdr);
+				return hdr;
+			}
+			if(node::Buffer::HasInstance(value)) {
+				data = node::Buffer::Data(value);
+				n = node::Buffer::Length(value);
+			} else if(value->IsString() && (t->kind == ZCL_KIND_CHAR_STR || t->kind == ZCL_KIND_LONG_CHAR_STR)) {
+				String::Utf8Value str(value);
+				n = str.length();
+				if(n > max || hdr + n > avail) {
+					return -1;
+				}
+				putUint(out, n, hdr);
+				memcpy(out + hdr, *str, n);
+				return hdr + n;
+			} else {
+				return -1;
+			}
+			if(n > max || hdr + n > avail) {
+				return -1;
+			}
+			putUint(out, n, hdr);
+			memcpy(out + hdr, data, n);
+			return hdr + n;
+		}
+
+		case ZCL_KIND_ARRAY:
+		{
+			//element type, element count, elements
+			if(avail < 3 || depth >= ZCL_MAX_NESTING || !value->IsObject()) {
+				return -1;
+			}
+			Local<Object> o = value->ToObject();
+			Local<Value> elemType = o->Get(Nan::New("elementType").ToLocalChecked());
+			Local<Value> values = o->Get(Nan::New("values").ToLocalChecked());
+			if(!elemType->IsNumber() || !values->IsArray()) {
+				return -1;
+			}
+			Local<Array> a = Local<Array>::Cast(values);
+			if(a->Length() >= 0xFFFF) {
+				return -1;
+			}
+			out[0] = (uint8_t)elemType->Uint32Value();
+			putUint(out + 1, a->Length(), 2);
+			len = 3;
+			for(uint32_t i = 0; i < a->Length(); i++) {
+				int e = encodeValue(out[0], a->Get(i), out + len, avail - len, depth + 1);
+				if(e < 0) {
+					return -1;
+				}
+				len += e;
+			}
+			return len;
+		}
+
+		case ZCL_KIND_STRUCT:
+		{
+			//element count, then element type and value for each
+			if(avail < 2 || depth >= ZCL_MAX_NESTING || !value->IsArray()) {
+				return -1;
+			}
+			Local<Array> a = Local<Array>::Cast(value);
+			if(a->Length() >= 0xFFFF) {
+				return -1;
+			}
+			putUint(out, a->Length(), 2);
+			len = 2;
+			for(uint32_t i = 0; i < a->Length(); i++) {
+				if(!a->Get(i)->IsObject() || len + 1 > avail) {
+					return -1;
+				}
+				Local<Object> elem = a->Get(i)->ToObject();
+				Local<Value> elemType = elem->Get(Nan::New("dataType").ToLocalChecked());
+				if(!elemType->IsNumber()) {
+					return -1;
+				}
+				out[len] = (uint8_t)elemType->Uint32Value();
+				int e = encodeValue(out[len], elem->Get(Nan::New("value").ToLocalChecked()), out + len + 1, avail - len - 1, depth + 1);
+				if(e < 0) {
+					return -1;
+				}
+				len += 1 + e;
+			}
+			return len;
+		}
+
+		case ZCL_KIND_TOD:
+		case ZCL_KIND_DATE:
+		{
+			if(!value->IsObject()) {
+				return -1;
+			}
+			Local<Object> o = value->ToObject();
+			bool ok;
+			if(t->kind == ZCL_KIND_TOD) {
+				ok = fieldOr(o, "hours",		0,		23,		0,		&out[0]) &&
+					fieldOr(o, "minutes",		0,		59,		0,		&out[1]) &&
+					fieldOr(o, "seconds",		0,		59,		0,		&out[2]) &&
+					fieldOr(o, "hundredths",	0,		99,		0,		&out[3]);
+			} else {
+				//years 1900 to 2154, 0xFF is taken by "don't care"
+				ok = fieldOr(o, "year",		1900,	2154,	1900,	&out[0]) &&
+					fieldOr(o, "month",		1,		12,		0,		&out[1]) &&
+					fieldOr(o, "day",			1,		31,		0,		&out[2]) &&
+					fieldOr(o, "weekday",		1,		7,		0,		&out[3]);
+			}
+			return ok ? len : -1;
+		}
+
+		default:
+			break;
+	}
+
+	//IEEE addresses and keys are taken as Buffers of their size, unknown types as is
+	if(!node::Buffer::HasInstance(value)) {
+		return -1;
+	}
+	size_t n = node::Buffer::Length(value);
+	if(t->kind == ZCL_KIND_UNKNOWN ? n > avail : n != t->size) {
+		return -1;
+	}
+	memcpy(out, node::Buffer::Data(value), n);
+	return n;
+}
+
+int zclEncodeValue(uint8_t dataType, Local<Value> value, uint8_t *out, uint16_t avail)
+{
+	return encodeValue(dataType, value, out, avail, 0);
+}
@@ -0,0 +1,76 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_ZCLTYPES_H_
+#define _ZNP_ZCLTYPES_H_
+
+#include <stdint.h>
+#include <nan.h>
+
+/*
+ * ZCL data types and their over the air encoding.
+ *
+ * One table describes every data type the ZCL defines, so read responses
+ * and reports are decoded to JS values here once instead of in every
+ * consumer of onAttrResponse / onAttributeReport, and typed values from JS
+ * are encoded straight into outgoing requests. The zcl library sizes
+ * attributes from the same table.
+ */
+enum zcl_kind {
+	ZCL_KIND_UNKNOWN,
+	ZCL_KIND_NONE,			//no data
+	ZCL_KIND_BOOL,
+	ZCL_KIND_UINT,			//also general data, bitmaps, enums and ids
+	ZCL_KIND_INT,
+	ZCL_KIND_FLOAT,			//semi, single and double precision
+	ZCL_KIND_OCTET_STR,
+	ZCL_KIND_CHAR_STR,
+	ZCL_KIND_LONG_OCTET_STR,
+	ZCL_KIND_LONG_CHAR_STR,
+	ZCL_KIND_ARRAY,			//also set and bag
+	ZCL_KIND_STRUCT,
+	ZCL_KIND_TOD,
+	ZCL_KIND_DATE,
+	ZCL_KIND_BYTES			//IEEE address, security key
+};
+
+typedef struct {
+	uint8_t dataType;
+	uint8_t kind;			//zcl_kind
+	uint8_t size;			//fixed size in bytes, 0 for variable length types
+	bool analog;			//reportable change is a value of the type, not a bit mask
+} zclTypeInfo;
+
+const zclTypeInfo *zclTypeOf(uint8_t dataType);
+
+//Bytes one value takes on air, -1 if it is malformed or runs past avail
+int zclValueLength(uint8_t dataType, const uint8_t *data, uint16_t avail);
+
+//One value to a JS value: numbers, booleans, strings, arrays, objects for
+//times and dates, Buffers for octet strings and anything not understood
+v8::Local<v8::Value> zclDecodeValue(uint8_t dataType, const uint8_t *data, uint16_t len);
+
+//A JS value, in the shapes zclDecodeValue produces, to its over the air
+//encoding at out. Arrays, sets and bags take { elementType, values }.
+//Returns the bytes written, -1 if the value does not fit the type or avail
+int zclEncodeValue(uint8_t dataType, v8::Local<v8::Value> value, uint8_t *out, uint16_t avail);
+
+//Read attributes response payload to [{ attrId, status, dataType, value }]
+v8::Local<v8::Array> zclDecodeReadRsp(const uint8_t *payload, uint16_t len);
+
+#endif //_ZNP_ZCLTYPES_H_
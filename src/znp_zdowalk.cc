@@ -0,0 +1,194 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "znp_zdowalk.h"
+#include "rpc.h"
+
+//ZDP status of a device that does not implement the request, asking again will not help
+#define ZDP_NOT_SUPPORTED	0x84
+
+ZdoTableWalker::ZdoTableWalker() :
+	running(false),
+	started(0),
+	done(0)
+{
+	opts.maxInFlight = 4;
+	opts.timeoutMs = 5000;
+	opts.retries = 2;
+	run = opts;
+	reset();
+}
+
+void ZdoTableWalker::configure(const zdo_walk_options &o)
+{
+	opts = o;
+	if(opts.maxInFlight == 0) {
+		opts.maxInFlight = 1;
+	}
+}
+
+void ZdoTableWalker::reset()
+{
+	walks.clear();
+	pending.clear();
+	queued.clear();
+	counts.tables = 0;
+	counts.entries = 0;
+	counts.requests = 0;
+	counts.retries = 0;
+	counts.durationMs = 0;
+	counts.failed.clear();
+}
+
+void ZdoTableWalker::begin(const zdo_walk_options &o, uint64_t now)
+{
+	reset();
+	run = o;
+	if(run.maxInFlight == 0) {
+		run.maxInFlight = 1;
+	}
+	running = true;
+	started = now;
+}
+
+void ZdoTableWalker::queue(uint16_t nwkAddr)
+{
+	if(queued.insert(nwkAddr).second) {
+		pending.push_back(nwkAddr);
+	}
+}
+
+void ZdoTableWalker::fail(std::map<uint16_t, walk>::iterator it)
+{
+	counts.failed.push_back(it->first);
+	discard(it->first);
+	walks.erase(it);
+}
+
+bool ZdoTableWalker::page(uint16_t nwkAddr, uint8_t status, uint8_t startIndex, uint8_t count,
+		uint16_t tableEntries, const void *rsp, uint64_t now)
+{
+	std::map<uint16_t, walk>::iterator it = walks.find(nwkAddr);
+
+	if(!running || it == walks.end()) {
+		return false;
+	}
+	walk &w = it->second;
+
+	//a late answer to a page already asked again is as good as the retry's
+	if(status == MT_RPC_SUCCESS && startIndex != w.startIndex) {
+		return true;
+	}
+
+	if(status != MT_RPC_SUCCESS) {
+		if(status == ZDP_NOT_SUPPORTED || w.tries > run.retries) {
+			fail(it);
+		} else {
+			//ask again on the next due()
+			w.asked = false;
+		}
+		return true;
+	}
+
+	decode(nwkAddr, rsp);
+
+	uint16_t next = startIndex + count;
+	if(count == 0 || next >= tableEntries) {
+		counts.tables++;
+		counts.entries += complete(nwkAddr, status, now);
+		walks.erase(it);
+	} else {
+		w.startIndex = next;
+		w.tries = 0;
+		w.asked = false;
+	}
+
+	return true;
+}
+
+void ZdoTableWalker::due(uint64_t now, std::vector<request> &send)
+{
+	if(!running) {
+		return;
+	}
+
+	for(std::map<uint16_t, walk>::iterator it = walks.begin(); it != walks.end(); ) {
+		walk &w = it->second;
+
+		if(w.asked && now < w.deadline) {
+			it++;
+			continue;
+		}
+		if(w.tries > run.retries) {
+			fail(it++);
+			continue;
+		}
+		if(w.tries > 0) {
+			counts.retries++;
+		}
+		w.tries++;
+		w.asked = true;
+		w.deadline = now + run.timeoutMs;
+		counts.requests++;
+
+		request r;
+		r.nwkAddr = it->first;
+		r.startIndex = w.startIndex;
+		send.push_back(r);
+		it++;
+	}
+
+	while(!pending.empty() && walks.size() < run.maxInFlight) {
+		walk w;
+		w.startIndex = 0;
+		w.tries = 1;
+		w.asked = true;
+		w.deadline = now + run.timeoutMs;
+		walks[pending.front()] = w;
+		counts.requests++;
+
+		request r;
+		r.nwkAddr = pending.front();
+		r.startIndex = 0;
+		send.push_back(r);
+		pending.pop_front();
+	}
+}
+
+uint64_t ZdoTableWalker::nextDeadline() const
+{
+	uint64_t wake = 0;
+
+	for(std::map<uint16_t, walk>::const_iterator it = walks.begin(); it != walks.end(); it++) {
+		if(it->second.asked && (wake == 0 || it->second.deadline < wake)) {
+			wake = it->second.deadline;
+		}
+	}
+	return wake;
+}
+
+bool ZdoTableWalker::finish(uint64_t now)
+{
+	if(!running || !walks.empty() || !pending.empty()) {
+		return false;
+	}
+	running = false;
+	done++;
+	counts.durationMs = now - started;
+	return true;
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2018, Arm Limited and affiliates.
+
+    SPDX-License-Identifier: Apache-2.0
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _ZNP_ZDOWALK_H_
+#define _ZNP_ZDOWALK_H_
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+/*
+ * ZDO table walker.
+ *
+ * Reads a management table (neighbors, routes) of a number of devices page
+ * by page: each device is asked once per walk, its table is read until the
+ * entry count its answers give is in, no more than maxInFlight devices are
+ * read at a time and pages that get no answer are asked again up to retries
+ * times. What a table holds is left to the subclass, which decodes each
+ * page it is given and takes every table read completely.
+ *
+ * Only used from the v8 thread, it does not lock.
+ */
+
+typedef struct {
+	uint8_t		maxInFlight;		//devices read at once
+	uint32_t	timeoutMs;			//wait for a page before asking again
+	uint8_t		retries;			//asks per page after the first
+} zdo_walk_options;
+
+class ZdoTableWalker {
+	public:
+		typedef struct {
+			uint16_t	nwkAddr;
+			uint8_t		startIndex;
+		} request;
+
+		typedef struct {
+			uint32_t	tables;			//read completely
+			uint32_t	entries;
+			uint32_t	requests;		//pages asked for, retries included
+			uint32_t	retries;
+			uint32_t	durationMs;
+			std::vector<uint16_t> failed;	//devices that never answered
+		} walk_summary;
+
+		ZdoTableWalker();
+		virtual ~ZdoTableWalker() {}
+
+		//Options walks run with unless they are started with their own
+		void configure(const zdo_walk_options &opts);
+		const zdo_walk_options &options() const { return opts; }
+
+		bool active() const { return running; }
+
+		//Pages to ask for now: further pages, retries and new devices up to maxInFlight.
+		//A request the ZNP does not accept needs nothing, it is asked again once it times out.
+		void due(uint64_t now, std::vector<request> &send);
+		//Loop time of the earliest page timeout, 0 if nothing is in flight
+		uint64_t nextDeadline() const;
+		//Nothing left to ask and nothing in flight. Ends the walk.
+		bool finish(uint64_t now);
+		//Of the walk in progress or the last one
+		const walk_summary &summary() const { return counts; }
+		//Walks that ran to the end
+		uint32_t walksFinished() const { return done; }
+
+	protected:
+		//Forget any walk in progress, the next one runs with o
+		void begin(const zdo_walk_options &o, uint64_t now);
+		//Read the table of nwkAddr in this walk, once
+		void queue(uint16_t nwkAddr);
+		//A response page with count entries of a table of tableEntries.
+		//Returns false if no walk asked for it.
+		bool page(uint16_t nwkAddr, uint8_t status, uint8_t startIndex, uint8_t count,
+				uint16_t tableEntries, const void *rsp, uint64_t now);
+
+		//The entries of a page of nwkAddr's table, in order
+		virtual void decode(uint16_t nwkAddr, const void *rsp) = 0;
+		//The last page of nwkAddr's table is in. Returns the entries it has.
+		virtual uint32_t complete(uint16_t nwkAddr, uint8_t status, uint64_t now) = 0;
+		//Pages decoded for nwkAddr are no good, it failed
+		virtual void discard(uint16_t nwkAddr) = 0;
+
+		walk_summary counts;
+
+	private:
+		typedef struct {
+			uint8_t		startIndex;		//next page
+			uint8_t		tries;			//asks for this page so far
+			bool		asked;			//the page is in flight
+			uint64_t	deadline;
+		} walk;
+
+		void reset();
+		void fail(std::map<uint16_t, walk>::iterator it);
+
+		zdo_walk_options opts;
+		zdo_walk_options run;				//of the walk in progress
+		bool running;
+		uint64_t started;
+		uint32_t done;
+
+		std::map<uint16_t, walk> walks;		//devices being read, keyed by nwk addr
+		std::deque<uint16_t> pending;		//queued, not asked yet
+		std::set<uint16_t> queued;			//queued this walk
+};
+
+#endif //_ZNP_ZDOWALK_H_